@@ -38,8 +38,10 @@
 #define __DGIFF_H__
 
 #include <inttypes.h>
+#include <stdio.h>
 
 #define DGIFF_FLAG_LITTLE_ENDIAN   0x01
+#define DGIFF_FLAG_ALIGNED_ROWS    0x02      /* Pixel data of rows starts at multiples of 'row_align' */
 
 typedef struct {
      unsigned char  magic[5];      /* "DGIFF" magic */
@@ -53,7 +55,7 @@ typedef struct {
 
      uint32_t       num_faces;
 
-     uint32_t       __pad;
+     uint32_t       row_align;     /* File offset alignment of row pixel data, see DGIFF_FLAG_ALIGNED_ROWS */
 } DGIFFHeader;
 
 typedef struct {
@@ -99,5 +101,53 @@ typedef struct {
      /* Raw pixel data follows, "height * pitch" bytes. */
 } DGIFFGlyphRow;
 
+/*
+ * Returns the number of bytes to pad before a row header at file 'offset' to align the pixel data following it.
+ */
+static inline unsigned long
+dgiff_row_padding( unsigned long offset, unsigned long row_align )
+{
+     if (!row_align)
+          return 0;
+
+     return (row_align - (offset + sizeof(DGIFFGlyphRow)) % row_align) % row_align;
+}
+
+/*
+ * Returns the row located at or after 'ptr' within the file mapped at 'header'.
+ *
+ * With DGIFF_FLAG_ALIGNED_ROWS, each row header is preceded by padding,
+ * so that the pixel data following it starts at a multiple of 'row_align'.
+ */
+static inline DGIFFGlyphRow *
+dgiff_align_row( const DGIFFHeader *header, const void *ptr )
+{
+     unsigned long offset;
+
+     if (!(header->flags & DGIFF_FLAG_ALIGNED_ROWS))
+          return (DGIFFGlyphRow*) ptr;
+
+     offset = (const char*) ptr - (const char*) header;
+
+     return (DGIFFGlyphRow*) ((const char*) ptr + dgiff_row_padding( offset, header->row_align ));
+}
+
+/*
+ * Writes 'size' zero bytes of padding, see dgiff_row_padding().
+ */
+static inline void
+dgiff_write_padding( FILE *stream, unsigned long size )
+{
+     static const unsigned char zeros[1024] = { 0 };
+
+     while (size) {
+          unsigned long num = size < sizeof(zeros) ? size : sizeof(zeros);
+
+          fwrite( zeros, num, 1, stream );
+
+          size -= num;
+     }
+}
+
 #endif
 
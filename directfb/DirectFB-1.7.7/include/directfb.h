@@ -1444,6 +1444,17 @@ typedef struct {
      DFBSurfaceColorSpace               colorspace;  /* color space */
 } DFBSurfaceDescription;
 
+/*
+ * Buffer of a surface in a file, e.g. a memfd or dma-buf received from another process.
+ *
+ * See IDirectFB::CreateSurfaceFromFDs().
+ */
+typedef struct {
+     int                                fd;          /* file descriptor of existing buffer */
+     unsigned int                       offset;      /* offset of buffer data within the file */
+     int                                pitch;       /* pitch of buffer */
+} DFBSurfaceBufferFD;
+
 /*
  * Description of the palette that is to be created.
  */
@@ -2209,6 +2220,26 @@ D_DEFINE_INTERFACE(   IDirectFB,
           DFBSurfaceID              surface_id,
           IDirectFBSurface        **ret_interface
      );
+
+     /*
+      * Create a surface using the memory of files instead of allocating it.
+      *
+      * The <b>fds</b> array has one entry per buffer (see DSCAPS_DOUBLE and
+      * DSCAPS_TRIPLE), each giving a memfd or dma-buf file descriptor with
+      * the offset and pitch of the pixel data. The descriptors stay owned
+      * by the caller, DirectFB imports its own references.
+      *
+      * Unlike DSDESC_PREALLOCATED, the pixels are not copied between
+      * processes, the surface can be accessed by any process directly.
+      *
+      * The description must not contain DSDESC_PREALLOCATED or DSCAPS_PRIMARY.
+      */
+     DFBResult (*CreateSurfaceFromFDs) (
+          IDirectFB                    *thiz,
+          const DFBSurfaceDescription  *desc,
+          const DFBSurfaceBufferFD     *fds,
+          IDirectFBSurface            **ret_interface
+     );
 )
 
 /* predefined layer ids */
@@ -6819,6 +6850,25 @@ D_DEFINE_INTERFACE(   IDirectFBFont,
           IDirectFBFont            *thiz,
           DFBFontDescription       *ret_description
      );
+
+
+   /** Glyph cache **/
+
+     /*
+      * Load the glyphs of a string into the glyph cache.
+      *
+      * Glyphs not cached yet are rasterized up front, in parallel
+      * if the font implementation supports it, so that the first
+      * DrawString() with this text does not have to.
+      *
+      * If <b>bytes</b> is -1, the string is assumed to be
+      * terminated by a NULL character.
+      */
+     DFBResult (*PrefetchGlyphs) (
+          IDirectFBFont            *thiz,
+          const char               *text,
+          int                       bytes
+     );
 )
 
 /*
@@ -6856,6 +6906,12 @@ typedef enum {
  */
 typedef DIRenderCallbackResult (*DIRenderCallback)(DFBRectangle *rect, void *ctx);
 
+/*
+ * Called once an image rendered by IDirectFBImageProvider::RenderToAsync() is complete,
+ * with the result RenderTo() would have returned.
+ */
+typedef void (*DIRenderDoneCallback)(DFBResult result, void *ctx);
+
 /**************************
  * IDirectFBImageProvider *
  **************************/
@@ -6946,6 +7002,24 @@ D_DEFINE_INTERFACE(   IDirectFBImageProvider,
           const DFBRectangle       *src_rect,
           const char               *filename
      );
+
+   /** Rendering **/
+
+     /*
+      * Render the file contents like RenderTo() in a separate thread.
+      *
+      * Returns immediately, the callback is called from that thread
+      * when rendering has finished. The provider and the destination
+      * are referenced until then, the provider must not be used for
+      * anything else meanwhile.
+      */
+     DFBResult (*RenderToAsync) (
+          IDirectFBImageProvider   *thiz,
+          IDirectFBSurface         *destination,
+          const DFBRectangle       *destination_rect,
+          DIRenderDoneCallback      callback,
+          void                     *callback_data
+     );
 )
 
 /*
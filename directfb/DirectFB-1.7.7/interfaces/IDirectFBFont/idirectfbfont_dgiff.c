@@ -33,6 +33,7 @@
 #include <config.h>
 
 #include <fcntl.h>
+#include <stdlib.h>
 #include <unistd.h>
 
 #include <sys/mman.h>
@@ -59,6 +60,8 @@
 #include <direct/memcpy.h>
 #include <direct/utf8.h>
 
+#include <fusion/conf.h>
+
 #include <dgiff.h>
 
 
@@ -84,27 +87,59 @@ DIRECT_INTERFACE_IMPLEMENTATION( IDirectFBFont, DGIFF )
 /**********************************************************************************************************************/
 
 typedef struct {
-     unsigned int                 stamp;
-
-     CoreSurface                 *surface;
-     int                          next_x;
-
-     DirectLink                  *glyphs;
-
-     int                          magic;
-} CoreFontCacheRow;
+     DGIFFGlyphRow               *row;           /* header and pixel data in the map */
+     CoreSurface                 *surface;       /* created on first use of a glyph  */
+} DGIFFRow;
 
 
 typedef struct {
      void *map;     /* Memory map of the file. */
      int   size;    /* Size of the memory map. */
 
-     CoreFontCacheRow            **rows;          /* contain bitmaps of loaded glyphs */
-     int                           num_rows;
+     DGIFFGlyphInfo               *glyphs;
+     unsigned int                  num_glyphs;
+     DGIFFGlyphInfo              **order;         /* glyphs sorted by unicode, unless they are in the file */
+
+     DGIFFRow                     *rows;
+     unsigned int                  num_rows;
+
+     bool                          prealloc;      /* wrap the mapped rows instead of copying them */
 } DGIFFImplData;
 
 /**********************************************************************************************************************/
 
+static void
+dgiff_impl_free( DGIFFImplData *impl )
+{
+     unsigned int i;
+     bool         created = false;
+
+     if (impl->rows) {
+          for (i=0; i<impl->num_rows; i++) {
+               if (impl->rows[i].surface) {
+                    created = true;
+
+                    dfb_surface_unref( impl->rows[i].surface );
+               }
+          }
+
+          /* Row surfaces may wrap the map and still be used by queued blits
+             (or other references), let them finish before unmapping. */
+          if (created)
+               dfb_gfxcard_sync();
+
+          D_FREE( impl->rows );
+     }
+
+     if (impl->order)
+          D_FREE( impl->order );
+
+     if (impl->map)
+          munmap( impl->map, impl->size );
+
+     D_FREE( impl );
+}
+
 static void
 IDirectFBFont_DGIFF_Destruct( IDirectFBFont *thiz )
 {
@@ -112,11 +147,9 @@ IDirectFBFont_DGIFF_Destruct( IDirectFBFont *thiz )
      CoreFont           *font = data->font;
      DGIFFImplData      *impl = font->impl_data;
 
-     munmap( impl->map, impl->size );
-
-     D_FREE( impl );
-
      IDirectFBFont_Destruct( thiz );
+
+     dgiff_impl_free( impl );
 }
 
 
@@ -132,6 +165,168 @@ IDirectFBFont_DGIFF_Release( IDirectFBFont *thiz )
      return DFB_OK;
 }
 
+/**********************************************************************************************************************/
+
+static int
+compare_unicode( const void *a, const void *b )
+{
+     const DGIFFGlyphInfo *ga = *(DGIFFGlyphInfo * const *) a;
+     const DGIFFGlyphInfo *gb = *(DGIFFGlyphInfo * const *) b;
+
+     return (ga->unicode > gb->unicode) - (ga->unicode < gb->unicode);
+}
+
+/*
+ * mkdgiff writes glyphs sorted by unicode, other files get a sorted index for the lookup.
+ */
+static DFBResult
+sort_glyphs( DGIFFImplData *impl )
+{
+     unsigned int i;
+
+     for (i=1; i<impl->num_glyphs; i++) {
+          if (impl->glyphs[i-1].unicode >= impl->glyphs[i].unicode)
+               break;
+     }
+
+     if (i >= impl->num_glyphs)
+          return DFB_OK;
+
+     impl->order = D_MALLOC( impl->num_glyphs * sizeof(DGIFFGlyphInfo*) );
+     if (!impl->order)
+          return D_OOM();
+
+     for (i=0; i<impl->num_glyphs; i++)
+          impl->order[i] = &impl->glyphs[i];
+
+     qsort( impl->order, impl->num_glyphs, sizeof(DGIFFGlyphInfo*), compare_unicode );
+
+     return DFB_OK;
+}
+
+static DGIFFGlyphInfo *
+find_glyph( const DGIFFImplData *impl,
+            unsigned int         unicode )
+{
+     unsigned int lower = 0;
+     unsigned int upper = impl->num_glyphs;
+
+     while (lower < upper) {
+          unsigned int    middle = (lower + upper) / 2;
+          DGIFFGlyphInfo *glyph  = impl->order ? impl->order[middle] : &impl->glyphs[middle];
+
+          if (glyph->unicode == unicode)
+               return glyph;
+
+          if (glyph->unicode < unicode)
+               lower = middle + 1;
+          else
+               upper = middle;
+     }
+
+     return NULL;
+}
+
+/*
+ * Creates the surface of a glyph row on first use, wrapping the mapped pixel data if possible.
+ */
+static DFBResult
+get_row_surface( CoreFont       *font,
+                 DGIFFImplData  *impl,
+                 unsigned int    index,
+                 CoreSurface   **ret_surface )
+{
+     DFBResult          ret;
+     DGIFFRow          *row = &impl->rows[index];
+     CoreSurfaceConfig  config;
+
+     if (row->surface) {
+          *ret_surface = row->surface;
+          return DFB_OK;
+     }
+
+     D_DEBUG_AT( Font_DGIFF, "%s( %u ) <- %dx%d, pitch %d\n", __FUNCTION__,
+                 index, row->row->width, row->row->height, row->row->pitch );
+
+     config.flags  = CSCONF_SIZE | CSCONF_FORMAT;
+     config.size.w = row->row->width;
+     config.size.h = row->row->height;
+     config.format = font->pixel_format;
+
+     /* Glyph rows are only read from, e.g. when blitting or uploading them to video memory. */
+     if (impl->prealloc && !((unsigned long)(row->row + 1) & 7)) {
+          config.flags |= CSCONF_PREALLOCATED;
+
+          config.preallocated[0].addr  = (void*)(row->row + 1);
+          config.preallocated[0].pitch = row->row->pitch;
+          config.preallocated[1].addr  = NULL;
+          config.preallocated[1].pitch = 0;
+
+          ret = CoreDFB_CreateSurface( font->core, &config, CSTF_PREALLOCATED, 0, NULL, &row->surface );
+          if (ret == DFB_OK) {
+               *ret_surface = row->surface;
+               return DFB_OK;
+          }
+
+          D_DEBUG_AT( Font_DGIFF, "  -> preallocated surface failed (%s), copying rows\n", DirectFBErrorString( ret ) );
+
+          impl->prealloc = false;
+
+          config.flags &= ~CSCONF_PREALLOCATED;
+     }
+
+     ret = CoreDFB_CreateSurface( font->core, &config, CSTF_NONE, 0, NULL, &row->surface );
+     if (ret) {
+          D_DERROR( ret, "DGIFF/Font: Could not create %s %dx%d glyph row surface!\n",
+                    dfb_pixelformat_name(font->pixel_format), row->row->width, row->row->height );
+          return ret;
+     }
+
+     dfb_surface_write_buffer( row->surface, CSBR_BACK, (void*)(row->row + 1), row->row->pitch, NULL );
+
+     *ret_surface = row->surface;
+
+     return DFB_OK;
+}
+
+static DFBResult
+DGIFF_GetGlyphData( CoreFont      *thiz,
+                    unsigned int   index,
+                    CoreGlyphData *info )
+{
+     DGIFFImplData  *impl  = thiz->impl_data;
+     DGIFFGlyphInfo *glyph = find_glyph( impl, index );
+
+     /* Characters missing in the file are cached as empty glyphs. */
+     if (!glyph) {
+          info->width    = 0;
+          info->height   = 0;
+          info->xadvance = 0;
+          info->yadvance = 0;
+
+          return DFB_OK;
+     }
+
+     if (glyph->row >= impl->num_rows)
+          return DFB_FAILURE;
+
+     info->start    = glyph->offset;
+     info->start_y  = 0;
+     info->width    = glyph->width;
+     info->height   = glyph->height;
+     info->left     = glyph->left;
+     info->top      = glyph->top;
+     info->xadvance = glyph->advance << 8;
+     info->yadvance = 0;
+
+     if (info->width < 1 || info->height < 1)
+          return DFB_OK;
+
+     return get_row_surface( thiz, impl, glyph->row, &info->surface );
+}
+
+/**********************************************************************************************************************/
+
 static DFBResult
 Probe( IDirectFBFont_ProbeContext *ctx )
 {
@@ -175,7 +370,7 @@ Construct( IDirectFBFont               *thiz,
            DFBFontDescription          *desc )
 {
      DFBResult        ret;
-     int              i;
+     unsigned int     i;
      int              fd;
      struct stat      stat;
      void            *ptr  = MAP_FAILED;
@@ -186,7 +381,6 @@ Construct( IDirectFBFont               *thiz,
      DGIFFGlyphRow   *row;
      DGIFFImplData   *data = NULL;
      const char      *filename;
-     CoreSurfaceConfig config;
 
      D_DEBUG_AT( Font_DGIFF, "%s()\n", __func__ );
 
@@ -240,25 +434,7 @@ Construct( IDirectFBFont               *thiz,
      }
 
      glyphs = (void*)(face + 1);
-     row    = (void*)(glyphs + face->num_glyphs);
-
-     /* Create the core object. */
-     ret = dfb_font_create( core, desc, filename, &font );
-     if (ret)
-          goto error;
-
-     /* Fill font information. */
-     font->ascender     = face->ascender;
-     font->descender    = face->descender;
-     font->height       = face->height;
-     font->up_unit_x    =  0.0;
-     font->up_unit_y    = -1.0;
-
-     font->maxadvance   = face->max_advance;
-     font->pixel_format = face->pixelformat;
-     font->surface_caps = DSCAPS_NONE;
-     font->flags        = CFF_SUBPIXEL_ADVANCE;
-
+     row    = dgiff_align_row( header, glyphs + face->num_glyphs );
 
      data = D_CALLOC( 1, sizeof(DGIFFImplData) );
      if (!data) {
@@ -266,98 +442,67 @@ Construct( IDirectFBFont               *thiz,
           goto error;
      }
 
-     data->num_rows     = face->num_rows;
+     data->map        = ptr;
+     data->size       = stat.st_size;
+     data->glyphs     = glyphs;
+     data->num_glyphs = face->num_glyphs;
+     data->num_rows   = face->num_rows;
 
-     if (face->blittingflags)
-          font->blittingflags = face->blittingflags;
-
-     CORE_FONT_DEBUG_AT( Font_DGIFF, font );
+     /* Preallocated surfaces are only accessible by their creator. */
+     data->prealloc   = !fusion_config->secure_fusion;
 
-     /* Allocate array for glyph cache rows. */
-     data->rows = D_CALLOC( face->num_rows, sizeof(void*) );
+     /* Locate the glyph rows, their surfaces are created on first use. */
+     data->rows = D_CALLOC( face->num_rows, sizeof(DGIFFRow) );
      if (!data->rows) {
           ret = D_OOM();
           goto error;
      }
 
-     /* Build glyph cache rows. */
-     bool prealloc = false;
-
-     config.flags  = CSCONF_SIZE | CSCONF_FORMAT;
-     config.format = face->pixelformat;
-
-     if (prealloc) {
-          config.flags |= CSCONF_PREALLOCATED;
-
-          config.preallocated[1].addr = NULL;
-          config.preallocated[1].pitch = 0;
-     }
-
      for (i=0; i<face->num_rows; i++) {
-          data->rows[i] = D_CALLOC( 1, sizeof(CoreFontCacheRow) );
-          if (!data->rows[i]) {
-               ret = D_OOM();
-               goto error;
-          }
-
-          config.size.w = row->width;
-          config.size.h = row->height;
-
-          if (prealloc) {
-               config.preallocated[0].addr = (void*)(row+1);
-               config.preallocated[0].pitch = row->pitch;
-          }
-
-          ret = CoreDFB_CreateSurface( core, &config, prealloc ? CSTF_PREALLOCATED : CSTF_NONE, 0, NULL,
-                                       &data->rows[i]->surface );
-
-          if (ret) {
-               D_DERROR( ret, "DGIFF/Font: Could not create preallocated %s %dx%d glyph row surface!\n",
-                         dfb_pixelformat_name(face->pixelformat), row->width, row->height );
+          if ((void*)(row + 1) + row->pitch * row->height > ptr + stat.st_size) {
+               ret = DFB_FAILURE;
+               D_ERROR( "Font/DGIFF: Glyph row %u exceeds the size of '%s'!\n", i, filename );
                goto error;
           }
 
-          if (!prealloc)
-               dfb_surface_write_buffer( data->rows[i]->surface, CSBR_BACK, (void*)(row+1), row->pitch, NULL );
-
-          D_MAGIC_SET( data->rows[i], CoreFontCacheRow );
+          data->rows[i].row = row;
 
           /* Jump to next row. */
-          row = (void*)(row + 1) + row->pitch * row->height;
+          row = dgiff_align_row( header, (void*)(row + 1) + row->pitch * row->height );
      }
 
-     /* Build glyph infos. */
-     for (i=0; i<face->num_glyphs; i++) {
-          CoreGlyphData  *glyph_data;
-          DGIFFGlyphInfo *glyph = &glyphs[i];
+     ret = sort_glyphs( data );
+     if (ret)
+          goto error;
 
-          glyph_data = D_CALLOC( 1, sizeof(CoreGlyphData) );
-          if (!glyph_data) {
-               ret = D_OOM();
-               goto error;
-          }
+     /* Create the core object. */
+     ret = dfb_font_create( core, desc, filename, &font );
+     if (ret)
+          goto error;
 
-          glyph_data->surface  = data->rows[glyph->row]->surface;
+     /* Fill font information. */
+     font->ascender     = face->ascender;
+     font->descender    = face->descender;
+     font->height       = face->height;
+     font->up_unit_x    =  0.0;
+     font->up_unit_y    = -1.0;
 
-          glyph_data->start    = glyph->offset;
-          glyph_data->width    = glyph->width;
-          glyph_data->height   = glyph->height;
-          glyph_data->left     = glyph->left;
-          glyph_data->top      = glyph->top;
-          glyph_data->xadvance = glyph->advance << 8;
-          glyph_data->yadvance = 0;
+     font->maxadvance   = face->max_advance;
+     font->pixel_format = face->pixelformat;
+     font->surface_caps = DSCAPS_NONE;
+     font->flags        = CFF_SUBPIXEL_ADVANCE;
 
-          D_MAGIC_SET( glyph_data, CoreGlyphData );
+     if (face->blittingflags)
+          font->blittingflags = face->blittingflags;
 
-          direct_hash_insert( font->layers[0].glyph_hash, glyph->unicode, glyph_data );
+     /* Glyphs are looked up on first use, pointing into their row surface. */
+     font->GetGlyphData = DGIFF_GetGlyphData;
 
-          if (glyph->unicode < 128)
-               font->layers[0].glyph_data[glyph->unicode] = glyph_data;
-     }
+     CORE_FONT_DEBUG_AT( Font_DGIFF, font );
 
+     D_DEBUG_AT( Font_DGIFF, "  -> %u glyphs, %u rows%s\n", data->num_glyphs, data->num_rows,
+                 (header->flags & DGIFF_FLAG_ALIGNED_ROWS) ? " (aligned)" : "" );
 
-     data->map  = ptr;
-     data->size = stat.st_size;
 
      font->impl_data = data;
 
@@ -373,26 +518,12 @@ Construct( IDirectFBFont               *thiz,
 
 
 error:
-     if (font) {
-          if (data->rows) {
-               for (i=0; i<data->num_rows; i++) {
-                    if (data->rows[i]) {
-                         if (data->rows[i]->surface)
-                              dfb_surface_unref( data->rows[i]->surface );
-
-                         D_FREE( data->rows[i] );
-                    }
-               }
-
-               D_FREE( data->rows );
-
-               data->rows = NULL;
-          }
-
+     if (font)
           dfb_font_destroy( font );
-     }
 
-     if (ptr != MAP_FAILED)
+     if (data)
+          dgiff_impl_free( data );
+     else if (ptr != MAP_FAILED)
           munmap( ptr, stat.st_size );
 
      close( fd );
@@ -32,12 +32,21 @@
 
 #include <config.h>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <stdarg.h>
 #include <math.h>
 
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <directfb.h>
 
 #include <core/fonts.h>
@@ -49,9 +58,11 @@
 
 #include <media/idirectfbfont.h>
 
+#include <direct/hash.h>
 #include <direct/mem.h>
 #include <direct/memcpy.h>
 #include <direct/messages.h>
+#include <direct/thread.h>
 #include <direct/utf8.h>
 #include <direct/util.h>
 
@@ -61,6 +72,7 @@
 #undef SIZEOF_LONG
 #include <ft2build.h>
 #include FT_GLYPH_H
+#include FT_OUTLINE_H
 
 #ifndef FT_LOAD_TARGET_MONO
     /* FT_LOAD_TARGET_MONO was added in FreeType-2.1.3. We have to use
@@ -89,6 +101,10 @@ Construct( IDirectFBFont               *thiz,
 
 DIRECT_INTERFACE_IMPLEMENTATION( IDirectFBFont, FT2 )
 
+/*
+ * The library is shared by all fonts, the mutex serializes creation and destruction of faces.
+ * Everything else using a face is serialized by the per face lock in FT2ImplData.
+ */
 static FT_Library      library           = NULL;
 static int             library_ref_count = 0;
 static pthread_mutex_t library_mutex     = PTHREAD_MUTEX_INITIALIZER;
@@ -107,6 +123,37 @@ static pthread_mutex_t library_mutex     = PTHREAD_MUTEX_INITIALIZER;
 
 #define CHAR_INDEX(c)    (((c) < 256) ? data->indices[c] : FT_Get_Char_Index( data->face, c ))
 
+/* Number of threads rasterizing glyphs in PrefetchGlyphs(), including the caller. */
+#define PREFETCH_WORKERS        4
+
+/* Minimum number of glyphs for each additional thread. */
+#define PREFETCH_WORKER_GLYPHS  8
+
+/*
+ * Each prefetch worker has its own library and face, so that rasterization
+ * neither waits for the font's face nor for other fonts.
+ */
+typedef struct {
+     FT_Library   library;
+     FT_Face      face;
+} FT2Worker;
+
+/*
+ * Glyph rasterized by PrefetchGlyphs(), consumed by get_glyph_info() and render_glyph().
+ */
+typedef struct {
+     FT_Bitmap    bitmap;        /* buffer follows this struct       */
+     FT_Int       bitmap_left;
+     FT_Int       bitmap_top;
+     FT_Vector    advance;
+     unsigned int layers;        /* layers rendered from it so far   */
+} FT2Glyph;
+
+/*
+ * Glyph file, see "Persistent glyph cache" below.
+ */
+typedef struct __FT2_GlyphFile GlyphFile;
+
 typedef struct {
      FT_Face      face;
      int          disable_charmap;
@@ -117,6 +164,26 @@ typedef struct {
      int          outline_opacity;
      float        up_unit_x;     /* unit vector pointing 'up' in for */
      float        up_unit_y;     /* this font's rotation             */
+
+     pthread_mutex_t  lock;      /* serializes use of the face and prefetched glyphs */
+
+     struct {
+          pthread_mutex_t  lock;                       /* one prefetch at a time per font */
+
+          const FT_Byte   *content;                    /* for creating the workers' faces */
+          FT_Long          content_size;
+          FT_Long          face_index;
+          FT_F26Dot6       char_width;
+          FT_F26Dot6       char_height;
+          bool             transformed;
+          FT_Matrix        matrix;
+
+          FT2Worker        workers[PREFETCH_WORKERS];
+     } prefetch;
+
+     DirectHash      *prefetched;    /* index -> FT2Glyph */
+
+     GlyphFile       *file;          /* glyphs shared with other processes, if enabled */
 } FT2ImplData;
 
 typedef struct {
@@ -145,11 +212,11 @@ ft2UTF8GetCharacterIndex( CoreFont     *thiz,
      if (data->disable_charmap)
           *ret_index = character;
      else {
-          pthread_mutex_lock ( &library_mutex );
+          pthread_mutex_lock ( &data->lock );
 
           *ret_index = CHAR_INDEX( character );
 
-          pthread_mutex_unlock ( &library_mutex );
+          pthread_mutex_unlock ( &data->lock );
      }
 
      return DFB_OK;
@@ -172,7 +239,7 @@ ft2UTF8DecodeText( CoreFont       *thiz,
      D_ASSERT( ret_indices != NULL );
      D_ASSERT( ret_num != NULL );
 
-     pthread_mutex_lock ( &library_mutex );
+     pthread_mutex_lock ( &data->lock );
 
      while (pos < length) {
           unsigned int c;
@@ -190,7 +257,7 @@ ft2UTF8DecodeText( CoreFont       *thiz,
                ret_indices[num++] = CHAR_INDEX( c );
      }
 
-     pthread_mutex_unlock ( &library_mutex );
+     pthread_mutex_unlock ( &data->lock );
 
      *ret_num = num;
 
@@ -259,34 +326,404 @@ static const CoreFontEncodingFuncs ft2Latin1Funcs = {
 
 /**********************************************************************************************************************/
 
-static DFBResult
-render_glyph( CoreFont      *thiz,
-              unsigned int   index,
-              CoreGlyphData *info )
+/**********************************************************************************************************************/
+
+/*
+ * Persistent glyph cache
+ *
+ * With "font-cache-dir" set, rasterized glyphs are appended to a file in that directory, named after
+ * a hash of the font data and a hash of the face index, size, transformation and load flags. Every
+ * process opening the same font in the same way maps the file read only and takes glyphs from it
+ * instead of rasterizing them again. Glyphs missing in the file are added by whoever needs them first.
+ *
+ * The file has a GlyphFileHeader followed by GlyphFileRecords, each followed by the bitmap. Records
+ * are only appended, with an exclusive lock on the file, and read with a shared lock.
+ */
+
+#define GLYPH_FILE_MAGIC           "DGCF"
+#define GLYPH_FILE_MAJOR           1
+#define GLYPH_FILE_MINOR           0
+
+#define GLYPH_FILE_FLAG_LITTLE_ENDIAN   0x01
+
+#define GLYPH_FILE_MAX_SIZE        (16 * 1024 * 1024)
+
+typedef struct {
+     unsigned char  magic[4];      /* "DGCF" magic */
+
+     unsigned char  major;         /* Major version number */
+     unsigned char  minor;         /* Minor version number */
+
+     unsigned char  flags;         /* Some flags like endianess */
+
+     unsigned char  __pad;
+
+     /* From now on endianess matters... */
+
+     uint64_t       font_hash;     /* FNV-1a of the font data */
+     uint32_t       font_size;
+     int32_t        face_index;
+
+     int32_t        char_width;    /* 26.6 */
+     int32_t        char_height;
+
+     int32_t        matrix[4];     /* 16.16, xx, xy, yx, yy */
+
+     int32_t        load_flags;
+
+     uint32_t       __pad2;
+} GlyphFileHeader;
+
+typedef struct {
+     uint32_t       index;
+     uint32_t       size;          /* of record and bitmap, 8 byte aligned */
+
+     int32_t        width;
+     int32_t        rows;
+     int32_t        pitch;
+     int32_t        pixel_mode;
+
+     int32_t        left;
+     int32_t        top;
+
+     int32_t        advance_x;
+     int32_t        advance_y;
+
+     /* Bitmap follows, "rows * pitch" bytes. */
+} GlyphFileRecord;
+
+struct __FT2_GlyphFile {
+     int                 fd;
+     bool                writable;
+
+     const u8           *map;          /* GLYPH_FILE_MAX_SIZE, valid up to 'scanned' */
+     size_t              scanned;      /* end of records in 'records' */
+
+     DirectHash         *records;      /* index -> offset of GlyphFileRecord */
+};
+
+static uint64_t
+glyph_file_hash( const u8 *bytes, size_t size )
 {
-     FT_Error     err;
-     FT_Face      face;
-     FT_Int       load_flags;
-     u8          *src;
-     int          y;
-     FT2ImplData *data    = thiz->impl_data;
-     CoreSurface *surface = info->surface;
-     CoreSurfaceBufferLock  lock;
+     size_t   i;
+     uint64_t hash = 0xcbf29ce484222325ULL;
 
-     pthread_mutex_lock ( &library_mutex );
+     for (i=0; i<size; i++) {
+          hash ^= bytes[i];
+          hash *= 0x100000001b3ULL;
+     }
 
-     face = data->face;
+     return hash;
+}
 
-     load_flags = (unsigned long) face->generic.data;
-     load_flags |= FT_LOAD_RENDER;
+static void
+glyph_file_header( const FT2ImplData *data,
+                   const FT_Byte     *content,
+                   FT_Long            content_size,
+                   GlyphFileHeader   *header )
+{
+     memset( header, 0, sizeof(GlyphFileHeader) );
 
-     if ((err = FT_Load_Glyph( face, index, load_flags ))) {
-          D_DEBUG( "DirectFB/FontFT2: Could not render glyph for character index #%d!\n", index );
-          pthread_mutex_unlock ( &library_mutex );
-          return DFB_FAILURE;
+     memcpy( header->magic, GLYPH_FILE_MAGIC, 4 );
+
+     header->major = GLYPH_FILE_MAJOR;
+     header->minor = GLYPH_FILE_MINOR;
+#ifndef WORDS_BIGENDIAN
+     header->flags = GLYPH_FILE_FLAG_LITTLE_ENDIAN;
+#endif
+
+     header->font_hash   = glyph_file_hash( content, content_size );
+     header->font_size   = content_size;
+     header->face_index  = data->prefetch.face_index;
+     header->char_width  = data->prefetch.char_width;
+     header->char_height = data->prefetch.char_height;
+
+     if (data->prefetch.transformed) {
+          header->matrix[0] = data->prefetch.matrix.xx;
+          header->matrix[1] = data->prefetch.matrix.xy;
+          header->matrix[2] = data->prefetch.matrix.yx;
+          header->matrix[3] = data->prefetch.matrix.yy;
+     }
+     else {
+          header->matrix[0] = 0x10000;
+          header->matrix[3] = 0x10000;
      }
 
-     pthread_mutex_unlock ( &library_mutex );
+     header->load_flags = (unsigned long) data->face->generic.data;
+}
+
+/*
+ * Indexes records appended since the last scan, the caller holds a lock on the file.
+ */
+static void
+glyph_file_scan( GlyphFile *file )
+{
+     size_t      size;
+     struct stat st;
+
+     if (fstat( file->fd, &st ) || st.st_size <= file->scanned)
+          return;
+
+     /* Records beyond the mapping are never used. */
+     size = MIN( st.st_size, GLYPH_FILE_MAX_SIZE );
+
+     /* The file is shared with other processes, so every record is checked before being used. */
+     while (file->scanned + sizeof(GlyphFileRecord) <= size) {
+          const GlyphFileRecord *record = (const GlyphFileRecord*) (file->map + file->scanned);
+
+          if ((record->pixel_mode != ft_pixel_mode_mono && record->pixel_mode != ft_pixel_mode_grays) ||
+              record->rows < 0 || record->pitch < 0 || record->width < 0 ||
+              record->width > (long long) record->pitch * (record->pixel_mode == ft_pixel_mode_mono ? 8 : 1) ||
+              record->size < sizeof(GlyphFileRecord) + (size_t) record->rows * record->pitch ||
+              record->size > size - file->scanned)
+          {
+               D_WARN( "invalid record at offset %zu in glyph cache file", file->scanned );
+               file->writable = false;
+               break;
+          }
+
+          if (!direct_hash_lookup( file->records, record->index ))
+               direct_hash_insert( file->records, record->index, (void*)(unsigned long) file->scanned );
+
+          file->scanned += record->size;
+     }
+}
+
+static GlyphFile *
+glyph_file_open( const FT2ImplData *data,
+                 const FT_Byte     *content,
+                 FT_Long            content_size )
+{
+     int              fd;
+     bool             writable = true;
+     char             filename[PATH_MAX];
+     GlyphFileHeader  header;
+     GlyphFileHeader  existing;
+     GlyphFile       *file;
+     void            *map;
+
+     glyph_file_header( data, content, content_size, &header );
+
+     snprintf( filename, sizeof(filename), "%s/%016" PRIx64 "-%016" PRIx64 ".dgcf", dfb_config->font_cache_dir,
+               header.font_hash, glyph_file_hash( (const u8*) &header, sizeof(header) ) );
+
+     fd = open( filename, O_RDWR | O_CREAT, 0644 );
+     if (fd < 0) {
+          fd = open( filename, O_RDONLY );
+          if (fd < 0) {
+               D_DEBUG( "DirectFB/FontFT2: Could not open glyph cache file '%s' (%s)!\n", filename, strerror(errno) );
+               return NULL;
+          }
+
+          writable = false;
+     }
+
+     /* Write the header if the file is new, check it otherwise. */
+     flock( fd, writable ? LOCK_EX : LOCK_SH );
+
+     if (pread( fd, &existing, sizeof(existing), 0 ) != sizeof(existing)) {
+          if (!writable || ftruncate( fd, 0 ) || pwrite( fd, &header, sizeof(header), 0 ) != sizeof(header)) {
+               flock( fd, LOCK_UN );
+               close( fd );
+               return NULL;
+          }
+     }
+     else if (memcmp( &existing, &header, sizeof(header) )) {
+          D_DEBUG( "DirectFB/FontFT2: Glyph cache file '%s' does not match the font!\n", filename );
+          flock( fd, LOCK_UN );
+          close( fd );
+          return NULL;
+     }
+
+     map = mmap( NULL, GLYPH_FILE_MAX_SIZE, PROT_READ, MAP_SHARED, fd, 0 );
+     if (map == MAP_FAILED) {
+          flock( fd, LOCK_UN );
+          close( fd );
+          return NULL;
+     }
+
+     file = D_CALLOC( 1, sizeof(GlyphFile) );
+     if (!file || direct_hash_create( 163, &file->records )) {
+          if (file)
+               D_FREE( file );
+          munmap( map, GLYPH_FILE_MAX_SIZE );
+          flock( fd, LOCK_UN );
+          close( fd );
+          return NULL;
+     }
+
+     file->fd       = fd;
+     file->writable = writable;
+     file->map      = map;
+     file->scanned  = sizeof(GlyphFileHeader);
+
+     glyph_file_scan( file );
+
+     flock( fd, LOCK_UN );
+
+     D_DEBUG( "DirectFB/FontFT2: Using glyph cache file '%s' (%zu bytes).\n", filename, file->scanned );
+
+     return file;
+}
+
+static void
+glyph_file_close( GlyphFile *file )
+{
+     munmap( (void*) file->map, GLYPH_FILE_MAX_SIZE );
+     close( file->fd );
+
+     direct_hash_destroy( file->records );
+
+     D_FREE( file );
+}
+
+static bool
+glyph_file_lookup( GlyphFile    *file,
+                   unsigned int  index,
+                   FT2Glyph     *ret_glyph )
+{
+     unsigned long          offset;
+     const GlyphFileRecord *record;
+
+     offset = (unsigned long) direct_hash_lookup( file->records, index );
+     if (!offset) {
+          /* Maybe another process has added it meanwhile. */
+          flock( file->fd, LOCK_SH );
+          glyph_file_scan( file );
+          flock( file->fd, LOCK_UN );
+
+          offset = (unsigned long) direct_hash_lookup( file->records, index );
+          if (!offset)
+               return false;
+     }
+
+     record = (const GlyphFileRecord*) (file->map + offset);
+
+     memset( ret_glyph, 0, sizeof(FT2Glyph) );
+
+     ret_glyph->bitmap.width      = record->width;
+     ret_glyph->bitmap.rows       = record->rows;
+     ret_glyph->bitmap.pitch      = record->pitch;
+     ret_glyph->bitmap.pixel_mode = record->pixel_mode;
+     ret_glyph->bitmap.buffer     = (unsigned char*) (record + 1);
+     ret_glyph->bitmap_left       = record->left;
+     ret_glyph->bitmap_top        = record->top;
+     ret_glyph->advance.x         = record->advance_x;
+     ret_glyph->advance.y         = record->advance_y;
+
+     return true;
+}
+
+static void
+glyph_file_add( GlyphFile       *file,
+                unsigned int     index,
+                const FT2Glyph  *glyph )
+{
+     int              y;
+     size_t           pitch, size;
+     struct stat      st;
+     GlyphFileRecord *record;
+     u8              *dst;
+
+     if (!file->writable)
+          return;
+
+     pitch = ABS( glyph->bitmap.pitch );
+     size  = (sizeof(GlyphFileRecord) + pitch * glyph->bitmap.rows + 7) & ~7;
+
+     record = D_CALLOC( 1, size );
+     if (!record)
+          return;
+
+     record->index      = index;
+     record->size       = size;
+     record->width      = glyph->bitmap.width;
+     record->rows       = glyph->bitmap.rows;
+     record->pitch      = pitch;
+     record->pixel_mode = glyph->bitmap.pixel_mode;
+     record->left       = glyph->bitmap_left;
+     record->top        = glyph->bitmap_top;
+     record->advance_x  = glyph->advance.x;
+     record->advance_y  = glyph->advance.y;
+
+     dst = (u8*) (record + 1);
+
+     for (y=0; y<glyph->bitmap.rows; y++)
+          direct_memcpy( dst + y * pitch, glyph->bitmap.buffer + y * glyph->bitmap.pitch, pitch );
+
+     flock( file->fd, LOCK_EX );
+
+     /* Index what others have added, the glyph may be among it. */
+     glyph_file_scan( file );
+
+     if (!direct_hash_lookup( file->records, index ) &&
+         !fstat( file->fd, &st ) && st.st_size == file->scanned && st.st_size + size <= GLYPH_FILE_MAX_SIZE)
+     {
+          if (pwrite( file->fd, record, size, st.st_size ) == size) {
+               direct_hash_insert( file->records, index, (void*)(unsigned long) file->scanned );
+
+               file->scanned += size;
+          }
+          else {
+               /* Don't leave a partial record. */
+               if (ftruncate( file->fd, st.st_size ))
+                    file->writable = false;
+          }
+     }
+
+     flock( file->fd, LOCK_UN );
+
+     D_FREE( record );
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Loads and renders the glyph, moved right by 'shift' in 26.6 for subpixel positioning.
+ * Only outlines can be moved, bitmap glyphs stay at the pixel.
+ */
+static FT_Error
+load_glyph_shifted( FT_Face      face,
+                    unsigned int index,
+                    FT_Pos       shift )
+{
+     FT_Error err;
+     FT_Int   load_flags = (unsigned long) face->generic.data;
+
+     err = FT_Load_Glyph( face, index, load_flags );
+     if (err)
+          return err;
+
+     if (shift && face->glyph->format == ft_glyph_format_outline)
+          FT_Outline_Translate( &face->glyph->outline, shift, 0 );
+
+     if (face->glyph->format != ft_glyph_format_bitmap)
+          err = FT_Render_Glyph( face->glyph,
+                                 (load_flags & FT_LOAD_TARGET_MONO) ? ft_render_mode_mono : ft_render_mode_normal );
+
+     return err;
+}
+
+static FT_Error
+load_glyph( FT_Face      face,
+            unsigned int index )
+{
+     return load_glyph_shifted( face, index, 0 );
+}
+
+static DFBResult
+render_bitmap( CoreFont        *thiz,
+               const FT_Bitmap *bitmap,
+               FT_Int           bitmap_left,
+               FT_Int           bitmap_top,
+               CoreGlyphData   *info )
+{
+     DFBResult    err;
+     u8          *src;
+     int          y;
+     FT2ImplData *data    = thiz->impl_data;
+     CoreSurface *surface = info->surface;
+     CoreSurfaceBufferLock  lock;
 
      err = dfb_surface_lock_buffer( surface, CSBR_BACK, CSAID_CPU, CSAF_WRITE, &lock );
      if (err) {
@@ -294,19 +731,19 @@ render_glyph( CoreFont      *thiz,
           return err;
      }
 
-     info->width = face->glyph->bitmap.width;
+     info->width = bitmap->width;
      if (info->width + info->start > surface->config.size.w)
           info->width = surface->config.size.w - info->start;
 
-     info->height = face->glyph->bitmap.rows;
-     if (info->height > surface->config.size.h)
-          info->height = surface->config.size.h;
+     info->height = bitmap->rows;
+     if (info->start_y + info->height > surface->config.size.h)
+          info->height = surface->config.size.h - info->start_y;
 
      /* bitmap_left and bitmap_top are relative to the glyph's origin on the
         baseline.  info->left and info->top are relative to the top-left of the
         character cell. */
-     info->left =   face->glyph->bitmap_left - thiz->ascender*thiz->up_unit_x;
-     info->top  = - face->glyph->bitmap_top  - thiz->ascender*thiz->up_unit_y;
+     info->left =   bitmap_left - thiz->ascender*thiz->up_unit_x;
+     info->top  = - bitmap_top  - thiz->ascender*thiz->up_unit_y;
 
      if (info->layer == 1 && info->width > 0 && info->height > 0) {
           int   xoffset, yoffset;
@@ -314,13 +751,13 @@ render_glyph( CoreFont      *thiz,
           void *blurred = NULL;
           int   radius  = data->outline_radius;
 
-          switch (face->glyph->bitmap.pixel_mode) {
+          switch (bitmap->pixel_mode) {
                case ft_pixel_mode_grays:
                     blurred = D_CALLOC( 1, (info->width + radius) * (info->height + radius) );
                     if (blurred) {
                          for (yoffset=0; yoffset<radius; yoffset++) {
                               for (xoffset=0; xoffset<radius; xoffset++) {
-                                   src = face->glyph->bitmap.buffer;
+                                   src = bitmap->buffer;
 
                                    for (y=0; y < info->height; y++) {
                                         int  i;
@@ -332,7 +769,7 @@ render_glyph( CoreFont      *thiz,
                                              dst8[i] = (val < 255) ? val : 255;
                                         }
 
-                                        src += face->glyph->bitmap.pitch;
+                                        src += bitmap->pitch;
                                    }
                               }
                          }
@@ -358,7 +795,7 @@ render_glyph( CoreFont      *thiz,
           info->top    -= (radius - 1) / 2;
 
           if (blurred) {
-               addr = lock.addr + DFB_BYTES_PER_LINE(surface->config.format, info->start);
+               addr = lock.addr + DFB_BYTES_PER_LINE(surface->config.format, info->start) + info->start_y * lock.pitch;
                src  = blurred;
 
                for (y=0; y < info->height; y++) {
@@ -366,7 +803,7 @@ render_glyph( CoreFont      *thiz,
                     u8  *dst8  = addr;
                     u32 *dst32 = addr;
 
-                    switch (face->glyph->bitmap.pixel_mode) {
+                    switch (bitmap->pixel_mode) {
                          case ft_pixel_mode_grays:
                               switch (surface->config.format) {
                                    case DSPF_ARGB:
@@ -418,8 +855,8 @@ render_glyph( CoreFont      *thiz,
                     info->width = data->fixed_advance;
           }
 
-          src = face->glyph->bitmap.buffer;
-          lock.addr += DFB_BYTES_PER_LINE(surface->config.format, info->start);
+          src = bitmap->buffer;
+          lock.addr += DFB_BYTES_PER_LINE(surface->config.format, info->start) + info->start_y * lock.pitch;
 
           for (y=0; y < info->height; y++) {
                int  i, j, n;
@@ -427,7 +864,7 @@ render_glyph( CoreFont      *thiz,
                u16 *dst16 = lock.addr;
                u32 *dst32 = lock.addr;
 
-               switch (face->glyph->bitmap.pixel_mode) {
+               switch (bitmap->pixel_mode) {
                     case ft_pixel_mode_grays:
                          switch (surface->config.format) {
                               case DSPF_ARGB:
@@ -662,7 +1099,7 @@ render_glyph( CoreFont      *thiz,
 
                }
 
-               src += face->glyph->bitmap.pitch;
+               src += bitmap->pitch;
 
                lock.addr += lock.pitch;
           }
@@ -674,54 +1111,128 @@ render_glyph( CoreFont      *thiz,
 }
 
 
+/*
+ * Looks up a glyph rasterized already, by PrefetchGlyphs() or into the glyph file.
+ * The latter is returned in 'file_glyph'.
+ */
+static FT2Glyph *
+find_glyph( FT2ImplData  *data,
+            unsigned int  index,
+            FT2Glyph     *file_glyph )
+{
+     FT2Glyph *glyph = NULL;
+
+     if (data->prefetched)
+          glyph = direct_hash_lookup( data->prefetched, index );
+
+     if (!glyph && data->file && glyph_file_lookup( data->file, index, file_glyph ))
+          glyph = file_glyph;
+
+     return glyph;
+}
+
+static DFBResult
+render_glyph( CoreFont      *thiz,
+              unsigned int   index,
+              CoreGlyphData *info )
+{
+     DFBResult    ret;
+     FT_Face      face;
+     FT2Glyph    *glyph;
+     FT2Glyph     file_glyph;
+     FT2ImplData *data  = thiz->impl_data;
+
+     pthread_mutex_lock( &data->lock );
+
+     face  = data->face;
+     glyph = info->phase ? NULL : find_glyph( data, index, &file_glyph );
+
+     if (glyph) {
+          ret = render_bitmap( thiz, &glyph->bitmap, glyph->bitmap_left, glyph->bitmap_top, info );
+
+          /* Drop the prefetched bitmap once every layer has been rendered from it. */
+          if (glyph != &file_glyph) {
+               glyph->layers |= 1 << info->layer;
+
+               if (glyph->layers == ((thiz->attributes & DFFA_OUTLINED) ? 3 : 1)) {
+                    direct_hash_remove( data->prefetched, index );
+                    D_FREE( glyph );
+               }
+          }
+     }
+     else if (load_glyph_shifted( face, index, (info->phase << 6) >> thiz->subpixel_shift )) {
+          D_DEBUG( "DirectFB/FontFT2: Could not render glyph for character index #%d!\n", index );
+          ret = DFB_FAILURE;
+     }
+     else
+          ret = render_bitmap( thiz, &face->glyph->bitmap, face->glyph->bitmap_left, face->glyph->bitmap_top, info );
+
+     pthread_mutex_unlock( &data->lock );
+
+     return ret;
+}
+
+
 static DFBResult
 get_glyph_info( CoreFont      *thiz,
                 unsigned int   index,
                 CoreGlyphData *info )
 {
-     FT_Error err;
-     FT_Face  face;
-     FT_Int   load_flags;
-     FT2ImplData *data = (FT2ImplData*) thiz->impl_data;
-
-     pthread_mutex_lock ( &library_mutex );
+     FT_Face          face;
+     const FT_Bitmap *bitmap;
+     FT_Vector        advance;
+     FT2Glyph        *glyph;
+     FT2Glyph         file_glyph;
+     FT2ImplData     *data  = (FT2ImplData*) thiz->impl_data;
 
-     face = data->face;
+     pthread_mutex_lock( &data->lock );
 
-     load_flags = (unsigned long) face->generic.data;
+     face  = data->face;
+     glyph = info->phase ? NULL : find_glyph( data, index, &file_glyph );
 
-     if ((err = FT_Load_Glyph( face, index, load_flags ))) {
+     if (glyph) {
+          bitmap  = &glyph->bitmap;
+          advance = glyph->advance;
+     }
+     else if (load_glyph_shifted( face, index, (info->phase << 6) >> thiz->subpixel_shift )) {
           D_DEBUG( "DirectFB/FontFT2: Could not load glyph for character index #%d!\n", index );
 
-          pthread_mutex_unlock ( &library_mutex );
+          pthread_mutex_unlock( &data->lock );
 
           return DFB_FAILURE;
      }
+     else {
+          bitmap  = &face->glyph->bitmap;
+          advance = face->glyph->advance;
 
-     if (face->glyph->format != ft_glyph_format_bitmap) {
-          err = FT_Render_Glyph( face->glyph,
-                                 (load_flags & FT_LOAD_TARGET_MONO) ? ft_render_mode_mono : ft_render_mode_normal );
-          if (err) {
-               D_ERROR( "DirectFB/FontFT2: Could not render glyph for character index #%d!\n", index );
-
-               pthread_mutex_unlock ( &library_mutex );
+          if (data->file && !info->phase) {
+               file_glyph.bitmap      = face->glyph->bitmap;
+               file_glyph.bitmap_left = face->glyph->bitmap_left;
+               file_glyph.bitmap_top  = face->glyph->bitmap_top;
+               file_glyph.advance     = face->glyph->advance;
 
-               return DFB_FAILURE;
+               glyph_file_add( data->file, index, &file_glyph );
           }
      }
 
-     pthread_mutex_unlock ( &library_mutex );
+     info->width   = bitmap->width;
+     info->height  = bitmap->rows;
 
-     info->width   = face->glyph->bitmap.width;
-     info->height  = face->glyph->bitmap.rows;
+     /* Empty glyphs are never rendered, don't keep them around. */
+     if (glyph && glyph != &file_glyph && (!info->width || !info->height)) {
+          direct_hash_remove( data->prefetched, index );
+          D_FREE( glyph );
+     }
+
+     pthread_mutex_unlock( &data->lock );
 
      if (data->fixed_advance) {
           info->xadvance = - data->fixed_advance * thiz->up_unit_y;
           info->yadvance =   data->fixed_advance * thiz->up_unit_x;
      }
      else {
-          info->xadvance =   face->glyph->advance.x << 2;
-          info->yadvance = - face->glyph->advance.y << 2;
+          info->xadvance =   advance.x << 2;
+          info->yadvance = - advance.y << 2;
      }
 
      if (data->fixed_clip && info->width > data->fixed_advance)
@@ -760,7 +1271,7 @@ get_kerning( CoreFont     *thiz,
           if (!cache->initialised && FT_HAS_KERNING(data->base.face)) {
                FT_Vector vector;
 
-               pthread_mutex_lock ( &library_mutex );
+               pthread_mutex_lock ( &data->base.lock );
 
                /* Lookup kerning values for the character pair. */
                FT_Get_Kerning( data->base.face,
@@ -771,7 +1282,7 @@ get_kerning( CoreFont     *thiz,
 
                cache->initialised = true;
 
-               pthread_mutex_unlock ( &library_mutex );
+               pthread_mutex_unlock ( &data->base.lock );
           }
 
           if (kern_x)
@@ -783,14 +1294,14 @@ get_kerning( CoreFont     *thiz,
           return DFB_OK;
      }
 
-     pthread_mutex_lock ( &library_mutex );
+     pthread_mutex_lock ( &data->base.lock );
 
      /* Lookup kerning values for the character pair. */
      /* The vector returned by FreeType does not allow for any rotation. */
      FT_Get_Kerning( data->base.face,
                      prev, current, ft_kerning_default, &vector );
 
-     pthread_mutex_unlock ( &library_mutex );
+     pthread_mutex_unlock ( &data->base.lock );
 
      /* Convert to integer. */
      if (kern_x)
@@ -802,6 +1313,239 @@ get_kerning( CoreFont     *thiz,
      return DFB_OK;
 }
 
+/**********************************************************************************************************************/
+
+typedef struct {
+     FT2ImplData         *data;
+     FT2Worker           *worker;
+
+     const unsigned int  *indices;
+     FT2Glyph           **glyphs;
+     unsigned int         num;
+     unsigned int         first;
+     unsigned int         step;
+} PrefetchJob;
+
+static DFBResult
+init_worker( FT2ImplData *data,
+             FT2Worker   *worker )
+{
+     FT_Error err;
+
+     if (worker->face)
+          return DFB_OK;
+
+     if (!worker->library) {
+          err = FT_Init_FreeType( &worker->library );
+          if (err) {
+               worker->library = NULL;
+               return DFB_FAILURE;
+          }
+     }
+
+     err = FT_New_Memory_Face( worker->library, data->prefetch.content, data->prefetch.content_size,
+                               data->prefetch.face_index, &worker->face );
+     if (err) {
+          worker->face = NULL;
+          return DFB_FAILURE;
+     }
+
+     if (data->prefetch.char_width || data->prefetch.char_height)
+          FT_Set_Char_Size( worker->face, data->prefetch.char_width, data->prefetch.char_height, 0, 0 );
+
+     if (data->prefetch.transformed)
+          FT_Set_Transform( worker->face, &data->prefetch.matrix, NULL );
+
+     worker->face->generic.data      = data->face->generic.data;
+     worker->face->generic.finalizer = NULL;
+
+     return DFB_OK;
+}
+
+static void
+deinit_worker( FT2Worker *worker )
+{
+     if (worker->face) {
+          FT_Done_Face( worker->face );
+          worker->face = NULL;
+     }
+
+     if (worker->library) {
+          FT_Done_FreeType( worker->library );
+          worker->library = NULL;
+     }
+}
+
+static FT2Glyph *
+rasterize_glyph( FT_Face      face,
+                 unsigned int index )
+{
+     int           y, pitch;
+     FT2Glyph     *glyph;
+     FT_GlyphSlot  slot = face->glyph;
+
+     if (load_glyph( face, index ))
+          return NULL;
+
+     pitch = ABS( slot->bitmap.pitch );
+
+     glyph = D_MALLOC( sizeof(FT2Glyph) + pitch * slot->bitmap.rows );
+     if (!glyph)
+          return NULL;
+
+     glyph->bitmap        = slot->bitmap;
+     glyph->bitmap.pitch  = pitch;
+     glyph->bitmap.buffer = (unsigned char*) (glyph + 1);
+     glyph->bitmap_left   = slot->bitmap_left;
+     glyph->bitmap_top    = slot->bitmap_top;
+     glyph->advance       = slot->advance;
+     glyph->layers        = 0;
+
+     for (y=0; y<slot->bitmap.rows; y++)
+          direct_memcpy( glyph->bitmap.buffer + y * pitch, slot->bitmap.buffer + y * slot->bitmap.pitch, pitch );
+
+     return glyph;
+}
+
+static void *
+prefetch_worker( DirectThread *thread,
+                 void         *arg )
+{
+     unsigned int  i;
+     PrefetchJob  *job = arg;
+
+     if (init_worker( job->data, job->worker ))
+          return NULL;
+
+     for (i=job->first; i<job->num; i+=job->step)
+          job->glyphs[i] = rasterize_glyph( job->worker->face, job->indices[i] );
+
+     return NULL;
+}
+
+static DFBResult
+prefetch_glyphs( CoreFont           *thiz,
+                 const unsigned int *indices,
+                 unsigned int        num )
+{
+     unsigned int   i, count;
+     FT2Glyph     **glyphs;
+     unsigned int  *missing = NULL;
+     PrefetchJob    jobs[PREFETCH_WORKERS];
+     DirectThread  *threads[PREFETCH_WORKERS];
+     FT2ImplData   *data = thiz->impl_data;
+
+     D_ASSERT( num > 0 );
+
+     /* Glyphs in the glyph file don't need to be rasterized. */
+     if (data->file) {
+          FT2Glyph file_glyph;
+
+          missing = D_MALLOC( num * sizeof(unsigned int) );
+          if (!missing)
+               return D_OOM();
+
+          pthread_mutex_lock( &data->lock );
+
+          for (i=0, count=0; i<num; i++) {
+               if (!glyph_file_lookup( data->file, indices[i], &file_glyph ))
+                    missing[count++] = indices[i];
+          }
+
+          pthread_mutex_unlock( &data->lock );
+
+          if (!count) {
+               D_FREE( missing );
+               return DFB_OK;
+          }
+
+          indices = missing;
+          num     = count;
+     }
+
+     glyphs = D_CALLOC( num, sizeof(FT2Glyph*) );
+     if (!glyphs) {
+          if (missing)
+               D_FREE( missing );
+          return D_OOM();
+     }
+
+     count = MIN( PREFETCH_WORKERS, (num + PREFETCH_WORKER_GLYPHS - 1) / PREFETCH_WORKER_GLYPHS );
+
+     D_DEBUG( "DirectFB/FontFT2: Prefetching %u glyphs with %u threads.\n", num, count );
+
+     pthread_mutex_lock( &data->prefetch.lock );
+
+     for (i=0; i<count; i++) {
+          jobs[i].data    = data;
+          jobs[i].worker  = &data->prefetch.workers[i];
+          jobs[i].indices = indices;
+          jobs[i].glyphs  = glyphs;
+          jobs[i].num     = num;
+          jobs[i].first   = i;
+          jobs[i].step    = count;
+
+          threads[i] = i ? direct_thread_create( DTT_DEFAULT, prefetch_worker, &jobs[i], "FT2 Prefetch" ) : NULL;
+     }
+
+     /* The calling thread takes the first share, and those of threads that could not be created. */
+     for (i=0; i<count; i++) {
+          if (!threads[i])
+               prefetch_worker( NULL, &jobs[i] );
+     }
+
+     for (i=1; i<count; i++) {
+          if (threads[i]) {
+               direct_thread_join( threads[i] );
+               direct_thread_destroy( threads[i] );
+          }
+     }
+
+     pthread_mutex_unlock( &data->prefetch.lock );
+
+     /* Hand the bitmaps over to get_glyph_info() and render_glyph(). */
+     pthread_mutex_lock( &data->lock );
+
+     for (i=0; i<num; i++) {
+          if (!glyphs[i])
+               continue;
+
+          if (data->file)
+               glyph_file_add( data->file, indices[i], glyphs[i] );
+
+          if (!data->prefetched && direct_hash_create( 17, &data->prefetched )) {
+               D_FREE( glyphs[i] );
+               continue;
+          }
+
+          if (direct_hash_lookup( data->prefetched, indices[i] ) ||
+              direct_hash_insert( data->prefetched, indices[i], glyphs[i] ))
+               D_FREE( glyphs[i] );
+     }
+
+     pthread_mutex_unlock( &data->lock );
+
+     D_FREE( glyphs );
+
+     if (missing)
+          D_FREE( missing );
+
+     return DFB_OK;
+}
+
+static bool
+free_prefetched( DirectHash    *hash,
+                 unsigned long  key,
+                 void          *value,
+                 void          *ctx )
+{
+     D_FREE( value );
+
+     return true;
+}
+
+/**********************************************************************************************************************/
+
 static DFBResult
 init_freetype( void )
 {
@@ -846,15 +1590,30 @@ release_freetype( void )
 static void
 IDirectFBFont_FT2_Destruct( IDirectFBFont *thiz )
 {
+     int                 i;
      IDirectFBFont_data *data = (IDirectFBFont_data*)thiz->priv;
 
      if (data->font->impl_data) {
           FT2ImplData *impl_data = (FT2ImplData*) data->font->impl_data;
 
+          for (i=0; i<PREFETCH_WORKERS; i++)
+               deinit_worker( &impl_data->prefetch.workers[i] );
+
+          if (impl_data->prefetched) {
+               direct_hash_iterate( impl_data->prefetched, free_prefetched, NULL );
+               direct_hash_destroy( impl_data->prefetched );
+          }
+
+          if (impl_data->file)
+               glyph_file_close( impl_data->file );
+
           pthread_mutex_lock ( &library_mutex );
           FT_Done_Face( impl_data->face );
           pthread_mutex_unlock ( &library_mutex );
 
+          pthread_mutex_destroy( &impl_data->prefetch.lock );
+          pthread_mutex_destroy( &impl_data->lock );
+
           D_FREE( impl_data );
 
           data->font->impl_data = NULL;
@@ -924,6 +1683,9 @@ Construct( IDirectFBFont               *thiz,
      FT_Face             face;
      FT_Error            err;
      FT_Int              load_flags = FT_LOAD_DEFAULT;
+     FT_Matrix           matrix;
+     FT_F26Dot6          char_width  = 0;
+     FT_F26Dot6          char_height = 0;
      FT2ImplData        *data;
      bool                disable_charmap = false;
      bool                disable_kerning = false;
@@ -989,17 +1751,14 @@ Construct( IDirectFBFont               *thiz,
 
           int sin_rot_fx = (int)(sin_rot*65536.0);
           int cos_rot_fx = (int)(cos_rot*65536.0);
-          FT_Matrix matrix;
           matrix.xx =  cos_rot_fx;
           matrix.xy = -sin_rot_fx;
           matrix.yx =  sin_rot_fx;
           matrix.yy =  cos_rot_fx;
 
-          pthread_mutex_lock ( &library_mutex );
           FT_Set_Transform( face, &matrix, NULL );
           /* FreeType docs suggest FT_Set_Transform returns an error code, but it seems
              that this is not the case. */
-          pthread_mutex_unlock ( &library_mutex );
      }
 
      if (dfb_config->font_format == DSPF_A1 ||
@@ -1038,9 +1797,8 @@ Construct( IDirectFBFont               *thiz,
           load_flags |= FT_LOAD_TARGET_MONO;
 
      if (!disable_charmap) {
-          pthread_mutex_lock ( &library_mutex );
+          /* The face is not used by anyone else yet, only face creation needs the library lock. */
           err = FT_Select_Charmap( face, ft_encoding_unicode );
-          pthread_mutex_unlock ( &library_mutex );
 
 #if FREETYPE_MINOR > 0
 
@@ -1049,18 +1807,14 @@ Construct( IDirectFBFont               *thiz,
                D_DEBUG( "DirectFB/FontFT2: "
                         "Couldn't select Unicode encoding, "
                         "falling back to Latin1.\n");
-               pthread_mutex_lock ( &library_mutex );
                err = FT_Select_Charmap( face, ft_encoding_latin_1 );
-               pthread_mutex_unlock ( &library_mutex );
           }
 #endif
           if (err) {
                D_DEBUG( "DirectFB/FontFT2: "
                         "Couldn't select Unicode/Latin1 encoding, "
                         "trying Symbol.\n");
-               pthread_mutex_lock ( &library_mutex );
                err = FT_Select_Charmap( face, ft_encoding_symbol );
-               pthread_mutex_unlock ( &library_mutex );
 
                if (!err)
                     mask = 0xf000;
@@ -1094,9 +1848,7 @@ Construct( IDirectFBFont               *thiz,
           else if (desc->flags & DFDESC_WIDTH)
                fw = desc->width << 6;
 
-          pthread_mutex_lock ( &library_mutex );
           err = FT_Set_Char_Size( face, fw, fh, 0, 0 );
-          pthread_mutex_unlock ( &library_mutex );
           if (err) {
                D_ERROR( "DirectB/FontFT2: "
                          "Could not set pixel size to %d x %d!\n",
@@ -1108,6 +1860,9 @@ Construct( IDirectFBFont               *thiz,
                DIRECT_DEALLOCATE_INTERFACE( thiz );
                return DFB_FAILURE;
           }
+
+          char_width  = fw;
+          char_height = fh;
      }
 
      face->generic.data = (void *)(unsigned long) load_flags;
@@ -1123,7 +1878,7 @@ Construct( IDirectFBFont               *thiz,
      }
 
      font->attributes = attributes;
-     font->flags      = CFF_SUBPIXEL_ADVANCE;
+     font->flags      = CFF_SUBPIXEL_ADVANCE | CFF_SUBPIXEL_PHASES;
 
      D_ASSERT( font->pixel_format == DSPF_ARGB ||
                font->pixel_format == DSPF_ABGR ||
@@ -1151,8 +1906,9 @@ Construct( IDirectFBFont               *thiz,
      D_DEBUG( "DirectFB/FontFT2: height = %d, ascender = %d, descender = %d, maxadvance = %d, up unit: %5.2f,%5.2f\n",
               font->height, font->ascender, font->descender, font->maxadvance, font->up_unit_x, font->up_unit_y );
 
-     font->GetGlyphData = get_glyph_info;
-     font->RenderGlyph  = render_glyph;
+     font->GetGlyphData   = get_glyph_info;
+     font->RenderGlyph    = render_glyph;
+     font->PrefetchGlyphs = prefetch_glyphs;
 
      if (FT_HAS_KERNING(face) && !disable_kerning) {
           font->GetKerning = get_kerning;
@@ -1164,6 +1920,20 @@ Construct( IDirectFBFont               *thiz,
      data->face            = face;
      data->disable_charmap = disable_charmap;
 
+     pthread_mutex_init( &data->lock, NULL );
+     pthread_mutex_init( &data->prefetch.lock, NULL );
+
+     data->prefetch.content      = ctx->content;
+     data->prefetch.content_size = ctx->content_size;
+     data->prefetch.face_index   = (desc->flags & DFDESC_INDEX) ? desc->index : 0;
+     data->prefetch.char_width   = char_width;
+     data->prefetch.char_height  = char_height;
+
+     if ((desc->flags & DFDESC_ROTATION) && desc->rotation) {
+          data->prefetch.transformed = true;
+          data->prefetch.matrix      = matrix;
+     }
+
      if (attributes & DFFA_OUTLINED) {
           if (desc->flags & DFDESC_OUTLINE_WIDTH)
                data->outline_radius = 1 + (desc->outline_width >> 16) * 2;
@@ -1187,6 +1957,9 @@ Construct( IDirectFBFont               *thiz,
      for (i=0; i<256; i++)
           data->indices[i] = FT_Get_Char_Index( face, i | mask );
 
+     if (dfb_config->font_cache_dir)
+          data->file = glyph_file_open( data, ctx->content, ctx->content_size );
+
      data->up_unit_x = font->up_unit_x;
      data->up_unit_y = font->up_unit_y;
 
@@ -570,6 +570,7 @@ Construct( IDirectFBImageProvider *thiz,
      }
 
      data->base.Destruct = IDirectFBImageProvider_BMP_Destruct;
+     data->base.cacheable = true;
 
      thiz->RenderTo              = IDirectFBImageProvider_BMP_RenderTo;
      thiz->SetRenderCallback     = IDirectFBImageProvider_BMP_SetRenderCallback;
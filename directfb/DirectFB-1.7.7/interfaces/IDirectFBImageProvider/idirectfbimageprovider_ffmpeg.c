@@ -451,6 +451,7 @@ Construct( IDirectFBImageProvider *thiz,
      data->image = D_MALLOC( data->width * data->height * 4 );
 
      data->base.Destruct         = IDirectFBImageProvider_FFMPEG_Destruct;
+     data->base.cacheable        = true;
      thiz->RenderTo              = IDirectFBImageProvider_FFMPEG_RenderTo;
      thiz->SetRenderCallback     = IDirectFBImageProvider_FFMPEG_SetRenderCallback;
      thiz->GetImageDescription   = IDirectFBImageProvider_FFMPEG_GetImageDescription;
@@ -215,6 +215,7 @@ Construct( IDirectFBImageProvider *thiz,
      }
 
      data->base.Destruct = IDirectFBImageProvider_GIF_Destruct;
+     data->base.cacheable = true;
 
      thiz->RenderTo = IDirectFBImageProvider_GIF_RenderTo;
      thiz->GetImageDescription = IDirectFBImageProvider_GIF_GetImageDescription;
@@ -178,6 +178,7 @@ Construct( IDirectFBImageProvider *thiz,
      D_DEBUG( "DirectFB/Media: IMLIB2 Provider Construct '%s'\n", data->filename );
 
      data->base.Destruct = IDirectFBImageProvider_IMLIB2_Destruct;
+     data->base.cacheable = true;
 
      thiz->RenderTo = IDirectFBImageProvider_IMLIB2_RenderTo;
      thiz->SetRenderCallback = IDirectFBImageProvider_IMLIB2_SetRenderCallback;
@@ -55,6 +55,7 @@
 #include <direct/mem.h>
 #include <direct/memcpy.h>
 #include <direct/messages.h>
+#include <direct/thread.h>
 
 #include <setjmp.h>
 #include <math.h>
@@ -228,9 +229,34 @@ jpeglib_panic(j_common_ptr cinfo)
      longjmp(myerr->setjmp_buffer, 1);
 }
 
+/*
+ * The line converters handle four pixels (twelve bytes) at a time using three word loads on little endian machines.
+ * Scanlines allocated by libjpeg are word aligned and the source always points to their start.
+ */
+
 static inline void
 copy_line32( u32 *argb, const u8 *rgb, int width )
 {
+#ifndef WORDS_BIGENDIAN
+     const u32 *src = (const u32*) rgb;
+
+     for (; width >= 4; width -= 4) {
+          u32 s0 = src[0];
+          u32 s1 = src[1];
+          u32 s2 = src[2];
+
+          argb[0] = 0xFF000000 | ((s0 & 0x000000FF) << 16) | (s0 & 0x0000FF00) | ((s0 >> 16) & 0xFF);
+          argb[1] = 0xFF000000 | ((s0 & 0xFF000000) >>  8) | ((s1 & 0xFF) << 8) | ((s1 >>  8) & 0xFF);
+          argb[2] = 0xFF000000 | (s1 & 0x00FF0000) | ((s1 >> 16) & 0xFF00) | (s2 & 0xFF);
+          argb[3] = 0xFF000000 | ((s2 & 0x0000FF00) <<  8) | ((s2 >>  8) & 0xFF00) | (s2 >> 24);
+
+          argb += 4;
+          src  += 3;
+     }
+
+     rgb = (const u8*) src;
+#endif
+
      while (width--) {
           *argb++ = 0xFF000000 | (rgb[0] << 16) | (rgb[1] << 8) | rgb[2];
 
@@ -241,9 +267,31 @@ copy_line32( u32 *argb, const u8 *rgb, int width )
 static inline void
 copy_line_nv16( u16 *yy, u16 *cbcr, const u8 *src_ycbcr, int width )
 {
-     int x;
+     int x = 0;
+
+#ifndef WORDS_BIGENDIAN
+     const u32 *src = (const u32*) src_ycbcr;
+
+     /* Two luma pairs per word store, destination lines are word aligned. */
+     for (; x < width/2 - 1; x += 2) {
+          u32 s0 = src[0];
+          u32 s1 = src[1];
+          u32 s2 = src[2];
+
+          *(u32*) &yy[x] = (s0 & 0xFF) | ((s0 >> 16) & 0xFF00) | (s1 & 0xFF0000) | ((s2 & 0xFF00) << 16);
 
-     for (x=0; x<width/2; x++) {
+          cbcr[x]   = ((((s0 >> 16) & 0xFF) + ((s1 >> 8) & 0xFF)) << 7 & 0xFF00) |
+                       ((((s0 >>  8) & 0xFF) +  (s1 & 0xFF)) >> 1);
+          cbcr[x+1] = ((( s2        & 0xFF) +  (s2 >> 24)) << 7 & 0xFF00) |
+                       ((  (s1 >> 24)       + ((s2 >> 16) & 0xFF)) >> 1);
+
+          src += 3;
+     }
+
+     src_ycbcr = (const u8*) src;
+#endif
+
+     for (; x<width/2; x++) {
 #ifdef WORDS_BIGENDIAN
           yy[x] = (src_ycbcr[0] << 8) | src_ycbcr[3];
 
@@ -275,9 +323,26 @@ copy_line_nv16( u16 *yy, u16 *cbcr, const u8 *src_ycbcr, int width )
 static inline void
 copy_line_uyvy( u32 *uyvy, const u8 *src_ycbcr, int width )
 {
-     int x;
+     int x = 0;
+
+#ifndef WORDS_BIGENDIAN
+     const u32 *src = (const u32*) src_ycbcr;
+
+     for (; x < width/2 - 1; x += 2) {
+          u32 s0 = src[0];
+          u32 s1 = src[1];
+          u32 s2 = src[2];
 
-     for (x=0; x<width/2; x++) {
+          uyvy[x]   = (s0 & 0xFF000000) | ((s1 & 0xFF00) << 8) | ((s0 & 0xFF) << 8) | ((s0 >> 8) & 0xFF);
+          uyvy[x+1] = ((s2 & 0xFF00) << 16) | ((s2 >> 8) & 0xFF0000) | ((s1 >> 8) & 0xFF00) | (s1 >> 24);
+
+          src += 3;
+     }
+
+     src_ycbcr = (const u8*) src;
+#endif
+
+     for (; x<width/2; x++) {
 #ifdef WORDS_BIGENDIAN
           uyvy[x] = (src_ycbcr[1] << 24) | (src_ycbcr[0] << 16) | (src_ycbcr[5] << 8) | src_ycbcr[3];
 #else
@@ -296,6 +361,486 @@ copy_line_uyvy( u32 *uyvy, const u8 *src_ycbcr, int width )
      }
 }
 
+/**********************************************************************************************************************/
+
+/*
+ * Sequential Huffman coded JPEGs with restart markers are decoded in bands of MCU rows by multiple threads.
+ *
+ * Each band becomes a JPEG of its own by copying the headers with a patched frame height, followed by the
+ * restart intervals of the band with their markers numbered from RST0, and an EOI. Bands overlap their
+ * neighbours by one restart aligned group of MCU rows, which is decoded but not kept, so that upsampling of
+ * the kept rows sees the same context as in a sequential decode.
+ */
+
+#define JPEG_MAX_BANDS            8
+#define JPEG_PARALLEL_MIN_PIXELS  (512 * 512)
+
+typedef struct {
+     const u8            *file;          /* complete JPEG data */
+     unsigned int         length;
+
+     unsigned int         height_offset; /* height field of the frame header */
+     unsigned int         scan_offset;   /* first byte of entropy coded data */
+     unsigned int         scan_end;      /* EOI marker */
+
+     unsigned int        *restarts;      /* offsets of all restart markers */
+     unsigned int         num_restarts;
+} JPEGScan;
+
+typedef struct {
+     const JPEGScan      *scan;
+
+     unsigned int         first_segment; /* first restart interval */
+     unsigned int         last_segment;  /* restart interval following the band */
+     unsigned int         height;        /* image rows covered by the restart intervals */
+
+     unsigned int         scale_num;
+     unsigned int         scale_denom;
+     J_DCT_METHOD         dct_method;
+
+     u32                 *image;         /* first image row kept */
+     unsigned int         width;
+     unsigned int         skip;          /* rows decoded before the first one kept */
+     unsigned int         lines;         /* rows kept */
+
+     JOCTET              *stream;
+     DFBResult            result;
+     DirectThread        *thread;
+} JPEGBand;
+
+static void
+memory_init_source( j_decompress_ptr cinfo )
+{
+     D_UNUSED_P( cinfo );
+}
+
+static boolean
+memory_fill_input_buffer( j_decompress_ptr cinfo )
+{
+     static const JOCTET eoi[2] = { 0xFF, JPEG_EOI };
+
+     /* Insert a fake EOI marker */
+     cinfo->src->next_input_byte = eoi;
+     cinfo->src->bytes_in_buffer = 2;
+
+     return TRUE;
+}
+
+static void
+memory_skip_input_data( j_decompress_ptr cinfo, long num_bytes )
+{
+     if (num_bytes > (long) cinfo->src->bytes_in_buffer) {
+          memory_fill_input_buffer( cinfo );
+     }
+     else if (num_bytes > 0) {
+          cinfo->src->next_input_byte += num_bytes;
+          cinfo->src->bytes_in_buffer -= num_bytes;
+     }
+}
+
+static void
+memory_term_source( j_decompress_ptr cinfo )
+{
+     D_UNUSED_P( cinfo );
+}
+
+static void
+jpeg_memory_src( j_decompress_ptr cinfo, const JOCTET *data, unsigned int length )
+{
+     struct jpeg_source_mgr *src;
+
+     src = cinfo->src = (struct jpeg_source_mgr *)
+                        cinfo->mem->alloc_small ((j_common_ptr) cinfo, JPOOL_PERMANENT,
+                                                 sizeof (struct jpeg_source_mgr));
+
+     src->init_source       = memory_init_source;
+     src->fill_input_buffer = memory_fill_input_buffer;
+     src->skip_input_data   = memory_skip_input_data;
+     src->resync_to_restart = jpeg_resync_to_restart; /* use default method */
+     src->term_source       = memory_term_source;
+     src->bytes_in_buffer   = length;
+     src->next_input_byte   = data;
+}
+
+/*
+ * Locates the frame height, the single scan and all of its restart markers.
+ */
+static DFBResult
+jpeg_scan_parse( JPEGScan *scan )
+{
+     const u8     *file = scan->file;
+     unsigned int  size = 0;
+     unsigned int  i    = 2;
+
+     while (!scan->scan_offset) {
+          unsigned int marker, length;
+
+          if (i + 4 > scan->length || file[i] != 0xFF)
+               return DFB_UNSUPPORTED;
+
+          marker = file[i+1];
+
+          /* Skip fill bytes. */
+          if (marker == 0xFF) {
+               i++;
+               continue;
+          }
+
+          length = (file[i+2] << 8) | file[i+3];
+
+          if (i + 2 + length > scan->length)
+               return DFB_UNSUPPORTED;
+
+          switch (marker) {
+               case 0xC0:
+               case 0xC1:
+                    scan->height_offset = i + 5;
+                    break;
+
+               case 0xC4:
+               case 0xC8:
+               case 0xCC:
+                    break;
+
+               case 0xDA:
+                    scan->scan_offset = i + 2 + length;
+                    break;
+
+               default:
+                    /* Progressive, lossless or arithmetic coded frame. */
+                    if (marker >= 0xC2 && marker <= 0xCF)
+                         return DFB_UNSUPPORTED;
+                    break;
+          }
+
+          i += 2 + length;
+     }
+
+     if (!scan->height_offset)
+          return DFB_UNSUPPORTED;
+
+     for (i=scan->scan_offset; i + 1 < scan->length; i++) {
+          if (file[i] != 0xFF)
+               continue;
+
+          switch (file[i+1]) {
+               case 0x00:
+                    /* Stuffed zero byte. */
+                    i++;
+                    break;
+
+               case 0xFF:
+                    /* Fill byte before a marker. */
+                    break;
+
+               case JPEG_RST0 ... JPEG_RST0 + 7:
+                    if (scan->num_restarts == size) {
+                         unsigned int *restarts;
+
+                         size     = size ? size * 2 : 256;
+                         restarts = D_REALLOC( scan->restarts, size * sizeof(unsigned int) );
+                         if (!restarts)
+                              return D_OOM();
+
+                         scan->restarts = restarts;
+                    }
+
+                    scan->restarts[scan->num_restarts++] = i++;
+                    break;
+
+               case JPEG_EOI:
+                    scan->scan_end = i;
+                    return DFB_OK;
+
+               default:
+                    /* More scans or tables following the first scan. */
+                    return DFB_UNSUPPORTED;
+          }
+     }
+
+     /* Truncated file. */
+     return DFB_UNSUPPORTED;
+}
+
+static void
+jpeg_band_decode( JPEGBand *band )
+{
+     struct jpeg_decompress_struct  cinfo;
+     struct my_error_mgr            jerr;
+     JSAMPARRAY                     buffer;
+     unsigned int                   i;
+     unsigned int                   y;
+     u32                           *row   = band->image;
+     const JPEGScan                *scan  = band->scan;
+     unsigned int                   start = band->first_segment ?
+                                            scan->restarts[band->first_segment - 1] + 2 : scan->scan_offset;
+     unsigned int                   end   = band->last_segment <= scan->num_restarts ?
+                                            scan->restarts[band->last_segment - 1] : scan->scan_end;
+     unsigned int                   size  = scan->scan_offset + end - start + 2;
+
+     band->stream = D_MALLOC( size );
+     if (!band->stream) {
+          band->result = D_OOM();
+          return;
+     }
+
+     direct_memcpy( band->stream, scan->file, scan->scan_offset );
+     direct_memcpy( band->stream + scan->scan_offset, scan->file + start, end - start );
+
+     band->stream[scan->height_offset]     = band->height >> 8;
+     band->stream[scan->height_offset + 1] = band->height & 0xFF;
+
+     for (i=band->first_segment; i + 1 < band->last_segment; i++)
+          band->stream[scan->scan_offset + scan->restarts[i] - start + 1] = JPEG_RST0 + ((i - band->first_segment) & 7);
+
+     band->stream[size - 2] = 0xFF;
+     band->stream[size - 1] = JPEG_EOI;
+
+     cinfo.err = jpeg_std_error( &jerr.pub );
+     jerr.pub.error_exit = jpeglib_panic;
+
+     if (setjmp( jerr.setjmp_buffer )) {
+          D_ERROR( "ImageProvider/JPEG: Error during decoding of band!\n" );
+
+          jpeg_destroy_decompress( &cinfo );
+
+          band->result = DFB_FAILURE;
+          return;
+     }
+
+     jpeg_create_decompress( &cinfo );
+     jpeg_memory_src( &cinfo, band->stream, size );
+     jpeg_read_header( &cinfo, TRUE );
+
+     cinfo.scale_num       = band->scale_num;
+     cinfo.scale_denom     = band->scale_denom;
+     cinfo.dct_method      = band->dct_method;
+     cinfo.out_color_space = JCS_RGB;
+
+     jpeg_start_decompress( &cinfo );
+
+     if (cinfo.output_width != band->width || cinfo.output_height < band->skip + band->lines) {
+          jpeg_destroy_decompress( &cinfo );
+
+          band->result = DFB_FAILURE;
+          return;
+     }
+
+     buffer = (*cinfo.mem->alloc_sarray)( (j_common_ptr) &cinfo, JPOOL_IMAGE, cinfo.output_width * 3, 1 );
+
+     for (y=0; y < band->skip + band->lines; y++) {
+          jpeg_read_scanlines( &cinfo, buffer, 1 );
+
+          if (y >= band->skip) {
+               copy_line32( row, *buffer, band->width );
+
+               row += band->width;
+          }
+     }
+
+     jpeg_abort_decompress( &cinfo );
+     jpeg_destroy_decompress( &cinfo );
+
+     band->result = DFB_OK;
+}
+
+static void *
+jpeg_band_thread( DirectThread *thread, void *arg )
+{
+     jpeg_band_decode( arg );
+
+     return NULL;
+}
+
+static unsigned int
+jpeg_read_file( IDirectFBDataBuffer *buffer, u8 **ret_file )
+{
+     DFBResult     ret;
+     unsigned int  length;
+     unsigned int  position;
+     unsigned int  got;
+     unsigned int  read = 0;
+     u8           *file;
+
+     if (buffer->GetLength( buffer, &length ) || buffer->GetPosition( buffer, &position ))
+          return 0;
+
+     file = D_MALLOC( length );
+     if (!file)
+          return 0;
+
+     /* Read the whole file and restore the position of the sequential decoder. */
+     buffer->SeekTo( buffer, 0 );
+
+     for (got = 0; got < length; got += read) {
+          ret = buffer->GetData( buffer, length - got, file + got, &read );
+          if (ret || !read)
+               break;
+     }
+
+     buffer->SeekTo( buffer, position );
+
+     if (got < length) {
+          D_FREE( file );
+          return 0;
+     }
+
+     *ret_file = file;
+
+     return length;
+}
+
+/*
+ * Decodes the image set up in 'cinfo' into data->image using multiple threads, if the file allows for it.
+ */
+static DFBResult
+jpeg_decode_parallel( IDirectFBImageProvider_JPEG_data *data, struct jpeg_decompress_struct *cinfo )
+{
+     DFBResult     ret = DFB_OK;
+     int           i;
+     int           num_bands;
+     unsigned int  interval = cinfo->restart_interval;
+     unsigned int  mcu_width;
+     unsigned int  mcu_height;
+     unsigned int  mcus_per_row;
+     unsigned int  mcu_rows;
+     unsigned int  unit;
+     unsigned int  units;
+     u8           *file     = NULL;
+     JPEGScan      scan;
+     JPEGBand      bands[JPEG_MAX_BANDS];
+
+     if (!interval || cinfo->progressive_mode || cinfo->arith_code ||
+         cinfo->comps_in_scan != cinfo->num_components ||
+         cinfo->output_width * cinfo->output_height < JPEG_PARALLEL_MIN_PIXELS)
+          return DFB_UNSUPPORTED;
+
+     num_bands = MIN( sysconf( _SC_NPROCESSORS_ONLN ), JPEG_MAX_BANDS );
+     if (num_bands < 2)
+          return DFB_UNSUPPORTED;
+
+     /* A single component scan is not interleaved, its MCU being one block. */
+     if (cinfo->num_components == 1) {
+          mcu_width  = DCTSIZE;
+          mcu_height = DCTSIZE;
+     }
+     else {
+          mcu_width  = cinfo->max_h_samp_factor * DCTSIZE;
+          mcu_height = cinfo->max_v_samp_factor * DCTSIZE;
+     }
+
+     mcus_per_row = (cinfo->image_width  + mcu_width  - 1) / mcu_width;
+     mcu_rows     = (cinfo->image_height + mcu_height - 1) / mcu_height;
+
+     /* Bands start at MCU rows starting with a restart interval, i.e. at multiples of 'unit' rows. */
+     for (i = mcus_per_row, unit = interval; i; ) {
+          unsigned int rest = unit % i;
+
+          unit = i;
+          i    = rest;
+     }
+
+     unit  = interval / unit;
+     units = (mcu_rows + unit - 1) / unit;
+
+     /* Need at least two groups per band for the overlap to pay off. */
+     num_bands = MIN( num_bands, units / 2 );
+     if (num_bands < 2)
+          return DFB_UNSUPPORTED;
+
+     if ((unit * mcu_height * cinfo->scale_num) % cinfo->scale_denom)
+          return DFB_UNSUPPORTED;
+
+     memset( &scan, 0, sizeof(scan) );
+
+     scan.length = jpeg_read_file( data->base.buffer, &file );
+     if (!scan.length)
+          return DFB_UNSUPPORTED;
+
+     scan.file = file;
+
+     ret = jpeg_scan_parse( &scan );
+     if (ret)
+          goto out;
+
+     if (scan.num_restarts + 1 != (mcus_per_row * mcu_rows + interval - 1) / interval) {
+          ret = DFB_UNSUPPORTED;
+          goto out;
+     }
+
+     data->image = D_CALLOC( cinfo->output_height, cinfo->output_width * 4 );
+     if (!data->image) {
+          ret = D_OOM();
+          goto out;
+     }
+
+     data->image_width  = cinfo->output_width;
+     data->image_height = cinfo->output_height;
+
+     memset( bands, 0, sizeof(bands) );
+
+     for (i=0; i<num_bands; i++) {
+          JPEGBand     *band  = &bands[i];
+          unsigned int  first = units * i / num_bands * unit;
+          unsigned int  last  = MIN( units * (i + 1) / num_bands * unit, mcu_rows );
+          unsigned int  from  = i ? first - unit : 0;
+          unsigned int  to    = MIN( last + unit, mcu_rows );
+          unsigned int  top   = first * mcu_height * cinfo->scale_num / cinfo->scale_denom;
+          unsigned int  next  = (i < num_bands - 1) ? last * mcu_height * cinfo->scale_num / cinfo->scale_denom :
+                                                      cinfo->output_height;
+
+          band->scan          = &scan;
+          band->first_segment = from * mcus_per_row / interval;
+          band->last_segment  = (to < mcu_rows) ? to * mcus_per_row / interval : scan.num_restarts + 1;
+          band->height        = MIN( to * mcu_height, cinfo->image_height ) - from * mcu_height;
+          band->scale_num     = cinfo->scale_num;
+          band->scale_denom   = cinfo->scale_denom;
+          band->dct_method    = cinfo->dct_method;
+          band->image         = data->image + top * data->image_width;
+          band->width         = cinfo->output_width;
+          band->skip          = (first - from) * mcu_height * cinfo->scale_num / cinfo->scale_denom;
+          band->lines         = next - top;
+
+          if (i)
+               band->thread = direct_thread_create( DTT_DEFAULT, jpeg_band_thread, band, "JPEG Band" );
+     }
+
+     jpeg_band_decode( &bands[0] );
+
+     for (i=0; i<num_bands; i++) {
+          JPEGBand *band = &bands[i];
+
+          if (band->thread) {
+               direct_thread_join( band->thread );
+               direct_thread_destroy( band->thread );
+          }
+          else if (i)
+               jpeg_band_decode( band );
+
+          if (band->result && !ret)
+               ret = band->result;
+
+          if (band->stream)
+               D_FREE( band->stream );
+     }
+
+     if (ret) {
+          D_FREE( data->image );
+
+          data->image        = NULL;
+          data->image_width  = 0;
+          data->image_height = 0;
+     }
+
+out:
+     if (scan.restarts)
+          D_FREE( scan.restarts );
+
+     D_FREE( file );
+
+     return ret;
+}
+
 
 static void
 IDirectFBImageProvider_JPEG_Destruct( IDirectFBImageProvider *thiz )
@@ -392,6 +937,7 @@ Construct( IDirectFBImageProvider *thiz,
      }
 
      data->base.Destruct = IDirectFBImageProvider_JPEG_Destruct;
+     data->base.cacheable = true;
 
      thiz->RenderTo = IDirectFBImageProvider_JPEG_RenderTo;
      thiz->GetImageDescription =IDirectFBImageProvider_JPEG_GetImageDescription;
@@ -575,6 +1121,20 @@ IDirectFBImageProvider_JPEG_RenderTo( IDirectFBImageProvider *thiz,
           if (data->flags & DIRENDER_FAST)
                cinfo.dct_method = JDCT_IFAST;
 
+          /* Large images are decoded on all CPUs if possible, without progress notification. */
+          if (cinfo.out_color_space == JCS_RGB && !data->base.render_callback &&
+              jpeg_decode_parallel( data, &cinfo ) == DFB_OK)
+          {
+               jpeg_destroy_decompress( &cinfo );
+
+               dfb_scale_linear_32( data->image, data->image_width, data->image_height,
+                                    lock.addr, lock.pitch, &rect, dst_surface, &clip );
+
+               dfb_surface_unlock_buffer( dst_surface, &lock );
+
+               return DFB_OK;
+          }
+
           jpeg_start_decompress( &cinfo );
 
           data->image_width = cinfo.output_width;
@@ -438,6 +438,7 @@ Construct( IDirectFBImageProvider *thiz,
      }
 
      data->base.Destruct = IDirectFBImageProvider_JPEG2000_Destruct;
+     data->base.cacheable = true;
 
      thiz->RenderTo              = IDirectFBImageProvider_JPEG2000_RenderTo;
      thiz->SetRenderCallback     = IDirectFBImageProvider_JPEG2000_SetRenderCallback;
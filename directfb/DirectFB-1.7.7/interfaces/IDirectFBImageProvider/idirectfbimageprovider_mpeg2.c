@@ -182,6 +182,7 @@ Construct( IDirectFBImageProvider *thiz,
      data->stage = STAGE_IMAGE;
 
      data->base.Destruct = IDirectFBImageProvider_MPEG2_Destruct;
+     data->base.cacheable = true;
 
      thiz->RenderTo = IDirectFBImageProvider_MPEG2_RenderTo;
      thiz->SetRenderCallback = IDirectFBImageProvider_MPEG2_SetRenderCallback;
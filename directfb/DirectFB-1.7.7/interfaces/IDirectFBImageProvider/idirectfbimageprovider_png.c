@@ -98,6 +98,29 @@ enum {
      STAGE_END
 };
 
+/*
+ * state of decoding rows directly into a locked destination
+ */
+typedef struct {
+     CoreSurface           *surface;
+     CoreSurfaceBufferLock  lock;
+
+     DFBRectangle           rect;        /* destination of the whole image */
+     DFBRegion              clip;
+
+     int                    sum_x;       /* integer downscaling by averaging pixels */
+     int                    sum_y;
+
+     bool                   lut8;        /* copy indices to a LUT8 surface */
+
+     u32                   *row;         /* decoded row in ARGB */
+     u32                   *scaled;      /* row scaled to the destination width */
+     u32                   *acc;         /* channel sums of rows being averaged */
+     int                    acc_rows;
+
+     int                    dst_y;       /* next destination row within rect */
+} PNGStream;
+
 /*
  * private data struct of IDirectFBImageProvider_PNG
  */
@@ -121,6 +144,9 @@ typedef struct {
      int                  pitch;
      u32                  palette[256];
      DFBColor             colors[256];
+
+     PNGStream           *stream;        /* rows are written to a surface while decoding */
+     bool                 streamed;      /* image has not been kept, decode again to render */
 } IDirectFBImageProvider_PNG_data;
 
 
@@ -161,6 +187,16 @@ push_data_until_stage (IDirectFBImageProvider_PNG_data *data,
                        int                              stage,
                        int                              buffer_size);
 
+/* Creates the PNG handles and reads until the info callback is called. */
+static DFBResult
+start_decoding( IDirectFBImageProvider_PNG_data *data );
+
+/* Converts a row of palette or gray indices to ARGB. */
+static void
+expand_indexed_row( IDirectFBImageProvider_PNG_data *data,
+                    const u8                        *S,
+                    u32                             *D );
+
 /**********************************************************************************************************************/
 
 static void
@@ -191,7 +227,7 @@ static DFBResult
 Construct( IDirectFBImageProvider *thiz,
            ... )
 {
-     DFBResult ret = DFB_FAILURE;
+     DFBResult ret;
 
      IDirectFBDataBuffer *buffer;
      CoreDFB             *core;
@@ -213,35 +249,13 @@ Construct( IDirectFBImageProvider *thiz,
      /* Increase the data buffer reference counter. */
      buffer->AddRef( buffer );
 
-     /* Create the PNG read handle. */
-     data->png_ptr = png_create_read_struct( PNG_LIBPNG_VER_STRING,
-                                             NULL, NULL, NULL );
-     if (!data->png_ptr)
-          goto error;
-
-     if (setjmp( png_jmpbuf(data->png_ptr) )) {
-          D_ERROR( "ImageProvider/PNG: Error reading header!\n" );
-          goto error;
-     }
-
-     /* Create the PNG info handle. */
-     data->info_ptr = png_create_info_struct( data->png_ptr );
-     if (!data->info_ptr)
-          goto error;
-
-     /* Setup progressive image loading. */
-     png_set_progressive_read_fn( data->png_ptr, data,
-                                  png_info_callback,
-                                  png_row_callback,
-                                  png_end_callback );
-
-
      /* Read until info callback is called. */
-     ret = push_data_until_stage( data, STAGE_INFO, 64 );
+     ret = start_decoding( data );
      if (ret)
           goto error;
 
      data->base.Destruct = IDirectFBImageProvider_PNG_Destruct;
+     data->base.cacheable = true;
 
      thiz->RenderTo              = IDirectFBImageProvider_PNG_RenderTo;
      thiz->GetImageDescription   = IDirectFBImageProvider_PNG_GetImageDescription;
@@ -265,6 +279,157 @@ error:
 
 /**********************************************************************************************************************/
 
+/*
+ * Returns the average count scaling 'src' down to 'dst' by an integer factor (or 1:1).
+ */
+static bool
+integer_downscale( int src, int dst, int *ret_sum )
+{
+     if (dst > src || src % dst)
+          return false;
+
+     *ret_sum = src / dst;
+
+     return true;
+}
+
+/*
+ * Locks the destination for decoding rows directly into it, if the image does not need to be kept.
+ *
+ * Interlaced images, upscaling and non integer downscaling still use the intermediate image,
+ * to get the same linear filtering as before.
+ */
+static DFBResult
+stream_begin( IDirectFBImageProvider_PNG_data *data,
+              CoreSurface                     *surface,
+              const DFBRectangle              *rect,
+              const DFBRegion                 *clip )
+{
+     DFBResult            ret;
+     PNGStream           *stream;
+     int                  sum_x, sum_y;
+     int                  size;
+     unsigned int         pos;
+     IDirectFBDataBuffer *buffer = data->base.buffer;
+
+     if (data->stage != STAGE_INFO || data->image)
+          return DFB_UNSUPPORTED;
+
+     if (png_get_interlace_type( data->png_ptr, data->info_ptr ) != PNG_INTERLACE_NONE)
+          return DFB_UNSUPPORTED;
+
+     if (!integer_downscale( data->width, rect->w, &sum_x ) ||
+         !integer_downscale( data->height, rect->h, &sum_y ))
+          return DFB_UNSUPPORTED;
+
+     /* Rendering again needs to decode the image again. */
+     if (buffer->GetPosition( buffer, &pos ) || buffer->SeekTo( buffer, pos ))
+          return DFB_UNSUPPORTED;
+
+     size = data->width + rect->w;
+
+     if (sum_x > 1 || sum_y > 1)
+          size += rect->w * 4;
+
+     stream = D_CALLOC( 1, sizeof(PNGStream) + size * 4 );
+     if (!stream)
+          return D_OOM();
+
+     stream->surface = surface;
+     stream->rect    = *rect;
+     stream->clip    = *clip;
+     stream->sum_x   = sum_x;
+     stream->sum_y   = sum_y;
+
+     stream->row     = (u32*)(stream + 1);
+     stream->scaled  = stream->row + data->width;
+     stream->acc     = stream->scaled + rect->w;
+
+     /* Special indexed PNG to LUT8 loading, complete surface only. */
+     if (data->color_type == PNG_COLOR_TYPE_PALETTE && data->bpp == 8 &&
+         surface->config.format == DSPF_LUT8 &&
+         rect->x == 0 && rect->y == 0 &&
+         rect->w == surface->config.size.w && rect->h == surface->config.size.h &&
+         rect->w == data->width && rect->h == data->height &&
+         clip->x1 <= 0 && clip->y1 <= 0 && clip->x2 >= rect->w - 1 && clip->y2 >= rect->h - 1)
+          stream->lut8 = true;
+
+     ret = dfb_surface_lock_buffer( surface, CSBR_BACK, CSAID_CPU, CSAF_WRITE, &stream->lock );
+     if (ret) {
+          D_FREE( stream );
+          return ret;
+     }
+
+     D_DEBUG_AT( imageProviderPNG, "  -> streaming to %4d,%4d-%4dx%4d (x/%d, y/%d)\n",
+                 DFB_RECTANGLE_VALS(rect), sum_x, sum_y );
+
+     data->stream   = stream;
+     data->streamed = true;
+
+     return DFB_OK;
+}
+
+static void
+stream_end( IDirectFBImageProvider_PNG_data *data )
+{
+     PNGStream *stream = data->stream;
+
+     dfb_surface_unlock_buffer( stream->surface, &stream->lock );
+
+     D_FREE( stream );
+
+     data->stream = NULL;
+}
+
+/*
+ * Scales a decoded ARGB row to the destination width, writing it once enough rows have been averaged.
+ */
+static void
+stream_argb_row( PNGStream *stream, u32 *row )
+{
+     int           x, i;
+     u32          *scaled = stream->scaled;
+     DFBRectangle  drect;
+
+     if (stream->sum_x == 1 && stream->sum_y == 1)
+          scaled = row;
+     else {
+          u32 *acc = stream->acc;
+          int  num = stream->sum_x * stream->sum_y;
+
+          for (x = 0; x < stream->rect.w; x++, acc += 4) {
+               const u32 *S = row + x * stream->sum_x;
+
+               for (i = 0; i < stream->sum_x; i++) {
+                    acc[0] += S[i] >> 24;
+                    acc[1] += (S[i] >> 16) & 0xff;
+                    acc[2] += (S[i] >>  8) & 0xff;
+                    acc[3] += S[i] & 0xff;
+               }
+          }
+
+          if (++stream->acc_rows < stream->sum_y)
+               return;
+
+          for (x = 0, acc = stream->acc; x < stream->rect.w; x++, acc += 4)
+               scaled[x] = PIXEL_ARGB( acc[0] / num, acc[1] / num, acc[2] / num, acc[3] / num );
+
+          memset( stream->acc, 0, stream->rect.w * 4 * sizeof(u32) );
+
+          stream->acc_rows = 0;
+     }
+
+     drect.x = stream->rect.x;
+     drect.y = stream->rect.y + stream->dst_y++;
+     drect.w = stream->rect.w;
+     drect.h = 1;
+
+     /* Writing may premultiply the row in place, it is not used afterwards. */
+     dfb_copy_buffer_32( scaled, stream->lock.addr, stream->lock.pitch, &drect, stream->surface, &stream->clip );
+}
+
+/**********************************************************************************************************************/
+
 static DFBResult
 IDirectFBImageProvider_PNG_RenderTo( IDirectFBImageProvider *thiz,
                                      IDirectFBSurface       *destination,
@@ -275,7 +440,7 @@ IDirectFBImageProvider_PNG_RenderTo( IDirectFBImageProvider *thiz,
      CoreSurface           *dst_surface;
      DFBRegion              clip;
      DFBRectangle           rect;
-     int                    x, y;
+     int                    y;
      DFBRectangle           clipped;
 
      DIRECT_INTERFACE_GET_DATA (IDirectFBImageProvider_PNG)
@@ -314,15 +479,64 @@ IDirectFBImageProvider_PNG_RenderTo( IDirectFBImageProvider *thiz,
           D_DEBUG_AT( imageProviderPNG, "  -> dest_rect %4d,%4d-%4dx%4d (from dst)\n", DFB_RECTANGLE_VALS(&rect) );
      }
 
+     clipped = rect;
+
+     D_DEBUG_AT( imageProviderPNG, "  -> clip      %4d,%4d-%4dx%4d\n", DFB_RECTANGLE_VALS_FROM_REGION(&clip) );
+
+     if (!dfb_rectangle_intersect_by_region( &clipped, &clip ))
+          return DFB_INVAREA;
+
+     D_DEBUG_AT( imageProviderPNG, "  -> clipped   %4d,%4d-%4dx%4d\n", DFB_RECTANGLE_VALS(&clipped) );
+
+     /* The image has been written to a surface while decoding before, start over. */
+     if (data->streamed && (data->stage == STAGE_END || data->stage < 0)) {
+          png_destroy_read_struct( &data->png_ptr, &data->info_ptr, NULL );
+
+          data->stage    = STAGE_START;
+          data->rows     = 0;
+          data->streamed = false;
+
+          ret = data->base.buffer->SeekTo( data->base.buffer, 0 );
+          if (ret)
+               return ret;
+
+          ret = start_decoding( data );
+          if (ret)
+               return ret;
+     }
+
      if (setjmp( png_jmpbuf(data->png_ptr) )) {
           D_ERROR( "ImageProvider/PNG: Error during decoding!\n" );
 
+          if (data->stream) {
+               stream_end( data );
+
+               if (data->stage < STAGE_IMAGE)
+                    return DFB_FAILURE;
+
+               data->stage = STAGE_ERROR;
+
+               return DFB_INCOMPLETE;
+          }
+
           if (data->stage < STAGE_IMAGE)
                return DFB_FAILURE;
 
           data->stage = STAGE_ERROR;
      }
 
+     /* Decode rows directly into the destination if possible. */
+     if (stream_begin( data, dst_surface, &rect, &clip ) == DFB_OK) {
+          ret = push_data_until_stage( data, STAGE_END, 16384 );
+
+          stream_end( data );
+
+          if (ret)
+               return ret;
+
+          return (data->stage != STAGE_END) ? DFB_INCOMPLETE : DFB_OK;
+     }
+
      /* Read until image is completely decoded. */
      if (data->stage != STAGE_ERROR) {
           ret = push_data_until_stage( data, STAGE_END, 16384 );
@@ -330,14 +544,8 @@ IDirectFBImageProvider_PNG_RenderTo( IDirectFBImageProvider *thiz,
                return ret;
      }
 
-     clipped = rect;
-
-     D_DEBUG_AT( imageProviderPNG, "  -> clip      %4d,%4d-%4dx%4d\n", DFB_RECTANGLE_VALS_FROM_REGION(&clip) );
-
-     if (!dfb_rectangle_intersect_by_region( &clipped, &clip ))
-          return DFB_INVAREA;
-
-     D_DEBUG_AT( imageProviderPNG, "  -> clipped   %4d,%4d-%4dx%4d\n", DFB_RECTANGLE_VALS(&clipped) );
+     if (!data->image)
+          return DFB_FAILURE;
 
      /* actual rendering */
      if (0    &&   // FIXME
@@ -392,10 +600,6 @@ IDirectFBImageProvider_PNG_RenderTo( IDirectFBImageProvider *thiz,
                      */
                     if (data->bpp == 16) {
                          /* in 16 bit grayscale,  conversion to RGB32 is already done! */
-
-                         for (x = 0; x < 256; x++)
-                              data->palette[x] = 0xff000000 | (x << 16) | (x << 8) | x;
-
                          dfb_scale_linear_32( data->image, data->width, data->height,
                                               lock.addr, lock.pitch, &rect, dst_surface, &clip );
                          break;
@@ -415,73 +619,9 @@ IDirectFBImageProvider_PNG_RenderTo( IDirectFBImageProvider *thiz,
                          ret = DFB_NOSYSTEMMEMORY;
                     }
                     else {
-                         if (data->color_type == PNG_COLOR_TYPE_GRAY) {
-                              int num = 1 << bit_depth;
-
-                              for (x = 0; x < num; x++) {
-                                   int value = x * 255 / (num - 1);
-
-                                   data->palette[x] = 0xff000000 | (value << 16) | (value << 8) | value;
-                              }
-                         }
-
-                         switch (bit_depth) {
-                              case 8:
-                                   for (y = 0; y < data->height; y++) {
-                                        u8  *S = (u8*)data->image + data->pitch * y;
-                                        u32 *D = (u32*)((u8*)image_argb  + data->width * y * 4);
-
-                                        for (x = 0; x < data->width; x++)
-                                             D[x] = data->palette[ S[x] ];
-                                   }
-                                   break;
-
-                              case 4:
-                                   for (y = 0; y < data->height; y++) {
-                                        u8  *S = (u8*)data->image + data->pitch * y;
-                                        u32 *D = (u32*)((u8*)image_argb  + data->width * y * 4);
-
-                                        for (x = 0; x < data->width; x++) {
-                                             if (x & 1)
-                                                  D[x] = data->palette[ S[x>>1] & 0xf ];
-                                             else
-                                                  D[x] = data->palette[ S[x>>1] >> 4 ];
-                                        }
-                                   }
-                                   break;
-
-                              case 2:
-                                   for (y = 0; y < data->height; y++) {
-                                        int  n = 6;
-                                        u8  *S = (u8*)data->image + data->pitch * y;
-                                        u32 *D = (u32*)((u8*)image_argb  + data->width * y * 4);
-
-                                        for (x = 0; x < data->width; x++) {
-                                             D[x] = data->palette[ (S[x>>2] >> n) & 3 ];
-
-                                             n = (n ? n - 2 : 6);
-                                        }
-                                   }
-                                   break;
-
-                              case 1:
-                                   for (y = 0; y < data->height; y++) {
-                                        int  n = 7;
-                                        u8  *S = (u8*)data->image + data->pitch * y;
-                                        u32 *D = (u32*)((u8*)image_argb  + data->width * y * 4);
-
-                                        for (x = 0; x < data->width; x++) {
-                                             D[x] = data->palette[ (S[x>>3] >> n) & 1 ];
-
-                                             n = (n ? n - 1 : 7);
-                                        }
-                                   }
-                                   break;
-
-                              default:
-                                   D_ERROR( "ImageProvider/PNG: Unsupported indexed bit depth %d!\n",
-                                            bit_depth );
-                         }
+                         for (y = 0; y < data->height; y++)
+                              expand_indexed_row( data, (u8*)data->image + data->pitch * y,
+                                                  (u32*)((u8*)image_argb + data->width * y * 4) );
 
                          dfb_scale_linear_32( image_argb, data->width, data->height,
                                               lock.addr, lock.pitch, &rect, dst_surface, &clip );
@@ -804,6 +944,14 @@ png_info_callback( png_structp png_read_ptr,
 
           case PNG_COLOR_TYPE_GRAY:
                if (data->bpp < 16) {
+                    int num = 1 << data->bpp;
+
+                    for (i = 0; i < num; i++) {
+                         int value = i * 255 / (num - 1);
+
+                         data->palette[i] = 0xff000000 | (value << 16) | (value << 8) | value;
+                    }
+
                     data->pitch = data->width;
                     break;
                }
@@ -839,6 +987,127 @@ png_info_callback( png_structp png_read_ptr,
      png_read_update_info( data->png_ptr, data->info_ptr );
 }
 
+/*
+ * Writes a row of a color keyed image with 16 bits per channel, see the comments below.
+ */
+static void
+write_keyed_row( IDirectFBImageProvider_PNG_data *data,
+                 u8                              *dst,
+                 u8                              *src,
+                 png_uint_32                      row_num,
+                 int                              pass_num )
+{
+     if (src) {
+          int src_advance = 8;
+          int src16_advance = 4;
+          int dst32_advance = 1;
+          int src16_initial_offset = 0;
+          int dst32_initial_offset = 0;
+
+          if (!(row_num % 2)) { /* even lines 0,2,4 ... */
+               switch (pass_num) {
+                    case 1:
+                         dst32_initial_offset = 4;
+                         src16_initial_offset = 16;
+                         src_advance = 64;
+                         src16_advance = 32;
+                         dst32_advance = 8;
+                         break;
+                    case 3:
+                         dst32_initial_offset = 2;
+                         src16_initial_offset = 8;
+                         src_advance = 32;
+                         src16_advance = 16;
+                         dst32_advance = 4;
+                         break;
+                    case 5:
+                         dst32_initial_offset = 1;
+                         src16_initial_offset = 4;
+                         src_advance = 16;
+                         src16_advance = 8;
+                         dst32_advance = 2;
+                         break;
+                    default:
+                         break;
+               }
+          }
+
+
+          png_bytep      trans;
+          png_color_16p  trans_color;
+          int            num_trans = 0;
+
+          png_get_tRNS( data->png_ptr, data->info_ptr,
+                        &trans, &num_trans, &trans_color );
+
+          u16 *src16 = (u16*)src + src16_initial_offset;
+          u32 *dst32 = (u32*)dst + dst32_initial_offset;
+
+          int remaining = data->width - dst32_initial_offset;
+
+          while (remaining > 0) {
+               int keyed = 0;
+#ifdef WORDS_BIGENDIAN
+               u16 comp_r = src16[1];
+               u16 comp_g = src16[2];
+               u16 comp_b = src16[3];
+               u32 pixel32 = src[1] << 24 | src[3] << 16 | src[5] << 8 | src[7];
+#else
+               u16 comp_r = src16[2];
+               u16 comp_g = src16[1];
+               u16 comp_b = src16[0];
+
+               u32 pixel32 = src[6] << 24 | src[4] << 16 | src[2] << 8 | src[0];
+#endif
+               /* is the pixel supposted to match the color key in 16 bit per channel resolution? */
+               if (((comp_r == trans_color[0].gray) && (data->color_type == PNG_COLOR_TYPE_GRAY)) ||
+                   ((comp_g == trans_color[0].green) && (comp_b == trans_color[0].blue) && (comp_r == trans_color[0].red)))
+                    keyed = 1;
+
+               /*
+                *  if the pixel was not supposed to get keyed but the colorkey matches in the reduced
+                *  color space, then toggle the least significant blue bit
+                */
+               if (!keyed && (pixel32 == (0xff000000 | data->color_key))) {
+                    D_ONCE( "ImageProvider/PNG: adjusting pixel data to protect it from being keyed!\n" );
+                    pixel32 ^= 0x00000001;
+               }
+
+               *dst32 = pixel32;
+
+               src16 += src16_advance;
+               src   += src_advance;
+               dst32 += dst32_advance;
+               remaining-= dst32_advance;
+          }
+     }
+}
+
+/*
+ * Converts a decoded row to ARGB and writes it to the destination being streamed to.
+ */
+static void
+stream_row( IDirectFBImageProvider_PNG_data *data,
+            png_bytep                        new_row,
+            png_uint_32                      row_num )
+{
+     PNGStream *stream = data->stream;
+
+     if (stream->lut8) {
+          direct_memcpy( (u8*)stream->lock.addr + stream->lock.pitch * row_num, new_row, data->width );
+          return;
+     }
+
+     if (data->bpp == 16 && data->color_keyed)
+          write_keyed_row( data, (u8*) stream->row, new_row, row_num, 0 );
+     else if (data->color_type == PNG_COLOR_TYPE_PALETTE || (data->color_type == PNG_COLOR_TYPE_GRAY && data->bpp < 16))
+          expand_indexed_row( data, new_row, stream->row );
+     else
+          direct_memcpy( stream->row, new_row, data->width * 4 );
+
+     stream_argb_row( stream, stream->row );
+}
+
 /* Called for each row; note that you will get duplicate row numbers
    for interlaced PNGs */
 static void
@@ -863,7 +1132,7 @@ png_row_callback( png_structp png_read_ptr,
      data->stage = STAGE_IMAGE;
 
      /* check image data pointer */
-     if (!data->image) {
+     if (!data->image && !data->stream) {
           // FIXME: allocates four additional bytes because the scaling functions
           //        in src/misc/gfx_util.c have an off-by-one bug which causes
           //        segfaults on darwin/osx (not on linux)
@@ -883,94 +1152,12 @@ png_row_callback( png_structp png_read_ptr,
      }
 
      /* write to image data */
-     if (data->bpp == 16 && data->color_keyed) {
-          u8 *dst = (u8*)((u8*)data->image + row_num * data->pitch);
-          u8 *src = (u8*)new_row;
-
-          if (src) {
-               int src_advance = 8;
-               int src16_advance = 4;
-               int dst32_advance = 1;
-               int src16_initial_offset = 0;
-               int dst32_initial_offset = 0;
-
-               if (!(row_num % 2)) { /* even lines 0,2,4 ... */
-                    switch (pass_num) {
-                         case 1:
-                              dst32_initial_offset = 4;
-                              src16_initial_offset = 16;
-                              src_advance = 64;
-                              src16_advance = 32;
-                              dst32_advance = 8;
-                              break;
-                         case 3:
-                              dst32_initial_offset = 2;
-                              src16_initial_offset = 8;
-                              src_advance = 32;
-                              src16_advance = 16;
-                              dst32_advance = 4;
-                              break;
-                         case 5:
-                              dst32_initial_offset = 1;
-                              src16_initial_offset = 4;
-                              src_advance = 16;
-                              src16_advance = 8;
-                              dst32_advance = 2;
-                              break;
-                         default:
-                              break;
-                    }
-               }
-
-
-               png_bytep      trans;
-               png_color_16p  trans_color;
-               int            num_trans = 0;
-
-               png_get_tRNS( data->png_ptr, data->info_ptr,
-                             &trans, &num_trans, &trans_color );
-
-               u16 *src16 = (u16*)src + src16_initial_offset;
-               u32 *dst32 = (u32*)dst + dst32_initial_offset;
-
-               int remaining = data->width - dst32_initial_offset;
-
-               while (remaining > 0) {
-                    int keyed = 0;
-#ifdef WORDS_BIGENDIAN
-                    u16 comp_r = src16[1];
-                    u16 comp_g = src16[2];
-                    u16 comp_b = src16[3];
-                    u32 pixel32 = src[1] << 24 | src[3] << 16 | src[5] << 8 | src[7];
-#else
-                    u16 comp_r = src16[2];
-                    u16 comp_g = src16[1];
-                    u16 comp_b = src16[0];
-
-                    u32 pixel32 = src[6] << 24 | src[4] << 16 | src[2] << 8 | src[0];
-#endif
-                    /* is the pixel supposted to match the color key in 16 bit per channel resolution? */
-                    if (((comp_r == trans_color[0].gray) && (data->color_type == PNG_COLOR_TYPE_GRAY)) ||
-                        ((comp_g == trans_color[0].green) && (comp_b == trans_color[0].blue) && (comp_r == trans_color[0].red)))
-                         keyed = 1;
-
-                    /*
-                     *  if the pixel was not supposed to get keyed but the colorkey matches in the reduced
-                     *  color space, then toggle the least significant blue bit
-                     */
-                    if (!keyed && (pixel32 == (0xff000000 | data->color_key))) {
-                         D_ONCE( "ImageProvider/PNG: adjusting pixel data to protect it from being keyed!\n" );
-                         pixel32 ^= 0x00000001;
-                    }
-
-                    *dst32 = pixel32;
-
-                    src16 += src16_advance;
-                    src   += src_advance;
-                    dst32 += dst32_advance;
-                    remaining-= dst32_advance;
-               }
-          }
+     if (data->stream) {
+          if (new_row)
+               stream_row( data, new_row, row_num );
+     }
+     else if (data->bpp == 16 && data->color_keyed) {
+          write_keyed_row( data, (u8*)data->image + row_num * data->pitch, new_row, row_num, pass_num );
      }
      else
          png_progressive_combine_row( data->png_ptr, (png_bytep)((u8*)data->image + row_num * data->pitch), new_row );
@@ -1059,3 +1246,75 @@ push_data_until_stage (IDirectFBImageProvider_PNG_data *data,
 
      return DFB_OK;
 }
+
+static DFBResult
+start_decoding( IDirectFBImageProvider_PNG_data *data )
+{
+     /* Create the PNG read handle. */
+     data->png_ptr = png_create_read_struct( PNG_LIBPNG_VER_STRING,
+                                             NULL, NULL, NULL );
+     if (!data->png_ptr)
+          return DFB_FAILURE;
+
+     if (setjmp( png_jmpbuf(data->png_ptr) )) {
+          D_ERROR( "ImageProvider/PNG: Error reading header!\n" );
+          return DFB_FAILURE;
+     }
+
+     /* Create the PNG info handle. */
+     data->info_ptr = png_create_info_struct( data->png_ptr );
+     if (!data->info_ptr)
+          return DFB_FAILURE;
+
+     /* Setup progressive image loading. */
+     png_set_progressive_read_fn( data->png_ptr, data,
+                                  png_info_callback,
+                                  png_row_callback,
+                                  png_end_callback );
+
+     /* Read until info callback is called. */
+     return push_data_until_stage( data, STAGE_INFO, 64 );
+}
+
+static void
+expand_indexed_row( IDirectFBImageProvider_PNG_data *data,
+                    const u8                        *S,
+                    u32                             *D )
+{
+     int x, n;
+
+     switch (data->bpp) {
+          case 8:
+               for (x = 0; x < data->width; x++)
+                    D[x] = data->palette[ S[x] ];
+               break;
+
+          case 4:
+               for (x = 0; x < data->width; x++) {
+                    if (x & 1)
+                         D[x] = data->palette[ S[x>>1] & 0xf ];
+                    else
+                         D[x] = data->palette[ S[x>>1] >> 4 ];
+               }
+               break;
+
+          case 2:
+               for (x = 0, n = 6; x < data->width; x++) {
+                    D[x] = data->palette[ (S[x>>2] >> n) & 3 ];
+
+                    n = (n ? n - 2 : 6);
+               }
+               break;
+
+          case 1:
+               for (x = 0, n = 7; x < data->width; x++) {
+                    D[x] = data->palette[ (S[x>>3] >> n) & 1 ];
+
+                    n = (n ? n - 1 : 7);
+               }
+               break;
+
+          default:
+               D_ONCE( "ImageProvider/PNG: Unsupported indexed bit depth %d!\n", data->bpp );
+     }
+}
@@ -763,6 +763,7 @@ Construct( IDirectFBImageProvider *thiz,
                format_names[data->format], data->width, data->height );
 
      data->base.Destruct = IDirectFBImageProvider_PNM_Destruct;
+     data->base.cacheable = true;
 
      thiz->RenderTo              = IDirectFBImageProvider_PNM_RenderTo;
      thiz->SetRenderCallback     = IDirectFBImageProvider_PNM_SetRenderCallback;
@@ -45,6 +45,7 @@
 #include <sawman.h>
 
 #include "sawman_config.h"
+#include "sawman_draw.h"
 
 #include "SaWManManager.h"
 
@@ -632,6 +633,82 @@ ISaWManManager_RaiseToTop( ISaWManManager     *thiz,
      return SaWManManager_Restack( data->manager, sawwin, NULL, 1 );
 }
 
+static DirectResult
+ISaWManManager_SetWindowSnapshot( ISaWManManager     *thiz,
+                                  SaWManWindowHandle  handle,
+                                  int                 width,
+                                  int                 height,
+                                  unsigned int        interval )
+{
+     DirectResult  ret;
+     SaWMan       *sawman;
+     SaWManWindow *sawwin = (SaWManWindow*)handle;
+
+     DIRECT_INTERFACE_GET_DATA( ISaWManManager )
+
+     D_DEBUG_AT( SaWMan_Manager, "%s( %dx%d, %u ms )\n", __FUNCTION__, width, height, interval );
+
+     if (handle == SAWMAN_WINDOW_NONE)
+          return DFB_INVARG;
+
+     sawman = data->sawman;
+     D_MAGIC_ASSERT( sawman, SaWMan );
+     D_MAGIC_ASSERT( sawwin, SaWManWindow );
+
+     /* Snapshot state is written directly to shared memory. */
+     if (fusion_config->secure_fusion)
+          return DR_ACCESSDENIED;
+
+     ret = sawman_lock( sawman );
+     if (ret)
+          return ret;
+
+     ret = sawman_set_snapshot( sawman, sawwin, width, height, interval );
+
+     sawman_unlock( sawman );
+
+     return ret;
+}
+
+static DirectResult
+ISaWManManager_GetWindowSnapshot( ISaWManManager     *thiz,
+                                  SaWManWindowHandle  handle,
+                                  DFBSurfaceID       *ret_surface_id,
+                                  unsigned int       *ret_generation )
+{
+     DirectResult  ret = DR_OK;
+     SaWMan       *sawman;
+     SaWManWindow *sawwin = (SaWManWindow*)handle;
+
+     DIRECT_INTERFACE_GET_DATA( ISaWManManager )
+
+     D_DEBUG_AT( SaWMan_Manager, "%s()\n", __FUNCTION__ );
+
+     if (!ret_surface_id || handle == SAWMAN_WINDOW_NONE)
+          return DFB_INVARG;
+
+     sawman = data->sawman;
+     D_MAGIC_ASSERT( sawman, SaWMan );
+     D_MAGIC_ASSERT( sawwin, SaWManWindow );
+
+     ret = sawman_lock( sawman );
+     if (ret)
+          return ret;
+
+     if (sawwin->snapshot.surface && sawwin->snapshot.generation) {
+          *ret_surface_id = sawwin->snapshot.surface->object.id;
+
+          if (ret_generation)
+               *ret_generation = sawwin->snapshot.generation;
+     }
+     else
+          ret = DR_BUFFEREMPTY;
+
+     sawman_unlock( sawman );
+
+     return ret;
+}
+
 DirectResult
 ISaWManManager_Construct( ISaWManManager *thiz,
                           SaWMan         *sawman,
@@ -671,5 +748,8 @@ ISaWManManager_Construct( ISaWManManager *thiz,
      thiz->GetMaximization = ISaWManManager_GetMaximization;
      thiz->RaiseToTop      = ISaWManManager_RaiseToTop;
 
+     thiz->SetWindowSnapshot = ISaWManManager_SetWindowSnapshot;
+     thiz->GetWindowSnapshot = ISaWManManager_GetWindowSnapshot;
+
      return DFB_OK;
 }
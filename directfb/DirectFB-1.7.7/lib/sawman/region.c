@@ -110,12 +110,17 @@ SOFTWARE.
 #include <stdio.h>
 
 #include <direct/mem.h>
+#include <direct/thread.h>
 #include <direct/types.h>
 
 #include <fusion/shmalloc.h>
 
 #include "region.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 
 typedef misc_box_t          box_type_t;
 typedef misc_region_data_t  region_data_type_t;
@@ -248,24 +253,123 @@ PIXREGION_SZOF(size_t n)
      return size + sizeof(region_data_type_t);
 }
 
+/*
+ * Data of local regions is recycled in power of two classes from 16 to 256 boxes,
+ * as most operations allocate a new array and free the old one right after.
+ */
+#define POOL_CLASSES     5
+#define POOL_MIN_BOXES   16
+#define POOL_DEPTH       8
+
+static DirectMutex          pool_lock = DIRECT_MUTEX_INITIALIZER( pool_lock );
+static region_data_type_t  *pool_free[POOL_CLASSES][POOL_DEPTH];
+static int                  pool_num[POOL_CLASSES];
+
+/* smallest class holding n boxes */
+static inline int
+pool_class_up( size_t n )
+{
+     int c;
+
+     for (c=0; c<POOL_CLASSES; c++) {
+          if (n <= (POOL_MIN_BOXES << c))
+               return c;
+     }
+
+     return -1;
+}
+
+/* largest class fitting into data of n boxes */
+static inline int
+pool_class_down( size_t n )
+{
+     int c;
+
+     for (c=POOL_CLASSES-1; c>=0; c--) {
+          if (n >= (POOL_MIN_BOXES << c))
+               return c;
+     }
+
+     return -1;
+}
+
+/* returns data for at least *n boxes, updating *n to the actual capacity */
 static void *
-allocData(region_type_t * region, size_t n)
+allocData(region_type_t * region, size_t *n)
 {
      size_t sz;
+     int    c;
 
      MISC_REGION_ASSERT( region );
 
-     sz = PIXREGION_SZOF(n);
+     if (!region->shmpool && (c = pool_class_up( *n )) >= 0) {
+          region_data_type_t *data = NULL;
+
+          direct_mutex_lock( &pool_lock );
+
+          if (pool_num[c])
+               data = pool_free[c][--pool_num[c]];
+
+          direct_mutex_unlock( &pool_lock );
+
+          *n = POOL_MIN_BOXES << c;
+
+          return data ? data : D_MALLOC( PIXREGION_SZOF(*n) );
+     }
+
+     sz = PIXREGION_SZOF(*n);
      if (!sz)
           return NULL;
 
      return region->shmpool ? SHMALLOC( region->shmpool, sz ) : D_MALLOC( sz );
 }
 
+static void
+releaseData(region_type_t * region, region_data_type_t *data)
+{
+     int c;
+
+     if (region->shmpool) {
+          SHFREE( region->shmpool, data );
+          return;
+     }
+
+     /* 'size' never exceeds the allocation, so rounding down is safe even after realloc */
+     c = pool_class_down( data->size );
+     if (c >= 0) {
+          direct_mutex_lock( &pool_lock );
+
+          if (pool_num[c] < POOL_DEPTH) {
+               pool_free[c][pool_num[c]++] = data;
+               data = NULL;
+          }
+
+          direct_mutex_unlock( &pool_lock );
+     }
+
+     if (data)
+          D_FREE( data );
+}
+
+void
+misc_region_pool_flush( void )
+{
+     int c;
+
+     direct_mutex_lock( &pool_lock );
+
+     for (c=0; c<POOL_CLASSES; c++) {
+          while (pool_num[c])
+               D_FREE( pool_free[c][--pool_num[c]] );
+     }
+
+     direct_mutex_unlock( &pool_lock );
+}
+
 #define freeData(reg)                             \
      do {                                         \
           if ((reg)->data && (reg)->data->size) { \
-               if ((reg)->shmpool) SHFREE((reg)->shmpool, (reg)->data); else D_FREE((reg)->data);               \
+               releaseData( (reg), (reg)->data ); \
                (reg)->data = NULL;                \
           }                                       \
      } while (0)
@@ -454,18 +558,23 @@ misc_rect_alloc (region_type_t * region, int n)
      MISC_REGION_ASSERT( region );
 
      if (!region->data) {
-          n++;
-          region->data = allocData(region, n);
+          size_t size = n + 1;
+
+          region->data = allocData(region, &size);
           if (!region->data)
                return misc_break (region);
           region->data->numRects = 1;
           *PIXREGION_BOXPTR(region) = region->extents;
+          n = size;
      }
      else if (!region->data->size) {
-          region->data = allocData(region, n);
+          size_t size = n;
+
+          region->data = allocData(region, &size);
           if (!region->data)
                return misc_break (region);
           region->data->numRects = 0;
+          n = size;
      }
      else {
           size_t data_size;
@@ -507,11 +616,13 @@ misc_region_copy (region_type_t *dst, region_type_t *src)
           return true;
      }
      if (!dst->data || (dst->data->size < src->data->numRects)) {
+          size_t size = src->data->numRects;
+
           freeData(dst);
-          dst->data = allocData(dst, src->data->numRects);
+          dst->data = allocData(dst, &size);
           if (!dst->data)
                return misc_break (dst);
-          dst->data->size = src->data->numRects;
+          dst->data->size = size;
      }
      dst->data->numRects = src->data->numRects;
      memmove((char *)PIXREGION_BOXPTR(dst),(char *)PIXREGION_BOXPTR(src),
@@ -579,6 +690,22 @@ misc_coalesce (
       */
      y2 = pCurBox->y2;
 
+#if defined(__SSE2__)
+     /*
+      * Compare x1 and x2 of a whole box at once (bytes 0-3 and 8-11 of the mask).
+      */
+     do {
+          __m128i prev = _mm_loadu_si128( (const __m128i *) pPrevBox );
+          __m128i cur  = _mm_loadu_si128( (const __m128i *) pCurBox );
+
+          if ((_mm_movemask_epi8( _mm_cmpeq_epi32( prev, cur ) ) & 0x0f0f) != 0x0f0f)
+               return(curStart);
+
+          pPrevBox++;
+          pCurBox++;
+          numRects--;
+     } while (numRects);
+#else
      do {
           if ((pPrevBox->x1 != pCurBox->x1) || (pPrevBox->x2 != pCurBox->x2)) {
                return(curStart);
@@ -587,6 +714,7 @@ misc_coalesce (
           pCurBox++;
           numRects--;
      } while (numRects);
+#endif
 
      /*
       * The bands may be merged, so set the bottom y of each box
@@ -602,6 +730,28 @@ misc_coalesce (
      return prevStart;
 }
 
+/*
+ * Index of the first box whose band reaches below 'y'. As bands don't overlap,
+ * y2 never decreases along the array, so this is always the start of a band.
+ */
+static inline int
+misc_find_band (const box_type_t *rects, int numRects, int y)
+{
+     int lo = 0;
+     int hi = numRects;
+
+     while (lo < hi) {
+          int mid = (lo + hi) >> 1;
+
+          if (rects[mid].y2 <= y)
+               lo = mid + 1;
+          else
+               hi = mid;
+     }
+
+     return lo;
+}
+
 /* Quicky macro to avoid trivial reject procedure calls to misc_coalesce */
 
 #define Coalesce(newReg, prevBand, curBand)                             \
@@ -794,12 +944,8 @@ misc_op(
           newReg->data->numRects = 0;
      if (newSize > newReg->data->size) {
           if (!misc_rect_alloc(newReg, newSize)) {
-               if (oldData) {
-                    if (newReg->shmpool)
-                         SHFREE(newReg->shmpool, oldData);
-                    else
-                         D_FREE(oldData);
-               }
+               if (oldData)
+                    releaseData(newReg, oldData);
                return false;
           }
      }
@@ -930,12 +1076,8 @@ misc_op(
           AppendRegions(newReg, r2BandEnd, r2End);
      }
 
-     if (oldData) {
-          if (newReg->shmpool)
-               SHFREE(newReg->shmpool, oldData);
-          else
-               D_FREE(oldData);
-     }
+     if (oldData)
+          releaseData(newReg, oldData);
 
      if (!(numRects = newReg->data->numRects)) {
           freeData(newReg);
@@ -1075,6 +1217,98 @@ misc_region_intersectO (region_type_t *region,
      return true;
 }
 
+/*-
+ *-----------------------------------------------------------------------
+ * misc_intersect_box --
+ *      Intersect a region having rectangle data with a single box. The
+ *      boxes are clipped directly, starting at the first band reaching
+ *      into the box, instead of walking both regions band by band.
+ *
+ *-----------------------------------------------------------------------
+ */
+static bool
+misc_intersect_box (region_type_t    *newReg,
+                    region_type_t    *reg,
+                    const box_type_t *clip)
+{
+     box_type_t         *r;
+     box_type_t         *rEnd;
+     box_type_t         *pNextRect;
+     region_data_type_t *oldData = NULL;
+     int                 prevBand = 0;
+     int                 curBand  = 0;
+     int                 bandY1   = INT_MIN;
+     int                 numRects;
+
+     assert(reg->data && reg->data->numRects > 1);
+
+     r    = PIXREGION_BOXPTR(reg);
+     rEnd = r + reg->data->numRects;
+     r   += misc_find_band (r, reg->data->numRects, clip->y1);
+
+     if (newReg == reg) {
+          oldData = newReg->data;
+          newReg->data = misc_region_emptyData;
+     }
+     else if (newReg->data && newReg->data->size)
+          newReg->data->numRects = 0;
+     else
+          newReg->data = misc_region_emptyData;
+
+     for (; r != rEnd && r->y1 < clip->y2; r++) {
+          int x1 = MAX(r->x1, clip->x1);
+          int x2 = MIN(r->x2, clip->x2);
+
+          if (x1 >= x2)
+               continue;
+
+          if (r->y1 != bandY1) {
+               /* Previous band is complete, try to merge it with the one before. */
+               if (newReg->data->numRects != curBand) {
+                    Coalesce(newReg, prevBand, curBand);
+               }
+
+               curBand = newReg->data->numRects;
+               bandY1  = r->y1;
+          }
+
+          RECTALLOC_BAIL(newReg, 1, bail);
+
+          pNextRect = PIXREGION_TOP(newReg);
+
+          ADDRECT(pNextRect, x1, MAX(r->y1, clip->y1), x2, MIN(r->y2, clip->y2));
+
+          newReg->data->numRects++;
+     }
+
+     if (newReg->data->numRects != curBand) {
+          Coalesce(newReg, prevBand, curBand);
+     }
+
+     if (oldData)
+          releaseData(newReg, oldData);
+
+     if (!(numRects = newReg->data->numRects)) {
+          freeData(newReg);
+          newReg->data = misc_region_emptyData;
+     }
+     else if (numRects == 1) {
+          newReg->extents = *PIXREGION_BOXPTR(newReg);
+          freeData(newReg);
+          newReg->data = (region_data_type_t *)NULL;
+     }
+
+     misc_set_extents(newReg);
+
+     return true;
+
+bail:
+     if (oldData)
+          releaseData(newReg, oldData);
+
+     return false;
+}
+
 bool
 misc_region_intersect (region_type_t *     newReg,
                        region_type_t *        reg1,
@@ -1119,6 +1353,16 @@ misc_region_intersect (region_type_t *     newReg,
      else if (reg1 == reg2) {
           return misc_region_copy (newReg, reg1);
      }
+     else if (!reg2->data) {
+          box_type_t clip = reg2->extents;
+
+          return misc_intersect_box (newReg, reg1, &clip);
+     }
+     else if (!reg1->data) {
+          box_type_t clip = reg1->extents;
+
+          return misc_intersect_box (newReg, reg2, &clip);
+     }
      else {
           /* General purpose intersection */
           int overlap; /* result ignored */
@@ -1246,6 +1490,54 @@ misc_region_union_rect (region_type_t *dest,
      return misc_region_union (dest, source, &region);
 }
 
+/*-
+ *-----------------------------------------------------------------------
+ * misc_union_below --
+ *      Union of a region having rectangle data with a box entirely below
+ *      it, which is just one more band, e.g. when collecting rectangles
+ *      from top to bottom.
+ *
+ *-----------------------------------------------------------------------
+ */
+static bool
+misc_union_below (region_type_t    *newReg,
+                  region_type_t    *reg,
+                  const box_type_t *box)
+{
+     box_type_t *pNextRect;
+     int         prevBand;
+     int         curBand;
+
+     assert(reg->data && reg->data->numRects > 1);
+     assert(box->y1 >= reg->extents.y2);
+
+     if (newReg != reg && !misc_region_copy (newReg, reg))
+          return false;
+
+     RECTALLOC(newReg, 1);
+
+     /* Find the start of the last band for coalescing. */
+     curBand  = newReg->data->numRects;
+     prevBand = curBand - 1;
+
+     while (prevBand > 0 && PIXREGION_BOX(newReg, prevBand - 1)->y1 == PIXREGION_BOX(newReg, curBand - 1)->y1)
+          prevBand--;
+
+     pNextRect = PIXREGION_TOP(newReg);
+
+     ADDRECT(pNextRect, box->x1, box->y1, box->x2, box->y2);
+
+     newReg->data->numRects++;
+
+     Coalesce(newReg, prevBand, curBand);
+
+     newReg->extents.x1 = MIN(newReg->extents.x1, box->x1);
+     newReg->extents.x2 = MAX(newReg->extents.x2, box->x2);
+     newReg->extents.y2 = box->y2;
+
+     return true;
+}
+
 bool
 misc_region_union (region_type_t *newReg,
                    region_type_t *reg1,
@@ -1312,6 +1604,21 @@ misc_region_union (region_type_t *newReg,
           return true;
      }
 
+     /*
+      * One box below a complex region only adds a band
+      */
+     if (!reg2->data && reg1->data && reg2->extents.y1 >= reg1->extents.y2) {
+          box_type_t box = reg2->extents;
+
+          return misc_union_below (newReg, reg1, &box);
+     }
+
+     if (!reg1->data && reg2->data && reg1->extents.y1 >= reg2->extents.y2) {
+          box_type_t box = reg1->extents;
+
+          return misc_union_below (newReg, reg2, &box);
+     }
+
      if (!misc_op(newReg, reg1, reg2, misc_region_unionO, true, true, &overlap))
           return false;
 
@@ -1768,7 +2075,7 @@ misc_region_subtract (region_type_t *      regD,
                return misc_break (regD);
           return misc_region_copy (regD, regM);
      }
-     else if (regM == regS) {
+     else if (regM == regS || (!regS->data && SUBSUMES(&regS->extents, &regM->extents))) {
           freeData(regD);
           regD->extents.x2 = regD->extents.x1;
           regD->extents.y2 = regD->extents.y1;
@@ -1908,8 +2215,10 @@ misc_region_contains_rectangle (region_type_t *  region,
      x = prect->x1;
      y = prect->y1;
 
-     /* can stop when both partOut and partIn are true, or we reach prect->y2 */
-     for (pbox = PIXREGION_BOXPTR(region), pboxEnd = pbox + numRects;
+     /* can stop when both partOut and partIn are true, or we reach prect->y2,
+        bands above the rectangle are skipped right away */
+     for (pbox = PIXREGION_BOXPTR(region), pboxEnd = pbox + numRects,
+          pbox += misc_find_band (pbox, numRects, y);
          pbox != pboxEnd;
          pbox++) {
 
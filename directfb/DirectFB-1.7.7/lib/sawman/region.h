@@ -283,6 +283,8 @@ void                  misc_region_reset             ( misc_region_t       *regio
 
 void                  misc_region_collapse          ( misc_region_t       *region );
 
+void                  misc_region_pool_flush        ( void );
+
 /**********************************************************************************************************************/
 
 static inline void
@@ -375,7 +377,7 @@ misc_region_init_updates( misc_region_t       *region,
 {
      misc_box_t boxes[updates->num_regions];
 
-     misc_region_regions_to_boxes( boxes, updates->regions, updates->num_regions );
+     misc_region_regions_to_boxes( boxes, (const DFBRegion*) updates->regions, updates->num_regions );
 
      return misc_region_init_boxes( region, shmpool, boxes, updates->num_regions );
 }
@@ -414,7 +416,7 @@ misc_region_add_updates( misc_region_t    *region,
      MISC_REGION_DEBUG_AT( Misc_Region, region, "updates" );
      MISC_REGION_ASSERT( region );
 
-     dfb_updates_get_rectangles( (void*) updates, rects, &num );
+     dfb_updates_get_rectangles( (DFBUpdates*) updates, rects, &num );
 
      return misc_region_union_rects( region, region, rects, num );
 }
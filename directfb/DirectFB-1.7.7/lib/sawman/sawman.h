@@ -654,6 +654,31 @@ DEFINE_INTERFACE(   ISaWManManager,
           ISaWManManager     *thiz,
           SaWManWindowHandle  handle 
      );
+
+     /*
+      * Enable downscaled snapshots of a window, taken on flip at most every 'interval' ms.
+      *
+      * A size of 0x0 disables them again.
+      */
+     DirectResult (*SetWindowSnapshot)(
+          ISaWManManager     *thiz,
+          SaWManWindowHandle  handle,
+          int                 width,
+          int                 height,
+          unsigned int        interval
+     );
+
+     /*
+      * Get the shared surface with the latest snapshot of a window, see IDirectFB::GetSurface().
+      *
+      * The generation is incremented with each snapshot, previews only need to be redrawn after it changed.
+      */
+     DirectResult (*GetWindowSnapshot)(
+          ISaWManManager     *thiz,
+          SaWManWindowHandle  handle,
+          DFBSurfaceID       *ret_surface_id,
+          unsigned int       *ret_generation
+     );
 )
 
 /**********************************************************************************************************************/
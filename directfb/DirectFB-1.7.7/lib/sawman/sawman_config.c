@@ -85,9 +85,15 @@ static const char *config_usage =
      "  [no-]show-empty                    Show layer even if no window is visible\n"
      "  flip-once-timeout=<num>            Flip once timeout\n"
      "  hw-cursor=<layer-id>               Set HW Cursor mode\n"
+     "  scanout-layer=<layer-id>           Show the topmost opaque window directly on this layer\n"
      "  resolution=<width>x<height>        Set virtual SaWMan resolution\n"
      "  [no-]static-layer                  Disable layer reconfiguration\n"
-     "  update-region-mode=<num>           Set internal update region mode (1-3, default 2)\n"
+     "  update-region-mode=<num>           Set internal update region mode (1-4, default 2)\n"
+     "  update-threads=<num>               Compose disjoint update regions in parallel (0-16, default 0)\n"
+     "  scale-cache=<kbytes>               Memory for pre-scaled copies of scaled windows (default 16384, 0 = off)\n"
+     "  [no-]coalesce-events               Notify listeners once per window and repaint instead of per blit\n"
+     "  frame-rate=<hz>                    Batch tier updates to this rate (default 0 = repaint immediately)\n"
+     "  frame-budget=<us>                  Time per tier repaint, merge update regions by predicted cost\n"
      "  keep-implicit-key-grabs            Causes implicit key grabs to stay even when window is withdrawn\n"
      "  hide-cursor-without-window         Hides the cursor when no window has control over it\n"
      "\n";
@@ -382,7 +388,8 @@ config_allocate( void )
      sawman_config->borders[1].theme.desktop_insets.b = 40;
 #endif
 
-     sawman_config->update_region_mode = 4;
+     sawman_config->update_region_mode = 2;
+     sawman_config->scale_cache        = 16384;
 
      sawman_config->static_layer = true;
 
@@ -591,6 +598,28 @@ sawman_config_set( const char *name, const char *value )
                return DFB_INVARG;
           }
      } else
+     if (strcmp (name, "scanout-layer" ) == 0) {
+          if (value) {
+               int id;
+
+               if (sscanf( value, "%d", &id ) < 1) {
+                    D_ERROR("SaWMan/Config '%s': Could not parse value!\n", name);
+                    return DFB_INVARG;
+               }
+
+               if (id < 0 || id >= MAX_LAYERS) {
+                    D_ERROR("SaWMan/Config '%s': Value %d out of bounds!\n", name, id);
+                    return DFB_INVARG;
+               }
+
+               sawman_config->scanout.enabled  = true;
+               sawman_config->scanout.layer_id = id;
+          }
+          else {
+               D_ERROR("SaWMan/Config '%s': No value specified!\n", name);
+               return DFB_INVARG;
+          }
+     } else
      if (strcmp (name, "resolution" ) == 0) {
           if (value) {
                int width, height;
@@ -650,6 +679,88 @@ sawman_config_set( const char *name, const char *value )
                return DFB_INVARG;
           }
      } else
+     if (strcmp (name, "update-threads" ) == 0) {
+          if (value) {
+               int threads;
+
+               if (sscanf( value, "%d", &threads ) < 1) {
+                    D_ERROR("SaWMan/Config '%s': Could not parse value!\n", name);
+                    return DFB_INVARG;
+               }
+               if (threads < 0 || threads > SAWMAN_MAX_UPDATE_THREADS) {
+                    D_ERROR("SaWMan/Config '%s': Value %d out of bounds!\n", name, threads);
+                    return DFB_INVARG;
+               }
+               sawman_config->update_threads = threads;
+          }
+          else {
+               D_ERROR("SaWMan/Config '%s': No value specified!\n", name);
+               return DFB_INVARG;
+          }
+     } else
+     if (strcmp (name, "scale-cache" ) == 0) {
+          if (value) {
+               int kbytes;
+
+               if (sscanf( value, "%d", &kbytes ) < 1) {
+                    D_ERROR("SaWMan/Config '%s': Could not parse value!\n", name);
+                    return DFB_INVARG;
+               }
+               if (kbytes < 0) {
+                    D_ERROR("SaWMan/Config '%s': Value %d out of bounds!\n", name, kbytes);
+                    return DFB_INVARG;
+               }
+               sawman_config->scale_cache = kbytes;
+          }
+          else {
+               D_ERROR("SaWMan/Config '%s': No value specified!\n", name);
+               return DFB_INVARG;
+          }
+     } else
+     if (strcmp (name, "frame-rate" ) == 0) {
+          if (value) {
+               int rate;
+
+               if (sscanf( value, "%d", &rate ) < 1) {
+                    D_ERROR("SaWMan/Config '%s': Could not parse value!\n", name);
+                    return DFB_INVARG;
+               }
+               if (rate < 0 || rate > 1000) {
+                    D_ERROR("SaWMan/Config '%s': Value %d out of bounds!\n", name, rate);
+                    return DFB_INVARG;
+               }
+               sawman_config->frame_rate = rate;
+          }
+          else {
+               D_ERROR("SaWMan/Config '%s': No value specified!\n", name);
+               return DFB_INVARG;
+          }
+     } else
+     if (strcmp (name, "frame-budget" ) == 0) {
+          if (value) {
+               int budget;
+
+               if (sscanf( value, "%d", &budget ) < 1) {
+                    D_ERROR("SaWMan/Config '%s': Could not parse value!\n", name);
+                    return DFB_INVARG;
+               }
+               if (budget < 0) {
+                    D_ERROR("SaWMan/Config '%s': Value %d out of bounds!\n", name, budget);
+                    return DFB_INVARG;
+               }
+               sawman_config->frame_budget = budget;
+          }
+          else {
+               D_ERROR("SaWMan/Config '%s': No value specified!\n", name);
+               return DFB_INVARG;
+          }
+     } else
+     if (strcmp (name, "coalesce-events") == 0) {
+          sawman_config->coalesce_events = true;
+     } else
+     if (strcmp (name, "no-coalesce-events") == 0) {
+          sawman_config->coalesce_events = false;
+     } else
      if (strcmp (name, "keep-implicit-key-grabs") == 0) {
           sawman_config->keep_implicit_key_grabs = true;
      } else
@@ -143,11 +143,23 @@ typedef struct {
           DFBDisplayLayerID        layer_id;
      }                     cursor;
 
+     struct {
+          bool                     enabled;
+          DFBDisplayLayerID        layer_id;
+     }                     scanout;     /* Extra layer for showing a window without composition. */
+
      DFBDimension          resolution;
 
      bool                  static_layer;
 
      int                   update_region_mode;
+     int                   update_threads;      /* Additional threads composing disjoint update regions. */
+     unsigned int          scale_cache;         /* KB for pre-scaled window copies, 0 disables. */
+
+     bool                  coalesce_events;     /* One blit notification per window and repaint. */
+
+     unsigned int          frame_rate;          /* Hz tier updates are batched to, 0 repaints immediately. */
+     unsigned int          frame_budget;        /* us per tier repaint, enables merging regions by predicted cost. */
 
      bool                  keep_implicit_key_grabs;
 
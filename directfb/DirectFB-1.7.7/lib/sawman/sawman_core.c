@@ -47,6 +47,7 @@
 #include <core/layer_context.h>
 #include <core/layer_control.h>
 #include <core/layer_region.h>
+#include <core/layers.h>
 #include <core/palette.h>
 #include <core/screen.h>
 #include <core/screens.h>
@@ -107,6 +108,7 @@ static FusionCallHandlerResult process_watcher     ( int                    call
                                                      int                   *ret_val );
 
 static DFBResult               init_hw_cursor      ( SaWMan                *sawman );
+static DFBResult               init_scanout        ( SaWMan                *sawman );
 
 static DirectResult            add_tier            ( SaWMan                *sawman,
                                                      FusionWorld           *world,
@@ -246,7 +248,7 @@ sawman_initialize( SaWMan         *sawman,
      for (i=0; i<SAWMAN_MAX_IMPLICIT_KEYGRABS; i++)
           sawman->keys[i].code = -1;
 
-     dfb_updates_init( &sawman->bg.visible, sawman->bg.visible_regions, D_ARRAY_SIZE(sawman->bg.visible_regions) );
+     misc_region_init( &sawman->visible_dirty, sawman->shmpool );
 
      D_MAGIC_SET( sawman, SaWMan );
 
@@ -355,6 +357,15 @@ sawman_post_init( SaWMan      *sawman,
           }
      }
 
+     /* Initialize scanout layer? */
+     if (sawman_config->scanout.enabled) {
+          ret = init_scanout( sawman );
+          if (ret) {
+               sawman_unlock( sawman );
+               return ret;
+          }
+     }
+
      sawman_unlock( sawman );
 
      return DFB_OK;
@@ -463,7 +474,13 @@ sawman_shutdown( SaWMan      *sawman,
           SHFREE( key->owner->shmpool, key );
      }
 
-     dfb_updates_deinit( &sawman->bg.visible );
+     misc_region_deinit( &sawman->visible_dirty );
+
+     /* Release pooled region data of local regions. */
+     misc_region_pool_flush();
+
+     /* Release unused snapshot surfaces. */
+     sawman_flush_snapshots( sawman );
 
      D_MAGIC_CLEAR( sawman );
 
@@ -1072,6 +1089,47 @@ init_hw_cursor( SaWMan *sawman )
      return DFB_OK;
 }
 
+static DFBResult
+init_scanout( SaWMan *sawman )
+{
+     DFBResult   ret;
+     SaWManTier *tier;
+
+     D_DEBUG_AT( SaWMan_Core, "%s()\n", __FUNCTION__ );
+
+     direct_list_foreach (tier, sawman->tiers) {
+          D_MAGIC_ASSERT( tier, SaWManTier );
+
+          if (tier->layer_id == sawman_config->scanout.layer_id) {
+               D_ERROR( "SaWMan/Scanout: Layer %d is already used by a tier!\n", sawman_config->scanout.layer_id );
+               return DFB_BUSY;
+          }
+     }
+
+     if (sawman_config->cursor.hw && sawman_config->cursor.layer_id == sawman_config->scanout.layer_id) {
+          D_ERROR( "SaWMan/Scanout: Layer %d is already used by the HW Cursor!\n", sawman_config->scanout.layer_id );
+          return DFB_BUSY;
+     }
+
+     if (sawman_config->scanout.layer_id >= dfb_layer_num()) {
+          D_ERROR( "SaWMan/Scanout: No layer with id %u!\n", sawman_config->scanout.layer_id );
+          return DFB_IDNOTFOUND;
+     }
+
+     sawman->scanout.layer = dfb_layer_at( sawman_config->scanout.layer_id );
+
+     /* Regions are created on demand, one per promoted window. */
+     ret = dfb_layer_create_context( sawman->scanout.layer, false, &sawman->scanout.context );
+     if (ret) {
+          D_DERROR( ret, "SaWMan/Scanout: Could not create context at layer (id %u)!\n", sawman_config->scanout.layer_id );
+          return ret;
+     }
+
+     dfb_layer_activate_context( sawman->scanout.layer, sawman->scanout.context );
+
+     return DFB_OK;
+}
+
 /**********************************************************************************************************************/
 
 static DirectResult
@@ -1122,6 +1180,10 @@ add_tier( SaWMan                *sawman,
      dfb_updates_init( &tier->right.updating, tier->right.updating_regions, SAWMAN_MAX_UPDATING_REGIONS );
      dfb_updates_init( &tier->right.updated,  tier->right.updated_regions, SAWMAN_MAX_UPDATED_REGIONS );
 
+     /* Initial repaint cost guess, refined with each repaint. */
+     tier->schedule.pixel_cost  = 1024;
+     tier->schedule.region_cost = 20000;
+
      D_MAGIC_SET( tier, SaWManTier );
 
      direct_list_append( &sawman->tiers, &tier->link );
@@ -40,6 +40,7 @@
 #include <direct/messages.h>
 #include <direct/util.h>
 
+#include <core/core.h>
 #include <core/gfxcard.h>
 #include <core/palette.h>
 #include <core/state.h>
@@ -103,6 +104,105 @@ sawman_get_performance( SaWMan                 *sawman,
      return DFB_OK;
 }
 
+DFBResult
+sawman_get_scale_stats( SaWMan                 *sawman,
+                        DFBWindowStackingClass  stacking,
+                        bool                    reset,
+                        unsigned int           *ret_hits,
+                        unsigned int           *ret_misses )
+{
+     SaWManTier *tier;
+
+     sawman_lock( sawman );
+
+     tier = sawman_tier_by_class( sawman, stacking );
+     if (!tier) {
+          sawman_unlock( sawman );
+          return DFB_BUG;
+     }
+
+     if (ret_hits)
+          *ret_hits = tier->performance.scale_hits;
+
+     if (ret_misses)
+          *ret_misses = tier->performance.scale_misses;
+
+     if (reset) {
+          tier->performance.scale_hits   = 0;
+          tier->performance.scale_misses = 0;
+     }
+
+     sawman_unlock( sawman );
+
+     return DFB_OK;
+}
+
+DFBResult
+sawman_get_schedule_stats( SaWMan                 *sawman,
+                           DFBWindowStackingClass  stacking,
+                           bool                    reset,
+                           unsigned int           *ret_frames,
+                           unsigned int           *ret_missed )
+{
+     SaWManTier *tier;
+
+     sawman_lock( sawman );
+
+     tier = sawman_tier_by_class( sawman, stacking );
+     if (!tier) {
+          sawman_unlock( sawman );
+          return DFB_BUG;
+     }
+
+     if (ret_frames)
+          *ret_frames = tier->schedule.frames;
+
+     if (ret_missed)
+          *ret_missed = tier->schedule.missed;
+
+     if (reset) {
+          tier->schedule.frames = 0;
+          tier->schedule.missed = 0;
+     }
+
+     sawman_unlock( sawman );
+
+     return DFB_OK;
+}
+
+DFBResult
+sawman_get_event_stats( SaWMan                 *sawman,
+                        DFBWindowStackingClass  stacking,
+                        bool                    reset,
+                        unsigned int           *ret_blits,
+                        unsigned int           *ret_merged )
+{
+     SaWManTier *tier;
+
+     sawman_lock( sawman );
+
+     tier = sawman_tier_by_class( sawman, stacking );
+     if (!tier) {
+          sawman_unlock( sawman );
+          return DFB_BUG;
+     }
+
+     if (ret_blits)
+          *ret_blits = tier->performance.blits;
+
+     if (ret_merged)
+          *ret_merged = tier->performance.blits_merged;
+
+     if (reset) {
+          tier->performance.blits        = 0;
+          tier->performance.blits_merged = 0;
+     }
+
+     sawman_unlock( sawman );
+
+     return DFB_OK;
+}
+
 void
 sawman_dispatch_tier_update( SaWMan             *sawman,
                              SaWManTier         *tier,
@@ -173,6 +273,82 @@ sawman_dispatch_blit( SaWMan             *sawman,
           fusion_reactor_dispatch( sawman->reactor, &data, true, NULL );
 }
 
+/*
+ * Sends one blit notification per window covering all of its visible parts within the updates.
+ */
+void
+sawman_dispatch_blits( SaWMan             *sawman,
+                       SaWManTier         *tier,
+                       bool                right_eye,
+                       const DFBRegion    *updates,
+                       unsigned int        num_updates )
+{
+     int           i;
+     SaWManWindow *sawwin;
+
+     D_MAGIC_ASSERT( sawman, SaWMan );
+     D_MAGIC_ASSERT( tier, SaWManTier );
+     FUSION_SKIRMISH_ASSERT( sawman->lock );
+
+     fusion_vector_foreach (sawwin, i, sawman->layout) {
+          CoreWindow    *window = sawwin->window;
+          misc_region_t *visible;
+          misc_box_t    *bounds;
+          DFBRegion      clip;
+          DFBRectangle   dst;
+          unsigned int   n;
+          unsigned int   num = 0;
+
+          D_MAGIC_ASSERT( sawwin, SaWManWindow );
+
+          if (!SAWMAN_VISIBLE_WINDOW( window ) || !(tier->classes & (1 << window->config.stacking)))
+               continue;
+
+          /* Color windows are not blitted. */
+          if (!window->surface)
+               continue;
+
+          visible = right_eye ? &sawwin->right.visible_region : &sawwin->left.visible_region;
+          bounds  = misc_region_extents( visible );
+
+          for (n=0; n<num_updates; n++) {
+               DFBRegion  area = updates[n];
+               misc_box_t box;
+
+               if (!dfb_region_intersect( &area, bounds->x1, bounds->y1, bounds->x2 - 1, bounds->y2 - 1 ))
+                    continue;
+
+               box.x1 = area.x1;
+               box.y1 = area.y1;
+               box.x2 = area.x2 + 1;
+               box.y2 = area.y2 + 1;
+
+               if (misc_region_contains_rectangle( visible, &box ) == MISC_REGION_OUT)
+                    continue;
+
+               if (num++)
+                    dfb_region_region_union( &clip, &area );
+               else
+                    clip = area;
+          }
+
+          if (!num)
+               continue;
+
+          D_DEBUG_AT( SaWMan_Draw, "  -> window %p drawn in %u updates\n", sawwin, num );
+
+          tier->performance.blits++;
+          tier->performance.blits_merged += num - 1;
+
+          /* Same stereo offset as draw_window(). */
+          dst = sawwin->dst;
+
+          dfb_rectangle_translate( &dst, right_eye ? -window->config.z : window->config.z, 0 );
+
+          sawman_dispatch_blit( sawman, sawwin, right_eye, &sawwin->src, &dst, &clip );
+     }
+}
+
 void sawman_draw_cursor    ( CoreWindowStack *stack,
                              CardState       *state,
                              CoreSurface     *surface,
@@ -782,6 +958,269 @@ draw_border( SaWManWindow    *sawwin,
      }
 }
 
+/**********************************************************************************************************************/
+
+static void
+scaled_key( SaWMan                *sawman,
+            SaWManWindow          *sawwin,
+            SaWManWindowScaledKey *ret_key )
+{
+     CoreSurface *surface = sawwin->window->surface;
+
+     ret_key->src          = sawwin->src;
+     ret_key->size.w       = sawwin->dst.w;
+     ret_key->size.h       = sawwin->dst.h;
+     ret_key->surface_id   = surface->object.id;
+     ret_key->surface_size = surface->config.size;
+     ret_key->format       = surface->config.format;
+     ret_key->mode         = sawman->scaling_mode;
+}
+
+static bool
+scaled_key_equal( const SaWManWindowScaledKey *a,
+                  const SaWManWindowScaledKey *b )
+{
+     return DFB_RECTANGLE_EQUAL( a->src, b->src ) &&
+            a->size.w         == b->size.w &&
+            a->size.h         == b->size.h &&
+            a->surface_id     == b->surface_id &&
+            a->surface_size.w == b->surface_size.w &&
+            a->surface_size.h == b->surface_size.h &&
+            a->format         == b->format &&
+            a->mode           == b->mode;
+}
+
+/*
+ * Only plain stretching is cached, anything depending on the eye or on exact source pixels is drawn directly.
+ */
+static bool
+scaled_eligible( SaWManWindow *sawwin )
+{
+     CoreWindow  *window  = sawwin->window;
+     CoreSurface *surface = window->surface;
+
+     if (!surface || sawwin->dst.w < 1 || sawwin->dst.h < 1)
+          return false;
+
+     if (sawwin->src.w == sawwin->dst.w && sawwin->src.h == sawwin->dst.h)
+          return false;
+
+     if (sawwin->caps & DWCAPS_STEREO)
+          return false;
+
+     if (window->config.options & (DWOP_STEREO_SIDE_BY_SIDE_HALF | DWOP_COLORKEYING))
+          return false;
+
+     if (surface->config.caps & DSCAPS_INTERLACED)
+          return false;
+
+     if (DFB_PIXELFORMAT_IS_INDEXED( surface->config.format ) || DFB_COLOR_IS_YUV( surface->config.format ))
+          return false;
+
+     return true;
+}
+
+static bool
+scaled_damaged( SaWManWindow    *sawwin,
+                const DFBRegion *updates,
+                unsigned int     num_updates )
+{
+     unsigned int i;
+
+     for (i=0; i<num_updates; i++) {
+          if (dfb_rectangle_region_intersects( &sawwin->dst, &updates[i] ))
+               return true;
+     }
+
+     return false;
+}
+
+void
+sawman_release_scaled( SaWMan       *sawman,
+                       SaWManWindow *sawwin )
+{
+     D_MAGIC_ASSERT( sawman, SaWMan );
+     D_MAGIC_ASSERT( sawwin, SaWManWindow );
+
+     if (sawwin->scaled.surface) {
+          D_DEBUG_AT( SaWMan_Draw, "%s( %p ) <- %lu bytes\n", __FUNCTION__, sawwin, sawwin->scaled.bytes );
+
+          D_ASSERT( sawman->scaled.bytes >= sawwin->scaled.bytes );
+
+          sawman->scaled.bytes -= sawwin->scaled.bytes;
+
+          dfb_surface_unlink( &sawwin->scaled.surface );
+     }
+
+     sawwin->scaled.bytes = 0;
+     sawwin->scaled.valid = false;
+}
+
+/*
+ * Make room for another copy by releasing the least recently used ones not needed by the current repaint.
+ */
+static bool
+scaled_evict( SaWMan        *sawman,
+              unsigned long  bytes )
+{
+     unsigned long budget = sawman_config->scale_cache * 1024UL;
+
+     if (bytes > budget)
+          return false;
+
+     while (sawman->scaled.bytes + bytes > budget) {
+          int           i;
+          SaWManWindow *sawwin;
+          SaWManWindow *oldest = NULL;
+
+          fusion_vector_foreach (sawwin, i, sawman->layout) {
+               if (!sawwin->scaled.surface || sawwin->scaled.used == sawman->scaled.stamp)
+                    continue;
+
+               if (!oldest || (int)(sawwin->scaled.used - oldest->scaled.used) < 0)
+                    oldest = sawwin;
+          }
+
+          if (!oldest)
+               return false;
+
+          sawman_release_scaled( sawman, oldest );
+     }
+
+     return true;
+}
+
+static bool
+scaled_render( SaWMan                      *sawman,
+               SaWManWindow                *sawwin,
+               CardState                   *state,
+               const SaWManWindowScaledKey *key )
+{
+     DFBResult      ret;
+     CoreSurface   *source = sawwin->window->surface;
+     CoreSurface   *surface;
+     DFBRectangle   rect   = { 0, 0, key->size.w, key->size.h };
+     DFBRegion      clip   = { 0, 0, key->size.w - 1, key->size.h - 1 };
+     unsigned long  bytes;
+
+     bytes = DFB_BYTES_PER_LINE( key->format, key->size.w ) * DFB_PLANE_MULTIPLY( key->format, key->size.h );
+
+     surface = sawwin->scaled.surface;
+     if (surface && (surface->config.size.w != key->size.w ||
+                     surface->config.size.h != key->size.h ||
+                     surface->config.format != key->format ||
+                     (surface->config.caps ^ source->config.caps) & DSCAPS_PREMULTIPLIED))
+          sawman_release_scaled( sawman, sawwin );
+
+     if (!sawwin->scaled.surface) {
+          if (!scaled_evict( sawman, bytes )) {
+               D_DEBUG_AT( SaWMan_Draw, "  -> %lu bytes exceed the scale cache\n", bytes );
+               return false;
+          }
+
+          ret = dfb_surface_create_simple( core_dfb, key->size.w, key->size.h, key->format,
+                                           source->config.colorspace, source->config.caps & DSCAPS_PREMULTIPLIED,
+                                           CSTF_SHARED, sawwin->id, NULL, &surface );
+          if (ret) {
+               D_DERROR( ret, "SaWMan/Draw: Could not create %dx%d scaled window copy!\n", key->size.w, key->size.h );
+               return false;
+          }
+
+          ret = dfb_surface_globalize( surface );
+          D_ASSERT( ret == DFB_OK );
+
+          sawwin->scaled.surface = surface;
+          sawwin->scaled.bytes   = bytes;
+
+          sawman->scaled.bytes += bytes;
+     }
+
+     D_DEBUG_AT( SaWMan_Draw, "%s( %p ) %4d,%4d-%4dx%4d -> %dx%d\n", __FUNCTION__,
+                 sawwin, DFB_RECTANGLE_VALS( &key->src ), key->size.w, key->size.h );
+
+     state->destination  = sawwin->scaled.surface;
+     state->to_eye       = DSSE_LEFT;
+     state->source       = source;
+     state->from_eye     = DSSE_LEFT;
+     state->modified    |= SMF_DESTINATION | SMF_TO | SMF_SOURCE | SMF_FROM;
+
+     dfb_state_set_clip( state, &clip );
+     dfb_state_set_blitting_flags( state, DSBLIT_NOFX );
+
+     if (key->mode == SWMSM_SMOOTH)
+          dfb_state_set_render_options( state, DSRO_SMOOTH_DOWNSCALE | DSRO_SMOOTH_UPSCALE );
+     else
+          dfb_state_set_render_options( state, DSRO_NONE );
+
+     CoreGraphicsStateClient_StretchBlit( state->client, &key->src, &rect, 1 );
+
+     return true;
+}
+
+void
+sawman_prepare_scaled( SaWMan          *sawman,
+                       SaWManTier      *tier,
+                       CardState       *state,
+                       const DFBRegion *updates,
+                       unsigned int     num_updates )
+{
+     int           i;
+     SaWManWindow *sawwin;
+
+     D_MAGIC_ASSERT( sawman, SaWMan );
+     D_MAGIC_ASSERT( tier, SaWManTier );
+     D_MAGIC_ASSERT( state, CardState );
+     FUSION_SKIRMISH_ASSERT( sawman->lock );
+
+     if (!sawman_config->scale_cache)
+          return;
+
+     sawman->scaled.stamp++;
+
+     fusion_vector_foreach (sawwin, i, sawman->layout) {
+          CoreWindow            *window = sawwin->window;
+          SaWManWindowScaledKey  key;
+
+          D_MAGIC_ASSERT( sawwin, SaWManWindow );
+
+          if (!(tier->classes & (1 << window->config.stacking)))
+               continue;
+
+          if (!SAWMAN_VISIBLE_WINDOW( window ) || !scaled_eligible( sawwin )) {
+               if (sawwin->scaled.surface)
+                    sawman_release_scaled( sawman, sawwin );
+
+               continue;
+          }
+
+          if (!scaled_damaged( sawwin, updates, num_updates ))
+               continue;
+
+          scaled_key( sawman, sawwin, &key );
+
+          /* Content or geometry is changing, keep stretching directly until it settles. */
+          if (sawwin->scaled.flipped || !scaled_key_equal( &key, &sawwin->scaled.key )) {
+               sawwin->scaled.key     = key;
+               sawwin->scaled.flipped = false;
+               sawwin->scaled.valid   = false;
+
+               tier->performance.scale_misses++;
+               continue;
+          }
+
+          sawwin->scaled.used = sawman->scaled.stamp;
+
+          if (sawwin->scaled.valid) {
+               tier->performance.scale_hits++;
+               continue;
+          }
+
+          tier->performance.scale_misses++;
+
+          sawwin->scaled.valid = scaled_render( sawman, sawwin, state, &key );
+     }
+}
+
 static void
 draw_window( SaWManTier   *tier,
              SaWManWindow *sawwin,
@@ -836,10 +1275,13 @@ draw_window( SaWManTier   *tier,
           return;
 
 
-     sawman_dispatch_blit( sawman, sawwin, right_eye, &sawwin->src, &dst, &clip );
+     /* Listeners are notified per repaint by sawman_dispatch_blits() when coalescing. */
+     if (!sawman_config->coalesce_events) {
+          sawman_dispatch_blit( sawman, sawwin, right_eye, &sawwin->src, &dst, &clip );
 
-     if (sawwin2)
-          sawman_dispatch_blit( sawman, sawwin2, right_eye, &sawwin2->src, &dst, &clip );
+          if (sawwin2)
+               sawman_dispatch_blit( sawman, sawwin2, right_eye, &sawwin2->src, &dst, &clip );
+     }
 
 
      /* Backup clipping region. */
@@ -1024,8 +1466,25 @@ draw_window( SaWManTier   *tier,
      else
 #endif
      {
-          /* Scale window to the screen clipped by the region being updated. */
-          CoreGraphicsStateClient_StretchBlit( state->client, &src, &dst, 1 );
+          SaWManWindowScaledKey key;
+
+          if (sawwin->scaled.valid)
+               scaled_key( sawman, sawwin, &key );
+
+          if (sawwin->scaled.valid && scaled_key_equal( &key, &sawwin->scaled.key )) {
+               DFBRectangle rect  = { 0, 0, dst.w, dst.h };
+               DFBPoint     point = { dst.x, dst.y };
+
+               /* Copy the window pre-scaled by sawman_prepare_scaled(). */
+               state->source    = sawwin->scaled.surface;
+               state->from_eye  = DSSE_LEFT;
+               state->modified |= SMF_SOURCE | SMF_FROM;
+
+               CoreGraphicsStateClient_Blit( state->client, &rect, &point, 1 );
+          }
+          else
+               /* Scale window to the screen clipped by the region being updated. */
+               CoreGraphicsStateClient_StretchBlit( state->client, &src, &dst, 1 );
      }
 
      /* Restore clipping region. */
@@ -1428,3 +1887,220 @@ sawman_draw_background( SaWManTier *tier, CardState *state, DFBRegion *region )
      }
 }
 
+
+/**********************************************************************************************************************/
+
+/*
+ * Snapshot surfaces are taken from and returned to a small pool, as previews are enabled and disabled
+ * often with the same size, e.g. whenever a taskbar is shown.
+ */
+static CoreSurface *
+snapshot_surface_get( SaWMan *sawman,
+                      int     width,
+                      int     height )
+{
+     int          i;
+     DFBResult    ret;
+     CoreSurface *surface;
+
+     for (i=0; i<sawman->snapshots.num_pool; i++) {
+          surface = sawman->snapshots.pool[i];
+
+          if (surface->config.size.w == width && surface->config.size.h == height) {
+               sawman->snapshots.pool[i] = sawman->snapshots.pool[--sawman->snapshots.num_pool];
+
+               return surface;
+          }
+     }
+
+     ret = dfb_surface_create_simple( core_dfb, width, height, DSPF_ARGB, DSCS_RGB, DSCAPS_NONE,
+                                      CSTF_SHARED, 0, NULL, &surface );
+     if (ret) {
+          D_DERROR( ret, "SaWMan/Draw: Could not create %dx%d window snapshot!\n", width, height );
+          return NULL;
+     }
+
+     ret = dfb_surface_globalize( surface );
+     D_ASSERT( ret == DFB_OK );
+
+     return surface;
+}
+
+static void
+snapshot_surface_put( SaWMan       *sawman,
+                      CoreSurface **surface )
+{
+     if (sawman->snapshots.num_pool < SAWMAN_MAX_SNAPSHOT_POOL) {
+          sawman->snapshots.pool[sawman->snapshots.num_pool++] = *surface;
+
+          *surface = NULL;
+     }
+     else
+          dfb_surface_unlink( surface );
+}
+
+DFBResult
+sawman_set_snapshot( SaWMan       *sawman,
+                     SaWManWindow *sawwin,
+                     int           width,
+                     int           height,
+                     unsigned int  interval )
+{
+     D_MAGIC_ASSERT( sawman, SaWMan );
+     D_MAGIC_ASSERT( sawwin, SaWManWindow );
+     FUSION_SKIRMISH_ASSERT( sawman->lock );
+
+     D_DEBUG_AT( SaWMan_Draw, "%s( %p, %dx%d, %u ms )\n", __FUNCTION__, sawwin, width, height, interval );
+
+     if (width < 0 || height < 0 || width > 1024 || height > 1024)
+          return DFB_INVARG;
+
+     if (!width || !height) {
+          sawman_release_snapshot( sawman, sawwin );
+          return DFB_OK;
+     }
+
+     if (sawwin->snapshot.surface && (sawwin->snapshot.size.w != width || sawwin->snapshot.size.h != height))
+          snapshot_surface_put( sawman, &sawwin->snapshot.surface );
+
+     if (!sawwin->snapshot.size.w)
+          sawman->snapshots.windows++;
+
+     sawwin->snapshot.size.w   = width;
+     sawwin->snapshot.size.h   = height;
+     sawwin->snapshot.interval = interval;
+     sawwin->snapshot.stamp    = 0;
+     sawwin->snapshot.dirty    = true;
+
+     return DFB_OK;
+}
+
+void
+sawman_release_snapshot( SaWMan       *sawman,
+                         SaWManWindow *sawwin )
+{
+     D_MAGIC_ASSERT( sawman, SaWMan );
+     D_MAGIC_ASSERT( sawwin, SaWManWindow );
+
+     if (!sawwin->snapshot.size.w)
+          return;
+
+     D_DEBUG_AT( SaWMan_Draw, "%s( %p )\n", __FUNCTION__, sawwin );
+
+     D_ASSERT( sawman->snapshots.windows > 0 );
+
+     sawman->snapshots.windows--;
+
+     if (sawwin->snapshot.surface)
+          snapshot_surface_put( sawman, &sawwin->snapshot.surface );
+
+     sawwin->snapshot.size.w = 0;
+     sawwin->snapshot.size.h = 0;
+     sawwin->snapshot.dirty  = false;
+}
+
+long long
+sawman_process_snapshots( SaWMan    *sawman,
+                          CardState *state )
+{
+     SaWManWindow *sawwin;
+     long long     now;
+     long long     next = 0;
+     bool          taken = false;
+
+     D_MAGIC_ASSERT( sawman, SaWMan );
+     D_MAGIC_ASSERT( state, CardState );
+     FUSION_SKIRMISH_ASSERT( sawman->lock );
+
+     if (!sawman->snapshots.windows)
+          return 0;
+
+     now = direct_clock_get_millis();
+
+     direct_list_foreach (sawwin, sawman->windows) {
+          CoreWindow   *window = sawwin->window;
+          CoreSurface  *source;
+          DFBRectangle  src;
+          DFBRectangle  dst;
+          DFBRegion     clip;
+
+          D_MAGIC_ASSERT( sawwin, SaWManWindow );
+
+          if (!sawwin->snapshot.dirty || !window || !window->surface)
+               continue;
+
+          /* Rate limit, remember when the next one is due. */
+          if (sawwin->snapshot.stamp && now - sawwin->snapshot.stamp < sawwin->snapshot.interval) {
+               long long due = sawwin->snapshot.stamp + sawwin->snapshot.interval;
+
+               if (!next || due < next)
+                    next = due;
+
+               continue;
+          }
+
+          if (!sawwin->snapshot.surface) {
+               sawwin->snapshot.surface = snapshot_surface_get( sawman, sawwin->snapshot.size.w, sawwin->snapshot.size.h );
+               if (!sawwin->snapshot.surface)
+                    continue;
+          }
+
+          source = window->surface;
+
+          src.x = 0;
+          src.y = 0;
+          src.w = source->config.size.w;
+          src.h = source->config.size.h;
+
+          dst.x = 0;
+          dst.y = 0;
+          dst.w = sawwin->snapshot.size.w;
+          dst.h = sawwin->snapshot.size.h;
+
+          clip.x1 = 0;
+          clip.y1 = 0;
+          clip.x2 = dst.w - 1;
+          clip.y2 = dst.h - 1;
+
+          D_DEBUG_AT( SaWMan_Draw, "  -> snapshot of %p (%dx%d -> %dx%d)\n", sawwin, src.w, src.h, dst.w, dst.h );
+
+          state->destination  = sawwin->snapshot.surface;
+          state->to_eye       = DSSE_LEFT;
+          state->source       = source;
+          state->from_eye     = DSSE_LEFT;
+          state->modified    |= SMF_DESTINATION | SMF_TO | SMF_SOURCE | SMF_FROM;
+
+          dfb_state_set_clip( state, &clip );
+          dfb_state_set_blitting_flags( state, DSBLIT_NOFX );
+          dfb_state_set_render_options( state, DSRO_SMOOTH_DOWNSCALE | DSRO_SMOOTH_UPSCALE );
+
+          CoreGraphicsStateClient_StretchBlit( state->client, &src, &dst, 1 );
+
+          sawwin->snapshot.generation++;
+          sawwin->snapshot.stamp = now;
+          sawwin->snapshot.dirty = false;
+
+          taken = true;
+     }
+
+     if (taken) {
+          state->destination  = NULL;
+          state->source       = NULL;
+          state->modified    |= SMF_DESTINATION | SMF_SOURCE;
+
+          dfb_state_set_render_options( state, DSRO_NONE );
+
+          CoreGraphicsStateClient_Flush( state->client, 0, CGSCFF_NONE );
+     }
+
+     return next;
+}
+
+void
+sawman_flush_snapshots( SaWMan *sawman )
+{
+     D_MAGIC_ASSERT( sawman, SaWMan );
+
+     while (sawman->snapshots.num_pool)
+          dfb_surface_unlink( &sawman->snapshots.pool[--sawman->snapshots.num_pool] );
+}
@@ -64,5 +64,35 @@ void sawman_draw_background( SaWManTier      *tier,
                              CardState       *state,
                              DFBRegion       *region );
 
+/*
+ * Renders pre-scaled copies of settled scaled windows touching the updates, called before composing them.
+ */
+void sawman_prepare_scaled  ( SaWMan          *sawman,
+                              SaWManTier      *tier,
+                              CardState       *state,
+                              const DFBRegion *updates,
+                              unsigned int     num_updates );
+
+void sawman_release_scaled  ( SaWMan          *sawman,
+                              SaWManWindow    *sawwin );
+
+/*
+ * Window snapshots for previews, taken by sawman_process_snapshots() when the window flipped and the interval passed.
+ * Returns the time in ms when the next snapshot is due, 0 if none is pending.
+ */
+DFBResult sawman_set_snapshot     ( SaWMan          *sawman,
+                                    SaWManWindow    *sawwin,
+                                    int              width,
+                                    int              height,
+                                    unsigned int     interval );
+
+void      sawman_release_snapshot ( SaWMan          *sawman,
+                                    SaWManWindow    *sawwin );
+
+long long sawman_process_snapshots( SaWMan          *sawman,
+                                    CardState       *state );
+
+void      sawman_flush_snapshots  ( SaWMan          *sawman );
+
 #endif
 
@@ -304,8 +304,8 @@ render_glyph( CoreFont      *thiz,
           info->width = surface->config.size.w - info->start;
 
      info->height = face->glyph->bitmap.rows;
-     if (info->height > surface->config.size.h)
-          info->height = surface->config.size.h;
+     if (info->start_y + info->height > surface->config.size.h)
+          info->height = surface->config.size.h - info->start_y;
 
      /* bitmap_left and bitmap_top are relative to the glyph's origin on the
         baseline.  info->left and info->top are relative to the top-left of the
@@ -363,7 +363,7 @@ render_glyph( CoreFont      *thiz,
           info->top    -= (radius - 1) / 2;
 
           if (blurred) {
-               addr = lock.addr + DFB_BYTES_PER_LINE(surface->config.format, info->start);
+               addr = lock.addr + DFB_BYTES_PER_LINE(surface->config.format, info->start) + info->start_y * lock.pitch;
                src  = blurred;
 
                for (y=0; y < info->height; y++) {
@@ -424,7 +424,7 @@ render_glyph( CoreFont      *thiz,
           }
 
           src = face->glyph->bitmap.buffer;
-          lock.addr += DFB_BYTES_PER_LINE(surface->config.format, info->start);
+          lock.addr += DFB_BYTES_PER_LINE(surface->config.format, info->start) + info->start_y * lock.pitch;
 
           for (y=0; y < info->height; y++) {
                int  i, j, n;
@@ -1246,7 +1246,7 @@ sawman_load_font( CoreDFB                     *core,
      }
 
      glyphs = (void*)(face + 1);
-     row    = (void*)(glyphs + face->num_glyphs);
+     row    = dgiff_align_row( header, glyphs + face->num_glyphs );
 
      /* Create the core object. */
      ret = dfb_font_create( core, desc, filename, &font );
@@ -1329,7 +1329,7 @@ sawman_load_font( CoreDFB                     *core,
           D_MAGIC_SET( data->rows[i], CoreFontCacheRow );
 
           /* Jump to next row. */
-          row = (void*)(row + 1) + row->pitch * row->height;
+          row = dgiff_align_row( header, (void*)(row + 1) + row->pitch * row->height );
      }
 
      /* Build glyph infos. */
@@ -1355,10 +1355,12 @@ sawman_load_font( CoreDFB                     *core,
 
           D_MAGIC_SET( glyph_data, CoreGlyphData );
 
-          direct_hash_insert( font->layers[0].glyph_hash, glyph->unicode, glyph_data );
-
-          if (glyph->unicode < 128)
-               font->layers[0].glyph_data[glyph->unicode] = glyph_data;
+          ret = dfb_font_insert_glyph( font, glyph->unicode, 0, glyph_data );
+          if (ret) {
+               D_MAGIC_CLEAR( glyph_data );
+               D_FREE( glyph_data );
+               goto error;
+          }
      }
 
 
@@ -55,6 +55,8 @@ extern "C"
 
 #include "sawman_types.h"
 
+#include "region.h"
+
 /**********************************************************************************************************************/
 
 #define VERSION_CODE( M, m, r )  (((M) * 1000) + ((m) * 100) + (r))
@@ -143,8 +145,14 @@ extern "C"
 #define SAWMAN_MAX_UPDATING_REGIONS      8   // updated region on tier to be scheduled for display
 #define SAWMAN_MAX_UPDATED_REGIONS       8   // updated region on tier scheduled for display
 #define SAWMAN_MAX_VISIBLE_REGIONS      10   // for the visible window region detection
+#define SAWMAN_MAX_UPDATE_THREADS       16   // for composing update regions in parallel
+#define SAWMAN_MAX_UPDATE_JOBS          64   // disjoint parts of a tier update handed to threads
 #define SAWMAN_MAX_UPDATES_REGIONS      10   // for the DSFLIP_QUEUE / DSFLIP_FLUSH implementation
+#define SAWMAN_MAX_SNAPSHOT_POOL         8   // unused snapshot surfaces kept for reuse
 #define SAWMAN_MAX_IMPLICIT_KEYGRABS    16
+#define SAWMAN_HIT_GRID_COLS            16   // spatial index for pointer hit tests
+#define SAWMAN_HIT_GRID_ROWS            16
+#define SAWMAN_HIT_CELL_WINDOWS          8   // more windows in one cell fall back to scanning the layout
 
 /**********************************************************************************************************************/
 
@@ -246,6 +254,11 @@ typedef struct {
      SaWManChangeFocusReason  reason;
 } SaWManChangeFocusArgs;
 
+typedef struct {
+     int                      num;                 /* > SAWMAN_HIT_CELL_WINDOWS if overflown */
+     u16                      windows[SAWMAN_HIT_CELL_WINDOWS];    /* layout indices, bottom to top */
+} SaWManHitCell;
+
 struct __SaWMan_SaWMan {
      int                   magic;
 
@@ -312,10 +325,7 @@ struct __SaWMan_SaWMan {
           SaWManLayerReconfig  layer_reconfig;
      } callback;
 
-     struct {
-          DFBUpdates             visible;
-          DFBRegion              visible_regions[SAWMAN_MAX_VISIBLE_REGIONS];
-     } bg;
+     misc_region_t             visible_dirty;      /* area where window visibility needs to be recalculated */
 
      struct {
           CoreLayer           *layer;
@@ -330,6 +340,41 @@ struct __SaWMan_SaWMan {
           SaWManWindow        *confined;
      } cursor;
 
+     struct {
+          CoreLayer           *layer;
+          CoreLayerContext    *context;
+          CoreLayerRegion     *region;             /* exists only while a window is promoted */
+
+          SaWManWindow        *window;             /* window shown directly on the scanout layer */
+          SaWManTier          *tier;
+          CoreSurface         *surface;
+          DFBRectangle         src;
+          DFBRectangle         dst;                /* tier coordinates */
+          DFBDimension         size;
+          DFBSurfacePixelFormat format;
+
+          SaWManWindow        *rejected;           /* last window the layer could not take */
+          DFBRectangle         rejected_src;
+          DFBRectangle         rejected_dst;
+     } scanout;
+
+     struct {
+          bool                 valid;              /* grid matches layout and window bounds */
+          DFBDimension         size;               /* resolution the grid was built for */
+          SaWManHitCell        cells[SAWMAN_HIT_GRID_ROWS][SAWMAN_HIT_GRID_COLS];
+     } hit;
+
+     struct {
+          unsigned long        bytes;              /* memory held by pre-scaled window copies */
+          unsigned int         stamp;              /* repaint counter for eviction */
+     } scaled;
+
+     struct {
+          unsigned int         windows;            /* windows with snapshots enabled */
+          CoreSurface         *pool[SAWMAN_MAX_SNAPSHOT_POOL];
+          int                  num_pool;
+     } snapshots;
+
      FusionCall                call;
 
      FusionReactor            *reactor;
@@ -424,8 +469,21 @@ struct __SaWMan_SaWManTier {
           long long               stamp;
           unsigned int            updates;
           unsigned long long      pixels;
+          unsigned int            scale_hits;
+          unsigned int            scale_misses;
+          unsigned int            blits;            /* window blit notifications sent */
+          unsigned int            blits_merged;     /* window blit notifications folded into others */
      } performance;
 
+     struct {
+          long long               next;             /* earliest time of the next repaint (us) */
+          long long               pending;          /* time updates are deferred since (us), 0 if none */
+          long long               pixel_cost;       /* predicted repaint cost per 1024 pixels (ns) */
+          long long               region_cost;      /* predicted repaint cost per region (ns) */
+          unsigned int            frames;
+          unsigned int            missed;           /* repaints exceeding the budget or coming a frame late */
+     } schedule;
+
      DFBDisplayLayerConfig   driver_config;
      bool                    driver_config_set;
 
@@ -436,6 +494,8 @@ struct __SaWMan_SaWManTier {
  * Per left/right window update info
  */
 typedef struct {
+     misc_region_t          visible_region;     /* exact visible area, maintained by sawman_update_visible() */
+
      DFBUpdates             visible;
      DFBRegion              visible_regions[SAWMAN_MAX_VISIBLE_REGIONS];
 
@@ -443,6 +503,61 @@ typedef struct {
      DFBRegion              updates_regions[SAWMAN_MAX_UPDATES_REGIONS];
 } SaWManWindowLR;
 
+/*
+ * Window state the visible regions have been calculated with
+ */
+typedef struct {
+     bool                   valid;
+     bool                   visible;
+     bool                   covering;           /* hides windows below within 'cover' */
+
+     DFBWindowStackingClass stacking;
+     int                    z;
+
+     DFBRectangle           bounds;
+     DFBRegion              cover;
+} SaWManWindowShape;
+
+/*
+ * Window state a pre-scaled copy has been rendered from
+ */
+typedef struct {
+     DFBRectangle           src;
+     DFBDimension           size;               /* destination size */
+
+     FusionObjectID         surface_id;
+     DFBDimension           surface_size;
+     DFBSurfacePixelFormat  format;
+
+     SaWManScalingMode      mode;
+} SaWManWindowScaledKey;
+
+typedef struct {
+     CoreSurface           *surface;            /* window content stretched to 'key.size' */
+     unsigned long          bytes;
+
+     SaWManWindowScaledKey  key;
+
+     bool                   valid;              /* surface matches window content for 'key' */
+     bool                   flipped;            /* window content changed since last repaint */
+
+     unsigned int           used;               /* repaint stamp for eviction */
+} SaWManWindowScaled;
+
+/*
+ * Downscaled copy of the window content for previews, rendered on flip at most every 'interval' ms
+ */
+typedef struct {
+     DFBDimension           size;               /* 0x0 if disabled */
+     unsigned int           interval;
+
+     CoreSurface           *surface;
+     unsigned int           generation;         /* incremented with each snapshot taken */
+     long long              stamp;              /* ms of the last snapshot */
+
+     bool                   dirty;              /* window content changed since last snapshot */
+} SaWManWindowSnapshot;
+
 struct __SaWMan_SaWManWindow {
      DirectLink             link;
 
@@ -482,6 +597,10 @@ struct __SaWMan_SaWManWindow {
      SaWManWindowLR         left;
      SaWManWindowLR         right;
 
+     SaWManWindowShape      shape;
+     SaWManWindowScaled     scaled;
+     SaWManWindowSnapshot   snapshot;
+
      bool close_focused;
      bool min_focused;
      bool max_focused;
@@ -516,6 +635,9 @@ typedef struct {
      CoreGraphicsStateClient       client;
 
      FusionSkirmish                update_skirmish;
+
+     SaWManComposer               *composer;     /* parallel composition, see sawman_composer_init() */
+     SaWManScheduler              *scheduler;    /* deferred tier updates, see sawman_scheduler_init() */
 } WMData;
 
 /**********************************************************************************************************************/
@@ -576,6 +698,24 @@ DFBResult sawman_get_performance( SaWMan                 *sawman,
                                   unsigned long long     *ret_pixels,
                                   long long              *ret_duration );
 
+DFBResult sawman_get_scale_stats( SaWMan                 *sawman,
+                                  DFBWindowStackingClass  clazz,
+                                  bool                    reset,
+                                  unsigned int           *ret_hits,
+                                  unsigned int           *ret_misses );
+
+DFBResult sawman_get_schedule_stats( SaWMan                 *sawman,
+                                     DFBWindowStackingClass  clazz,
+                                     bool                    reset,
+                                     unsigned int           *ret_frames,
+                                     unsigned int           *ret_missed );
+
+DFBResult sawman_get_event_stats( SaWMan                 *sawman,
+                                  DFBWindowStackingClass  clazz,
+                                  bool                    reset,
+                                  unsigned int           *ret_blits,
+                                  unsigned int           *ret_merged );
+
 void sawman_dispatch_tier_update( SaWMan             *sawman,
                                   SaWManTier         *tier,
                                   bool                right_eye,
@@ -588,6 +728,12 @@ void sawman_dispatch_blit( SaWMan             *sawman,
                            const DFBRectangle *src,
                            const DFBRectangle *dst,
                            const DFBRegion    *clip );
+
+void sawman_dispatch_blits( SaWMan             *sawman,
+                            SaWManTier         *tier,
+                            bool                right_eye,
+                            const DFBRegion    *updates,
+                            unsigned int        num_updates );
                      
 /**********************************************************************************************************************/
 
@@ -37,6 +37,8 @@ extern "C"
 #endif
 
 typedef struct __SaWMan_SaWMan           SaWMan;
+typedef struct __SaWMan_SaWManComposer   SaWManComposer;
+typedef struct __SaWMan_SaWManScheduler  SaWManScheduler;
 typedef struct __SaWMan_SaWManGrabbedKey SaWManGrabbedKey;
 typedef struct __SaWMan_SaWManLayout     SaWManLayout;
 typedef struct __SaWMan_SaWManTier       SaWManTier;
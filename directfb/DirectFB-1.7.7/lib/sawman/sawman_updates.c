@@ -32,10 +32,15 @@
 
 #include <config.h>
 
+#include <limits.h>
 #include <unistd.h>
 
+#include <direct/clock.h>
 #include <direct/debug.h>
 #include <direct/list.h>
+#include <direct/mem.h>
+#include <direct/memcpy.h>
+#include <direct/thread.h>
 
 #include <fusion/conf.h>
 #include <fusion/fusion.h>
@@ -73,6 +78,8 @@ D_DEBUG_DOMAIN( SaWMan_Update,   "SaWMan/Update",   "SaWMan window manager updat
 D_DEBUG_DOMAIN( SaWMan_FlipOnce, "SaWMan/FlipOnce", "SaWMan window manager flip once" );
 D_DEBUG_DOMAIN( SaWMan_Surface,  "SaWMan/Surface",  "SaWMan window manager surface" );
 D_DEBUG_DOMAIN( SaWMan_Focus,    "SaWMan/Focus",    "SaWMan window manager focus" );
+D_DEBUG_DOMAIN( SaWMan_Scanout,  "SaWMan/Scanout",  "SaWMan direct scanout of windows" );
+D_DEBUG_DOMAIN( SaWMan_Schedule, "SaWMan/Schedule", "SaWMan frame scheduling of tier updates" );
 
 /**********************************************************************************************************************/
 
@@ -469,27 +476,27 @@ update_region2( SaWMan          *sawman,
           D_MAGIC_ASSERT( window, CoreWindow );
 
           if (SAWMAN_VISIBLE_WINDOW( window ) && (tier->classes & (1 << window->config.stacking))) {
-               misc_region_t visible;
-               misc_region_t render;
-               misc_region_t opt;
+               misc_region_t *visible = right_eye ? &sawwin->right.visible_region : &sawwin->left.visible_region;
+               misc_box_t    *bounds  = misc_region_extents( visible );
+               misc_region_t  render;
+               misc_region_t  opt;
+
+               /* skip windows not visible within the update */
+               if (bounds->x1 >= extents.x2 || bounds->x2 <= extents.x1 ||
+                   bounds->y1 >= extents.y2 || bounds->y2 <= extents.y1)
+                    continue;
 
                D_DEBUG_AT( SaWMan_Update, " -=> [%d] <=-\n", i );
 
                MISC_REGION_DEBUG_AT( SaWMan_Update, &dirty, "dirty" );
 
-               /* visible (window) */
-               if (right_eye)
-                    misc_region_init_updates( &visible, NULL, &sawwin->right.visible );
-               else
-                    misc_region_init_updates( &visible, NULL, &sawwin->left.visible );
-
                /* render (extents) */
                misc_region_init_with_extents( &render, NULL, &extents );
 
                misc_region_init( &opt, NULL );
 
                /* render = visible & render(extents) */
-               misc_region_intersect( &render, &visible, &render );
+               misc_region_intersect( &render, visible, &render );
 
                /* opt = render & dirty */
                misc_region_intersect( &opt, &render, &dirty );
@@ -507,7 +514,7 @@ update_region2( SaWMan          *sawman,
                     /* blend = render - opt */
                     misc_region_subtract( &blend, &render, &opt );
 
-                    MISC_REGION_DEBUG_AT( SaWMan_Update, &visible, "visible" );
+                    MISC_REGION_DEBUG_AT( SaWMan_Update, visible, "visible" );
                     MISC_REGION_DEBUG_AT( SaWMan_Update, &render, "render" );
                     MISC_REGION_DEBUG_AT( SaWMan_Update, &opt, "opt" );
                     MISC_REGION_DEBUG_AT( SaWMan_Update, &blend, "blend" );
@@ -543,7 +550,7 @@ update_region2( SaWMan          *sawman,
                     misc_region_deinit( &blend );
                }
                else {
-                    MISC_REGION_DEBUG_AT( SaWMan_Update, &visible, "visible" );
+                    MISC_REGION_DEBUG_AT( SaWMan_Update, visible, "visible" );
                     MISC_REGION_DEBUG_AT( SaWMan_Update, &render, "render" );
                     MISC_REGION_DEBUG_AT( SaWMan_Update, &opt, "clear" );
 
@@ -583,7 +590,6 @@ update_region2( SaWMan          *sawman,
 
                misc_region_deinit( &opt );
                misc_region_deinit( &render );
-               misc_region_deinit( &visible );
           }
      }
 
@@ -1248,6 +1254,414 @@ sawman_flush_updating( SaWMan     *sawman,
      }
 }
 
+static void
+repaint_cursor( SaWMan          *sawman,
+                SaWManTier      *tier,
+                CardState       *state,
+                CoreSurface     *surface,
+                const DFBRegion *update,
+                DFBRegion       *cursor_inter,
+                bool             right_eye,
+                WMData          *wmdata )
+{
+     int              x, y;
+     CoreWindowStack *stack = tier->stack;
+     //DFBRectangle rect = DFB_RECTANGLE_INIT_FROM_REGION( cursor_inter );
+
+     D_ASSUME( tier->cursor_bs_valid );
+
+     dfb_gfx_copy_regions_client( surface, CSBR_BACK, right_eye ? DSSE_RIGHT : DSSE_LEFT,
+                                  right_eye ? tier->cursor_bs_right : tier->cursor_bs, CSBR_BACK, DSSE_LEFT,
+                                  cursor_inter, 1,
+                                  - tier->cursor_region.x1,
+                                  - tier->cursor_region.y1, &wmdata->client );
+
+     x = (s64) stack->cursor.x * (s64) tier->size.w / (s64) sawman->resolution.w;
+     y = (s64) stack->cursor.y * (s64) tier->size.h / (s64) sawman->resolution.h;
+
+     /* Set destination. */
+     state->destination  = surface;
+     state->to_eye       = right_eye ? DSSE_RIGHT : DSSE_LEFT;
+     state->modified    |= SMF_DESTINATION | SMF_TO;
+
+     /* Set clipping region. */
+     dfb_state_set_clip( state, update );
+
+     sawman_draw_cursor( stack, state, surface, cursor_inter, x, y );
+}
+
+static void
+compose_region( SaWMan          *sawman,
+                SaWManTier      *tier,
+                CardState       *state,
+                CoreSurface     *surface,
+                const DFBRegion *update,
+                bool             right_eye )
+{
+     CoreLayerRegion *region = tier->region;
+
+     DFB_REGION_ASSERT( update );
+
+     /* Set destination. */
+     state->destination  = surface;
+     state->to_eye       = right_eye ? DSSE_RIGHT : DSSE_LEFT;
+     state->modified    |= SMF_DESTINATION | SMF_TO;
+
+     if (!DFB_PLANAR_PIXELFORMAT(region->config.format))
+          dfb_state_set_dst_colorkey( state, dfb_color_to_pixel( region->config.format,
+                                                                 region->config.src_key.r,
+                                                                 region->config.src_key.g,
+                                                                 region->config.src_key.b ) );
+     else
+          dfb_state_set_dst_colorkey( state, 0 );
+
+     /* Set clipping region. */
+     dfb_state_set_clip( state, update );
+
+     /* Compose updated region. */
+     switch (sawman_config->update_region_mode) {
+          case 1:
+               update_region( sawman, tier, state,
+                              fusion_vector_size( &sawman->layout ) - 1,
+                              update->x1, update->y1, update->x2, update->y2,
+                              right_eye );
+
+               break;
+          case 3:
+               update_region3( sawman, tier, state,
+                               fusion_vector_size( &sawman->layout ) - 1,
+                               update->x1, update->y1, update->x2, update->y2,
+                               right_eye );
+
+               break;
+          case 4:
+               update_region4( sawman, tier, state,
+                               fusion_vector_size( &sawman->layout ) - 1,
+                               update->x1, update->y1, update->x2, update->y2,
+                               right_eye );
+
+               break;
+          case 2:
+          default:
+               update_region2( sawman, tier, state,
+                               fusion_vector_size( &sawman->layout ) - 1,
+                               update->x1, update->y1, update->x2, update->y2,
+                               right_eye );
+     }
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Threads composing parts of a tier update, each with its own state and client.
+ *
+ * The parts never overlap in the destination, the caller holds the SaWMan lock during the whole run.
+ */
+struct __SaWMan_SaWManComposer {
+     int                  magic;
+
+     CoreDFB             *core;
+
+     DirectMutex          lock;
+     DirectWaitQueue      wq;
+
+     DirectThread        *threads[SAWMAN_MAX_UPDATE_THREADS];
+     int                  num_threads;
+
+     bool                 quit;
+
+     /* current run */
+     SaWMan              *sawman;
+     SaWManTier          *tier;
+     CoreSurface         *surface;
+     bool                 right_eye;
+
+     DFBRegion            jobs[SAWMAN_MAX_UPDATE_JOBS];
+     int                  num_jobs;
+     int                  next;
+     int                  busy;
+};
+
+static bool
+composer_run_job( SaWManComposer *composer,
+                  CardState      *state )
+{
+     int index;
+
+     D_MAGIC_ASSERT( composer, SaWManComposer );
+
+     if (composer->next == composer->num_jobs)
+          return false;
+
+     index = composer->next++;
+
+     composer->busy++;
+
+     direct_mutex_unlock( &composer->lock );
+
+     D_DEBUG_AT( SaWMan_Update, "  -> job %d [%4d,%4d-%4dx%4d]\n", index,
+                 DFB_RECTANGLE_VALS_FROM_REGION( &composer->jobs[index] ) );
+
+     compose_region( composer->sawman, composer->tier, state, composer->surface,
+                     &composer->jobs[index], composer->right_eye );
+
+     CoreGraphicsStateClient_Flush( state->client, 0, CGSCFF_NONE );
+
+     direct_mutex_lock( &composer->lock );
+
+     if (!--composer->busy && composer->next == composer->num_jobs)
+          direct_waitqueue_broadcast( &composer->wq );
+
+     return true;
+}
+
+static void *
+composer_loop( DirectThread *thread,
+               void         *arg )
+{
+     DFBResult                ret;
+     SaWManComposer          *composer = arg;
+     CardState                state;
+     CoreGraphicsStateClient  client;
+
+     D_MAGIC_ASSERT( composer, SaWManComposer );
+
+     dfb_state_init( &state, composer->core );
+
+     /* The client belongs to this thread. */
+     ret = CoreGraphicsStateClient_Init( &client, &state );
+     if (ret) {
+          D_DERROR( ret, "SaWMan/Composer: Could not initialize graphics state client!\n" );
+          dfb_state_destroy( &state );
+          return NULL;
+     }
+
+     direct_mutex_lock( &composer->lock );
+
+     while (!composer->quit) {
+          if (!composer_run_job( composer, &state )) {
+               /* Release the destination while idle. */
+               state.destination  = NULL;
+               state.modified    |= SMF_DESTINATION;
+
+               direct_waitqueue_wait( &composer->wq, &composer->lock );
+          }
+     }
+
+     direct_mutex_unlock( &composer->lock );
+
+     CoreGraphicsStateClient_Deinit( &client );
+
+     dfb_state_destroy( &state );
+
+     return NULL;
+}
+
+/*
+ * Splits the updates into disjoint parts of similar size, roughly two per thread.
+ */
+static int
+composer_split( const SaWManComposer *composer,
+                const DFBRegion      *updates,
+                int                   num_updates,
+                DFBRegion            *ret_disjoint,
+                int                  *ret_num_disjoint,
+                DFBRegion            *ret_jobs )
+{
+     int            i, n, num;
+     misc_region_t  region;
+     misc_box_t    *boxes;
+     long long      pixels  = 0;
+     long long      target;
+     int            num_jobs = 0;
+
+     misc_region_init_regions( &region, NULL, updates, num_updates );
+
+     boxes = misc_region_boxes( &region, &num );
+
+     /* Too fragmented, keep the bounding box. */
+     if (num > SAWMAN_MAX_UPDATE_JOBS) {
+          misc_box_t extents = *misc_region_extents( &region );
+
+          misc_region_reset( &region, &extents );
+
+          boxes = misc_region_boxes( &region, &num );
+     }
+
+     for (i=0; i<num; i++) {
+          ret_disjoint[i].x1 = boxes[i].x1;
+          ret_disjoint[i].y1 = boxes[i].y1;
+          ret_disjoint[i].x2 = boxes[i].x2 - 1;
+          ret_disjoint[i].y2 = boxes[i].y2 - 1;
+
+          pixels += (long long) (boxes[i].x2 - boxes[i].x1) * (boxes[i].y2 - boxes[i].y1);
+     }
+
+     *ret_num_disjoint = num;
+
+     target = pixels / ((composer->num_threads + 1) * 2) + 1;
+
+     for (i=0; i<num; i++) {
+          const DFBRegion *box    = &ret_disjoint[i];
+          int              height = box->y2 - box->y1 + 1;
+          int              bands  = (box->x2 - box->x1 + 1) * (long long) height / target;
+          int              y      = box->y1;
+
+          bands = MAX( bands, 1 );
+          bands = MIN( bands, height );
+          bands = MIN( bands, SAWMAN_MAX_UPDATE_JOBS - num_jobs - (num - i - 1) );
+
+          /* horizontal bands */
+          for (n=0; n<bands; n++) {
+               DFBRegion *job = &ret_jobs[num_jobs++];
+
+               job->x1 = box->x1;
+               job->x2 = box->x2;
+               job->y1 = y;
+               job->y2 = (n == bands - 1) ? box->y2 : y + height / bands - 1;
+
+               y = job->y2 + 1;
+          }
+     }
+
+     misc_region_deinit( &region );
+
+     return num_jobs;
+}
+
+static void
+composer_compose( SaWManComposer  *composer,
+                  const DFBRegion *jobs,
+                  int              num_jobs,
+                  SaWMan          *sawman,
+                  SaWManTier      *tier,
+                  CardState       *state,
+                  CoreSurface     *surface,
+                  bool             right_eye )
+{
+     D_MAGIC_ASSERT( composer, SaWManComposer );
+     D_ASSERT( num_jobs <= SAWMAN_MAX_UPDATE_JOBS );
+
+     direct_mutex_lock( &composer->lock );
+
+     direct_memcpy( composer->jobs, jobs, num_jobs * sizeof(DFBRegion) );
+
+     composer->num_jobs  = num_jobs;
+     composer->sawman    = sawman;
+     composer->tier      = tier;
+     composer->surface   = surface;
+     composer->right_eye = right_eye;
+     composer->next      = 0;
+     composer->busy      = 0;
+
+     direct_waitqueue_broadcast( &composer->wq );
+
+     /* Take part in the work, then wait for the others. */
+     while (composer_run_job( composer, state ));
+
+     while (composer->busy)
+          direct_waitqueue_wait( &composer->wq, &composer->lock );
+
+     composer->num_jobs = 0;
+     composer->next     = 0;
+
+     direct_mutex_unlock( &composer->lock );
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Thread repainting tiers whose updates have been deferred to the next frame and taking rate limited snapshots.
+ */
+struct __SaWMan_SaWManScheduler {
+     int                  magic;
+
+     WMData              *wmdata;
+
+     DirectMutex          lock;
+     DirectWaitQueue      wq;
+
+     DirectThread        *thread;
+
+     bool                 quit;
+
+     long long            wakeup;       /* time of the earliest deferred repaint (us), 0 if none */
+};
+
+static void
+sawman_scheduler_wakeup( SaWManScheduler *scheduler,
+                         long long        time )
+{
+     D_MAGIC_ASSERT( scheduler, SaWManScheduler );
+
+     direct_mutex_lock( &scheduler->lock );
+
+     if (!scheduler->wakeup || time < scheduler->wakeup) {
+          scheduler->wakeup = time;
+
+          direct_waitqueue_broadcast( &scheduler->wq );
+     }
+
+     direct_mutex_unlock( &scheduler->lock );
+}
+
+static void *
+scheduler_loop( DirectThread *thread,
+                void         *arg )
+{
+     SaWManScheduler *scheduler = arg;
+     WMData          *wmdata;
+     SaWMan          *sawman;
+
+     D_MAGIC_ASSERT( scheduler, SaWManScheduler );
+
+     wmdata = scheduler->wmdata;
+     sawman = wmdata->sawman;
+
+     direct_mutex_lock( &scheduler->lock );
+
+     while (!scheduler->quit) {
+          long long now = direct_clock_get_micros();
+
+          if (!scheduler->wakeup) {
+               direct_waitqueue_wait( &scheduler->wq, &scheduler->lock );
+               continue;
+          }
+
+          if (now < scheduler->wakeup) {
+               direct_waitqueue_wait_timeout( &scheduler->wq, &scheduler->lock, scheduler->wakeup - now );
+               continue;
+          }
+
+          scheduler->wakeup = 0;
+
+          direct_mutex_unlock( &scheduler->lock );
+
+          /* Never block on the locks, they may be held while the scheduler is stopped. */
+          if (fusion_skirmish_swoop( sawman->lock ) == DR_OK) {
+               if (fusion_skirmish_swoop( &wmdata->update_skirmish ) == DR_OK) {
+                    sawman_process_updates( sawman, DSFLIP_NONE, wmdata );
+
+                    fusion_skirmish_dismiss( &wmdata->update_skirmish );
+               }
+               else
+                    sawman_scheduler_wakeup( scheduler, now + 1000 );
+
+               sawman_unlock( sawman );
+          }
+          else
+               sawman_scheduler_wakeup( scheduler, now + 1000 );
+
+          direct_mutex_lock( &scheduler->lock );
+     }
+
+     direct_mutex_unlock( &scheduler->lock );
+
+     return NULL;
+}
+
+/**********************************************************************************************************************/
+
 static void
 repaint_tier( SaWMan              *sawman,
               SaWManTier          *tier,
@@ -1262,7 +1676,10 @@ repaint_tier( SaWMan              *sawman,
      CardState       *state;
      CoreSurface     *surface;
      DFBRegion        cursor_inter;
-     CoreWindowStack *stack;
+     DFBRegion        disjoint[SAWMAN_MAX_UPDATE_JOBS];
+     int              num_disjoint;
+     DFBRegion        jobs[SAWMAN_MAX_UPDATE_JOBS];
+     int              num_jobs = 0;
 
      D_MAGIC_ASSERT( sawman, SaWMan );
      D_MAGIC_ASSERT( tier, SaWManTier );
@@ -1273,9 +1690,6 @@ repaint_tier( SaWMan              *sawman,
      if (num_updates == 0)
           return;
 
-     stack = tier->stack;
-     D_ASSERT( stack != NULL );
-
      region = tier->region;
      D_ASSERT( region != NULL );
 
@@ -1291,88 +1705,45 @@ repaint_tier( SaWMan              *sawman,
 
      sawman_dispatch_tier_update( sawman, tier, right_eye, updates, num_updates );
 
-     for (i=0; i<num_updates; i++) {
-          const DFBRegion *update = &updates[i];
-
-          DFB_REGION_ASSERT( update );
-
-          D_DEBUG_AT( SaWMan_Update, "  -> %d, %d - %dx%d  (%d)\n",
-                      DFB_RECTANGLE_VALS_FROM_REGION( update ), i );
+     /* Windows are only scaled once per eye pair, before the composer threads share them. */
+     if (!right_eye)
+          sawman_prepare_scaled( sawman, tier, state, updates, num_updates );
 
-          /* Set destination. */
-          state->destination  = surface;
-          state->to_eye       = right_eye ? DSSE_RIGHT : DSSE_LEFT;
-          state->modified    |= SMF_DESTINATION | SMF_TO;
+     if (sawman_config->coalesce_events)
+          sawman_dispatch_blits( sawman, tier, right_eye, updates, num_updates );
 
-          if (!DFB_PLANAR_PIXELFORMAT(region->config.format))
-               dfb_state_set_dst_colorkey( state, dfb_color_to_pixel( region->config.format,
-                                                                      region->config.src_key.r,
-                                                                      region->config.src_key.g,
-                                                                      region->config.src_key.b ) );
-          else
-               dfb_state_set_dst_colorkey( state, 0 );
+     if (wmdata->composer)
+          num_jobs = composer_split( wmdata->composer, updates, num_updates, disjoint, &num_disjoint, jobs );
 
-          /* Set clipping region. */
-          dfb_state_set_clip( state, update );
+     if (num_jobs > 1) {
+          D_DEBUG_AT( SaWMan_Update, "  -> %d disjoint updates in %d jobs\n", num_disjoint, num_jobs );
 
-          /* Compose updated region. */
-          switch (sawman_config->update_region_mode) {
-               case 1:
-                    update_region( sawman, tier, state,
-                                   fusion_vector_size( &sawman->layout ) - 1,
-                                   update->x1, update->y1, update->x2, update->y2,
-                                   right_eye );
+          composer_compose( wmdata->composer, jobs, num_jobs, sawman, tier, state, surface, right_eye );
 
-                    break;
-               case 3:
-                    update_region3( sawman, tier, state,
-                                    fusion_vector_size( &sawman->layout ) - 1,
-                                    update->x1, update->y1, update->x2, update->y2,
-                                    right_eye );
+          /* Cursor on top of the disjoint parts, not overwriting its own background. */
+          updates     = disjoint;
+          num_updates = num_disjoint;
+     }
+     else {
+          for (i=0; i<num_updates; i++) {
+               D_DEBUG_AT( SaWMan_Update, "  -> %d, %d - %dx%d  (%d)\n",
+                           DFB_RECTANGLE_VALS_FROM_REGION( &updates[i] ), i );
 
-                    break;
-               case 4:
-                    update_region4( sawman, tier, state,
-                                    fusion_vector_size( &sawman->layout ) - 1,
-                                    update->x1, update->y1, update->x2, update->y2,
-                                    right_eye );
+               compose_region( sawman, tier, state, surface, &updates[i], right_eye );
 
-                    break;
-               case 2:
-               default:
-                    update_region2( sawman, tier, state,
-                                    fusion_vector_size( &sawman->layout ) - 1,
-                                    update->x1, update->y1, update->x2, update->y2,
-                                    right_eye );
+               /* Update cursor? */
+               cursor_inter = tier->cursor_region;
+               if (tier->cursor_drawn && dfb_region_region_intersect( &cursor_inter, &updates[i] ))
+                    repaint_cursor( sawman, tier, state, surface, &updates[i], &cursor_inter, right_eye, wmdata );
           }
 
-          /* Update cursor? */
-          cursor_inter = tier->cursor_region;
-          if (tier->cursor_drawn && dfb_region_region_intersect( &cursor_inter, update )) {
-               int          x, y;
-               //DFBRectangle rect = DFB_RECTANGLE_INIT_FROM_REGION( &cursor_inter );
-
-               D_ASSUME( tier->cursor_bs_valid );
-
-               dfb_gfx_copy_regions_client( surface, CSBR_BACK, right_eye ? DSSE_RIGHT : DSSE_LEFT,
-                                            right_eye ? tier->cursor_bs_right : tier->cursor_bs, CSBR_BACK, DSSE_LEFT,
-                                            &cursor_inter, 1,
-                                            - tier->cursor_region.x1,
-                                            - tier->cursor_region.y1, &wmdata->client );
-
-               x = (s64) stack->cursor.x * (s64) tier->size.w / (s64) sawman->resolution.w;
-               y = (s64) stack->cursor.y * (s64) tier->size.h / (s64) sawman->resolution.h;
-
-               /* Set destination. */
-               state->destination  = surface;
-               state->to_eye       = right_eye ? DSSE_RIGHT : DSSE_LEFT;
-               state->modified    |= SMF_DESTINATION | SMF_TO;
-
-               /* Set clipping region. */
-               dfb_state_set_clip( state, update );
+          num_updates = 0;
+     }
 
-               sawman_draw_cursor( stack, state, surface, &cursor_inter, x, y );
-          }
+     for (i=0; i<num_updates; i++) {
+          cursor_inter = tier->cursor_region;
+          if (tier->cursor_drawn && dfb_region_region_intersect( &cursor_inter, &updates[i] ))
+               repaint_cursor( sawman, tier, state, surface, &updates[i], &cursor_inter, right_eye, wmdata );
      }
 
      /* Reset destination. */
@@ -1955,6 +2326,149 @@ set_config( SaWMan     *sawman,
      return DFB_OK;
 }
 
+/**********************************************************************************************************************/
+
+/*
+ * Repaint cost of a tier is predicted as a linear function of the number of pixels and regions.
+ * Both factors are refined after each repaint by a normalized least mean squares step.
+ */
+static long long
+schedule_predict( const SaWManTier *tier,
+                  long long         pixels,
+                  int               num )
+{
+     return pixels * tier->schedule.pixel_cost / 1024 + num * tier->schedule.region_cost;
+}
+
+static void
+schedule_learn( SaWManTier *tier,
+                long long   pixels,
+                int         num,
+                long long   duration )
+{
+     long long error = duration * 1000 - schedule_predict( tier, pixels, num );
+     long long kpix  = pixels / 1024;
+     long long norm  = kpix * kpix + num * num;
+
+     if (!norm)
+          return;
+
+     tier->schedule.pixel_cost  += error * kpix / (4 * norm);
+     tier->schedule.region_cost += error * num  / (4 * norm);
+
+     if (tier->schedule.pixel_cost < 1)
+          tier->schedule.pixel_cost = 1;
+
+     if (tier->schedule.region_cost < 0)
+          tier->schedule.region_cost = 0;
+}
+
+static long long
+schedule_area( const DFBRegion *regions,
+               int              num )
+{
+     int       i;
+     long long area = 0;
+
+     for (i=0; i<num; i++)
+          area += (long long)(regions[i].x2 - regions[i].x1 + 1) * (regions[i].y2 - regions[i].y1 + 1);
+
+     return area;
+}
+
+/*
+ * Merges the pair of regions adding the least area as long as this lowers the predicted cost.
+ */
+static int
+schedule_merge( const SaWManTier *tier,
+                const DFBRegion  *regions,
+                int               num,
+                DFBRegion        *ret_regions )
+{
+     int       i, j;
+     long long pixels = schedule_area( regions, num );
+     long long cost   = schedule_predict( tier, pixels, num );
+
+     direct_memcpy( ret_regions, regions, sizeof(DFBRegion) * num );
+
+     while (num > 1) {
+          int       best_i = 0, best_j = 1;
+          long long best   = LLONG_MAX;
+          long long merged;
+
+          for (i=0; i<num-1; i++) {
+               for (j=i+1; j<num; j++) {
+                    DFBRegion united = ret_regions[i];
+                    long long added;
+
+                    dfb_region_region_union( &united, &ret_regions[j] );
+
+                    added = schedule_area( &united, 1 ) - schedule_area( &ret_regions[i], 1 ) - schedule_area( &ret_regions[j], 1 );
+                    if (added < best) {
+                         best   = added;
+                         best_i = i;
+                         best_j = j;
+                    }
+               }
+          }
+
+          merged = schedule_predict( tier, pixels + best, num - 1 );
+          if (merged >= cost)
+               break;
+
+          dfb_region_region_union( &ret_regions[best_i], &ret_regions[best_j] );
+
+          ret_regions[best_j] = ret_regions[--num];
+
+          pixels += best;
+          cost    = merged;
+     }
+
+     D_DEBUG_AT( SaWMan_Schedule, "  -> %d regions, %lld pixels, predicted %lld us\n", num, pixels, cost / 1000 );
+
+     return num;
+}
+
+/*
+ * Accounts a repaint of the tier, refining the cost prediction and counting missed deadlines.
+ */
+static void
+schedule_account( SaWManTier      *tier,
+                  const DFBRegion *left_updates,
+                  int              left_num,
+                  const DFBRegion *right_updates,
+                  int              right_num,
+                  long long        start,
+                  long long        end )
+{
+     long long pixels   = schedule_area( left_updates, left_num ) + schedule_area( right_updates, right_num );
+     long long duration = end - start;
+     bool      missed   = false;
+
+     schedule_learn( tier, pixels, left_num + right_num, duration );
+
+     if (sawman_config->frame_budget && duration > sawman_config->frame_budget)
+          missed = true;
+
+     if (sawman_config->frame_rate) {
+          long long interval = 1000000LL / sawman_config->frame_rate;
+
+          if (tier->schedule.pending && start - tier->schedule.pending > interval)
+               missed = true;
+
+          tier->schedule.next = start + interval;
+     }
+
+     D_DEBUG_AT( SaWMan_Schedule, "  -> repaint took %lld us for %lld pixels (%lld ns/kpixel, %lld ns/region)%s\n",
+                 duration, pixels, tier->schedule.pixel_cost, tier->schedule.region_cost, missed ? " MISSED" : "" );
+
+     tier->schedule.pending = 0;
+     tier->schedule.frames++;
+
+     if (missed)
+          tier->schedule.missed++;
+}
+
 static DFBResult
 process_updates( SaWMan              *sawman,
                  SaWManTier          *tier,
@@ -1971,6 +2485,9 @@ process_updates( SaWMan              *sawman,
      DFBRegion        full_tier_region = { 0, 0, tier->size.w - 1, tier->size.h - 1 };
      DFBRegion        left_united;
      DFBRegion        right_united;
+     DFBRegion        left_merged[SAWMAN_MAX_UPDATE_REGIONS];
+     DFBRegion        right_merged[SAWMAN_MAX_UPDATE_REGIONS];
+     long long        start;
 
      D_MAGIC_ASSERT( sawman, SaWMan );
      D_MAGIC_ASSERT( tier, SaWManTier );
@@ -2009,6 +2526,16 @@ process_updates( SaWMan              *sawman,
                     right_num     = 1;
                }
           }
+          else if (sawman_config->frame_budget) {
+               /* Merge regions as far as it lowers the predicted cost, be it down to the bounding box. */
+               left_updates = left_merged;
+               left_num     = schedule_merge( tier, tier->left.updates.regions, tier->left.updates.num_regions, left_merged );
+
+               if (tier->region->config.options & DLOP_STEREO) {
+                    right_updates = right_merged;
+                    right_num     = schedule_merge( tier, tier->right.updates.regions, tier->right.updates.num_regions, right_merged );
+               }
+          }
           else if (tier->left.updates.num_regions + tier->right.updates.num_regions < 2 || total < bounding * n / d) {
                left_updates = tier->left.updates.regions;
                left_num     = tier->left.updates.num_regions;
@@ -2029,6 +2556,8 @@ process_updates( SaWMan              *sawman,
           }
      }
 
+     start = direct_clock_get_micros();
+
      if (left_num) {
           dfb_regions_unite( &left_united, left_updates, left_num );
 
@@ -2041,6 +2570,8 @@ process_updates( SaWMan              *sawman,
           repaint_tier( sawman, tier, right_updates, right_num, flags, true, wmdata );
      }
 
+     schedule_account( tier, left_updates, left_num, right_updates, right_num, start, direct_clock_get_micros() );
+
 
      switch (tier->region->config.buffermode) {
           case DLBM_TRIPLE:
@@ -2145,7 +2676,7 @@ process_updates( SaWMan              *sawman,
 
           D_MAGIC_ASSERT( tier->region->surface, CoreSurface );
 
-          if (fusion_skirmish_prevail( &tier->region->surface->lock ) == DFB_OK) {
+          if (dfb_surface_lock( tier->region->surface ) == DFB_OK) {
                if (tier->region->config.options & DLOP_STEREO) {
                     buffer = dfb_surface_get_buffer2( tier->region->surface, CSBR_FRONT, DSSE_LEFT );
                     D_MAGIC_ASSERT( buffer, CoreSurfaceBuffer );
@@ -2162,7 +2693,7 @@ process_updates( SaWMan              *sawman,
                     ret = dfb_surface_buffer_dump( buffer, ".", "tier" );
                }
 
-               fusion_skirmish_dismiss( &tier->region->surface->lock );
+               dfb_surface_unlock( tier->region->surface );
           }
      }
 #endif
@@ -2188,14 +2719,371 @@ process_updates( SaWMan              *sawman,
      return DFB_OK;
 }
 
-/* FIXME: Split up in smaller functions and clean up things like forcing reconfiguration. */
-DirectResult
+/**********************************************************************************************************************/
+
+/*
+ * A window is shown directly on the scanout layer if it is opaque, unbordered, mono, covers at least
+ * a quarter of its tier and no other visible window overlaps it. Its surface is attached to a region
+ * on that layer, so flips of the window no longer cause any copy into the tier surface.
+ */
+static bool
+scanout_eligible( SaWMan       *sawman,
+                  SaWManTier   *tier,
+                  SaWManWindow *sawwin )
+{
+     CoreWindow  *window;
+     CoreSurface *surface;
+
+     D_MAGIC_ASSERT( sawman, SaWMan );
+     D_MAGIC_ASSERT( tier, SaWManTier );
+     D_MAGIC_ASSERT( sawwin, SaWManWindow );
+
+     window = sawwin->window;
+     D_MAGIC_COREWINDOW_ASSERT( window );
+
+     surface = window->surface;
+     if (!surface)
+          return false;
+
+     if (SAWMAN_TRANSLUCENT_WINDOW(window) || sawman_window_border( sawwin ))
+          return false;
+
+     if ((window->caps & (DWCAPS_COLOR | DWCAPS_LR_MONO | DWCAPS_STEREO)) || window->config.z)
+          return false;
+
+     if (DFB_PIXELFORMAT_IS_INDEXED( surface->config.format ))
+          return false;
+
+     if (sawwin->dst.x < 0 || sawwin->dst.x + sawwin->dst.w > tier->size.w ||
+         sawwin->dst.y < 0 || sawwin->dst.y + sawwin->dst.h > tier->size.h)
+          return false;
+
+     if ((long long) sawwin->dst.w * sawwin->dst.h * 4 < (long long) tier->size.w * tier->size.h)
+          return false;
+
+     /* The software cursor is drawn into the tier and would end up hidden below the window. */
+     if (!sawman->cursor.region && tier->cursor_drawn &&
+         dfb_rectangle_region_intersects( &sawwin->dst, &tier->cursor_region ))
+          return false;
+
+     return true;
+}
+
+static SaWManWindow *
+scanout_candidate( SaWMan      *sawman,
+                   SaWManTier **ret_tier )
+{
+     int           n;
+     SaWManWindow *sawwin;
+
+     D_MAGIC_ASSERT( sawman, SaWMan );
+     D_ASSERT( ret_tier != NULL );
+
+     fusion_vector_foreach_reverse (sawwin, n, sawman->layout) {
+          int         i;
+          CoreWindow *window;
+          SaWManTier *tier;
+
+          D_MAGIC_ASSERT( sawwin, SaWManWindow );
+
+          window = sawwin->window;
+          D_MAGIC_COREWINDOW_ASSERT( window );
+
+          if (!SAWMAN_VISIBLE_WINDOW(window))
+               continue;
+
+          tier = sawman_tier_by_class( sawman, window->config.stacking );
+
+          if (!scanout_eligible( sawman, tier, sawwin ))
+               continue;
+
+          /* Anything visible above overlapping it would be hidden by the scanout layer. */
+          for (i=n+1; i<sawman->layout.count; i++) {
+               SaWManWindow *above = fusion_vector_at( &sawman->layout, i );
+               DFBRegion     bounds = DFB_REGION_INIT_FROM_RECTANGLE( &above->bounds );
+
+               D_MAGIC_ASSERT( above, SaWManWindow );
+
+               if (SAWMAN_VISIBLE_WINDOW(above->window) && dfb_rectangle_region_intersects( &sawwin->dst, &bounds ))
+                    break;
+          }
+
+          if (i == sawman->layout.count) {
+               *ret_tier = tier;
+               return sawwin;
+          }
+     }
+
+     return NULL;
+}
+
+static DFBResult
+scanout_promote( SaWMan       *sawman,
+                 SaWManTier   *tier,
+                 SaWManWindow *sawwin )
+{
+     DFBResult                ret;
+     CoreWindow              *window;
+     CoreSurface             *surface;
+     CoreLayer               *layer;
+     CoreLayerShared         *shared;
+     CoreLayerRegion         *region;
+     CoreLayerRegionConfig    config;
+     DFBRectangle             dst = sawwin->dst;
+     DFBRectangle             src = sawwin->src;
+     int                      screen_width;
+     int                      screen_height;
+
+     D_MAGIC_ASSERT( sawman, SaWMan );
+     D_MAGIC_ASSERT( tier, SaWManTier );
+     D_MAGIC_ASSERT( sawwin, SaWManWindow );
+     D_ASSERT( sawman->scanout.window == NULL );
+     D_ASSERT( sawman->scanout.region == NULL );
+
+     window = sawwin->window;
+     D_MAGIC_COREWINDOW_ASSERT( window );
+
+     surface = window->surface;
+     D_ASSERT( surface != NULL );
+
+     layer = sawman->scanout.layer;
+     D_ASSERT( layer != NULL );
+
+     shared = layer->shared;
+     D_ASSERT( shared != NULL );
+
+     D_DEBUG_AT( SaWMan_Scanout, "%s( window id %u, %d,%d-%dx%d -> %d,%d-%dx%d )\n", __FUNCTION__,
+                 window->id, DFB_RECTANGLE_VALS( &src ), DFB_RECTANGLE_VALS( &dst ) );
+
+     dfb_screen_get_screen_size( layer->screen, &screen_width, &screen_height );
+
+     /* Same mapping to the screen as used for single mode. */
+     if (shared->description.caps & DLCAPS_SCREEN_LOCATION) {
+          dst.x = dst.x * screen_width  / tier->size.w;
+          dst.y = dst.y * screen_height / tier->size.h;
+          dst.w = dst.w * screen_width  / tier->size.w;
+          dst.h = dst.h * screen_height / tier->size.h;
+     }
+     else {
+          if (dst.w != src.w || dst.h != src.h)
+               return DFB_UNSUPPORTED;
+
+          if (shared->description.caps & DLCAPS_SCREEN_POSITION) {
+               dst.x += (screen_width  - tier->size.w) / 2;
+               dst.y += (screen_height - tier->size.h) / 2;
+          }
+          else if (dst.x || dst.y)
+               return DFB_UNSUPPORTED;
+     }
+
+#ifdef SAWMAN_NO_LAYER_DOWNSCALE
+     if (dst.w < src.w)
+          return DFB_UNSUPPORTED;
+#endif
+
+     ret = dfb_layer_region_create( sawman->scanout.context, &region );
+     if (ret) {
+          D_DERROR( ret, "SaWMan/Scanout: Could not create region at layer (id %u)!\n", sawman_config->scanout.layer_id );
+          return ret;
+     }
+
+     config = sawman->scanout.context->primary.config;
+
+     config.width        = surface->config.size.w;
+     config.height       = surface->config.size.h;
+     config.format       = surface->config.format;
+     config.surface_caps = surface->config.caps;
+     config.buffermode   = DLBM_FRONTONLY;
+     config.options      = DLOP_NONE;
+     config.opacity      = 0xff;
+     config.source       = src;
+     config.dest         = dst;
+     config.keep_buffers = true;
+
+     ret = dfb_layer_region_set_configuration( region, &config, CLRCF_ALL | CLRCF_FREEZE );
+     if (ret) {
+          D_DEBUG_AT( SaWMan_Scanout, "  -> layer does not take it (%s)\n", DirectResultString( ret ) );
+          dfb_layer_region_unref( region );
+          return ret;
+     }
+
+     region->config.keep_buffers = true;
+
+     ret = dfb_layer_region_set_surface( region, surface, false );
+     if (ret) {
+          D_DERROR( ret, "SaWMan/Scanout: Failed to set layer surface!\n" );
+          dfb_layer_region_unref( region );
+          return ret;
+     }
+
+     dfb_layer_region_enable( region );
+
+     ret = dfb_layer_region_flip_update( region, NULL, DSFLIP_NONE );
+     if (ret) {
+          D_DERROR( ret, "SaWMan/Scanout: Failed to show window on layer!\n" );
+          dfb_layer_region_unref( region );
+          return ret;
+     }
+
+     sawman->scanout.region  = region;
+     sawman->scanout.window  = sawwin;
+     sawman->scanout.tier    = tier;
+     sawman->scanout.surface = surface;
+     sawman->scanout.src     = sawwin->src;
+     sawman->scanout.dst     = sawwin->dst;
+     sawman->scanout.size    = surface->config.size;
+     sawman->scanout.format  = surface->config.format;
+
+     return DFB_OK;
+}
+
+static void
+scanout_demote( SaWMan *sawman )
+{
+     SaWManTier *tier;
+     DFBRegion   area;
+
+     D_MAGIC_ASSERT( sawman, SaWMan );
+     D_ASSERT( sawman->scanout.window != NULL );
+
+     tier = sawman->scanout.tier;
+     D_MAGIC_ASSERT( tier, SaWManTier );
+
+     D_DEBUG_AT( SaWMan_Scanout, "%s( %p )\n", __FUNCTION__, sawman->scanout.window );
+
+     /* Destroying the region releases the window surface. */
+     dfb_layer_region_disable( sawman->scanout.region );
+     dfb_layer_region_unref( sawman->scanout.region );
+
+     /* The tier has not been composed below the window meanwhile. */
+     dfb_region_from_rectangle( &area, &sawman->scanout.dst );
+
+     dfb_updates_add( &tier->left.updates, &area );
+
+     if (tier->region->config.options & DLOP_STEREO)
+          dfb_updates_add( &tier->right.updates, &area );
+
+     sawman->scanout.region  = NULL;
+     sawman->scanout.window  = NULL;
+     sawman->scanout.tier    = NULL;
+     sawman->scanout.surface = NULL;
+}
+
+static void
+scanout_assign( SaWMan *sawman )
+{
+     SaWManTier   *tier = NULL;
+     SaWManWindow *sawwin;
+
+     D_MAGIC_ASSERT( sawman, SaWMan );
+
+     sawwin = scanout_candidate( sawman, &tier );
+
+     if (sawman->scanout.window) {
+          if (sawwin == sawman->scanout.window &&
+              sawwin->window->surface == sawman->scanout.surface &&
+              DFB_RECTANGLE_EQUAL( sawwin->src, sawman->scanout.src ) &&
+              DFB_RECTANGLE_EQUAL( sawwin->dst, sawman->scanout.dst ) &&
+              sawman->scanout.surface->config.size.w == sawman->scanout.size.w &&
+              sawman->scanout.surface->config.size.h == sawman->scanout.size.h &&
+              sawman->scanout.surface->config.format == sawman->scanout.format)
+               return;
+
+          scanout_demote( sawman );
+     }
+
+     if (!sawwin)
+          return;
+
+     /* Don't retry each frame what the layer refused before. */
+     if (sawwin == sawman->scanout.rejected &&
+         DFB_RECTANGLE_EQUAL( sawwin->src, sawman->scanout.rejected_src ) &&
+         DFB_RECTANGLE_EQUAL( sawwin->dst, sawman->scanout.rejected_dst ))
+          return;
+
+     if (scanout_promote( sawman, tier, sawwin )) {
+          sawman->scanout.rejected     = sawwin;
+          sawman->scanout.rejected_src = sawwin->src;
+          sawman->scanout.rejected_dst = sawwin->dst;
+     }
+     else
+          sawman->scanout.rejected = NULL;
+}
+
+/*
+ * Drops updates which lie entirely within the promoted window, returns true if any update touched it.
+ */
+static bool
+scanout_filter_updates( SaWMan     *sawman,
+                        DFBUpdates *updates )
+{
+     int       i;
+     int       num     = 0;
+     bool      touched = false;
+     DFBRegion area;
+     DFBRegion keep[SAWMAN_MAX_UPDATE_REGIONS];
+
+     D_MAGIC_ASSERT( sawman, SaWMan );
+     D_ASSERT( updates->num_regions <= SAWMAN_MAX_UPDATE_REGIONS );
+
+     dfb_region_from_rectangle( &area, &sawman->scanout.dst );
+
+     for (i=0; i<updates->num_regions; i++) {
+          if (dfb_region_region_intersects( &updates->regions[i], &area )) {
+               touched = true;
+
+               if (dfb_region_region_contains( &area, &updates->regions[i] ))
+                    continue;
+          }
+
+          keep[num++] = updates->regions[i];
+     }
+
+     if (num < updates->num_regions) {
+          dfb_updates_reset( updates );
+
+          for (i=0; i<num; i++)
+               dfb_updates_add( updates, &keep[i] );
+     }
+
+     return touched;
+}
+
+bool
+sawman_scanout_release( SaWMan             *sawman,
+                        const SaWManWindow *sawwin,
+                        const DFBRegion    *area )
+{
+     D_MAGIC_ASSERT( sawman, SaWMan );
+     DFB_REGION_ASSERT_IF( area );
+     FUSION_SKIRMISH_ASSERT( sawman->lock );
+
+     if (sawwin && sawwin == sawman->scanout.rejected)
+          sawman->scanout.rejected = NULL;
+
+     if (!sawman->scanout.window)
+          return false;
+
+     if (sawwin && sawwin != sawman->scanout.window)
+          return false;
+
+     if (area && !dfb_rectangle_region_intersects( &sawman->scanout.dst, area ))
+          return false;
+
+     scanout_demote( sawman );
+
+     return true;
+}
+
+/* FIXME: Split up in smaller functions and clean up things like forcing reconfiguration. */
+DirectResult
 sawman_process_updates( SaWMan              *sawman,
                         DFBSurfaceFlipFlags  flags,
                         WMData              *wmdata )
 {
      DirectResult  ret;
      int           idx = -1;
+     long long     next;
      SaWManTier   *tier;
      StackData    *data;
 
@@ -2254,8 +3142,20 @@ sawman_process_updates( SaWMan              *sawman,
      if (!data->active)
           return DFB_OK;
 
+     /* Bring visible regions up to date with windows changed meanwhile. */
+     sawman_update_visible( sawman );
+
+     /* Decide which window, if any, is shown without composition. */
+     if (sawman->scanout.context)
+          scanout_assign( sawman );
+
      fusion_skirmish_prevail( &wmdata->update_skirmish );
 
+     /* Take snapshots of flipped windows, repeat when the rate limit allows for the next ones. */
+     next = sawman_process_snapshots( sawman, &wmdata->state );
+     if (next && wmdata->scheduler)
+          sawman_scheduler_wakeup( wmdata->scheduler, next * 1000 );
+
      direct_list_foreach (tier, sawman->tiers) {
           bool          none = false;
           bool          border_only;
@@ -2275,6 +3175,32 @@ sawman_process_updates( SaWMan              *sawman,
                tier->update_once = false;
           }
 
+          /* Batch updates arriving within the current frame, the scheduler repaints them at the next one. */
+          if (sawman_config->frame_rate && wmdata->scheduler) {
+               long long now = direct_clock_get_micros();
+
+               if (now < tier->schedule.next) {
+                    D_DEBUG_AT( SaWMan_Schedule, "  -> deferring tier %d by %lld us\n", idx, tier->schedule.next - now );
+
+                    if (!tier->schedule.pending)
+                         tier->schedule.pending = now;
+
+                    sawman_scheduler_wakeup( wmdata->scheduler, tier->schedule.next );
+                    continue;
+               }
+          }
+
+          if (sawman->scanout.tier == tier) {
+               bool left  = scanout_filter_updates( sawman, &tier->left.updates );
+               bool right = scanout_filter_updates( sawman, &tier->right.updates );
+
+               if (left || right)
+                    dfb_layer_region_flip_update( sawman->scanout.region, NULL, DSFLIP_UPDATE );
+
+               if (!tier->left.updates.num_regions && !tier->right.updates.num_regions)
+                    continue;
+          }
+
           D_DEBUG_AT( SaWMan_Update, "  -> %d left_updates, %d right_updates (tier %d, layer %d)\n",
                       tier->left.updates.num_regions, tier->right.updates.num_regions,
                       idx, tier->layer_id );
@@ -2380,3 +3306,170 @@ sawman_process_updates( SaWMan              *sawman,
      return DFB_OK;
 }
 
+/**********************************************************************************************************************/
+
+DirectResult
+sawman_composer_init( WMData *wmdata )
+{
+     int             i;
+     SaWManComposer *composer;
+
+     D_DEBUG_AT( SaWMan_Update, "%s( %p ) <- %d threads\n", __FUNCTION__, wmdata, sawman_config->update_threads );
+
+     D_ASSERT( wmdata != NULL );
+     D_ASSERT( wmdata->composer == NULL );
+
+     if (sawman_config->update_threads < 1)
+          return DFB_OK;
+
+     composer = D_CALLOC( 1, sizeof(SaWManComposer) );
+     if (!composer)
+          return D_OOM();
+
+     composer->core = wmdata->core;
+
+     direct_mutex_init( &composer->lock );
+     direct_waitqueue_init( &composer->wq );
+
+     D_MAGIC_SET( composer, SaWManComposer );
+
+     for (i=0; i<sawman_config->update_threads; i++) {
+          composer->threads[i] = direct_thread_create( DTT_DEFAULT, composer_loop, composer, "SaWMan Composer" );
+          if (!composer->threads[i])
+               break;
+
+          composer->num_threads++;
+     }
+
+     if (!composer->num_threads) {
+          D_ERROR( "SaWMan/Composer: Could not create any thread, composing sequentially!\n" );
+
+          D_MAGIC_CLEAR( composer );
+
+          direct_waitqueue_deinit( &composer->wq );
+          direct_mutex_deinit( &composer->lock );
+
+          D_FREE( composer );
+
+          return DFB_OK;
+     }
+
+     wmdata->composer = composer;
+
+     return DFB_OK;
+}
+
+void
+sawman_composer_deinit( WMData *wmdata )
+{
+     int             i;
+     SaWManComposer *composer;
+
+     D_DEBUG_AT( SaWMan_Update, "%s( %p )\n", __FUNCTION__, wmdata );
+
+     D_ASSERT( wmdata != NULL );
+
+     composer = wmdata->composer;
+     if (!composer)
+          return;
+
+     D_MAGIC_ASSERT( composer, SaWManComposer );
+
+     direct_mutex_lock( &composer->lock );
+
+     composer->quit = true;
+
+     direct_waitqueue_broadcast( &composer->wq );
+
+     direct_mutex_unlock( &composer->lock );
+
+     for (i=0; i<composer->num_threads; i++) {
+          direct_thread_join( composer->threads[i] );
+          direct_thread_destroy( composer->threads[i] );
+     }
+
+     D_MAGIC_CLEAR( composer );
+
+     direct_waitqueue_deinit( &composer->wq );
+     direct_mutex_deinit( &composer->lock );
+
+     D_FREE( composer );
+
+     wmdata->composer = NULL;
+}
+
+DirectResult
+sawman_scheduler_init( WMData *wmdata )
+{
+     SaWManScheduler *scheduler;
+
+     D_DEBUG_AT( SaWMan_Schedule, "%s( %p ) <- %u Hz\n", __FUNCTION__, wmdata, sawman_config->frame_rate );
+
+     D_ASSERT( wmdata != NULL );
+     D_ASSERT( wmdata->scheduler == NULL );
+
+     scheduler = D_CALLOC( 1, sizeof(SaWManScheduler) );
+     if (!scheduler)
+          return D_OOM();
+
+     scheduler->wmdata = wmdata;
+
+     direct_mutex_init( &scheduler->lock );
+     direct_waitqueue_init( &scheduler->wq );
+
+     D_MAGIC_SET( scheduler, SaWManScheduler );
+
+     scheduler->thread = direct_thread_create( DTT_DEFAULT, scheduler_loop, scheduler, "SaWMan Scheduler" );
+     if (!scheduler->thread) {
+          D_ERROR( "SaWMan/Scheduler: Could not create thread, repainting immediately!\n" );
+
+          D_MAGIC_CLEAR( scheduler );
+
+          direct_waitqueue_deinit( &scheduler->wq );
+          direct_mutex_deinit( &scheduler->lock );
+
+          D_FREE( scheduler );
+
+          return DFB_OK;
+     }
+
+     wmdata->scheduler = scheduler;
+
+     return DFB_OK;
+}
+
+void
+sawman_scheduler_deinit( WMData *wmdata )
+{
+     SaWManScheduler *scheduler;
+
+     D_DEBUG_AT( SaWMan_Schedule, "%s( %p )\n", __FUNCTION__, wmdata );
+
+     D_ASSERT( wmdata != NULL );
+
+     scheduler = wmdata->scheduler;
+     if (!scheduler)
+          return;
+
+     D_MAGIC_ASSERT( scheduler, SaWManScheduler );
+
+     direct_mutex_lock( &scheduler->lock );
+
+     scheduler->quit = true;
+
+     direct_waitqueue_broadcast( &scheduler->wq );
+
+     direct_mutex_unlock( &scheduler->lock );
+
+     direct_thread_join( scheduler->thread );
+     direct_thread_destroy( scheduler->thread );
+
+     D_MAGIC_CLEAR( scheduler );
+
+     direct_waitqueue_deinit( &scheduler->wq );
+     direct_mutex_deinit( &scheduler->lock );
+
+     D_FREE( scheduler );
+
+     wmdata->scheduler = NULL;
+}
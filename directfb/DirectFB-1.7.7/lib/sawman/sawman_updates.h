@@ -49,6 +49,29 @@ void         sawman_flush_updating ( SaWMan                *sawman,
                                      SaWManTier            *tier,
                                      WMData                *wmdata );
 
+/*
+ * Hand the window shown on the scanout layer back to composition, if it is 'sawwin' (any if NULL)
+ * and intersects 'area' (anywhere if NULL). Returns true if it has been released.
+ */
+bool         sawman_scanout_release( SaWMan                *sawman,
+                                     const SaWManWindow    *sawwin,
+                                     const DFBRegion       *area );
+
+/*
+ * Start/stop the threads composing disjoint parts of tier updates in parallel (see 'update-threads' option).
+ */
+DirectResult sawman_composer_init  ( WMData                *wmdata );
+
+void         sawman_composer_deinit( WMData                *wmdata );
+
+/*
+ * Start/stop the thread repainting tier updates deferred to the next frame (see 'frame-rate' option)
+ * and taking window snapshots delayed by their rate limit.
+ */
+DirectResult sawman_scheduler_init ( WMData                *wmdata );
+
+void         sawman_scheduler_deinit( WMData                *wmdata );
+
 
 #ifdef __cplusplus
 }
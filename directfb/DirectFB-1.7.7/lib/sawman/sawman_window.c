@@ -60,6 +60,7 @@
 
 #include "sawman_config.h"
 #include "sawman_draw.h"
+#include "sawman_updates.h"
 #include "sawman_window.h"
 
 #include "isawman.h"
@@ -88,13 +89,24 @@ static void wind_of_showing( SaWMan              *sawman,
                              int                  changed,
                              bool                *ret_showing );
 
-static void update_visible ( SaWMan              *sawman,
-                             int                  start,
-                             int                  x1,
-                             int                  y1,
-                             int                  x2,
-                             int                  y2,
-                             bool                 right_eye );
+static void window_shape     ( SaWManWindow            *sawwin,
+                              SaWManWindowShape       *ret_shape );
+
+static void invalidate_shape ( SaWMan                  *sawman,
+                              const SaWManWindowShape *shape );
+
+static void update_visible   ( SaWMan                  *sawman,
+                              bool                     right_eye );
+
+#define HIT_GRID_COL(sawman,x)  CLAMP( (long long) (x) * SAWMAN_HIT_GRID_COLS / MAX( (sawman)->hit.size.w, 1 ), 0, SAWMAN_HIT_GRID_COLS - 1 )
+#define HIT_GRID_ROW(sawman,y)  CLAMP( (long long) (y) * SAWMAN_HIT_GRID_ROWS / MAX( (sawman)->hit.size.h, 1 ), 0, SAWMAN_HIT_GRID_ROWS - 1 )
+
+static bool window_hit       ( SaWMan                  *sawman,
+                              SaWManWindow            *sawwin,
+                              int                      x,
+                              int                      y );
+
+static void update_hit_grid  ( SaWMan                  *sawman );
 
 /**********************************************************************************************************************/
 
@@ -573,8 +585,12 @@ sawman_insert_window( SaWMan       *sawman,
                index--;
 
           if (old != index) {
+               invalidate_shape( sawman, &sawwin->shape );
+
                fusion_vector_move( &sawman->layout, old, index );
 
+               sawman->hit.valid = false;
+
                dfb_wm_dispatch_WindowRestack( layer->core, window, index );
           }
      }
@@ -583,6 +599,8 @@ sawman_insert_window( SaWMan       *sawman,
           if (ret)
                return ret;
 
+          sawman->hit.valid = false;
+
           dfb_wm_dispatch_WindowRestack( layer->core, window, index );
 
           /* Set 'inserted' flag. */
@@ -630,6 +648,19 @@ sawman_remove_window( SaWMan       *sawman,
 
      fusion_vector_remove( &sawman->layout, index );
 
+     sawman->hit.valid = false;
+
+     /* Uncover windows below. */
+     invalidate_shape( sawman, &sawwin->shape );
+
+     sawwin->shape.valid = false;
+
+     misc_region_reset( &sawwin->left.visible_region, NULL );
+     misc_region_reset( &sawwin->right.visible_region, NULL );
+
+     dfb_updates_reset( &sawwin->left.visible );
+     dfb_updates_reset( &sawwin->right.visible );
+
      /* Release all explicit key grabs. */
      direct_list_foreach_safe (key, next, sawman->grabbed_keys) {
           if (key->owner == sawwin) {
@@ -700,6 +731,12 @@ sawman_withdraw_window( SaWMan       *sawman,
      }
 #endif
 
+     /* Give up direct scanout of the window. */
+     sawman_scanout_release( sawman, sawwin, NULL );
+
+     /* Free the pre-scaled copy, it is rebuilt after the window settles again. */
+     sawman_release_scaled( sawman, sawwin );
+
      /* Release explicit keyboard grab. */
      if (sawman->keyboard_window == sawwin)
           sawman->keyboard_window = NULL;
@@ -923,6 +960,9 @@ sawman_update_geometry( SaWManWindow *sawwin )
      /* adjust border. */
      sawman_adjust_window_bounds( sawwin, &sawwin->bounds );   
 
+     if (sawman)
+          sawman->hit.valid = false;
+
      /* Calculate source geometry. */
      clip.x1 = 0;
      clip.y1 = 0;
@@ -1408,6 +1448,8 @@ sawman_restack_window( SaWMan                 *sawman,
           /* Actually change the stacking order now. */
           fusion_vector_move( &sawman->layout, old, index );
 
+          sawman->hit.valid = false;
+
           D_DEBUG_AT( SaWMan_Stacking, "  -> now index %d\n", fusion_vector_index_of( &sawman->layout, sawwin ) );
 
           dfb_wm_dispatch_WindowRestack( layer->core, window, index );
@@ -1980,9 +2022,10 @@ sawman_window_at_pointer( SaWMan          *sawman,
                           int              x,
                           int              y )
 {
-     int           i;
-     SaWManWindow *sawwin;
-     CoreWindow   *window;
+     int            i;
+     SaWManWindow  *sawwin;
+     CoreWindow    *window;
+     SaWManHitCell *cell;
 
      D_MAGIC_ASSERT( sawman, SaWMan );
      D_ASSERT( stack != NULL );
@@ -2006,26 +2049,25 @@ sawman_window_at_pointer( SaWMan          *sawman,
      if (y < 0)
           y = stack->cursor.y;
 
-     fusion_vector_foreach_reverse (sawwin, i, sawman->layout) {
-          SaWManTier *tier;
-          int         tx, ty;
+     if (!sawman->hit.valid || sawman->hit.size.w != sawman->resolution.w || sawman->hit.size.h != sawman->resolution.h)
+          update_hit_grid( sawman );
 
-          D_MAGIC_ASSERT( sawwin, SaWManWindow );
-          window = sawwin->window;
-          D_ASSERT( window != NULL );
+     cell = &sawman->hit.cells[HIT_GRID_ROW( sawman, y )][HIT_GRID_COL( sawman, x )];
 
-          /* Retrieve corresponding SaWManTier. */
-          tier = sawman_tier_by_class( sawman, sawwin->window->config.stacking );
-          D_MAGIC_ASSERT( tier, SaWManTier );
+     if (cell->num <= SAWMAN_HIT_CELL_WINDOWS && sawman->layout.count <= 0x10000) {
+          for (i=cell->num-1; i>=0; i--) {
+               sawwin = fusion_vector_at( &sawman->layout, cell->windows[i] );
 
-          /* Convert to Tier coordinates */
-          tx = (s64) x * (s64) tier->size.w / (s64) sawman->resolution.w;
-          ty = (s64) y * (s64) tier->size.h / (s64) sawman->resolution.h;
+               if (window_hit( sawman, sawwin, x, y ))
+                    return sawwin;
+          }
 
-          if (!(window->config.options & DWOP_GHOST) && 
-              !window->config.hide && window->config.opacity &&
-              tx >= sawwin->bounds.x  &&  tx < sawwin->bounds.x + sawwin->bounds.w &&
-              ty >= sawwin->bounds.y  &&  ty < sawwin->bounds.y + sawwin->bounds.h)
+          return NULL;
+     }
+
+     /* Too many windows overlapping the cell. */
+     fusion_vector_foreach_reverse (sawwin, i, sawman->layout) {
+          if (window_hit( sawman, sawwin, x, y ))
                return sawwin;
      }
 
@@ -2145,27 +2187,42 @@ sawman_window_border( const SaWManWindow *sawwin )
 void
 sawman_update_visible( SaWMan *sawman )
 {
-     int         i;
-     SaWManTier *tier;
+     int           i;
+     SaWManWindow *sawwin;
 
      D_DEBUG_AT( SaWMan_Update, "%s()\n", __FUNCTION__ );
 
-     dfb_updates_reset( &sawman->bg.visible );
+     D_MAGIC_ASSERT( sawman, SaWMan );
+     FUSION_SKIRMISH_ASSERT( sawman->lock );
+
+     /* Collect the areas of windows that changed since the last calculation. */
+     fusion_vector_foreach (sawwin, i, sawman->layout) {
+          SaWManWindowShape shape;
 
-     for (i=0; i<sawman->layout.count; i++) {
-          SaWManWindow *window = sawman->layout.elements[i];
+          D_MAGIC_ASSERT( sawwin, SaWManWindow );
 
-          D_MAGIC_ASSERT( window, SaWManWindow );
+          window_shape( sawwin, &shape );
+
+          if (!memcmp( &shape, &sawwin->shape, sizeof(shape) ))
+               continue;
+
+          D_DEBUG_AT( SaWMan_Update, "  -> [%2d] window %p changed\n", i, sawwin );
 
-          dfb_updates_reset( &window->left.visible );
-          dfb_updates_reset( &window->right.visible );
+          invalidate_shape( sawman, &sawwin->shape );
+          invalidate_shape( sawman, &shape );
+
+          sawwin->shape = shape;
      }
 
-     tier = (SaWManTier*) sawman->tiers;     // FIXME: using lowest tier for max resolution
-     D_MAGIC_ASSERT( tier, SaWManTier );
+     if (misc_region_is_empty( &sawman->visible_dirty ))
+          return;
+
+     MISC_REGION_DEBUG_AT( SaWMan_Update, &sawman->visible_dirty, "dirty" );
+
+     update_visible( sawman, false );
+     update_visible( sawman, true );
 
-     update_visible( sawman, sawman->layout.count - 1, 0, 0, tier->size.w, tier->size.h, false );
-     update_visible( sawman, sawman->layout.count - 1, 0, 0, tier->size.w, tier->size.h, true );
+     misc_region_reset( &sawman->visible_dirty, NULL );
 
 #if D_DEBUG_ENABLED
      for (i=0; i<sawman->layout.count; i++) {
@@ -2394,88 +2451,245 @@ wind_of_showing( SaWMan     *sawman,
      *ret_showing = true;
 }
 
+static void
+window_shape( SaWManWindow      *sawwin,
+              SaWManWindowShape *ret_shape )
+{
+     CoreWindow *window;
+
+     D_MAGIC_ASSERT( sawwin, SaWManWindow );
+     D_ASSERT( ret_shape != NULL );
+
+     window = sawwin->window;
+     D_MAGIC_COREWINDOW_ASSERT( window );
+
+     /* Zero padding as well, shapes are compared via memcmp(). */
+     memset( ret_shape, 0, sizeof(SaWManWindowShape) );
+
+     ret_shape->valid    = true;
+     ret_shape->visible  = SAWMAN_VISIBLE_WINDOW( window ) && sawwin->bounds.w > 0 && sawwin->bounds.h > 0;
+     ret_shape->stacking = window->config.stacking;
+     ret_shape->z        = window->config.z;
+     ret_shape->bounds   = sawwin->bounds;
+
+     if (!ret_shape->visible)
+          return;
+
+     if (!SAWMAN_TRANSLUCENT_WINDOW( window )) {
+          ret_shape->cover    = DFB_REGION_INIT_FROM_RECTANGLE( &sawwin->dst );
+          ret_shape->covering = true;
+     }
+     else if (D_FLAGS_ARE_SET( window->config.options, DWOP_ALPHACHANNEL | DWOP_OPAQUE_REGION ) &&
+              !(window->config.options & (DWOP_INPUTONLY | DWOP_COLORKEYING)) &&
+              window->config.opacity == 0xff && window->config.dst_geometry.mode == DWGM_DEFAULT)
+     {
+          ret_shape->cover    = DFB_REGION_INIT_TRANSLATED( &window->config.opaque, sawwin->bounds.x, sawwin->bounds.y );
+          ret_shape->covering = dfb_region_intersect( &ret_shape->cover, DFB_REGION_VALS_FROM_RECTANGLE( &sawwin->bounds ) );
+     }
+}
+
+static void
+invalidate_shape( SaWMan                  *sawman,
+                  const SaWManWindowShape *shape )
+{
+     misc_region_t area;
+
+     D_MAGIC_ASSERT( sawman, SaWMan );
+     D_ASSERT( shape != NULL );
+
+     if (!shape->valid || !shape->visible)
+          return;
+
+     /* both eyes, z is 0 for mono windows */
+     misc_region_init_rect( &area, NULL, shape->bounds.x + shape->z, shape->bounds.y, shape->bounds.w, shape->bounds.h );
+
+     misc_region_union( &sawman->visible_dirty, &sawman->visible_dirty, &area );
+
+     if (shape->z) {
+          misc_region_deinit( &area );
+
+          misc_region_init_rect( &area, NULL, shape->bounds.x - shape->z, shape->bounds.y, shape->bounds.w, shape->bounds.h );
+
+          misc_region_union( &sawman->visible_dirty, &sawman->visible_dirty, &area );
+     }
+
+     misc_region_deinit( &area );
+}
+
+/*
+     Recalculates the visible regions within the dirty area only, going from top to bottom per tier.
+     Outside of the dirty area the visible regions of all windows are still valid.
+*/
 static void
 update_visible( SaWMan *sawman,
-                int     start,
-                int     x1,
-                int     y1,
-                int     x2,
-                int     y2,
                 bool    right_eye )
 {
-     int           i      = start;
-     DFBRegion     region = { x1, y1, x2, y2 };
-     CoreWindow   *window = NULL;
-     SaWManWindow *sawwin = NULL;
-     int           stereo_offset = 0;
+     int           i;
+     SaWManTier   *tier;
+     misc_box_t   *dirty;
 
-     D_DEBUG_AT( SaWMan_Update, "%s( %d, %d,%d - %d,%d )\n", __FUNCTION__, start, x1, y1, x2, y2 );
+     D_DEBUG_AT( SaWMan_Update, "%s( %s )\n", __FUNCTION__, right_eye ? "right" : "left" );
 
      D_MAGIC_ASSERT( sawman, SaWMan );
-     D_ASSERT( start < fusion_vector_size( &sawman->layout ) );
-     D_ASSUME( x1 <= x2 );
-     D_ASSUME( y1 <= y2 );
 
-     if (x1 > x2 || y1 > y2)
-          return;
+     dirty = misc_region_extents( &sawman->visible_dirty );
 
-     /* Find next intersecting window. */
-     while (i >= 0) {
-          sawwin = fusion_vector_at( &sawman->layout, i );
-          D_MAGIC_ASSERT( sawwin, SaWManWindow );
+     direct_list_foreach (tier, sawman->tiers) {
+          misc_region_t area;
+          misc_region_t covered;
+          misc_box_t    extents = { 0, 0, tier->size.w, tier->size.h };
 
-          window = sawwin->window;
-          D_MAGIC_COREWINDOW_ASSERT( window );
+          D_MAGIC_ASSERT( tier, SaWManTier );
 
-          stereo_offset = right_eye ? -window->config.z : window->config.z;
+          /* area = dirty & tier */
+          misc_region_init_with_extents( &area, NULL, &extents );
+          misc_region_intersect( &area, &area, &sawman->visible_dirty );
 
-          if (SAWMAN_VISIBLE_WINDOW( window )) {
-               if (dfb_region_intersect( &region,
-                                         sawwin->bounds.x + stereo_offset, sawwin->bounds.y,
-                                         sawwin->bounds.x + stereo_offset + sawwin->bounds.w - 1,
-                                         sawwin->bounds.y + sawwin->bounds.h - 1))
-                    break;
+          /* covered by windows above (within area) */
+          misc_region_init( &covered, NULL );
+
+          for (i=sawman->layout.count-1; i>=0; i--) {
+               SaWManWindow      *sawwin = sawman->layout.elements[i];
+               SaWManWindowShape *shape  = &sawwin->shape;
+               SaWManWindowLR    *lr     = right_eye ? &sawwin->right : &sawwin->left;
+               int                offset = right_eye ? -shape->z : shape->z;
+               misc_region_t      part;
+               misc_box_t        *boxes;
+               int                n, num;
+
+               D_MAGIC_ASSERT( sawwin, SaWManWindow );
+               D_ASSERT( shape->valid );
+
+               if (!(tier->classes & (1 << shape->stacking)))
+                    continue;
+
+               if (!shape->visible) {
+                    if (misc_region_not_empty( &lr->visible_region )) {
+                         misc_region_reset( &lr->visible_region, NULL );
+                         dfb_updates_reset( &lr->visible );
+                    }
+                    continue;
+               }
+
+               /* Untouched windows keep their visible region, their cover is outside of the area as well. */
+               if (shape->bounds.x + offset >= dirty->x2 || shape->bounds.x + offset + shape->bounds.w <= dirty->x1 ||
+                   shape->bounds.y >= dirty->y2 || shape->bounds.y + shape->bounds.h <= dirty->y1)
+                    continue;
+
+               /* visible -= dirty */
+               misc_region_subtract( &lr->visible_region, &lr->visible_region, &sawman->visible_dirty );
+
+               /* visible += (bounds & area) - covered */
+               misc_region_init_rect( &part, NULL, shape->bounds.x + offset, shape->bounds.y, shape->bounds.w, shape->bounds.h );
+               misc_region_intersect( &part, &part, &area );
+               misc_region_subtract( &part, &part, &covered );
+               misc_region_union( &lr->visible_region, &lr->visible_region, &part );
+               misc_region_deinit( &part );
+
+               /* covered += cover */
+               if (shape->covering) {
+                    misc_region_init_rect( &part, NULL, shape->cover.x1 + offset, shape->cover.y1,
+                                           shape->cover.x2 - shape->cover.x1 + 1, shape->cover.y2 - shape->cover.y1 + 1 );
+                    misc_region_union( &covered, &covered, &part );
+                    misc_region_deinit( &part );
+               }
+
+               /* Keep the (bounded) update list in sync for users of the old representation. */
+               dfb_updates_reset( &lr->visible );
+
+               boxes = misc_region_boxes( &lr->visible_region, &num );
+
+               for (n=0; n<num; n++) {
+                    DFBRegion region = { boxes[n].x1, boxes[n].y1, boxes[n].x2 - 1, boxes[n].y2 - 1 };
+
+                    dfb_updates_add( &lr->visible, &region );
+               }
           }
 
-          i--;
+          misc_region_deinit( &covered );
+          misc_region_deinit( &area );
      }
+}
+
+/**********************************************************************************************************************/
+
+static bool
+window_hit( SaWMan       *sawman,
+            SaWManWindow *sawwin,
+            int           x,
+            int           y )
+{
+     SaWManTier *tier;
+     CoreWindow *window;
+     int         tx, ty;
+
+     D_MAGIC_ASSERT( sawwin, SaWManWindow );
+     window = sawwin->window;
+     D_ASSERT( window != NULL );
+
+     /* Retrieve corresponding SaWManTier. */
+     tier = sawman_tier_by_class( sawman, sawwin->window->config.stacking );
+     D_MAGIC_ASSERT( tier, SaWManTier );
+
+     /* Convert to Tier coordinates */
+     tx = (s64) x * (s64) tier->size.w / (s64) sawman->resolution.w;
+     ty = (s64) y * (s64) tier->size.h / (s64) sawman->resolution.h;
+
+     return !(window->config.options & DWOP_GHOST) && 
+            !window->config.hide && window->config.opacity &&
+            tx >= sawwin->bounds.x  &&  tx < sawwin->bounds.x + sawwin->bounds.w &&
+            ty >= sawwin->bounds.y  &&  ty < sawwin->bounds.y + sawwin->bounds.h;
+}
+
+/*
+ * Spreads the windows over a coarse grid in SaWMan resolution, each cell listing the windows
+ * possibly overlapping it from bottom to top. Bounds are mapped from tier coordinates generously,
+ * window_hit() does the exact test.
+ */
+static void
+update_hit_grid( SaWMan *sawman )
+{
+     int           i;
+     int           cx, cy;
+     SaWManWindow *sawwin;
+
+     D_MAGIC_ASSERT( sawman, SaWMan );
+
+     memset( sawman->hit.cells, 0, sizeof(sawman->hit.cells) );
+
+     sawman->hit.size  = sawman->resolution;
+     sawman->hit.valid = true;
+
+     fusion_vector_foreach (sawwin, i, sawman->layout) {
+          SaWManTier *tier;
+          int         col1, col2, row1, row2;
 
-     /* Intersecting window found? */
-     if (i >= 0) {
           D_MAGIC_ASSERT( sawwin, SaWManWindow );
-          D_MAGIC_COREWINDOW_ASSERT( window );
 
-          if (SAWMAN_TRANSLUCENT_WINDOW( window )) {
-               /* draw everything below */
-               update_visible( sawman, i-1, x1, y1, x2, y2, right_eye );
-          }
-          else {
-               DFBRegion dst = DFB_REGION_INIT_FROM_RECTANGLE( &sawwin->dst );
+          if (sawwin->bounds.w < 1 || sawwin->bounds.h < 1)
+               continue;
 
-               dfb_region_translate( &dst, stereo_offset, 0 );
+          tier = sawman_tier_by_class( sawman, sawwin->window->config.stacking );
+          D_MAGIC_ASSERT( tier, SaWManTier );
 
-               dfb_region_region_intersect( &dst, &region );
+          if (tier->size.w < 1 || tier->size.h < 1)
+               continue;
 
-               /* left */
-               if (dst.x1 != x1)
-                    update_visible( sawman, i-1, x1, dst.y1, dst.x1-1, dst.y2, right_eye );
+          col1 = HIT_GRID_COL( sawman, (s64) sawwin->bounds.x * sawman->resolution.w / tier->size.w );
+          col2 = HIT_GRID_COL( sawman, (s64) (sawwin->bounds.x + sawwin->bounds.w) * sawman->resolution.w / tier->size.w );
+          row1 = HIT_GRID_ROW( sawman, (s64) sawwin->bounds.y * sawman->resolution.h / tier->size.h );
+          row2 = HIT_GRID_ROW( sawman, (s64) (sawwin->bounds.y + sawwin->bounds.h) * sawman->resolution.h / tier->size.h );
 
-               /* upper */
-               if (dst.y1 != y1)
-                    update_visible( sawman, i-1, x1, y1, x2, dst.y1-1, right_eye );
+          for (cy=row1; cy<=row2; cy++) {
+               for (cx=col1; cx<=col2; cx++) {
+                    SaWManHitCell *cell = &sawman->hit.cells[cy][cx];
 
-               /* right */
-               if (dst.x2 != x2)
-                    update_visible( sawman, i-1, dst.x2+1, dst.y1, x2, dst.y2, right_eye );
+                    if (cell->num < SAWMAN_HIT_CELL_WINDOWS && i < 0x10000)
+                         cell->windows[cell->num] = i;
 
-               /* lower */
-               if (dst.y2 != y2)
-                    update_visible( sawman, i-1, x1, dst.y2+1, x2, y2, right_eye );
+                    if (cell->num <= SAWMAN_HIT_CELL_WINDOWS)
+                         cell->num++;
+               }
           }
-
-          dfb_updates_add( right_eye ? &sawwin->right.visible : &sawwin->left.visible, &region );
      }
-     else
-          dfb_updates_add( &sawman->bg.visible, &region );
 }
-
@@ -221,6 +221,90 @@ manage_interlocks( CoreSurfaceAllocation  *allocation,
      allocation->accessed[accessor] = (CoreSurfaceAccessFlags)(allocation->accessed[accessor] | access);
 }
 
+/*
+ * Reader-shared path of PreLockBuffer for reading the front buffer.
+ *
+ * If there's an up to date allocation that can be read without any interlocking or pool preparation,
+ * nothing in the surface needs to be modified. The allocation is picked holding the shared read lock then,
+ * not contending with the client drawing into its back buffer. Returns DFB_BUSY if the regular path is needed.
+ *
+ * Without a flip count the current front buffer is used.
+ */
+static DFBResult
+prelock_front_shared( CoreSurface             *surface,
+                      CoreSurfaceBufferRole    role,
+                      const u32               *flip_count,
+                      DFBSurfaceStereoEye      eye,
+                      CoreSurfaceAccessorID    accessor,
+                      CoreSurfaceAccessFlags   access,
+                      DFBBoolean               lock,
+                      CoreSurfaceAllocation  **ret_allocation )
+{
+     int                    i;
+     int                    index;
+     CoreSurfaceBuffer     *buffer;
+     CoreSurfaceAllocation *allocation;
+     DFBResult              ret = DFB_BUSY;
+
+     if (role != CSBR_FRONT || access != CSAF_READ || accessor >= _CSAID_NUM || dfb_config->task_manager)
+          return DFB_BUSY;
+
+     if (!dfb_surface_read_lock( surface ))
+          return DFB_BUSY;
+
+     if ((surface->state & CSSF_DESTROYED) || surface->num_buffers < 1)
+          goto out;
+
+     index  = surface->buffer_indices[((flip_count ? *flip_count : surface->flips) + role) % surface->num_buffers];
+     buffer = (eye == DSSE_RIGHT) ? surface->right_buffers[index] : surface->left_buffers[index];
+
+     D_MAGIC_ASSERT( buffer, CoreSurfaceBuffer );
+
+     fusion_vector_foreach (allocation, i, buffer->allocs) {
+          D_MAGIC_ASSERT( allocation, CoreSurfaceAllocation );
+
+          if (allocation->flags & CSALF_PREALLOCATED)
+               continue;
+
+          if (!(allocation->access[accessor] & CSAF_READ))
+               continue;
+
+          if (!direct_serial_check( &allocation->serial, &buffer->serial ))
+               continue;
+
+          if (lock || !(allocation->pool->desc.caps & CSPCAPS_READ)) {
+               /* Locking must not need any pool preparation... */
+               if (dfb_surface_pool_has_prelock( allocation->pool ))
+                    continue;
+
+               /* ...nor would manage_interlocks() have anything to do. */
+               if (accessor != CSAID_GPU) {
+                    if (allocation->accessed[CSAID_GPU] & CSAF_WRITE)
+                         continue;
+               }
+               else if (allocation->accessed[CSAID_CPU] & (CSAF_READ | CSAF_WRITE))
+                    continue;
+
+               if (!D_FLAGS_ARE_SET( allocation->accessed[accessor], access ))
+                    continue;
+          }
+
+          D_DEBUG_AT( DirectFB_CoreSurface, "  -> shared read of allocation %p (%s)\n", allocation, allocation->pool->desc.name );
+
+          dfb_surface_allocation_ref( allocation );
+
+          *ret_allocation = allocation;
+
+          ret = DFB_OK;
+          break;
+     }
+
+out:
+     dfb_surface_read_unlock( surface );
+
+     return ret;
+}
+
 class LockTask : public SurfaceTask
 {
 public:
@@ -407,6 +491,9 @@ ISurface_Real::PreLockBuffer2(
 
      D_ASSERT( !dfb_config->task_manager || accessor == CSAID_CPU );
 
+     if (prelock_front_shared( surface, role, NULL, eye, accessor, access, lock, ret_allocation ) == DFB_OK)
+          return DFB_OK;
+
      ret = (DFBResult) dfb_surface_lock( surface );
      if (ret)
           return ret;
@@ -710,6 +797,9 @@ ISurface_Real::PreLockBuffer3(
 
      D_ASSERT( !dfb_config->task_manager );
 
+     if (prelock_front_shared( surface, role, &flip_count, eye, accessor, access, lock, ret_allocation ) == DFB_OK)
+          return DFB_OK;
+
      ret = (DFBResult) dfb_surface_lock( surface );
      if (ret)
           return ret;
@@ -296,7 +296,7 @@ DisplayTask::Flush()
      D_DEBUG_AT( DirectFB_Task_Display_List, "  -> adding to list %p\n", region->display_tasks );
      region->display_tasks->Append( this );
 
-     if (pts > 0 && !(dfb_system_caps() & CSCAPS_DISPLAY_PTS)) {
+     if (pts > 0 && !(dfb_layer_system_caps( layer ) & CSCAPS_DISPLAY_PTS)) {
           D_DEBUG_AT( DirectFB_Task_Display, "  -> system WITHOUT display task PTS support, setting emit time stamp to %lld us\n", pts );
 
           ts_emit = pts;
@@ -447,7 +447,7 @@ DisplayTask::Run()
                                                   left_update, &left,
                                                   stereo ? right_update : NULL, stereo ? &right : NULL );
 
-                    if (!(dfb_system_caps() & CSCAPS_NOTIFY_DISPLAY)) {
+                    if (!(dfb_layer_system_caps( layer ) & CSCAPS_NOTIFY_DISPLAY)) {
                          D_DEBUG_AT( DirectFB_Task_Display, "  -> system WITHOUT notify_display support, calling it now\n" );
 
                          dfb_surface_notify_display2( surface, left.allocation->index, this );
@@ -489,7 +489,7 @@ DisplayTask::Run()
                                                &left_rotated, &left,
                                                stereo ? &right_rotated : NULL, stereo ? &right : NULL );
 
-                    if (!(dfb_system_caps() & CSCAPS_NOTIFY_DISPLAY)) {
+                    if (!(dfb_layer_system_caps( layer ) & CSCAPS_NOTIFY_DISPLAY)) {
                          D_DEBUG_AT( DirectFB_Task_Display, "  -> system WITHOUT notify_display support, calling it now\n" );
 
                          dfb_surface_notify_display2( surface, left.allocation->index, this );
@@ -530,7 +530,7 @@ out:
           return ret;
      }
 
-     if (!(dfb_system_caps() & CSCAPS_DISPLAY_TASKS)) {
+     if (!(dfb_layer_system_caps( layer ) & CSCAPS_DISPLAY_TASKS)) {
           D_DEBUG_AT( DirectFB_Task_Display, "  -> system WITHOUT display task support, calling Task_Done on previous task\n" );
 
           if (layer->prev_task)
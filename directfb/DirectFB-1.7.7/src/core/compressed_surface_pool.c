@@ -0,0 +1,757 @@
+/*
+   (c) Copyright 2012-2013  DirectFB integrated media GmbH
+   (c) Copyright 2001-2013  The world wide DirectFB Open Source Community (directfb.org)
+   (c) Copyright 2000-2004  Convergence (integrated media) GmbH
+
+   All rights reserved.
+
+   Written by Denis Oliver Kropp <dok@directfb.org>,
+              Andreas Shimokawa <andi@directfb.org>,
+              Marek Pikarski <mass@directfb.org>,
+              Sven Neumann <neo@directfb.org>,
+              Ville Syrjälä <syrjala@sci.fi> and
+              Claudio Ciccani <klan@users.sf.net>.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+
+
+#include <config.h>
+
+#include <direct/clock.h>
+#include <direct/debug.h>
+#include <direct/fastlz.h>
+#include <direct/list.h>
+#include <direct/mem.h>
+#include <direct/memcpy.h>
+#include <direct/thread.h>
+#include <direct/util.h>
+
+#include <fusion/conf.h>
+#include <fusion/shmalloc.h>
+
+#include <core/core.h>
+#include <core/compressed_surface_pool.h>
+#include <core/surface_pool.h>
+
+#include <misc/conf.h>
+
+D_DEBUG_DOMAIN( Core_Compressed, "Core/Compressed", "Core Compressed Surface Pool" );
+
+/**********************************************************************************************************************/
+
+/*
+ * Backing store for allocations displaced from other pools (see backup_allocation() in surface_pool.c).
+ *
+ * The pool can not be locked, buffers are only transferred via Write() when backing up and Read() when
+ * restoring. Written buffers are compressed with FastLZ by worker threads of the writing process, until
+ * then (or if not compressible enough) the raw copy is kept.
+ */
+
+typedef enum {
+     CBS_PENDING,                   /* raw data, queued for compression */
+     CBS_COMPRESSING,               /* raw data, being compressed by a worker */
+     CBS_RAW,                       /* raw data, not compressible enough */
+     CBS_PACKED                     /* compressed data */
+} CompressedBackupState;
+
+typedef struct {
+     int                         magic;
+
+     CompressedBackupState       state;
+     bool                        dead;      /* released while queued, to be freed by the worker */
+
+     int                         pitch;     /* pitch of the raw data */
+     int                         size;      /* size of the raw data */
+
+     void                       *data;      /* raw or compressed data */
+     int                         length;    /* length of the data */
+} CompressedBackup;
+
+typedef struct {
+     int                         magic;
+
+     FusionSkirmish              lock;      /* protects backups against the compression workers */
+     FusionSHMPoolShared        *shmpool;
+
+     bool                        enabled;
+
+     CompressedSurfacePoolStats  stats;
+} CompressedPoolData;
+
+typedef struct {
+     CompressedPoolData         *data;
+
+     DirectMutex                 lock;
+     DirectWaitQueue             wq;
+
+     DirectLink                 *jobs;
+
+     DirectThread              **threads;
+     int                         num_threads;
+
+     bool                        stop;
+} CompressedPoolLocalData;
+
+typedef struct {
+     CompressedBackup           *backup;
+} CompressedAllocationData;
+
+typedef struct {
+     DirectLink                  link;
+
+     CompressedBackup           *backup;
+} CompressJob;
+
+static CompressedPoolData *compressed_pool;
+
+/**********************************************************************************************************************/
+
+static void
+backup_free( CompressedPoolData *data,
+             CompressedBackup   *backup )
+{
+     D_MAGIC_ASSERT( backup, CompressedBackup );
+
+     if (backup->data)
+          SHFREE( data->shmpool, backup->data );
+
+     D_MAGIC_CLEAR( backup );
+
+     SHFREE( data->shmpool, backup );
+}
+
+/*
+ * Releases a backup that's no longer used by an allocation. Requires data->lock.
+ */
+static void
+backup_release( CompressedPoolData *data,
+                CompressedBackup   *backup )
+{
+     D_MAGIC_ASSERT( backup, CompressedBackup );
+
+     data->stats.raw_bytes    -= backup->size;
+     data->stats.packed_bytes -= backup->length;
+
+     if (backup->state == CBS_PENDING || backup->state == CBS_COMPRESSING)
+          backup->dead = true;
+     else
+          backup_free( data, backup );
+}
+
+static void
+backup_compress( CompressedPoolData *data,
+                 CompressedBackup   *backup )
+{
+     long long  start;
+     int        length = 0;
+     void      *buffer;
+     void      *packed = NULL;
+
+     D_MAGIC_ASSERT( backup, CompressedBackup );
+
+     fusion_skirmish_prevail( &data->lock );
+
+     if (backup->dead) {
+          backup_free( data, backup );
+          fusion_skirmish_dismiss( &data->lock );
+          return;
+     }
+
+     D_ASSERT( backup->state == CBS_PENDING );
+
+     backup->state = CBS_COMPRESSING;
+
+     fusion_skirmish_dismiss( &data->lock );
+
+     start = direct_clock_get_micros();
+
+     /* FastLZ needs 5% more than the input, at least 66 bytes. */
+     buffer = D_MALLOC( backup->size + backup->size / 16 + 66 );
+     if (buffer) {
+          length = direct_fastlz_compress( backup->data, backup->size, buffer );
+
+          /* Only worth it when saving at least one eighth. */
+          if (length > 0 && length < backup->size - backup->size / 8) {
+               packed = SHMALLOC( data->shmpool, length );
+               if (packed)
+                    direct_memcpy( packed, buffer, length );
+          }
+
+          D_FREE( buffer );
+     }
+     else
+          D_OOM();
+
+     fusion_skirmish_prevail( &data->lock );
+
+     data->stats.compress_time += direct_clock_get_micros() - start;
+
+     if (backup->dead) {
+          if (packed)
+               SHFREE( data->shmpool, packed );
+
+          backup_free( data, backup );
+     }
+     else if (packed) {
+          D_DEBUG_AT( Core_Compressed, "  -> %p compressed %d -> %d bytes\n", backup, backup->size, length );
+
+          SHFREE( data->shmpool, backup->data );
+
+          data->stats.packed_bytes += length - backup->length;
+          data->stats.compressed++;
+
+          backup->data   = packed;
+          backup->length = length;
+          backup->state  = CBS_PACKED;
+     }
+     else {
+          D_DEBUG_AT( Core_Compressed, "  -> %p not compressible (%d -> %d bytes)\n", backup, backup->size, length );
+
+          data->stats.stored++;
+
+          backup->state = CBS_RAW;
+     }
+
+     fusion_skirmish_dismiss( &data->lock );
+}
+
+static void *
+compress_loop( DirectThread *thread,
+               void         *arg )
+{
+     CompressedPoolLocalData *local = arg;
+     CompressJob             *job;
+
+     direct_mutex_lock( &local->lock );
+
+     while (!local->stop) {
+          job = (CompressJob*) local->jobs;
+          if (!job) {
+               direct_waitqueue_wait( &local->wq, &local->lock );
+               continue;
+          }
+
+          direct_list_remove( &local->jobs, &job->link );
+
+          direct_mutex_unlock( &local->lock );
+
+          backup_compress( local->data, job->backup );
+
+          D_FREE( job );
+
+          direct_mutex_lock( &local->lock );
+     }
+
+     direct_mutex_unlock( &local->lock );
+
+     return NULL;
+}
+
+/*
+ * Queues the backup for compression, starting the workers on first use. Compresses right away without workers.
+ */
+static void
+backup_queue( CompressedPoolLocalData *local,
+              CompressedBackup        *backup )
+{
+     int          i;
+     CompressJob *job;
+
+     direct_mutex_lock( &local->lock );
+
+     if (!local->threads && local->num_threads > 0) {
+          local->threads = D_CALLOC( local->num_threads, sizeof(DirectThread*) );
+          if (local->threads) {
+               for (i=0; i<local->num_threads; i++)
+                    local->threads[i] = direct_thread_create( DTT_DEFAULT, compress_loop, local, "Surface Compress" );
+          }
+          else
+               local->num_threads = 0;
+     }
+
+     job = local->num_threads ? D_CALLOC( 1, sizeof(CompressJob) ) : NULL;
+     if (job) {
+          job->backup = backup;
+
+          direct_list_append( &local->jobs, &job->link );
+
+          direct_waitqueue_signal( &local->wq );
+     }
+
+     direct_mutex_unlock( &local->lock );
+
+     if (!job)
+          backup_compress( local->data, backup );
+}
+
+static void
+stop_workers( CompressedPoolLocalData *local )
+{
+     int          i;
+     CompressJob *job, *next;
+
+     direct_mutex_lock( &local->lock );
+
+     local->stop = true;
+
+     direct_waitqueue_broadcast( &local->wq );
+
+     direct_mutex_unlock( &local->lock );
+
+     if (local->threads) {
+          for (i=0; i<local->num_threads; i++) {
+               if (local->threads[i]) {
+                    direct_thread_join( local->threads[i] );
+                    direct_thread_destroy( local->threads[i] );
+               }
+          }
+
+          D_FREE( local->threads );
+     }
+
+     /* Backups still queued stay uncompressed. */
+     direct_list_foreach_safe (job, next, local->jobs) {
+          fusion_skirmish_prevail( &local->data->lock );
+
+          if (job->backup->dead)
+               backup_free( local->data, job->backup );
+          else {
+               job->backup->state = CBS_RAW;
+               local->data->stats.stored++;
+          }
+
+          fusion_skirmish_dismiss( &local->data->lock );
+
+          D_FREE( job );
+     }
+
+     direct_waitqueue_deinit( &local->wq );
+     direct_mutex_deinit( &local->lock );
+}
+
+static void
+init_local( CompressedPoolLocalData *local,
+            CompressedPoolData      *data )
+{
+     local->data        = data;
+     local->num_threads = direct_config_get_int_value_with_default( "surface-backup-compression-threads", 1 );
+
+     direct_mutex_init( &local->lock );
+     direct_waitqueue_init( &local->wq );
+
+     compressed_pool = data;
+}
+
+/**********************************************************************************************************************/
+
+static int
+compressedPoolDataSize( void )
+{
+     return sizeof(CompressedPoolData);
+}
+
+static int
+compressedPoolLocalDataSize( void )
+{
+     return sizeof(CompressedPoolLocalData);
+}
+
+static int
+compressedAllocationDataSize( void )
+{
+     return sizeof(CompressedAllocationData);
+}
+
+static DFBResult
+compressedInitPool( CoreDFB                    *core,
+                    CoreSurfacePool            *pool,
+                    void                       *pool_data,
+                    void                       *pool_local,
+                    void                       *system_data,
+                    CoreSurfacePoolDescription *ret_desc )
+{
+     CompressedPoolData *data = pool_data;
+
+     D_DEBUG_AT( Core_Compressed, "%s()\n", __FUNCTION__ );
+
+     D_MAGIC_ASSERT( pool, CoreSurfacePool );
+     D_ASSERT( ret_desc != NULL );
+
+     /* Never chosen for allocations, only as backup pool, and not accessible other than via Read() and Write(). */
+     ret_desc->caps     = CSPCAPS_VIRTUAL;
+     ret_desc->types    = CSTF_NONE;
+     ret_desc->priority = CSPP_DEFAULT;
+
+     snprintf( ret_desc->name, DFB_SURFACE_POOL_DESC_NAME_LENGTH, "Compressed Backup" );
+
+     data->shmpool = dfb_core_shmpool( core );
+     data->enabled = direct_config_get_int_value( "surface-backup-compression" );
+
+     fusion_skirmish_init2( &data->lock, "Compressed Backup Pool", dfb_core_world(core), fusion_config->secure_fusion );
+
+     D_MAGIC_SET( data, CompressedPoolData );
+
+     init_local( pool_local, data );
+
+     return DFB_OK;
+}
+
+static DFBResult
+compressedJoinPool( CoreDFB                    *core,
+                    CoreSurfacePool            *pool,
+                    void                       *pool_data,
+                    void                       *pool_local,
+                    void                       *system_data )
+{
+     CompressedPoolData *data = pool_data;
+
+     D_DEBUG_AT( Core_Compressed, "%s()\n", __FUNCTION__ );
+
+     D_MAGIC_ASSERT( pool, CoreSurfacePool );
+     D_MAGIC_ASSERT( data, CompressedPoolData );
+
+     init_local( pool_local, data );
+
+     return DFB_OK;
+}
+
+static DFBResult
+compressedDestroyPool( CoreSurfacePool *pool,
+                       void            *pool_data,
+                       void            *pool_local )
+{
+     CompressedPoolData *data = pool_data;
+
+     D_DEBUG_AT( Core_Compressed, "%s()\n", __FUNCTION__ );
+
+     D_MAGIC_ASSERT( pool, CoreSurfacePool );
+     D_MAGIC_ASSERT( data, CompressedPoolData );
+
+     stop_workers( pool_local );
+
+     if (data->stats.backups)
+          D_INFO( "Core/Surface/Compressed: %u backups (%u compressed, %u stored), %u restores (avg %lld us, max %lld us)\n",
+                  data->stats.backups, data->stats.compressed, data->stats.stored, data->stats.restores,
+                  data->stats.restores ? data->stats.restore_time / data->stats.restores : 0, data->stats.restore_max );
+
+     fusion_skirmish_destroy( &data->lock );
+
+     D_MAGIC_CLEAR( data );
+
+     compressed_pool = NULL;
+
+     return DFB_OK;
+}
+
+static DFBResult
+compressedLeavePool( CoreSurfacePool *pool,
+                     void            *pool_data,
+                     void            *pool_local )
+{
+     D_DEBUG_AT( Core_Compressed, "%s()\n", __FUNCTION__ );
+
+     D_MAGIC_ASSERT( pool, CoreSurfacePool );
+
+     stop_workers( pool_local );
+
+     compressed_pool = NULL;
+
+     return DFB_OK;
+}
+
+static DFBResult
+compressedTestConfig( CoreSurfacePool         *pool,
+                      void                    *pool_data,
+                      void                    *pool_local,
+                      CoreSurfaceBuffer       *buffer,
+                      const CoreSurfaceConfig *config )
+{
+     D_DEBUG_AT( Core_Compressed, "%s()\n", __FUNCTION__ );
+
+     return DFB_UNSUPPORTED;
+}
+
+static DFBResult
+compressedAllocateBuffer( CoreSurfacePool       *pool,
+                          void                  *pool_data,
+                          void                  *pool_local,
+                          CoreSurfaceBuffer     *buffer,
+                          CoreSurfaceAllocation *allocation,
+                          void                  *alloc_data )
+{
+     CoreSurface        *surface;
+     CompressedPoolData *data = pool_data;
+
+     D_DEBUG_AT( Core_Compressed, "%s()\n", __FUNCTION__ );
+
+     D_MAGIC_ASSERT( pool, CoreSurfacePool );
+     D_MAGIC_ASSERT( buffer, CoreSurfaceBuffer );
+     D_MAGIC_ASSERT( data, CompressedPoolData );
+
+     surface = buffer->surface;
+     D_MAGIC_ASSERT( surface, CoreSurface );
+
+     /* Planar formats are left to the next backup pool, plane pitches depend on the source. */
+     if (!data->enabled || DFB_PLANAR_PIXELFORMAT( buffer->format ))
+          return DFB_UNSUPPORTED;
+
+     allocation->size = DFB_BYTES_PER_LINE( buffer->format, surface->config.size.w ) * surface->config.size.h;
+
+     return DFB_OK;
+}
+
+static DFBResult
+compressedDeallocateBuffer( CoreSurfacePool       *pool,
+                            void                  *pool_data,
+                            void                  *pool_local,
+                            CoreSurfaceBuffer     *buffer,
+                            CoreSurfaceAllocation *allocation,
+                            void                  *alloc_data )
+{
+     CompressedPoolData       *data  = pool_data;
+     CompressedAllocationData *alloc = alloc_data;
+
+     D_DEBUG_AT( Core_Compressed, "%s()\n", __FUNCTION__ );
+
+     D_MAGIC_ASSERT( pool, CoreSurfacePool );
+     D_MAGIC_ASSERT( allocation, CoreSurfaceAllocation );
+
+     if (alloc->backup) {
+          fusion_skirmish_prevail( &data->lock );
+
+          backup_release( data, alloc->backup );
+
+          fusion_skirmish_dismiss( &data->lock );
+     }
+
+     return DFB_OK;
+}
+
+static DFBResult
+compressedRead( CoreSurfacePool       *pool,
+                void                  *pool_data,
+                void                  *pool_local,
+                CoreSurfaceAllocation *allocation,
+                void                  *alloc_data,
+                void                  *destination,
+                int                    pitch,
+                const DFBRectangle    *rect )
+{
+     DFBResult                 ret = DFB_OK;
+     int                       y;
+     int                       bytes;
+     long long                 start;
+     long long                 time;
+     const u8                 *src;
+     u8                       *dst    = destination;
+     u8                       *buffer = NULL;
+     CompressedBackup         *backup;
+     CompressedPoolData       *data   = pool_data;
+     CompressedAllocationData *alloc  = alloc_data;
+     CoreSurface              *surface;
+
+     D_DEBUG_AT( Core_Compressed, "%s( %p, %d,%d-%dx%d )\n", __FUNCTION__, allocation, DFB_RECTANGLE_VALS( rect ) );
+
+     D_MAGIC_ASSERT( pool, CoreSurfacePool );
+     D_MAGIC_ASSERT( allocation, CoreSurfaceAllocation );
+
+     surface = allocation->surface;
+     D_MAGIC_ASSERT( surface, CoreSurface );
+
+     start = direct_clock_get_micros();
+
+     fusion_skirmish_prevail( &data->lock );
+
+     backup = alloc->backup;
+     if (!backup) {
+          fusion_skirmish_dismiss( &data->lock );
+          return DFB_BUFFEREMPTY;
+     }
+
+     D_MAGIC_ASSERT( backup, CompressedBackup );
+
+     src = backup->data;
+
+     if (backup->state == CBS_PACKED) {
+          /* Decompress directly into the destination if possible. */
+          if (rect->x == 0 && rect->y == 0 && rect->w == surface->config.size.w && rect->h == surface->config.size.h &&
+              pitch == backup->pitch)
+          {
+               if (direct_fastlz_decompress( backup->data, backup->length, destination, backup->size ) != backup->size)
+                    ret = DFB_FAILURE;
+
+               goto out;
+          }
+
+          buffer = D_MALLOC( backup->size );
+          if (!buffer) {
+               ret = D_OOM();
+               goto out;
+          }
+
+          if (direct_fastlz_decompress( backup->data, backup->length, buffer, backup->size ) != backup->size) {
+               ret = DFB_FAILURE;
+               goto out;
+          }
+
+          src = buffer;
+     }
+
+     bytes = DFB_BYTES_PER_LINE( allocation->config.format, rect->w );
+
+     src += DFB_BYTES_PER_LINE( allocation->config.format, rect->x ) + rect->y * backup->pitch;
+
+     for (y=0; y<rect->h; y++) {
+          direct_memcpy( dst, src, bytes );
+
+          src += backup->pitch;
+          dst += pitch;
+     }
+
+out:
+     if (ret)
+          D_DERROR( ret, "Core/Surface/Compressed: Could not restore from backup!\n" );
+     else {
+          time = direct_clock_get_micros() - start;
+
+          data->stats.restores++;
+          data->stats.restore_time += time;
+
+          if (data->stats.restore_max < time)
+               data->stats.restore_max = time;
+     }
+
+     fusion_skirmish_dismiss( &data->lock );
+
+     if (buffer)
+          D_FREE( buffer );
+
+     return ret;
+}
+
+static DFBResult
+compressedWrite( CoreSurfacePool       *pool,
+                 void                  *pool_data,
+                 void                  *pool_local,
+                 CoreSurfaceAllocation *allocation,
+                 void                  *alloc_data,
+                 const void            *source,
+                 int                    pitch,
+                 const DFBRectangle    *rect )
+{
+     int                       y;
+     const u8                 *src    = source;
+     u8                       *dst;
+     CompressedBackup         *backup;
+     CompressedPoolData       *data   = pool_data;
+     CompressedAllocationData *alloc  = alloc_data;
+     CoreSurface              *surface;
+
+     D_DEBUG_AT( Core_Compressed, "%s( %p, %d,%d-%dx%d )\n", __FUNCTION__, allocation, DFB_RECTANGLE_VALS( rect ) );
+
+     D_MAGIC_ASSERT( pool, CoreSurfacePool );
+     D_MAGIC_ASSERT( allocation, CoreSurfaceAllocation );
+
+     surface = allocation->surface;
+     D_MAGIC_ASSERT( surface, CoreSurface );
+
+     /* Only complete buffers are backed up. */
+     if (rect->x || rect->y || rect->w != surface->config.size.w || rect->h != surface->config.size.h)
+          return DFB_UNSUPPORTED;
+
+     backup = SHCALLOC( data->shmpool, 1, sizeof(CompressedBackup) );
+     if (!backup)
+          return D_OOSHM();
+
+     backup->state  = CBS_PENDING;
+     backup->pitch  = DFB_BYTES_PER_LINE( allocation->config.format, rect->w );
+     backup->size   = backup->pitch * rect->h;
+     backup->length = backup->size;
+
+     backup->data = SHMALLOC( data->shmpool, backup->size );
+     if (!backup->data) {
+          SHFREE( data->shmpool, backup );
+          return D_OOSHM();
+     }
+
+     /* Store the raw copy without padding. */
+     for (y=0, dst=backup->data; y<rect->h; y++) {
+          direct_memcpy( dst, src, backup->pitch );
+
+          src += pitch;
+          dst += backup->pitch;
+     }
+
+     D_MAGIC_SET( backup, CompressedBackup );
+
+     fusion_skirmish_prevail( &data->lock );
+
+     if (alloc->backup)
+          backup_release( data, alloc->backup );
+
+     alloc->backup = backup;
+
+     data->stats.backups++;
+     data->stats.raw_bytes    += backup->size;
+     data->stats.packed_bytes += backup->length;
+
+     fusion_skirmish_dismiss( &data->lock );
+
+     backup_queue( pool_local, backup );
+
+     return DFB_OK;
+}
+
+const SurfacePoolFuncs compressedSurfacePoolFuncs = {
+     .PoolDataSize       = compressedPoolDataSize,
+     .PoolLocalDataSize  = compressedPoolLocalDataSize,
+     .AllocationDataSize = compressedAllocationDataSize,
+     .InitPool           = compressedInitPool,
+     .JoinPool           = compressedJoinPool,
+     .DestroyPool        = compressedDestroyPool,
+     .LeavePool          = compressedLeavePool,
+
+     .TestConfig         = compressedTestConfig,
+
+     .AllocateBuffer     = compressedAllocateBuffer,
+     .DeallocateBuffer   = compressedDeallocateBuffer,
+
+     .Read               = compressedRead,
+     .Write              = compressedWrite,
+};
+
+/**********************************************************************************************************************/
+
+DFBResult
+dfb_compressed_surface_pool_get_stats( CompressedSurfacePoolStats *ret_stats )
+{
+     D_ASSERT( ret_stats != NULL );
+
+     if (!compressed_pool || !compressed_pool->enabled)
+          return DFB_UNSUPPORTED;
+
+     D_MAGIC_ASSERT( compressed_pool, CompressedPoolData );
+
+     fusion_skirmish_prevail( &compressed_pool->lock );
+
+     *ret_stats = compressed_pool->stats;
+
+     fusion_skirmish_dismiss( &compressed_pool->lock );
+
+     return DFB_OK;
+}
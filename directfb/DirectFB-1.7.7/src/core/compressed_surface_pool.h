@@ -0,0 +1,64 @@
+/*
+   (c) Copyright 2012-2013  DirectFB integrated media GmbH
+   (c) Copyright 2001-2013  The world wide DirectFB Open Source Community (directfb.org)
+   (c) Copyright 2000-2004  Convergence (integrated media) GmbH
+
+   All rights reserved.
+
+   Written by Denis Oliver Kropp <dok@directfb.org>,
+              Andreas Shimokawa <andi@directfb.org>,
+              Marek Pikarski <mass@directfb.org>,
+              Sven Neumann <neo@directfb.org>,
+              Ville Syrjälä <syrjala@sci.fi> and
+              Claudio Ciccani <klan@users.sf.net>.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+
+
+
+#ifndef __CORE__COMPRESSED_SURFACE_POOL_H__
+#define __CORE__COMPRESSED_SURFACE_POOL_H__
+
+#include <directfb.h>
+
+#include <core/coretypes.h>
+
+
+typedef struct {
+     unsigned int        backups;        /* buffers written into the pool (displaced surfaces) */
+     unsigned int        compressed;     /* backups stored compressed */
+     unsigned int        stored;         /* backups stored uncompressed, not compressible enough */
+     unsigned int        restores;       /* buffers read back from the pool */
+
+     unsigned long long  raw_bytes;      /* uncompressed size of the current backups */
+     unsigned long long  packed_bytes;   /* memory used by the current backups */
+
+     long long           compress_time;  /* total time spent compressing (micro seconds) */
+     long long           restore_time;   /* total time spent restoring (micro seconds) */
+     long long           restore_max;    /* slowest restore (micro seconds) */
+} CompressedSurfacePoolStats;
+
+
+/*
+ * Returns the statistics of the compressed backing store,
+ * DFB_UNSUPPORTED if it's not enabled via "surface-backup-compression".
+ */
+DFBResult dfb_compressed_surface_pool_get_stats( CompressedSurfacePoolStats *ret_stats );
+
+
+#endif
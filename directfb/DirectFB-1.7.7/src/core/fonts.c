@@ -75,8 +75,27 @@ static bool free_glyphs( DirectHash    *hash,
                          void          *value,
                          void          *ctx );
 
+static void remove_row ( DFBFontCacheRow *row );
+
+static void remove_layout( DFBFontManager *manager,
+                           CoreFontLayout *layout );
+
+static void remove_glyph ( CoreFont      *font,
+                           CoreGlyphData *data );
+
+static void free_phases  ( CoreGlyphData   *data,
+                           DFBFontCacheRow *row,
+                           bool             remove_empty );
+
 /**********************************************************************************************************************/
 
+typedef struct {
+     unsigned int        lookups;
+     unsigned int        hits;
+     unsigned int        evictions;
+     unsigned int        entries;
+} DFBFontLayoutStats;
+
 struct __DFB_DFBFontManager {
      int                 magic;
 
@@ -88,7 +107,14 @@ struct __DFB_DFBFontManager {
 
      unsigned int        max_rows;
      unsigned int        num_rows;
-     unsigned long long  row_stamp;     // FIXME: lru calculation wrong if value overruns (non-fatal)
+
+     DirectLink         *rows;          /* rows of all caches, most recently used first */
+
+     DirectMap          *layouts;       /* laid out text runs of all fonts */
+     DirectLink         *layouts_lru;   /* most recently used first */
+     unsigned int        max_layouts;
+
+     DFBFontLayoutStats  layout_stats;
 };
 
 #define DFB_FONT_MANAGER_ASSERT( manager )                            \
@@ -100,6 +126,22 @@ struct __DFB_DFBFontManager {
 
 /**********************************************************************************************************************/
 
+/*
+ * Each cache row surface is packed with shelves, i.e. horizontal strips of glyphs.
+ * Shelf heights are rounded up to classes, each class having one shelf open for insertion.
+ */
+#define FONT_CACHE_SHELF_ALIGN   4    /* height granularity of shelves */
+#define FONT_CACHE_ROW_UNITS     4    /* maximum number of cache heights per row surface */
+
+typedef struct {
+     DFBFontCacheRow    *row;
+
+     unsigned int        cls;           /* height class */
+     unsigned int        y;
+     unsigned int        height;
+     unsigned int        next_x;
+} DFBFontCacheShelf;
+
 struct __DFB_DFBFontCache {
      int                 magic;
 
@@ -108,8 +150,14 @@ struct __DFB_DFBFontCache {
      DFBFontCacheType    type;
 
      unsigned int        row_width;
+     unsigned int        row_height;    /* height of row surfaces, a multiple of type.height */
+     unsigned int        row_units;     /* rows counted against max-font-rows per row surface */
+     unsigned int        align;         /* horizontal alignment mask of glyphs */
 
-     DirectLink         *rows;
+     DFBFontCacheRow    *current;       /* row to open new shelves in */
+
+     DFBFontCacheShelf **shelves;       /* open shelf per height class */
+     unsigned int        num_classes;
 };
 
 #define DFB_FONT_CACHE_ASSERT( cache )                                \
@@ -120,16 +168,17 @@ struct __DFB_DFBFontCache {
 /**********************************************************************************************************************/
 
 struct __DFB_DFBFontCacheRow {
-     DirectLink          link;
+     DirectLink          link;          /* in the manager's LRU list */
 
      int                 magic;
 
      DFBFontCache       *cache;
 
-     unsigned long long  stamp;
-
      CoreSurface        *surface;
-     unsigned int        next_x;
+     unsigned int        next_y;        /* top of space not used by shelves */
+
+     DFBFontCacheShelf  *shelves;
+     unsigned int        num_shelves;
 
      DirectLink         *glyphs;
 };
@@ -164,6 +213,51 @@ font_cache_map_hash( DirectMap    *map,
      return (type->height * 131 + type->pixel_format) * 131 + type->surface_caps;
 }
 
+/**********************************************************************************************************************/
+
+/*
+ * Text runs longer than this are laid out without being cached.
+ */
+#define FONT_LAYOUT_MAX_BYTES    256
+
+typedef struct {
+     const CoreFont     *font;
+     DFBTextEncodingID   encoding;
+     const void         *text;
+     int                 bytes;
+} CoreFontLayoutKey;
+
+static bool
+font_layout_map_compare( DirectMap    *map,
+                         const void   *key,
+                         void         *object,
+                         void         *ctx )
+{
+     const CoreFontLayoutKey *layout_key = key;
+     CoreFontLayout          *layout     = object;
+
+     return layout->font     == layout_key->font     &&
+            layout->encoding == layout_key->encoding &&
+            layout->bytes    == layout_key->bytes    &&
+            !memcmp( layout->text, layout_key->text, layout_key->bytes );
+}
+
+static unsigned int
+font_layout_map_hash( DirectMap    *map,
+                      const void   *key,
+                      void         *ctx )
+{
+     const CoreFontLayoutKey *layout_key = key;
+     const u8                *text       = layout_key->text;
+     unsigned int             hash       = 2166136261u;
+     int                      i;
+
+     for (i=0; i<layout_key->bytes; i++)
+          hash = (hash ^ text[i]) * 16777619u;
+
+     return (hash ^ (unsigned int)(unsigned long) layout_key->font) * 131 + layout_key->encoding;
+}
+
 /**********************************************************************************************************************/
 /**********************************************************************************************************************/
 
@@ -219,13 +313,20 @@ dfb_font_manager_init( DFBFontManager *manager,
      D_ASSERT( core != NULL );
      D_ASSERT( manager != NULL );
 
-     manager->core      = core;
-     manager->max_rows  = dfb_config->max_font_rows;
+     manager->core        = core;
+     manager->max_rows    = dfb_config->max_font_rows;
+     manager->max_layouts = dfb_config->max_font_layouts;
 
      ret = direct_map_create( 11, font_cache_map_compare, font_cache_map_hash, NULL, &manager->caches );
      if (ret)
           return ret;
 
+     ret = direct_map_create( 67, font_layout_map_compare, font_layout_map_hash, NULL, &manager->layouts );
+     if (ret) {
+          direct_map_destroy( manager->caches );
+          return ret;
+     }
+
      direct_util_recursive_pthread_mutex_init( &manager->lock );
 
      D_MAGIC_SET( manager, DFBFontManager );
@@ -256,6 +357,14 @@ dfb_font_manager_deinit( DFBFontManager *manager )
 
      DFB_FONT_MANAGER_ASSERT( manager );
 
+     D_DEBUG_AT( Font_Manager, "  -> layouts: %u hits in %u lookups, %u evictions\n",
+                 manager->layout_stats.hits, manager->layout_stats.lookups, manager->layout_stats.evictions );
+
+     while (manager->layouts_lru)
+          remove_layout( manager, (CoreFontLayout*) manager->layouts_lru );
+
+     direct_map_destroy( manager->layouts );
+
      direct_map_iterate( manager->caches, destroy_caches, NULL );
      direct_map_destroy( manager->caches );
 
@@ -338,69 +447,67 @@ dfb_font_manager_get_cache( DFBFontManager          *manager,
      return DFB_OK;
 }
 
-typedef struct {
-     unsigned int     lru_stamp;
-     DFBFontCacheRow *lru_row;
-} FindLruRowContext;
-
-static DirectEnumerationResult
-find_lru_row( DirectMap *map,
-              void      *object,
-              void      *ctx )
+DFBResult
+dfb_font_manager_remove_lru_row( DFBFontManager *manager )
 {
-     D_DEBUG_AT( Font_Manager, "%s( object %p )\n", __func__, object );
-
-     FindLruRowContext *context = ctx;
-     DFBFontCache      *cache   = object;
-     DFBFontCacheRow   *row;
+     D_DEBUG_AT( Font_Manager, "%s()\n", __func__ );
 
-     DFB_FONT_CACHE_ASSERT( cache );
+     DFBFontCacheRow *row;
 
-     direct_list_foreach (row, cache->rows) {
-          D_DEBUG_AT( Font_Manager, "  -> stamp %llu\n", row->stamp );
+     DFB_FONT_MANAGER_ASSERT( manager );
 
-          if (!context->lru_row || context->lru_stamp > row->stamp) {
-               context->lru_row   = row;
-               context->lru_stamp = row->stamp;
-          }
+     row = direct_list_get_last( manager->rows );
+     if (!row) {
+          D_ERROR( "Core/Font: Could not find any row (LRU)!\n" );
+          return DFB_ITEMNOTFOUND;
      }
 
-     return DENUM_OK;
+     DFB_FONT_CACHE_ROW_ASSERT( row );
+
+     D_DEBUG_AT( Font_Manager, "  -> row %p\n", row );
+
+     remove_row( row );
+
+     return DFB_OK;
 }
 
-DFBResult
-dfb_font_manager_remove_lru_row( DFBFontManager *manager )
+/*
+ * Unlinks the row from the manager and its cache and destroys it.
+ */
+static void
+remove_row( DFBFontCacheRow *row )
 {
-     D_DEBUG_AT( Font_Manager, "%s()\n", __func__ );
+     unsigned int    i;
+     DFBFontCache   *cache;
+     DFBFontManager *manager;
 
-     FindLruRowContext  context;
-     DFBFontCache      *cache;
+     DFB_FONT_CACHE_ROW_ASSERT( row );
 
+     cache = row->cache;
+     DFB_FONT_CACHE_ASSERT( cache );
+
+     manager = cache->manager;
      DFB_FONT_MANAGER_ASSERT( manager );
 
-     context.lru_stamp = 0;
-     context.lru_row   = NULL;
+     direct_list_remove( &manager->rows, &row->link );
 
-     direct_map_iterate( manager->caches, find_lru_row, &context );
+     /* Close shelves of this row. */
+     for (i=0; i<row->num_shelves; i++) {
+          DFBFontCacheShelf *shelf = &row->shelves[i];
 
-     if (!context.lru_row) {
-          D_ERROR( "Core/Font: Could not find any row (LRU)!\n" );
-          return DFB_ITEMNOTFOUND;
+          if (cache->shelves[shelf->cls] == shelf)
+               cache->shelves[shelf->cls] = NULL;
      }
 
-     D_DEBUG_AT( Font_Manager, "  -> row %p (stamp %llu)\n", context.lru_row, context.lru_row->stamp );
-
-     cache = context.lru_row->cache;
-     DFB_FONT_CACHE_ASSERT( cache );
-
-     direct_list_remove( &cache->rows, &context.lru_row->link );
+     if (cache->current == row)
+          cache->current = NULL;
 
-     dfb_font_cache_row_destroy( context.lru_row );
+     dfb_font_cache_row_destroy( row );
 
      /* Decrease row counter. */
-     manager->num_rows--;
+     D_ASSERT( manager->num_rows >= cache->row_units );
 
-     return DFB_OK;
+     manager->num_rows -= cache->row_units;
 }
 
 /**********************************************************************************************************************/
@@ -472,6 +579,26 @@ dfb_font_cache_init( DFBFontCache           *cache,
 
      cache->row_width = (cache->row_width + 7) & ~7;
 
+     /* Stack several cache heights in one surface, counting each against max-font-rows. */
+     cache->row_units = FONT_CACHE_ROW_UNITS;
+
+     if (cache->row_units > manager->max_rows)
+          cache->row_units = manager->max_rows;
+
+     while (cache->row_units > 1 && type->height * cache->row_units > cache->row_width)
+          cache->row_units--;
+
+     cache->row_height = type->height * cache->row_units;
+
+     cache->align = (8 / (DFB_BYTES_PER_PIXEL( type->pixel_format ) ? : 1)) *
+                    (DFB_PIXELFORMAT_ALIGNMENT( type->pixel_format ) + 1) - 1;
+
+     cache->num_classes = (type->height + FONT_CACHE_SHELF_ALIGN - 1) / FONT_CACHE_SHELF_ALIGN;
+
+     cache->shelves = D_CALLOC( cache->num_classes, sizeof(DFBFontCacheShelf*) );
+     if (!cache->shelves)
+          return D_OOM();
+
 
      D_MAGIC_SET( cache, DFBFontCache );
 
@@ -485,10 +612,14 @@ dfb_font_cache_deinit( DFBFontCache *cache )
 
      DFB_FONT_CACHE_ASSERT( cache );
 
-     direct_list_foreach_safe (row, next, cache->rows)
-          dfb_font_cache_row_destroy( row );
+     direct_list_foreach_safe (row, next, cache->manager->rows) {
+          if (row->cache == cache)
+               remove_row( row );
+     }
+
+     D_ASSERT( cache->current == NULL );
 
-     cache->rows = NULL;
+     D_FREE( cache->shelves );
 
      D_MAGIC_CLEAR( cache );
 
@@ -498,76 +629,94 @@ dfb_font_cache_deinit( DFBFontCache *cache )
 DFBResult
 dfb_font_cache_get_row( DFBFontCache     *cache,
                         unsigned int      width,
-                        DFBFontCacheRow **ret_row )
+                        unsigned int      height,
+                        DFBFontCacheRow **ret_row,
+                        int              *ret_x,
+                        int              *ret_y )
 {
-     DFBResult        ret;
-     DFBFontManager  *manager;
-     DFBFontCacheRow *row;
-     DFBFontCacheRow *best_row = NULL;
-     unsigned int     best_val = 0;
+     DFBResult          ret;
+     DFBFontManager    *manager;
+     DFBFontCacheRow   *row;
+     DFBFontCacheShelf *shelf;
+     unsigned int       cls;
 
      DFB_FONT_CACHE_ASSERT( cache );
+     D_ASSERT( width > 0 );
+     D_ASSERT( width <= cache->row_width );
+     D_ASSERT( height > 0 );
+     D_ASSERT( height <= cache->type.height );
      D_ASSERT( ret_row != NULL );
+     D_ASSERT( ret_x != NULL );
+     D_ASSERT( ret_y != NULL );
 
      manager = cache->manager;
      DFB_FONT_MANAGER_ASSERT( manager );
 
-     /* Try freshest row first. */
-     row = (DFBFontCacheRow*) cache->rows;
-     if (row && row->next_x + width <= cache->row_width) {
-          *ret_row = row;
+     /* Use the open shelf of the glyph's height class if the glyph fits. */
+     cls = (height - 1) / FONT_CACHE_SHELF_ALIGN;
 
-          return DFB_OK;
-     }
+     D_ASSERT( cls < cache->num_classes );
 
-     /* Check for trailing space in each row. */
-     direct_list_foreach (row, cache->rows) {
-          DFB_FONT_CACHE_ROW_ASSERT( row );
+     shelf = cache->shelves[cls];
+
+     if (!shelf || shelf->next_x + width > cache->row_width) {
+          unsigned int shelf_height = MIN( (cls + 1) * FONT_CACHE_SHELF_ALIGN, cache->row_height );
 
-          /* If glyph fits... */
-          if (row->next_x + width <= cache->row_width) {
-               /* ...and no row yet or this row fits better... */
-               if (!best_row || best_val < row->next_x) {
-                    /* ...remember row */
-                    best_row = row;
-                    best_val = row->next_x;
+          /* Need a new shelf, check for space below the shelves of the current row. */
+          row = cache->current;
+          if (!row || row->next_y + shelf_height > cache->row_height) {
+               /*
+                * Need a new cache row
+                */
+
+               /* Maximum number of rows reached? */
+               while (manager->num_rows + cache->row_units > manager->max_rows) {
+                    /* Remove the least recently used row. */
+                    ret = dfb_font_manager_remove_lru_row( manager );
+                    if (ret)
+                         return ret;
                }
+
+               /* Create another row. */
+               ret = dfb_font_cache_row_create( cache, &row );
+               if (ret)
+                    return ret;
+
+               /* Prepend to list (freshest is first). */
+               direct_list_prepend( &manager->rows, &row->link );
+
+               /* Increase row counter in manager. */
+               manager->num_rows += cache->row_units;
+
+               cache->current = row;
           }
-     }
 
-     if (best_row) {
-          *ret_row = best_row;
+          D_ASSERT( row->num_shelves < cache->row_height / FONT_CACHE_SHELF_ALIGN + 1 );
 
-          return DFB_OK;
-     }
+          shelf = &row->shelves[row->num_shelves++];
 
+          shelf->row    = row;
+          shelf->cls    = cls;
+          shelf->y      = row->next_y;
+          shelf->height = shelf_height;
+          shelf->next_x = 0;
 
-     /*
-      * Need a new cache row
-      */
+          row->next_y += shelf_height;
 
-     /* Maximum number of rows reached? */
-     if (manager->num_rows == manager->max_rows) {
-          /* Remove the least recently used row. */
-          ret = dfb_font_manager_remove_lru_row( manager );
-          if (ret)
-               return ret;
+          cache->shelves[cls] = shelf;
      }
 
-     D_ASSERT( manager->num_rows < manager->max_rows );
+     row = shelf->row;
 
-     /* Create another row. */
-     ret = dfb_font_cache_row_create( cache, &row );
-     if (ret)
-          return ret;
+     DFB_FONT_CACHE_ROW_ASSERT( row );
 
-     /* Prepend to list (freshest is first). */
-     direct_list_prepend( &cache->rows, &row->link );
+     *ret_row = row;
+     *ret_x   = shelf->next_x;
+     *ret_y   = shelf->y;
 
-     /* Increase row counter in manager. */
-     manager->num_rows++;
+     shelf->next_x += (width + cache->align) & ~cache->align;
 
-     *ret_row = row;
+     direct_list_move_to_front( &manager->rows, &row->link );
 
      return DFB_OK;
 }
@@ -623,10 +772,15 @@ dfb_font_cache_row_init( DFBFontCacheRow *row,
 
      row->cache = cache;
 
+     /* Room for the maximum number of shelves, i.e. all of the smallest height class. */
+     row->shelves = D_CALLOC( cache->row_height / FONT_CACHE_SHELF_ALIGN + 1, sizeof(DFBFontCacheShelf) );
+     if (!row->shelves)
+          return D_OOM();
+
      /* Create a new font surface. */
      ret = dfb_surface_create_simple( manager->core,
                                       cache->row_width,
-                                      cache->type.height,
+                                      cache->row_height,
                                       cache->type.pixel_format, DFB_COLORSPACE_DEFAULT(cache->type.pixel_format),
                                       cache->type.surface_caps,
                                       CSTF_FONT,
@@ -634,6 +788,7 @@ dfb_font_cache_row_init( DFBFontCacheRow *row,
                                       NULL, &row->surface );
      if (ret) {
           D_DERROR( ret, "Core/Font: Could not create font surface!\n" );
+          D_FREE( row->shelves );
           return ret;
      }
 
@@ -660,11 +815,16 @@ dfb_font_cache_row_deinit( DFBFontCacheRow *row )
           D_MAGIC_ASSERT( glyph, CoreGlyphData );
           D_ASSERT( glyph->layer < D_ARRAY_SIZE(font->layers) );
 
-          /*ret =*/ direct_hash_remove( font->layers[glyph->layer].glyph_hash, glyph->index );
-          //FIXME: use D_ASSERT( ret == DFB_OK );
+          if (glyph->phase) {
+               /* Variants in this row lost their base already. */
+               if (glyph->base)
+                    glyph->base->phases[glyph->phase-1] = NULL;
+          }
+          else {
+               free_phases( glyph, row, false );
 
-          if (glyph->index < 128)
-               font->layers[glyph->layer].glyph_data[glyph->index] = NULL;
+               remove_glyph( font, glyph );
+          }
 
           D_MAGIC_CLEAR( glyph );
           D_FREE( glyph );
@@ -673,6 +833,8 @@ dfb_font_cache_row_deinit( DFBFontCacheRow *row )
 
      dfb_surface_unref( row->surface );
 
+     D_FREE( row->shelves );
+
      D_MAGIC_CLEAR( row );
 
      return DFB_OK;
@@ -732,6 +894,10 @@ dfb_font_create( CoreDFB                   *core,
 
      font->blittingflags = DSBLIT_BLEND_ALPHACHANNEL | DSBLIT_COLORIZE;
 
+     /* glyph variants per pixel if the font module supports CFF_SUBPIXEL_PHASES */
+     while ((2 << font->subpixel_shift) <= MIN( dfb_config->font_subpixel_phases, DFB_FONT_MAX_SUBPIXEL_PHASES ))
+          font->subpixel_shift++;
+
      D_MAGIC_SET( font, CoreFont );
 
      *ret_font = font;
@@ -742,7 +908,8 @@ dfb_font_create( CoreDFB                   *core,
 void
 dfb_font_destroy( CoreFont *font )
 {
-     int i;
+     int             i;
+     CoreFontLayout *layout, *next;
 
      D_DEBUG_AT( Core_Font, "%s()\n", __FUNCTION__ );
 
@@ -750,6 +917,15 @@ dfb_font_destroy( CoreFont *font )
 
      dfb_font_dispose( font );
 
+     dfb_font_manager_lock( font->manager );
+
+     direct_list_foreach_safe (layout, next, font->manager->layouts_lru) {
+          if (layout->font == font)
+               remove_layout( font->manager, layout );
+     }
+
+     dfb_font_manager_unlock( font->manager );
+
      for (i=0; i<DFB_FONT_MAX_LAYERS; i++)
           direct_hash_destroy( font->layers[i].glyph_hash );
 
@@ -789,9 +965,20 @@ dfb_font_dispose( CoreFont *font )
      dfb_font_manager_lock( font->manager );
 
      for (i=0; i<DFB_FONT_MAX_LAYERS; i++) {
+          unsigned int p;
+
           direct_hash_iterate( font->layers[i].glyph_hash, free_glyphs, NULL );
 
-          memset( font->layers[i].glyph_data, 0, sizeof(font->layers[i].glyph_data) );
+          for (p=0; p<font->layers[i].num_pages; p++) {
+               if (font->layers[i].glyph_pages[p])
+                    D_FREE( font->layers[i].glyph_pages[p] );
+          }
+
+          if (font->layers[i].glyph_pages)
+               D_FREE( font->layers[i].glyph_pages );
+
+          font->layers[i].glyph_pages = NULL;
+          font->layers[i].num_pages   = 0;
      }
 
      dfb_font_manager_unlock( font->manager );
@@ -801,93 +988,128 @@ dfb_font_dispose( CoreFont *font )
 
 /**********************************************************************************************************************/
 
-DFBResult
-dfb_font_get_glyph_data( CoreFont       *font,
-                         unsigned int    index,
-                         unsigned int    layer,
-                         CoreGlyphData **ret_data )
+static inline CoreGlyphData *
+lookup_glyph( const CoreFont *font,
+              unsigned int    index,
+              unsigned int    layer )
 {
-     DFBResult        ret;
-     CoreGlyphData   *data;
-     int              align;
-     DFBFontManager  *manager;
-     DFBFontCache    *cache;
-     DFBFontCacheRow *row = NULL;
+     unsigned int page = index >> DFB_FONT_GLYPH_PAGE_BITS;
 
-     D_DEBUG_AT( Core_Font, "%s( index %u, layer %u )\n", __FUNCTION__, index, layer );
+     if (page < font->layers[layer].num_pages) {
+          CoreGlyphData **entries = font->layers[layer].glyph_pages[page];
 
-     D_MAGIC_ASSERT( font, CoreFont );
-     D_ASSERT( ret_data != NULL );
+          return entries ? entries[index & (DFB_FONT_GLYPH_PAGE_SIZE - 1)] : NULL;
+     }
 
-     D_ASSERT( layer < D_ARRAY_SIZE(font->layers) );
+     if (page < DFB_FONT_GLYPH_MAX_PAGES)
+          return NULL;
 
-     manager = font->manager;
-     DFB_FONT_MANAGER_ASSERT( manager );
+     return direct_hash_lookup( font->layers[layer].glyph_hash, index );
+}
 
-     /* Quick Lookup in array */
-     if (index < 128 && font->layers[layer].glyph_data[index]) {
-          data = font->layers[layer].glyph_data[index];
-          if (data->retry)
-               goto retry;
+DFBResult
+dfb_font_insert_glyph( CoreFont      *font,
+                       unsigned int   index,
+                       unsigned int   layer,
+                       CoreGlyphData *data )
+{
+     DFBResult    ret;
+     unsigned int page = index >> DFB_FONT_GLYPH_PAGE_BITS;
 
-          *ret_data = font->layers[layer].glyph_data[index];
-          return DFB_OK;
-     }
+     D_MAGIC_ASSERT( font, CoreFont );
+     D_MAGIC_ASSERT( data, CoreGlyphData );
+     D_ASSERT( layer < D_ARRAY_SIZE(font->layers) );
 
-     /* Standard lookup in hash */
-     data = direct_hash_lookup( font->layers[layer].glyph_hash, index );
-     if (data) {
-          D_MAGIC_ASSERT( data, CoreGlyphData );
+     data->font  = font;
+     data->index = index;
+     data->layer = layer;
 
-          D_DEBUG_AT( Core_Font, "  -> already in cache (%p)\n", data );
+     if (page < DFB_FONT_GLYPH_MAX_PAGES) {
+          CoreGlyphData **entries;
 
-          row = data->row;
-          if (row) {
-               DFB_FONT_CACHE_ROW_ASSERT( row );
+          /* Grow the table of pages, at least doubling it. */
+          if (page >= font->layers[layer].num_pages) {
+               unsigned int     num   = MIN( MAX( page + 1, font->layers[layer].num_pages * 2 ), DFB_FONT_GLYPH_MAX_PAGES );
+               CoreGlyphData ***pages = D_REALLOC( font->layers[layer].glyph_pages, num * sizeof(CoreGlyphData**) );
+
+               if (!pages)
+                    return D_OOM();
 
-               row->stamp = manager->row_stamp++;
+               memset( pages + font->layers[layer].num_pages, 0,
+                       (num - font->layers[layer].num_pages) * sizeof(CoreGlyphData**) );
+
+               font->layers[layer].glyph_pages = pages;
+               font->layers[layer].num_pages   = num;
           }
 
-          if (data->retry)
-               goto retry;
+          entries = font->layers[layer].glyph_pages[page];
+          if (!entries) {
+               entries = D_CALLOC( DFB_FONT_GLYPH_PAGE_SIZE, sizeof(CoreGlyphData*) );
+               if (!entries)
+                    return D_OOM();
 
-          *ret_data = data;
-          return DFB_OK;
+               font->layers[layer].glyph_pages[page] = entries;
+          }
+
+          entries[index & (DFB_FONT_GLYPH_PAGE_SIZE - 1)] = data;
      }
 
+     ret = direct_hash_insert( font->layers[layer].glyph_hash, index, data );
+     if (ret && page < DFB_FONT_GLYPH_MAX_PAGES)
+          font->layers[layer].glyph_pages[page][index & (DFB_FONT_GLYPH_PAGE_SIZE - 1)] = NULL;
 
-     /*
-      * No glyph data available in cache, load new glyph
-      */
+     return ret;
+}
 
-     if (!font->GetGlyphData)
-          return DFB_UNSUPPORTED;
+/*
+ * Removes the glyph from the font's lookup tables, empty pages are kept until the font is disposed.
+ */
+static void
+remove_glyph( CoreFont      *font,
+              CoreGlyphData *data )
+{
+     unsigned int page = data->index >> DFB_FONT_GLYPH_PAGE_BITS;
 
-     /* Allocate glyph data */
-     data = D_CALLOC( 1, sizeof(CoreGlyphData) );
-     if (!data)
-          return D_OOM();
+     D_MAGIC_ASSERT( data, CoreGlyphData );
+     D_ASSERT( data->layer < D_ARRAY_SIZE(font->layers) );
 
-     D_MAGIC_SET( data, CoreGlyphData );
+     /*ret =*/ direct_hash_remove( font->layers[data->layer].glyph_hash, data->index );
+     //FIXME: use D_ASSERT( ret == DFB_OK );
 
-     data->font  = font;
-     data->index = index;
-     data->layer = layer;
+     if (page < font->layers[data->layer].num_pages && font->layers[data->layer].glyph_pages[page])
+          font->layers[data->layer].glyph_pages[page][data->index & (DFB_FONT_GLYPH_PAGE_SIZE - 1)] = NULL;
+}
+
+/*
+ * Gets the glyph info from the font implementation and renders it into a cache row,
+ * unless the implementation provides the bitmap in a surface of its own.
+ * Failures of the implementation leave an empty glyph, to be retried if it returned DFB_BUFFEREMPTY.
+ */
+static DFBResult
+load_glyph( CoreFont      *font,
+            CoreGlyphData *data )
+{
+     DFBResult         ret;
+     DFBFontCache     *cache;
+     DFBFontCacheRow  *row;
+     DFBFontCacheType  type;
 
-retry:
      data->retry = false;
 
+     if (!data->row)
+          data->surface = NULL;
+
      /* Get glyph data from font implementation */
-     ret = font->GetGlyphData( font, index, data );
+     ret = font->GetGlyphData( font, data->index, data );
      if (ret) {
-          D_DERROR( ret, "Core/Font: Could not get glyph info for index %d!\n", index );
-          data->start = data->width = data->height = 0;
+          D_DERROR( ret, "Core/Font: Could not get glyph info for index %d!\n", data->index );
+          data->start = data->start_y = data->width = data->height = 0;
 
           /* If the font module returned BUFFEREMPTY we will retry loading next time */
           if (ret == DFB_BUFFEREMPTY)
                data->retry = true;
 
-          goto out;
+          return DFB_OK;
      }
 
      if (!(font->flags & CFF_SUBPIXEL_ADVANCE)) {
@@ -897,14 +1119,18 @@ retry:
 
      if (data->width < 1 || data->height < 1) {
           D_DEBUG_AT( Core_Font, "  -> zero size glyph bitmap!\n" );
-          data->start = data->width = data->height = 0;
-          goto out;
+          data->start = data->start_y = data->width = data->height = 0;
+          return DFB_OK;
      }
 
+     /* Bitmap is kept by the implementation, e.g. in a memory mapped file. */
+     if (data->surface && !data->row) {
+          CORE_GLYPH_DATA_DEBUG_AT( Core_Font, data );
+          return DFB_OK;
+     }
 
-     /* Get the proper cache based on size... */
-     DFBFontCacheType type;
 
+     /* Get the proper cache based on size... */
      type.height       = MAX( data->height, data->width );
      type.pixel_format = font->pixel_format;
      type.surface_caps = font->surface_caps;
@@ -915,45 +1141,43 @@ retry:
      ret = dfb_font_manager_get_cache( font->manager, &type, &cache );
      if (ret) {
           D_DEBUG_AT( Core_Font, "  -> could not get cache from manager!\n" );
-          goto error;
+          return ret;
      }
 
-     /* Check for a cache row (surface) to use */
-     ret = dfb_font_cache_get_row( cache, data->width, &row );
+     /* Find a place in a cache row (surface) */
+     ret = dfb_font_cache_get_row( cache, data->width, data->height, &row, &data->start, &data->start_y );
      if (ret) {
           D_DEBUG_AT( Core_Font, "  -> could not get row from cache!\n" );
-          goto error;
+          return ret;
      }
 
      /*
       * Add the glyph to the cache row
       */
 
-     D_DEBUG_AT( Core_FontSurfaces, "  -> render %2d - %2dx%2d at %03d font <%p>\n",
-                 index, data->width, data->height, row->next_x, font );
+     D_DEBUG_AT( Core_FontSurfaces, "  -> render %2d/%u - %2dx%2d at %03d,%03d font <%p>\n",
+                 data->index, data->phase, data->width, data->height, data->start, data->start_y, font );
+
+     /* Move a glyph being retried to its new place. */
+     if (data->row)
+          direct_list_remove( &data->row->glyphs, &data->link );
 
      data->row     = row;
-     data->start   = row->next_x;
      data->surface = row->surface;
 
-     align = (8 / (DFB_BYTES_PER_PIXEL( font->pixel_format ) ? : 1)) *
-                  (DFB_PIXELFORMAT_ALIGNMENT( font->pixel_format ) + 1) - 1;
-
-     row->next_x  += (data->width + align) & ~align;
-
-     row->stamp = manager->row_stamp++;
+     direct_list_append( &row->glyphs, &data->link );
 
      /* Render the glyph data into the surface. */
-     ret = font->RenderGlyph( font, index, data );
+     ret = font->RenderGlyph( font, data->index, data );
      if (ret) {
           D_DEBUG_AT( Core_Font, "  -> rendering glyph failed!\n" );
-          data->start = data->width = data->height = 0;
+          data->start = data->start_y = data->width = data->height = 0;
 
           /* If the font module returned BUFFEREMPTY we will retry loading next time */
           if (ret == DFB_BUFFEREMPTY)
                data->retry = true;
 
-          goto out;
+          return DFB_OK;
      }
 
      if (!dfb_config->task_manager)
@@ -961,16 +1185,89 @@ retry:
 
      CORE_GLYPH_DATA_DEBUG_AT( Core_Font, data );
 
+     return DFB_OK;
+}
 
-out:
-     if (!data->inserted) {
-          if (row)
-               direct_list_append( &row->glyphs, &data->link );
+DFBResult
+dfb_font_get_glyph_data( CoreFont       *font,
+                         unsigned int    index,
+                         unsigned int    layer,
+                         CoreGlyphData **ret_data )
+{
+     DFBResult        ret;
+     CoreGlyphData   *data;
+     DFBFontManager  *manager;
+     DFBFontCacheRow *row;
 
-          direct_hash_insert( font->layers[layer].glyph_hash, index, data );
+     D_DEBUG_AT( Core_Font, "%s( index %u, layer %u )\n", __FUNCTION__, index, layer );
 
-          if (index < 128)
-               font->layers[layer].glyph_data[index] = data;
+     D_MAGIC_ASSERT( font, CoreFont );
+     D_ASSERT( ret_data != NULL );
+
+     D_ASSERT( layer < D_ARRAY_SIZE(font->layers) );
+
+     manager = font->manager;
+     DFB_FONT_MANAGER_ASSERT( manager );
+
+     /* Lookup in page table */
+     data = lookup_glyph( font, index, layer );
+     if (data) {
+          D_MAGIC_ASSERT( data, CoreGlyphData );
+
+          D_DEBUG_AT( Core_Font, "  -> already in cache (%p)\n", data );
+
+          /* Mark the row as used, consecutive glyphs mostly share it. */
+          row = data->row;
+          if (row && manager->rows != &row->link) {
+               DFB_FONT_CACHE_ROW_ASSERT( row );
+
+               direct_list_move_to_front( &manager->rows, &row->link );
+          }
+
+          if (data->retry)
+               goto retry;
+
+          *ret_data = data;
+          return DFB_OK;
+     }
+
+
+     /*
+      * No glyph data available in cache, load new glyph
+      */
+
+     if (!font->GetGlyphData)
+          return DFB_UNSUPPORTED;
+
+     /* Allocate glyph data */
+     data = D_CALLOC( 1, sizeof(CoreGlyphData) );
+     if (!data)
+          return D_OOM();
+
+     D_MAGIC_SET( data, CoreGlyphData );
+
+     data->font  = font;
+     data->index = index;
+     data->layer = layer;
+
+retry:
+     ret = load_glyph( font, data );
+     if (ret) {
+          if (!data->inserted)
+               goto error;
+
+          data->retry = true;
+          return ret;
+     }
+
+     if (!data->inserted) {
+          ret = dfb_font_insert_glyph( font, index, layer, data );
+          if (ret) {
+               if (data->row)
+                    direct_list_remove( &data->row->glyphs, &data->link );
+
+               goto error;
+          }
 
           data->inserted = true;
      }
@@ -987,6 +1284,420 @@ error:
      return ret;
 }
 
+DFBResult
+dfb_font_get_glyph_phase( CoreFont       *font,
+                          unsigned int    index,
+                          unsigned int    layer,
+                          unsigned int    phase,
+                          CoreGlyphData **ret_data )
+{
+     DFBResult        ret;
+     CoreGlyphData   *base;
+     CoreGlyphData   *data;
+     DFBFontManager  *manager;
+     DFBFontCacheRow *row;
+
+     D_DEBUG_AT( Core_Font, "%s( index %u, layer %u, phase %u )\n", __FUNCTION__, index, layer, phase );
+
+     D_MAGIC_ASSERT( font, CoreFont );
+     D_ASSERT( ret_data != NULL );
+
+     ret = dfb_font_get_glyph_data( font, index, layer, &base );
+     if (ret)
+          return ret;
+
+     /* Only visible glyphs of fonts rendering variants on horizontal baselines have them. */
+     if (!phase || !(font->flags & CFF_SUBPIXEL_PHASES) || !base->width || base->yadvance || base->retry) {
+          *ret_data = base;
+          return DFB_OK;
+     }
+
+     D_ASSERT( phase < (1 << font->subpixel_shift) );
+     D_ASSERT( phase < DFB_FONT_MAX_SUBPIXEL_PHASES );
+
+     manager = font->manager;
+
+     data = base->phases[phase-1];
+     if (data) {
+          D_MAGIC_ASSERT( data, CoreGlyphData );
+
+          row = data->row;
+          if (row && manager->rows != &row->link) {
+               DFB_FONT_CACHE_ROW_ASSERT( row );
+
+               direct_list_move_to_front( &manager->rows, &row->link );
+          }
+
+          if (!data->retry) {
+               *ret_data = data;
+               return DFB_OK;
+          }
+     }
+     else {
+          data = D_CALLOC( 1, sizeof(CoreGlyphData) );
+          if (!data)
+               return D_OOM();
+
+          D_MAGIC_SET( data, CoreGlyphData );
+
+          data->font  = font;
+          data->index = index;
+          data->layer = layer;
+          data->phase = phase;
+          data->base  = base;
+
+          base->phases[phase-1] = data;
+     }
+
+     ret = load_glyph( font, data );
+     if (ret) {
+          base->phases[phase-1] = NULL;
+
+          if (data->row)
+               direct_list_remove( &data->row->glyphs, &data->link );
+
+          D_MAGIC_CLEAR( data );
+          D_FREE( data );
+
+          /* Draw the glyph without subpixel offset. */
+          *ret_data = base;
+          return DFB_OK;
+     }
+
+     /* Loading is retried next time (BUFFEREMPTY), meanwhile draw the base glyph instead of an empty one. */
+     if (data->retry) {
+          *ret_data = base;
+          return DFB_OK;
+     }
+
+     *ret_data = data;
+
+     return DFB_OK;
+}
+
+/*
+ * Frees the subpixel variants of a glyph, except those in the given row which only get detached.
+ * Rows getting empty are destroyed if requested.
+ */
+static void
+free_phases( CoreGlyphData   *data,
+             DFBFontCacheRow *row,
+             bool             remove_empty )
+{
+     unsigned int i;
+
+     for (i=0; i<D_ARRAY_SIZE(data->phases); i++) {
+          CoreGlyphData *variant = data->phases[i];
+
+          if (!variant)
+               continue;
+
+          D_MAGIC_ASSERT( variant, CoreGlyphData );
+          D_ASSERT( variant->base == data );
+
+          data->phases[i] = NULL;
+          variant->base   = NULL;
+
+          if (row && variant->row == row)
+               continue;
+
+          if (variant->row) {
+               DFBFontCacheRow *variant_row = variant->row;
+
+               direct_list_remove( &variant_row->glyphs, &variant->link );
+
+               if (remove_empty && !variant_row->glyphs)
+                    remove_row( variant_row );
+          }
+
+          D_MAGIC_CLEAR( variant );
+          D_FREE( variant );
+     }
+}
+
+/**********************************************************************************************************************/
+
+static int
+compare_indices( const void *a, const void *b )
+{
+     unsigned int ia = *(const unsigned int*) a;
+     unsigned int ib = *(const unsigned int*) b;
+
+     return (ia > ib) - (ia < ib);
+}
+
+DFBResult
+dfb_font_prefetch_glyphs( CoreFont           *font,
+                          const unsigned int *indices,
+                          unsigned int        num )
+{
+     unsigned int   i, l, n = 0;
+     unsigned int   layers = 1;
+     unsigned int  *missing;
+     CoreGlyphData *data;
+
+     D_DEBUG_AT( Core_Font, "%s( %p, %u )\n", __FUNCTION__, font, num );
+
+     D_MAGIC_ASSERT( font, CoreFont );
+     D_ASSERT( indices != NULL || num == 0 );
+
+     if (!num)
+          return DFB_OK;
+
+     if (font->attributes & DFFA_OUTLINED)
+          layers = 2;
+
+     missing = D_MALLOC( num * sizeof(unsigned int) );
+     if (!missing)
+          return D_OOM();
+
+     dfb_font_lock( font );
+
+     for (i=0; i<num; i++) {
+          unsigned int index = indices[i];
+
+          if (lookup_glyph( font, index, 0 ))
+               continue;
+
+          missing[n++] = index;
+     }
+
+     dfb_font_unlock( font );
+
+     if (!n) {
+          D_FREE( missing );
+          return DFB_OK;
+     }
+
+     /* Drop duplicates, the module should rasterize each glyph once. */
+     qsort( missing, n, sizeof(unsigned int), compare_indices );
+
+     for (i=1, l=1; i<n; i++) {
+          if (missing[i] != missing[l-1])
+               missing[l++] = missing[i];
+     }
+
+     n = l;
+
+     D_DEBUG_AT( Core_Font, "  -> %u glyphs not cached\n", n );
+
+     /* Rasterize without holding the (manager wide) font lock. */
+     if (font->PrefetchGlyphs)
+          font->PrefetchGlyphs( font, missing, n );
+
+     /* Place them in the cache rows. */
+     dfb_font_lock( font );
+
+     for (i=0; i<n; i++) {
+          for (l=0; l<layers; l++)
+               dfb_font_get_glyph_data( font, missing[i], l, &data );
+     }
+
+     dfb_font_unlock( font );
+
+     D_FREE( missing );
+
+     return DFB_OK;
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Unlinks the layout from the manager's map and LRU list and frees it.
+ */
+static void
+remove_layout( DFBFontManager *manager,
+               CoreFontLayout *layout )
+{
+     CoreFontLayoutKey key;
+
+     D_MAGIC_ASSERT( layout, CoreFontLayout );
+     D_ASSERT( layout->cached );
+
+     key.font     = layout->font;
+     key.encoding = layout->encoding;
+     key.text     = layout->text;
+     key.bytes    = layout->bytes;
+
+     direct_map_remove( manager->layouts, &key );
+     direct_list_remove( &manager->layouts_lru, &layout->link );
+
+     D_ASSERT( manager->layout_stats.entries > 0 );
+
+     manager->layout_stats.entries--;
+
+     D_MAGIC_CLEAR( layout );
+     D_FREE( layout );
+}
+
+DFBResult
+dfb_font_layout_text( CoreFont           *font,
+                      DFBTextEncodingID   encoding,
+                      const void         *text,
+                      int                 bytes,
+                      CoreFontLayout    **ret_layout )
+{
+     DFBResult          ret;
+     int                i, n, num;
+     unsigned int       prev = 0;
+     unsigned int       indices[bytes];
+     int                x    = 0;
+     int                y    = 0;
+     bool               cache;
+     size_t             size;
+     CoreFontLayout    *layout;
+     CoreFontLayoutKey  key;
+     DFBFontManager    *manager;
+
+     D_DEBUG_AT( Core_Font, "%s( %p, %d bytes )\n", __FUNCTION__, font, bytes );
+
+     D_MAGIC_ASSERT( font, CoreFont );
+     D_ASSERT( text != NULL );
+     D_ASSERT( bytes > 0 );
+     D_ASSERT( ret_layout != NULL );
+
+     manager = font->manager;
+     DFB_FONT_MANAGER_ASSERT( manager );
+
+     cache = manager->max_layouts && bytes <= FONT_LAYOUT_MAX_BYTES;
+
+     if (cache) {
+          key.font     = font;
+          key.encoding = encoding;
+          key.text     = text;
+          key.bytes    = bytes;
+
+          manager->layout_stats.lookups++;
+
+          layout = direct_map_lookup( manager->layouts, &key );
+          if (layout) {
+               D_MAGIC_ASSERT( layout, CoreFontLayout );
+
+               if (!layout->retry) {
+                    D_DEBUG_AT( Core_Font, "  -> already laid out (%p)\n", layout );
+
+                    manager->layout_stats.hits++;
+
+                    direct_list_move_to_front( &manager->layouts_lru, &layout->link );
+
+                    *ret_layout = layout;
+
+                    return DFB_OK;
+               }
+
+               remove_layout( manager, layout );
+          }
+     }
+
+     /* Decode string to character indices. */
+     ret = dfb_font_decode_text( font, encoding, text, bytes, indices, &num );
+     if (ret)
+          return ret;
+
+     D_ASSERT( num <= bytes );
+
+     size = sizeof(CoreFontLayout) + num * sizeof(CoreLayoutGlyph);
+
+     layout = D_CALLOC( 1, size + (cache ? bytes : 0) );
+     if (!layout)
+          return D_OOM();
+
+     layout->font     = font;
+     layout->encoding = encoding;
+     layout->bytes    = bytes;
+     layout->glyphs   = (CoreLayoutGlyph*)(layout + 1);
+
+     for (i=0, n=0; i<num; i++) {
+          unsigned int   current = indices[i];
+          CoreGlyphData *glyph;
+          int            kx, ky = 0;
+
+          ret = dfb_font_get_glyph_data( font, current, 0, &glyph );
+          if (ret || glyph->retry) {
+               /* Metrics may still change, don't reuse this layout. */
+               layout->retry = true;
+
+               if (ret) {
+                    prev = current;
+                    continue;
+               }
+          }
+
+          if (prev && font->GetKerning &&
+              font->GetKerning( font, prev, current, &kx, &ky ) == DFB_OK) {
+               x += kx << 8;
+               y += ky << 8;
+          }
+
+          layout->glyphs[n].index = current;
+          layout->glyphs[n].x     = x;
+          layout->glyphs[n].y     = y;
+
+          n++;
+
+          DFBRectangle glyph_rect = { x + (glyph->left << 8), y + (glyph->top << 8),
+                                      glyph->width << 8, glyph->height << 8 };
+
+          dfb_rectangle_union( &layout->ink, &glyph_rect );
+
+          x += glyph->xadvance;
+          y += glyph->yadvance;
+
+          prev = current;
+     }
+
+     layout->num      = n;
+     layout->xadvance = x;
+     layout->yadvance = y;
+
+     D_MAGIC_SET( layout, CoreFontLayout );
+
+     if (cache) {
+          layout->text = (u8*) layout + size;
+
+          memcpy( (u8*) layout + size, text, bytes );
+
+          ret = direct_map_insert( manager->layouts, &key, layout );
+          if (ret == DFB_OK) {
+               layout->cached = true;
+
+               direct_list_prepend( &manager->layouts_lru, &layout->link );
+
+               manager->layout_stats.entries++;
+
+               while (manager->layout_stats.entries > manager->max_layouts) {
+                    CoreFontLayout *lru = direct_list_get_last( manager->layouts_lru );
+
+                    D_ASSERT( lru != layout );
+
+                    remove_layout( manager, lru );
+
+                    manager->layout_stats.evictions++;
+               }
+          }
+     }
+     else
+          layout->text = text;
+
+     *ret_layout = layout;
+
+     return DFB_OK;
+}
+
+void
+dfb_font_layout_done( CoreFont       *font,
+                      CoreFontLayout *layout )
+{
+     D_MAGIC_ASSERT( font, CoreFont );
+     D_MAGIC_ASSERT( layout, CoreFontLayout );
+     D_ASSERT( layout->font == font );
+
+     if (!layout->cached) {
+          D_MAGIC_CLEAR( layout );
+          D_FREE( layout );
+     }
+}
+
 /**********************************************************************************************************************/
 
 DFBResult
@@ -1173,8 +1884,10 @@ free_glyphs( DirectHash    *hash,
 
      CORE_GLYPH_DATA_DEBUG_AT( Core_Font, data );
 
-     /* Remove glyph from font. */
-     direct_hash_remove( hash, key );
+     /* Remove glyph and its variants from font. */
+     remove_glyph( data->font, data );
+
+     free_phases( data, NULL, true );
 
 
      row = data->row;
@@ -1185,24 +1898,8 @@ free_glyphs( DirectHash    *hash,
           direct_list_remove( &row->glyphs, &data->link );
 
           /* If cache row got empty, destroy it. */
-          if (!row->glyphs) {
-               DFBFontManager *manager;
-               DFBFontCache   *cache = row->cache;
-
-               DFB_FONT_CACHE_ASSERT( cache );
-
-               manager = cache->manager;
-               DFB_FONT_MANAGER_ASSERT( manager );
-
-               /* Remove row from cache. */
-               direct_list_remove( &cache->rows, &row->link );
-
-               /* Destroy row. */
-               dfb_font_cache_row_destroy( row );
-
-               /* Decrease row counter in manager. */
-               manager->num_rows--;
-          }
+          if (!row->glyphs)
+               remove_row( row );
      }
 
 
@@ -78,7 +78,10 @@ DFBResult dfb_font_cache_init            ( DFBFontCache            *cache,
 DFBResult dfb_font_cache_deinit          ( DFBFontCache            *cache );
 DFBResult dfb_font_cache_get_row         ( DFBFontCache            *cache,
                                            unsigned int             width,
-                                           DFBFontCacheRow        **ret_row );
+                                           unsigned int             height,
+                                           DFBFontCacheRow        **ret_row,
+                                           int                     *ret_x,
+                                           int                     *ret_y );
 
 DFBResult dfb_font_cache_row_create      ( DFBFontCache            *cache,
                                            DFBFontCacheRow        **ret_row );
@@ -91,6 +94,11 @@ DFBResult dfb_font_cache_row_deinit      ( DFBFontCacheRow         *row );
 
 
 
+/*
+ * maximum number of horizontal subpixel positions rendered per glyph
+ */
+#define DFB_FONT_MAX_SUBPIXEL_PHASES 4
+
 /*
  * glyph struct
  */
@@ -102,8 +110,11 @@ struct _CoreGlyphData {
      unsigned int     index;
      unsigned int     layer;
 
-     CoreSurface     *surface;              /* contains bitmap of glyph         */
+     CoreSurface     *surface;              /* contains bitmap of glyph, may be
+                                               set by GetGlyphData() to provide
+                                               it without using a cache row     */
      int              start;                /* x offset of glyph in surface     */
+     int              start_y;              /* y offset of glyph in surface     */
      int              width;                /* width of the glyphs bitmap       */
      int              height;               /* height of the glyphs bitmap      */
      int              left;                 /* x offset of the glyph            */
@@ -117,6 +128,10 @@ struct _CoreGlyphData {
 
      bool             inserted;
      bool             retry;
+
+     unsigned int     phase;                /* subpixel offset in 1/phases pixel */
+     CoreGlyphData   *base;                 /* glyph at phase 0 of a variant    */
+     CoreGlyphData   *phases[DFB_FONT_MAX_SUBPIXEL_PHASES-1];   /* variants of phase 0 */
 };
 
 #define CORE_GLYPH_DATA_DEBUG_AT(Domain, data)                                       \
@@ -161,13 +176,22 @@ typedef enum {
      CFF_NONE             = 0x00000000,
 
      CFF_SUBPIXEL_ADVANCE = 0x00000001,
+     CFF_SUBPIXEL_PHASES  = 0x00000002,   /* RenderGlyph() supports CoreGlyphData::phase */
 
-     CFF_ALL              = 0x00000001,
+     CFF_ALL              = 0x00000003,
 } CoreFontFlags;
 
 
 #define DFB_FONT_MAX_LAYERS 2
 
+/*
+ * Loaded glyphs are looked up via a two level table of pages allocated on demand,
+ * covering the Unicode code space. Higher indices are only found in the hash.
+ */
+#define DFB_FONT_GLYPH_PAGE_BITS  8
+#define DFB_FONT_GLYPH_PAGE_SIZE  (1 << DFB_FONT_GLYPH_PAGE_BITS)
+#define DFB_FONT_GLYPH_MAX_PAGES  (0x110000 >> DFB_FONT_GLYPH_PAGE_BITS)
+
 /*
  * font struct
  */
@@ -189,7 +213,8 @@ struct _CoreFont {
 
      struct {
           DirectHash              *glyph_hash;    /* infos about loaded glyphs        */
-          CoreGlyphData           *glyph_data[128];
+          CoreGlyphData         ***glyph_pages;   /* page table of glyph_hash         */
+          unsigned int             num_pages;
      } layers[DFB_FONT_MAX_LAYERS];
 
      int                           height;        /* font height                      */
@@ -223,6 +248,10 @@ struct _CoreFont {
                                                    int           *ret_x,
                                                    int           *ret_y );
 
+     DFBResult                  (* PrefetchGlyphs)( CoreFont           *thiz,
+                                                    const unsigned int *indices,
+                                                    unsigned int        num );
+
 
      int                           magic;
 
@@ -230,8 +259,40 @@ struct _CoreFont {
      int                           underline_thickness;
 
      CoreFontFlags                 flags;
+
+     unsigned int                  subpixel_shift; /* log2 of glyph variants per pixel */
 };
 
+/*
+ * laid out text run, positions are relative to the origin in 1/256 pixel
+ */
+typedef struct {
+     unsigned int     index;
+     int              x;                    /* pen position, kerning applied    */
+     int              y;
+} CoreLayoutGlyph;
+
+typedef struct {
+     DirectLink        link;                /* in the manager's LRU list        */
+
+     int               magic;
+
+     CoreFont         *font;
+     DFBTextEncodingID encoding;
+     const void       *text;                /* copy of the text, follows glyphs */
+     int               bytes;
+
+     int               num;                 /* glyphs available in layer 0      */
+     CoreLayoutGlyph  *glyphs;
+
+     int               xadvance;            /* pen position after the run       */
+     int               yadvance;
+     DFBRectangle      ink;                 /* union of glyph rectangles        */
+
+     bool              cached;
+     bool              retry;               /* some glyph needs to be reloaded  */
+} CoreFontLayout;
+
 #define CORE_FONT_DEBUG_AT(Domain, font)                                             \
      do {                                                                            \
           D_DEBUG_AT( Domain, "  -> ascender  %d\n", (font)->ascender );             \
@@ -287,6 +348,47 @@ DFBResult dfb_font_get_glyph_data( CoreFont        *font,
                                    unsigned int     layer,
                                    CoreGlyphData  **glyph_data );
 
+/*
+ * loads glyph data rendered at a horizontal subpixel offset of phase / (1 << subpixel_shift),
+ * falling back to phase 0 if the font doesn't support it
+ */
+DFBResult dfb_font_get_glyph_phase( CoreFont        *font,
+                                    unsigned int     index,
+                                    unsigned int     layer,
+                                    unsigned int     phase,
+                                    CoreGlyphData  **glyph_data );
+
+/*
+ * adds glyph data to the font's lookup tables, used by modules providing preloaded glyphs
+ */
+DFBResult dfb_font_insert_glyph( CoreFont        *font,
+                                 unsigned int     index,
+                                 unsigned int     layer,
+                                 CoreGlyphData   *data );
+
+/*
+ * loads the glyphs of all indices into the cache that are not cached yet,
+ * letting the font module rasterize them up front (without the font lock)
+ */
+DFBResult dfb_font_prefetch_glyphs( CoreFont           *font,
+                                    const unsigned int *indices,
+                                    unsigned int        num );
+
+/*
+ * decodes the text and lays out the glyphs of layer 0 including kerning,
+ * looking up the manager's LRU cache of runs first (font must be locked)
+ */
+DFBResult dfb_font_layout_text( CoreFont           *font,
+                                DFBTextEncodingID   encoding,
+                                const void         *text,
+                                int                 bytes,
+                                CoreFontLayout    **ret_layout );
+
+/*
+ * releases a layout returned by dfb_font_layout_text() before unlocking the font
+ */
+void dfb_font_layout_done( CoreFont       *font,
+                           CoreFontLayout *layout );
 
 /*
  * Called by font module to register encoding implementations.
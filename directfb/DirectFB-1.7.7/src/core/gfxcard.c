@@ -3646,20 +3646,18 @@ dfb_gfxcard_drawstring( const u8 *text, int bytes,
                         CoreFont *font, unsigned int layers, CoreGraphicsStateClient *client,
                         DFBSurfaceTextFlags flags )
 {
-     DFBResult     ret;
-     unsigned int  prev = 0;
-     unsigned int  indices[bytes];
-     int           i, l, num;
-     int           kern_x;
-     int           kern_y;
-     CoreSurface  *surface;
-     CardState     state_backup;
-     DFBPoint      points[50];
-     DFBRectangle  rects[50];
-     int           num_blits = 0;
-     int           ox = x;
-     int           oy = y;
-     CardState    *state;
+     DFBResult       ret;
+     int             i, l;
+     CoreFontLayout *layout;
+     unsigned int    shift;
+     CoreSurface    *surface;
+     CardState       state_backup;
+     DFBPoint        points[50];
+     DFBRectangle    rects[50];
+     int             num_blits = 0;
+     int             ox = x;
+     int             oy = y;
+     CardState      *state;
 
      if (encoding == DTEID_UTF8)
           D_DEBUG_AT( Core_GraphicsOps, "%s( '%s' [%d], %d,%d, %p, %p )\n",
@@ -3691,40 +3689,44 @@ dfb_gfxcard_drawstring( const u8 *text, int bytes,
           }
      }
 
-     /* Decode string to character indices. */
-     ret = dfb_font_decode_text( font, encoding, text, bytes, indices, &num );
-     if (ret)
+     dfb_font_lock( font );
+
+     /* Decode string and position glyphs, usually found in the layout cache. */
+     ret = dfb_font_layout_text( font, encoding, text, bytes, &layout );
+     if (ret) {
+          dfb_font_unlock( font );
           return;
+     }
 
      font_state_prepare( state, &state_backup, font, surface, !(flags & DSTF_BLEND_FUNCS) );
 
-     dfb_font_lock( font );
+     shift = (font->flags & CFF_SUBPIXEL_PHASES) ? font->subpixel_shift : 0;
 
      for (l=layers-1; l>=0; l--) {
-          x = ox << 8;
-          y = oy << 8;
-
           if (layers > 1)
                dfb_state_set_color( state, &state->colors[l] );
 
           /* blit glyphs */
-          for (i=0; i<num; i++) {
+          for (i=0; i<layout->num; i++) {
                DFBResult      ret;
                CoreGlyphData *glyph;
-               unsigned int   current = indices[i];
+               unsigned int   phase = 0;
+
+               x = (ox << 8) + layout->glyphs[i].x;
+               y = (oy << 8) + layout->glyphs[i].y;
+
+               /* Round to the nearest subpixel phase, whose variant is drawn at the pixel to the left. */
+               if (shift) {
+                    x    += 0x80 >> shift;
+                    phase = (x >> (8 - shift)) & ((1 << shift) - 1);
+               }
 
-               ret = dfb_font_get_glyph_data( font, current, l, &glyph );
+               ret = dfb_font_get_glyph_phase( font, layout->glyphs[i].index, l, phase, &glyph );
                if (ret) {
                     D_DEBUG_AT( Core_GraphicsOps, "  -> dfb_font_get_glyph_data() failed! [%s]\n", DirectFBErrorString( ret ) );
-                    prev = current;
                     continue;
                }
 
-               if (prev && font->GetKerning && font->GetKerning( font, prev, current, &kern_x, &kern_y) == DFB_OK) {
-                    x += kern_x << 8;
-                    y += kern_y << 8;
-               }
-
                if (glyph->width) {
                     if (glyph->surface != state->source || num_blits == D_ARRAY_SIZE(rects)) {
                          if (num_blits) {
@@ -3737,14 +3739,10 @@ dfb_gfxcard_drawstring( const u8 *text, int bytes,
                     }
 
                     points[num_blits] = (DFBPoint){ (x >> 8) + glyph->left, (y >> 8) + glyph->top };
-                    rects[num_blits]  = (DFBRectangle){ glyph->start, 0, glyph->width, glyph->height };
+                    rects[num_blits]  = (DFBRectangle){ glyph->start, glyph->start_y, glyph->width, glyph->height };
 
                     num_blits++;
                }
-
-               x   += glyph->xadvance;
-               y   += glyph->yadvance;
-               prev = current;
           }
 
           if (num_blits) {
@@ -3753,6 +3751,8 @@ dfb_gfxcard_drawstring( const u8 *text, int bytes,
           }
      }
 
+     dfb_font_layout_done( font, layout );
+
      dfb_font_unlock( font );
 
      font_state_restore( state, &state_backup );
@@ -3790,7 +3790,7 @@ void dfb_gfxcard_drawglyph( CoreGlyphData **glyph, int x, int y,
 
           /* blit glyph */
           if (glyph[l]->width) {
-               DFBRectangle rect  = { glyph[l]->start, 0, glyph[l]->width, glyph[l]->height };
+               DFBRectangle rect  = { glyph[l]->start, glyph[l]->start_y, glyph[l]->width, glyph[l]->height };
                DFBPoint     point = { x + glyph[l]->left, y + glyph[l]->top };
 
                dfb_state_set_source( state, glyph[l]->surface );
@@ -573,7 +573,7 @@ dfb_layer_region_flip_update( CoreLayerRegion     *region,
                                                        update, &left,
                                                        NULL, NULL );
 
-                         if (!(dfb_system_caps() & CSCAPS_NOTIFY_DISPLAY)) {
+                         if (!(dfb_layer_system_caps( layer ) & CSCAPS_NOTIFY_DISPLAY)) {
                               D_DEBUG_AT( Core_Layers, "  -> system WITHOUT notify_display support, calling it now\n" );
 
                               dfb_surface_notify_display2( surface, left.allocation->index, NULL );
@@ -651,7 +651,7 @@ update_only:
                                                &rotated, &left,
                                                NULL, NULL );
 
-                    if (!(dfb_system_caps() & CSCAPS_NOTIFY_DISPLAY)) {
+                    if (!(dfb_layer_system_caps( layer ) & CSCAPS_NOTIFY_DISPLAY)) {
                          D_DEBUG_AT( Core_Layers, "  -> system WITHOUT notify_display support, calling it now\n" );
 
                          dfb_surface_notify_display2( surface, left.allocation->index, NULL );
@@ -1575,7 +1575,7 @@ dfb_layer_region_unrealize( CoreLayerRegion *region )
           if (ret)
                D_DERROR( ret, "Core/Layers: RemoveRegion failed!\n" );
 
-          if (!(dfb_system_caps() & CSCAPS_DISPLAY_TASKS)) {
+          if (!(dfb_layer_system_caps( layer ) & CSCAPS_DISPLAY_TASKS)) {
                D_DEBUG_AT( Core_Layers, "  -> system WITHOUT display task support, calling Task_Done on last task\n" );
 
                if (layer->prev_task)
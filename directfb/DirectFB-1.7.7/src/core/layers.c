@@ -606,6 +606,26 @@ dfb_layer_id( const CoreLayer *layer )
      return layer->shared->layer_id;
 }
 
+CoreSystemCapabilities
+dfb_layer_system_caps( const CoreLayer *layer )
+{
+     D_ASSERT( layer != NULL );
+     D_ASSERT( layer->shared != NULL );
+
+     return dfb_system_caps() | layer->shared->system_caps;
+}
+
+void
+dfb_layer_add_system_caps( CoreLayer              *layer,
+                           CoreSystemCapabilities  caps )
+{
+     D_ASSERT( layer != NULL );
+     D_ASSERT( layer->shared != NULL );
+     D_FLAGS_ASSERT( caps, CSCAPS_DISPLAY_TASKS | CSCAPS_NOTIFY_DISPLAY | CSCAPS_DISPLAY_PTS );
+
+     layer->shared->system_caps |= caps;
+}
+
 DFBDisplayLayerID
 dfb_layer_id_translated( const CoreLayer *layer )
 {
@@ -39,6 +39,7 @@
 
 #include <core/gfxcard.h>
 #include <core/surface_buffer.h>
+#include <core/system.h>
 
 
 struct __DFB_CoreLayerRegionConfig {
@@ -388,6 +389,17 @@ DFBDisplayLayerID dfb_layer_id_translated( const CoreLayer *layer );
 
 DFBDisplayLayerID dfb_layer_id_translate( DFBDisplayLayerID layer_id );
 
+/*
+ * Returns the system capabilities plus display task handling done by the driver of this layer only.
+ */
+CoreSystemCapabilities dfb_layer_system_caps( const CoreLayer *layer );
+
+/*
+ * Called by drivers completing display tasks or notifying display of one layer themselves.
+ */
+void dfb_layer_add_system_caps( CoreLayer              *layer,
+                                CoreSystemCapabilities  caps );
+
 DFBSurfacePixelFormat dfb_primary_layer_pixelformat( void );
 
 #endif
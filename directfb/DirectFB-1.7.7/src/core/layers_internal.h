@@ -82,6 +82,8 @@ typedef struct {
      FusionCall                         call;
 
      DFBSurfacePixelFormat              pixelformat;
+
+     CoreSystemCapabilities             system_caps;   /* display task handling done by the driver */
 } CoreLayerShared;
 
 struct __DFB_CoreLayer {
@@ -0,0 +1,745 @@
+/*
+   (c) Copyright 2012-2013  DirectFB integrated media GmbH
+   (c) Copyright 2001-2013  The world wide DirectFB Open Source Community (directfb.org)
+   (c) Copyright 2000-2004  Convergence (integrated media) GmbH
+
+   All rights reserved.
+
+   Written by Denis Oliver Kropp <dok@directfb.org>,
+              Andreas Shimokawa <andi@directfb.org>,
+              Marek Pikarski <mass@directfb.org>,
+              Sven Neumann <neo@directfb.org>,
+              Ville Syrjälä <syrjala@sci.fi> and
+              Claudio Ciccani <klan@users.sf.net>.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <direct/atomic.h>
+#include <direct/debug.h>
+#include <direct/hash.h>
+#include <direct/mem.h>
+#include <direct/system.h>
+#include <direct/util.h>
+
+#include <fusion/conf.h>
+#include <fusion/vector.h>
+
+#include <core/core.h>
+#include <core/surface_allocation.h>
+#include <core/surface_pool.h>
+#include <core/system.h>
+
+#include <misc/conf.h>
+
+D_DEBUG_DOMAIN( Core_MemFD, "Core/MemFD", "Core MemFD Surface Pool" );
+
+/**********************************************************************************************************************/
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+/*
+ * The pool allocates buffers as memfd files (or imports memfd/dma-buf file descriptors of the application).
+ *
+ * Only the master keeps the file descriptors open. Other processes import the master's descriptor on their first lock,
+ * either via pidfd_getfd() or by opening /proc/<pid>/fd/<fd>, so no pixel data is ever copied.
+ *
+ * The mapping is kept per process until the allocation is gone. Each allocation has a unique serial, the master
+ * records the serials of deallocated buffers in a ring, which the other processes check for mappings to remove.
+ */
+
+#define MEMFD_RETIRED_RING  64
+
+typedef struct {
+     pid_t          master_pid;
+
+     bool           allocate;      /* regular allocations enabled via "surface-memfd" */
+
+     unsigned long  serial;        /* serial of the latest allocation */
+
+     unsigned int   retired;       /* number of deallocations, see 'retired_serials' */
+     unsigned long  retired_serials[MEMFD_RETIRED_RING];
+} MemFDPoolData;
+
+typedef struct {
+     pthread_mutex_t  lock;
+
+     DirectHash      *maps;        /* MemFDLocalMap by allocation serial (slaves only) */
+
+     unsigned int     retired;     /* deallocations already handled */
+} MemFDPoolLocalData;
+
+typedef struct {
+     void            *addr;
+     size_t           length;
+} MemFDLocalMap;
+
+typedef struct {
+     unsigned long serial;
+
+     int          fd;            /* file descriptor in the master */
+     unsigned int offset;        /* offset of the pixel data within the file */
+     int          pitch;
+     int          size;          /* size of the pixel data */
+     size_t       length;        /* length of the mapping, including the offset */
+
+     bool         imported;      /* file descriptor came from the application */
+
+     void        *master_map;
+} MemFDAllocationData;
+
+/**********************************************************************************************************************/
+
+static int
+memfd_create_fd( const char *name )
+{
+#ifdef __NR_memfd_create
+     return syscall( __NR_memfd_create, name, MFD_CLOEXEC );
+#else
+     errno = ENOSYS;
+     return -1;
+#endif
+}
+
+/*
+ * Returns a new file descriptor in the calling process referring to the file of 'fd' in process 'pid'.
+ */
+static int
+memfd_import_fd( pid_t pid,
+                 int   fd )
+{
+     char buf[64];
+     int  ret;
+
+     if (pid == getpid())
+          return dup( fd );
+
+#if defined(__NR_pidfd_open) && defined(__NR_pidfd_getfd)
+     {
+          int pidfd = syscall( __NR_pidfd_open, pid, 0 );
+
+          if (pidfd >= 0) {
+               ret = syscall( __NR_pidfd_getfd, pidfd, fd, 0 );
+
+               close( pidfd );
+
+               if (ret >= 0)
+                    return ret;
+          }
+     }
+#endif
+
+     /* Fallback, works for memfd, but not for dma-buf */
+     snprintf( buf, sizeof(buf), "/proc/%d/fd/%d", pid, fd );
+
+     ret = open( buf, O_RDWR | O_CLOEXEC );
+     if (ret < 0)
+          D_PERROR( "Core/Surface/MemFD: Could not import file descriptor %d of process %d!\n", fd, pid );
+
+     return ret;
+}
+
+/*
+ * Checks that the file of an imported descriptor has at least 'length' bytes, and prevents it from shrinking if
+ * it is a memfd allowing seals.
+ */
+static DFBResult
+memfd_check_length( int    fd,
+                    size_t length )
+{
+     struct stat st;
+     off_t       size;
+
+     if (fstat( fd, &st ) < 0) {
+          D_PERROR( "Core/Surface/MemFD: Could not stat imported file descriptor!\n" );
+          return DFB_IO;
+     }
+
+     /* The size of a dma-buf is only reported by seeking to its end. */
+     size = S_ISREG( st.st_mode ) ? st.st_size : lseek( fd, 0, SEEK_END );
+
+     if (size < 0 || (unsigned long long) size < length) {
+          D_ERROR( "Core/Surface/MemFD: Imported file has %lld bytes, buffer needs %zu!\n", (long long) size, length );
+          return DFB_INVARG;
+     }
+
+#ifdef F_ADD_SEALS
+     fcntl( fd, F_ADD_SEALS, F_SEAL_SHRINK );
+#endif
+
+     return DFB_OK;
+}
+
+static void *
+memfd_map( int    fd,
+           size_t length )
+{
+     int   flags = MAP_SHARED;
+     void *map;
+
+     if (direct_config_get_int_value_with_default( "fusion-shm-populate", 0 ))
+          flags |= MAP_POPULATE;
+
+     map = mmap( NULL, length, PROT_READ | PROT_WRITE, flags, fd, 0 );
+     if (map == MAP_FAILED) {
+          D_PERROR( "Core/Surface/MemFD: Could not mmap %zu bytes of file descriptor %d!\n", length, fd );
+          return NULL;
+     }
+
+     return map;
+}
+
+static bool
+memfd_unmap_local( DirectHash    *hash,
+                   unsigned long  key,
+                   void          *value,
+                   void          *ctx )
+{
+     MemFDLocalMap *map = value;
+
+     munmap( map->addr, map->length );
+
+     D_FREE( map );
+
+     return true;
+}
+
+static DFBResult
+memfd_init_local( MemFDPoolLocalData *local )
+{
+     DFBResult ret;
+
+     ret = direct_hash_create( 7, &local->maps );
+     if (ret) {
+          D_DERROR( ret, "Core/Surface/MemFD: Could not create local hash table!\n" );
+          return ret;
+     }
+
+     pthread_mutex_init( &local->lock, NULL );
+
+     return DFB_OK;
+}
+
+static void
+memfd_deinit_local( MemFDPoolLocalData *local )
+{
+     direct_hash_iterate( local->maps, memfd_unmap_local, NULL );
+     direct_hash_destroy( local->maps );
+
+     pthread_mutex_destroy( &local->lock );
+}
+
+/*
+ * Keeps only the local mappings of allocations still existing, if too many deallocations were missed to know the
+ * retired serials. Mappings of existing allocations may still be in use, so they are never removed.
+ */
+static void
+memfd_keep_live( CoreSurfacePool    *pool,
+                 MemFDPoolData      *data,
+                 MemFDPoolLocalData *local )
+{
+     int                    i;
+     DirectHash            *maps;
+     CoreSurfaceAllocation *allocation;
+
+     if (direct_hash_create( 7, &maps )) {
+          D_OOM();
+          return;
+     }
+
+     /* The pool lock excludes deallocations while looking at the list. */
+     if (fusion_skirmish_prevail( &pool->lock )) {
+          direct_hash_destroy( maps );
+          return;
+     }
+
+     fusion_vector_foreach (allocation, i, pool->allocs) {
+          MemFDAllocationData *alloc = allocation->data;
+          MemFDLocalMap       *map   = direct_hash_lookup( local->maps, alloc->serial );
+
+          if (map) {
+               direct_hash_remove( local->maps, alloc->serial );
+               direct_hash_insert( maps, alloc->serial, map );
+          }
+     }
+
+     local->retired = data->retired;
+
+     fusion_skirmish_dismiss( &pool->lock );
+
+     D_DEBUG_AT( Core_MemFD, "  -> removing %d mappings of deallocated buffers\n", direct_hash_count( local->maps ) );
+
+     /* Only mappings of deallocated buffers are left. */
+     direct_hash_iterate( local->maps, memfd_unmap_local, NULL );
+     direct_hash_destroy( local->maps );
+
+     local->maps = maps;
+}
+
+/*
+ * Removes the local mappings of buffers deallocated by the master meanwhile, called with the local lock held.
+ */
+static void
+memfd_remove_retired( CoreSurfacePool    *pool,
+                      MemFDPoolData      *data,
+                      MemFDPoolLocalData *local )
+{
+     unsigned int retired = data->retired;
+     unsigned int first   = local->retired;
+
+     if (retired - first > MEMFD_RETIRED_RING) {
+          D_DEBUG_AT( Core_MemFD, "  -> missed %u deallocations\n", retired - local->retired );
+
+          memfd_keep_live( pool, data, local );
+          return;
+     }
+
+     while (local->retired != retired) {
+          unsigned long  serial = data->retired_serials[local->retired % MEMFD_RETIRED_RING];
+          MemFDLocalMap *map    = direct_hash_lookup( local->maps, serial );
+
+          if (map) {
+               D_DEBUG_AT( Core_MemFD, "  -> removing mapping of serial %lu\n", serial );
+
+               direct_hash_remove( local->maps, serial );
+
+               memfd_unmap_local( local->maps, serial, map, NULL );
+          }
+
+          local->retired++;
+     }
+
+     /* Entries read may have been overwritten meanwhile, these serials are retired as well, but others were missed. */
+     if (data->retired - first > MEMFD_RETIRED_RING)
+          memfd_keep_live( pool, data, local );
+}
+
+/**********************************************************************************************************************/
+
+static int
+memfdPoolDataSize( void )
+{
+     return sizeof(MemFDPoolData);
+}
+
+static int
+memfdPoolLocalDataSize( void )
+{
+     return sizeof(MemFDPoolLocalData);
+}
+
+static int
+memfdAllocationDataSize( void )
+{
+     return sizeof(MemFDAllocationData);
+}
+
+static DFBResult
+memfdInitPool( CoreDFB                    *core,
+               CoreSurfacePool            *pool,
+               void                       *pool_data,
+               void                       *pool_local,
+               void                       *system_data,
+               CoreSurfacePoolDescription *ret_desc )
+{
+     DFBResult           ret;
+     MemFDPoolData      *data  = pool_data;
+     MemFDPoolLocalData *local = pool_local;
+
+     D_DEBUG_AT( Core_MemFD, "%s()\n", __FUNCTION__ );
+
+     D_MAGIC_ASSERT( pool, CoreSurfacePool );
+     D_ASSERT( ret_desc != NULL );
+
+     ret = memfd_init_local( local );
+     if (ret)
+          return ret;
+
+     /* Imports are always supported, regular allocations only if enabled. */
+     ret_desc->caps              = CSPCAPS_VIRTUAL;
+     ret_desc->access[CSAID_CPU] = CSAF_READ | CSAF_WRITE | CSAF_SHARED;
+     ret_desc->types             = CSTF_PREALLOCATED | CSTF_INTERNAL;
+     ret_desc->priority          = CSPP_PREFERED;
+
+     data->allocate = direct_config_get_int_value( "surface-memfd" );
+
+     if (data->allocate) {
+          ret_desc->types |= CSTF_LAYER | CSTF_WINDOW | CSTF_CURSOR | CSTF_FONT | CSTF_SHARED;
+
+          if (dfb_system_caps() & CSCAPS_SYSMEM_EXTERNAL)
+               ret_desc->types |= CSTF_EXTERNAL;
+     }
+
+     snprintf( ret_desc->name, DFB_SURFACE_POOL_DESC_NAME_LENGTH, "MemFD Memory" );
+
+     data->master_pid = getpid();
+
+     return DFB_OK;
+}
+
+static DFBResult
+memfdJoinPool( CoreDFB         *core,
+               CoreSurfacePool *pool,
+               void            *pool_data,
+               void            *pool_local,
+               void            *system_data )
+{
+     DFBResult           ret;
+     MemFDPoolData      *data  = pool_data;
+     MemFDPoolLocalData *local = pool_local;
+
+     D_DEBUG_AT( Core_MemFD, "%s()\n", __FUNCTION__ );
+
+     D_MAGIC_ASSERT( pool, CoreSurfacePool );
+
+     ret = memfd_init_local( local );
+     if (ret)
+          return ret;
+
+     local->retired = data->retired;
+
+     return DFB_OK;
+}
+
+static DFBResult
+memfdDestroyPool( CoreSurfacePool *pool,
+                  void            *pool_data,
+                  void            *pool_local )
+{
+     MemFDPoolLocalData *local = pool_local;
+
+     D_DEBUG_AT( Core_MemFD, "%s()\n", __FUNCTION__ );
+
+     D_MAGIC_ASSERT( pool, CoreSurfacePool );
+
+     memfd_deinit_local( local );
+
+     return DFB_OK;
+}
+
+static DFBResult
+memfdLeavePool( CoreSurfacePool *pool,
+                void            *pool_data,
+                void            *pool_local )
+{
+     MemFDPoolLocalData *local = pool_local;
+
+     D_DEBUG_AT( Core_MemFD, "%s()\n", __FUNCTION__ );
+
+     D_MAGIC_ASSERT( pool, CoreSurfacePool );
+
+     memfd_deinit_local( local );
+
+     return DFB_OK;
+}
+
+static DFBResult
+memfdTestConfig( CoreSurfacePool         *pool,
+                 void                    *pool_data,
+                 void                    *pool_local,
+                 CoreSurfaceBuffer       *buffer,
+                 const CoreSurfaceConfig *config )
+{
+     CoreSurface   *surface;
+     MemFDPoolData *data = pool_data;
+
+     D_DEBUG_AT( Core_MemFD, "%s()\n", __FUNCTION__ );
+
+     D_MAGIC_ASSERT( pool, CoreSurfacePool );
+     D_MAGIC_ASSERT( buffer, CoreSurfaceBuffer );
+     D_ASSERT( config != NULL );
+
+     surface = buffer->surface;
+     D_MAGIC_ASSERT( surface, CoreSurface );
+
+     /* Preallocated buffers must come from our own PreAlloc(). */
+     if (surface->type & CSTF_PREALLOCATED)
+          return (surface->config.preallocated_pool_id == pool->pool_id) ? DFB_OK : DFB_UNSUPPORTED;
+
+     return data->allocate ? DFB_OK : DFB_UNSUPPORTED;
+}
+
+static DFBResult
+memfdPreAlloc( CoreSurfacePool             *pool,
+               void                        *pool_data,
+               void                        *pool_local,
+               const DFBSurfaceDescription *description,
+               CoreSurfaceConfig           *config )
+{
+     unsigned int i, num = 1;
+
+     D_DEBUG_AT( Core_MemFD, "%s()\n", __FUNCTION__ );
+
+     D_MAGIC_ASSERT( pool, CoreSurfacePool );
+
+     if (!(config->flags & CSCONF_PREALLOCATED_FD))
+          return DFB_UNSUPPORTED;
+
+     if (config->caps & DSCAPS_VIDEOONLY)
+          return DFB_UNSUPPORTED;
+
+     if (config->caps & DSCAPS_DOUBLE)
+          num = 2;
+     else if (config->caps & DSCAPS_TRIPLE)
+          num = 3;
+
+     /* Runs in the creating process, the master imports the descriptors during allocation. */
+     for (i=0; i<num; i++) {
+          config->preallocated[i].addr = NULL;
+          config->preallocated[i].pid  = getpid();
+     }
+
+     return DFB_OK;
+}
+
+static DFBResult
+memfdAllocateBuffer( CoreSurfacePool       *pool,
+                     void                  *pool_data,
+                     void                  *pool_local,
+                     CoreSurfaceBuffer     *buffer,
+                     CoreSurfaceAllocation *allocation,
+                     void                  *alloc_data )
+{
+     DFBResult            ret;
+     CoreSurface         *surface;
+     MemFDPoolData       *data  = pool_data;
+     MemFDAllocationData *alloc = alloc_data;
+
+     D_DEBUG_AT( Core_MemFD, "%s()\n", __FUNCTION__ );
+
+     D_MAGIC_ASSERT( pool, CoreSurfacePool );
+     D_MAGIC_ASSERT( buffer, CoreSurfaceBuffer );
+
+     surface = buffer->surface;
+     D_MAGIC_ASSERT( surface, CoreSurface );
+
+     if (surface->type & CSTF_PREALLOCATED) {
+          int index = dfb_surface_buffer_index( buffer );
+
+          if (surface->config.preallocated[index].pitch < DFB_BYTES_PER_LINE( surface->config.format,
+                                                                              surface->config.size.w ))
+               return DFB_BUG;
+
+          alloc->fd = memfd_import_fd( surface->config.preallocated[index].pid, surface->config.preallocated[index].fd );
+          if (alloc->fd < 0)
+               return DFB_IO;
+
+          alloc->imported = true;
+          alloc->offset   = surface->config.preallocated[index].offset;
+          alloc->pitch    = surface->config.preallocated[index].pitch;
+          alloc->size     = alloc->pitch * DFB_PLANE_MULTIPLY( surface->config.format, surface->config.size.h );
+          alloc->length   = alloc->offset + alloc->size;
+
+          /* Accessing pages beyond the end of the file would raise SIGBUS, the data of all planes must be there. */
+          ret = memfd_check_length( alloc->fd, alloc->length );
+          if (ret) {
+               close( alloc->fd );
+               return ret;
+          }
+
+          allocation->flags = CSALF_PREALLOCATED;
+     }
+     else {
+          char name[64];
+
+          dfb_surface_calc_buffer_size( surface, 8, 0, &alloc->pitch, &alloc->size );
+
+          snprintf( name, sizeof(name), "dfb-surface-0x%08x", surface->object.id );
+
+          alloc->fd = memfd_create_fd( name );
+          if (alloc->fd < 0) {
+               D_PERROR( "Core/Surface/MemFD: Could not create memfd '%s'!\n", name );
+               return DFB_IO;
+          }
+
+          if (ftruncate( alloc->fd, alloc->size ) < 0) {
+               D_PERROR( "Core/Surface/MemFD: Setting size of '%s' to %d failed!\n", name, alloc->size );
+               close( alloc->fd );
+               return DFB_IO;
+          }
+
+          alloc->imported = false;
+          alloc->offset   = 0;
+          alloc->length   = alloc->size;
+
+          allocation->flags = CSALF_VOLATILE;
+     }
+
+     alloc->master_map = memfd_map( alloc->fd, alloc->length );
+     if (!alloc->master_map) {
+          close( alloc->fd );
+          return DFB_IO;
+     }
+
+     alloc->serial = ++data->serial;
+
+     D_DEBUG_AT( Core_MemFD, "  -> fd %d, offset %u, pitch %d, size %d%s, serial %lu\n", alloc->fd, alloc->offset,
+                 alloc->pitch, alloc->size, alloc->imported ? " (imported)" : "", alloc->serial );
+
+     allocation->size = alloc->size;
+
+     return DFB_OK;
+}
+
+static DFBResult
+memfdDeallocateBuffer( CoreSurfacePool       *pool,
+                       void                  *pool_data,
+                       void                  *pool_local,
+                       CoreSurfaceBuffer     *buffer,
+                       CoreSurfaceAllocation *allocation,
+                       void                  *alloc_data )
+{
+     MemFDPoolData       *data  = pool_data;
+     MemFDAllocationData *alloc = alloc_data;
+
+     D_DEBUG_AT( Core_MemFD, "%s()\n", __FUNCTION__ );
+
+     D_MAGIC_ASSERT( pool, CoreSurfacePool );
+     D_MAGIC_ASSERT( allocation, CoreSurfaceAllocation );
+
+     munmap( alloc->master_map, alloc->length );
+
+     close( alloc->fd );
+
+     /* Let other processes remove their mappings. */
+     data->retired_serials[data->retired % MEMFD_RETIRED_RING] = alloc->serial;
+
+     D_SYNC_ADD( &data->retired, 1 );
+
+     return DFB_OK;
+}
+
+static DFBResult
+memfdLock( CoreSurfacePool       *pool,
+           void                  *pool_data,
+           void                  *pool_local,
+           CoreSurfaceAllocation *allocation,
+           void                  *alloc_data,
+           CoreSurfaceBufferLock *lock )
+{
+     MemFDPoolData       *data  = pool_data;
+     MemFDPoolLocalData  *local = pool_local;
+     MemFDAllocationData *alloc = alloc_data;
+
+     D_DEBUG_AT( Core_MemFD, "%s() <- size %d\n", __FUNCTION__, alloc->size );
+
+     D_MAGIC_ASSERT( pool, CoreSurfacePool );
+     D_MAGIC_ASSERT( allocation, CoreSurfaceAllocation );
+     D_MAGIC_ASSERT( lock, CoreSurfaceBufferLock );
+
+     if (dfb_core_is_master( core_dfb )) {
+          lock->addr = alloc->master_map + alloc->offset;
+     }
+     else {
+          MemFDLocalMap *map;
+
+          pthread_mutex_lock( &local->lock );
+
+          memfd_remove_retired( pool, data, local );
+
+          map = direct_hash_lookup( local->maps, alloc->serial );
+          if (!map) {
+               int fd = memfd_import_fd( data->master_pid, alloc->fd );
+
+               if (fd < 0) {
+                    pthread_mutex_unlock( &local->lock );
+                    return DFB_IO;
+               }
+
+               map = D_CALLOC( 1, sizeof(MemFDLocalMap) );
+               if (!map) {
+                    close( fd );
+                    pthread_mutex_unlock( &local->lock );
+                    return D_OOM();
+               }
+
+               /* The mapping stays valid without the imported descriptor. */
+               map->addr   = memfd_map( fd, alloc->length );
+               map->length = alloc->length;
+
+               close( fd );
+
+               if (!map->addr) {
+                    D_FREE( map );
+                    pthread_mutex_unlock( &local->lock );
+                    return DFB_IO;
+               }
+
+               direct_hash_insert( local->maps, alloc->serial, map );
+
+               D_DEBUG_AT( Core_MemFD, "  -> mapped serial %lu to %p\n", alloc->serial, map->addr );
+          }
+
+          lock->addr = map->addr + alloc->offset;
+
+          pthread_mutex_unlock( &local->lock );
+     }
+
+     lock->pitch = alloc->pitch;
+
+     return DFB_OK;
+}
+
+static DFBResult
+memfdUnlock( CoreSurfacePool       *pool,
+             void                  *pool_data,
+             void                  *pool_local,
+             CoreSurfaceAllocation *allocation,
+             void                  *alloc_data,
+             CoreSurfaceBufferLock *lock )
+{
+     D_DEBUG_AT( Core_MemFD, "%s()\n", __FUNCTION__ );
+
+     D_MAGIC_ASSERT( pool, CoreSurfacePool );
+     D_MAGIC_ASSERT( allocation, CoreSurfaceAllocation );
+     D_MAGIC_ASSERT( lock, CoreSurfaceBufferLock );
+
+     return DFB_OK;
+}
+
+const SurfacePoolFuncs memfdSurfacePoolFuncs = {
+     .PoolDataSize       = memfdPoolDataSize,
+     .PoolLocalDataSize  = memfdPoolLocalDataSize,
+     .AllocationDataSize = memfdAllocationDataSize,
+     .InitPool           = memfdInitPool,
+     .JoinPool           = memfdJoinPool,
+     .DestroyPool        = memfdDestroyPool,
+     .LeavePool          = memfdLeavePool,
+
+     .TestConfig         = memfdTestConfig,
+
+     .PreAlloc           = memfdPreAlloc,
+     .AllocateBuffer     = memfdAllocateBuffer,
+     .DeallocateBuffer   = memfdDeallocateBuffer,
+
+     .Lock               = memfdLock,
+     .Unlock             = memfdUnlock,
+};
+
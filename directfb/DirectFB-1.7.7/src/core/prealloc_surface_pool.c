@@ -113,6 +113,9 @@ preallocPrealloc( CoreSurfacePool             *pool,
 
      D_MAGIC_ASSERT( pool, CoreSurfacePool );
 
+     if (!(description->flags & DSDESC_PREALLOCATED))
+          return DFB_UNSUPPORTED;
+
      if (config->caps & DSCAPS_VIDEOONLY)
           return DFB_UNSUPPORTED;
 
@@ -38,7 +38,10 @@
 #include <zlib.h>
 #endif
 
+#include <direct/atomic.h>
+#include <direct/clock.h>
 #include <direct/debug.h>
+#include <direct/util.h>
 
 #include <core/core.h>
 #include <core/palette.h>
@@ -779,11 +782,11 @@ dfb_surface_reconfig( CoreSurface             *surface,
      if (config->flags & CSCONF_PREALLOCATED)
           return DFB_UNSUPPORTED;
 
-     if (fusion_skirmish_prevail( &surface->lock ))
+     if (dfb_surface_lock( surface ))
           return DFB_FUSION;
 
      if (surface->type & CSTF_PREALLOCATED) {
-          fusion_skirmish_dismiss( &surface->lock );
+          dfb_surface_unlock( surface );
           return DFB_UNSUPPORTED;
      }
 
@@ -794,7 +797,7 @@ dfb_surface_reconfig( CoreSurface             *surface,
      {
           surface->config.size = config->size;
 
-          fusion_skirmish_dismiss( &surface->lock );
+          dfb_surface_unlock( surface );
           return DFB_OK;
      }
 
@@ -890,14 +893,14 @@ dfb_surface_reconfig( CoreSurface             *surface,
      if (dfb_config->surface_clear)
           dfb_surface_clear_buffers( surface );
 
-     fusion_skirmish_dismiss( &surface->lock );
+     dfb_surface_unlock( surface );
 
      return DFB_OK;
 
 error:
      D_UNIMPLEMENTED();
 
-     fusion_skirmish_dismiss( &surface->lock );
+     dfb_surface_unlock( surface );
 
      return ret;
 }
@@ -912,11 +915,11 @@ dfb_surface_destroy_buffers( CoreSurface *surface )
 
      D_MAGIC_ASSERT( surface, CoreSurface );
 
-     if (fusion_skirmish_prevail( &surface->lock ))
+     if (dfb_surface_lock( surface ))
           return DFB_FUSION;
 
      if (surface->type & CSTF_PREALLOCATED) {
-          fusion_skirmish_dismiss( &surface->lock );
+          dfb_surface_unlock( surface );
           return DFB_UNSUPPORTED;
      }
 
@@ -933,7 +936,7 @@ dfb_surface_destroy_buffers( CoreSurface *surface )
 
      surface->num_buffers = 0;
 
-     fusion_skirmish_dismiss( &surface->lock );
+     dfb_surface_unlock( surface );
 
      return DFB_OK;
 }
@@ -948,11 +951,11 @@ dfb_surface_deallocate_buffers( CoreSurface *surface )
 
      D_MAGIC_ASSERT( surface, CoreSurface );
 
-     if (fusion_skirmish_prevail( &surface->lock ))
+     if (dfb_surface_lock( surface ))
           return DFB_FUSION;
 
      if (surface->type & CSTF_PREALLOCATED) {
-          fusion_skirmish_dismiss( &surface->lock );
+          dfb_surface_unlock( surface );
           return DFB_UNSUPPORTED;
      }
 
@@ -965,7 +968,7 @@ dfb_surface_deallocate_buffers( CoreSurface *surface )
      }
      dfb_surface_set_stereo_eye(surface, DSSE_LEFT);
 
-     fusion_skirmish_dismiss( &surface->lock );
+     dfb_surface_unlock( surface );
 
      return DFB_OK;
 }
@@ -977,7 +980,7 @@ dfb_surface_destroy( CoreSurface *surface )
 
      D_MAGIC_ASSERT( surface, CoreSurface );
 
-     if (fusion_skirmish_prevail( &surface->lock ))
+     if (dfb_surface_lock( surface ))
           return DFB_FUSION;
 
 
@@ -985,11 +988,160 @@ dfb_surface_destroy( CoreSurface *surface )
 
      surface->state |= CSSF_DESTROYED;
 
-     fusion_skirmish_dismiss( &surface->lock );
+     dfb_surface_unlock( surface );
 
      return DFB_OK;
 }
 
+static void
+surface_lock_acquired( CoreSurface *surface,
+                       long long    start )
+{
+     CoreSurfaceLockStats *stats = &surface->lock_stats;
+
+     if (surface->lock_depth++)
+          return;
+
+     /* Keep out new shared readers and wait for the remaining ones to leave. */
+     if (D_SYNC_ADD_AND_FETCH( &surface->readers, CORE_SURFACE_READERS_EXCLUSIVE ) != CORE_SURFACE_READERS_EXCLUSIVE) {
+          long long now;
+
+          if (!start)
+               start = direct_clock_get_micros();
+
+          while (*(volatile int*) &surface->readers != CORE_SURFACE_READERS_EXCLUSIVE) {
+               now = direct_clock_get_micros();
+
+               /* Readers which are still there after that long have died (or never unlock),
+                  drop them, dfb_surface_read_unlock() copes with leaving after the reset. */
+               if (now - start > CORE_SURFACE_READERS_TIMEOUT) {
+                    D_WARN( "dropping %d stale shared reader(s) of surface %p after %lld ms",
+                            surface->readers & ~CORE_SURFACE_READERS_EXCLUSIVE, surface, (now - start) / 1000 );
+
+                    surface->readers = CORE_SURFACE_READERS_EXCLUSIVE;
+                    break;
+               }
+
+               /* Readers only copy out pixels, yield first and sleep if it takes longer. */
+               if (now - start < 1000)
+                    direct_sched_yield();
+               else
+                    direct_thread_sleep( 100 );
+          }
+     }
+
+     surface->lock_time = direct_clock_get_micros();
+
+     stats->locks++;
+
+     if (start) {
+          long long wait = surface->lock_time - start;
+
+          stats->contended++;
+          stats->wait_time += wait;
+
+          if (stats->wait_max < wait)
+               stats->wait_max = wait;
+     }
+}
+
+DirectResult
+dfb_surface_lock( CoreSurface *surface )
+{
+     DirectResult ret;
+     long long    start = 0;
+
+     D_MAGIC_ASSERT( surface, CoreSurface );
+
+     /* Only take the time if the lock is contended. */
+     ret = fusion_skirmish_swoop( &surface->lock );
+     if (ret == DR_BUSY) {
+          start = direct_clock_get_micros();
+
+          ret = fusion_skirmish_prevail( &surface->lock );
+     }
+
+     if (ret)
+          return ret;
+
+     surface_lock_acquired( surface, start );
+
+     return DR_OK;
+}
+
+DirectResult
+dfb_surface_trylock( CoreSurface *surface )
+{
+     DirectResult ret;
+
+     D_MAGIC_ASSERT( surface, CoreSurface );
+
+     ret = fusion_skirmish_swoop( &surface->lock );
+     if (ret)
+          return ret;
+
+     surface_lock_acquired( surface, 0 );
+
+     return DR_OK;
+}
+
+DirectResult
+dfb_surface_unlock( CoreSurface *surface )
+{
+     D_MAGIC_ASSERT( surface, CoreSurface );
+     D_ASSERT( surface->lock_depth > 0 );
+
+     if (!--surface->lock_depth) {
+          CoreSurfaceLockStats *stats = &surface->lock_stats;
+          long long             hold  = direct_clock_get_micros() - surface->lock_time;
+
+          stats->hold_time += hold;
+
+          if (stats->hold_max < hold)
+               stats->hold_max = hold;
+
+          D_SYNC_ADD( &surface->readers, -CORE_SURFACE_READERS_EXCLUSIVE );
+     }
+
+     return fusion_skirmish_dismiss( &surface->lock );
+}
+
+bool
+dfb_surface_read_lock( CoreSurface *surface )
+{
+     D_MAGIC_ASSERT( surface, CoreSurface );
+
+     if (D_SYNC_ADD_AND_FETCH( &surface->readers, 1 ) & CORE_SURFACE_READERS_EXCLUSIVE) {
+          D_SYNC_ADD( &surface->readers, -1 );
+
+          D_SYNC_ADD( &surface->lock_stats.shared_failed, 1 );
+
+          return false;
+     }
+
+     D_SYNC_ADD( &surface->lock_stats.shared, 1 );
+
+     return true;
+}
+
+void
+dfb_surface_read_unlock( CoreSurface *surface )
+{
+     int readers;
+
+     D_MAGIC_ASSERT( surface, CoreSurface );
+
+     /* Don't go below zero if the surface lock holder dropped us after waiting too long. */
+     do {
+          readers = *(volatile int*) &surface->readers;
+
+          if (!(readers & ~CORE_SURFACE_READERS_EXCLUSIVE)) {
+               D_WARN( "shared reader of surface %p left after being dropped", surface );
+               return;
+          }
+     } while (!D_SYNC_BOOL_COMPARE_AND_SWAP( &surface->readers, readers, readers - 1 ));
+}
+
 DFBResult
 dfb_surface_lock_buffer( CoreSurface            *surface,
                          CoreSurfaceBufferRole   role,
@@ -1302,7 +1454,7 @@ dfb_surface_clear_buffers( CoreSurface *surface )
      if (surface->num_buffers == 0)
           return DFB_SUSPENDED;
 
-     if (fusion_skirmish_prevail( &surface->lock ))
+     if (dfb_surface_lock( surface ))
           return DFB_FUSION;
 
      dfb_gfx_clear( surface, CSBR_FRONT );
@@ -1313,7 +1465,7 @@ dfb_surface_clear_buffers( CoreSurface *surface )
      if (surface->config.caps & DSCAPS_TRIPLE)
           dfb_gfx_clear( surface, CSBR_IDLE );
 
-     fusion_skirmish_dismiss( &surface->lock );
+     dfb_surface_unlock( surface );
 
      return ret;
 }
@@ -1331,11 +1483,11 @@ dfb_surface_dump_buffer( CoreSurface           *surface,
      D_MAGIC_ASSERT( surface, CoreSurface );
      D_ASSERT( path != NULL );
 
-     if (fusion_skirmish_prevail( &surface->lock ))
+     if (dfb_surface_lock( surface ))
           return DFB_FUSION;
 
      if (surface->num_buffers == 0) {
-          fusion_skirmish_dismiss( &surface->lock );
+          dfb_surface_unlock( surface );
           return DFB_SUSPENDED;
      }
 
@@ -1344,7 +1496,7 @@ dfb_surface_dump_buffer( CoreSurface           *surface,
 
      ret =  buffer->allocs.count ? dfb_surface_buffer_dump( buffer, path, prefix ) : DFB_BUFFEREMPTY;
 
-     fusion_skirmish_dismiss( &surface->lock );
+     dfb_surface_unlock( surface );
 
      return ret;
 }
@@ -1365,7 +1517,7 @@ dfb_surface_dump_raw_buffer( CoreSurface           *surface,
      if (surface->num_buffers == 0)
           return DFB_SUSPENDED;
 
-     if (fusion_skirmish_prevail( &surface->lock ))
+     if (dfb_surface_lock( surface ))
           return DFB_FUSION;
 
      buffer = dfb_surface_get_buffer( surface, role );
@@ -1373,7 +1525,7 @@ dfb_surface_dump_raw_buffer( CoreSurface           *surface,
 
      ret = dfb_surface_buffer_dump_raw( buffer, path, prefix );
 
-     fusion_skirmish_dismiss( &surface->lock );
+     dfb_surface_unlock( surface );
 
      return ret;
 }
@@ -1692,7 +1844,7 @@ dfb_surface_set_palette( CoreSurface *surface,
      D_MAGIC_ASSERT( surface, CoreSurface );
      D_MAGIC_ASSERT_IF( palette, CorePalette );
 
-     if (fusion_skirmish_prevail( &surface->lock ))
+     if (dfb_surface_lock( surface ))
           return DFB_FUSION;
 
      if (surface->palette != palette) {
@@ -1710,7 +1862,7 @@ dfb_surface_set_palette( CoreSurface *surface,
           dfb_surface_notify( surface, CSNF_PALETTE_CHANGE );
      }
 
-     fusion_skirmish_dismiss( &surface->lock );
+     dfb_surface_unlock( surface );
 
      return DFB_OK;
 }
@@ -1721,14 +1873,14 @@ dfb_surface_set_field( CoreSurface *surface,
 {
      D_MAGIC_ASSERT( surface, CoreSurface );
 
-     if (fusion_skirmish_prevail( &surface->lock ))
+     if (dfb_surface_lock( surface ))
           return DFB_FUSION;
 
      surface->field = field;
 
      dfb_surface_notify( surface, CSNF_FIELD );
 
-     fusion_skirmish_dismiss( &surface->lock );
+     dfb_surface_unlock( surface );
 
      return DFB_OK;
 }
@@ -1742,7 +1894,7 @@ dfb_surface_set_alpha_ramp( CoreSurface *surface,
 {
      D_MAGIC_ASSERT( surface, CoreSurface );
 
-     if (fusion_skirmish_prevail( &surface->lock ))
+     if (dfb_surface_lock( surface ))
           return DFB_FUSION;
 
      surface->alpha_ramp[0] = a0;
@@ -1752,7 +1904,7 @@ dfb_surface_set_alpha_ramp( CoreSurface *surface,
 
      dfb_surface_notify( surface, CSNF_ALPHA_RAMP );
 
-     fusion_skirmish_dismiss( &surface->lock );
+     dfb_surface_unlock( surface );
 
      return DFB_OK;
 }
@@ -1768,12 +1920,12 @@ _dfb_surface_palette_listener( const void *msg_data,
           return RS_REMOVE;
 
      if (notification->flags & CPNF_ENTRIES) {
-          if (fusion_skirmish_prevail( &surface->lock ))
+          if (dfb_surface_lock( surface ))
                return RS_OK;
 
           dfb_surface_notify( surface, CSNF_PALETTE_UPDATE );
 
-          fusion_skirmish_dismiss( &surface->lock );
+          dfb_surface_unlock( surface );
      }
 
      return RS_OK;
@@ -98,8 +98,9 @@ typedef enum {
      CSCONF_COLORSPACE   = 0x00000008,
 
      CSCONF_PREALLOCATED = 0x00000010,
+     CSCONF_PREALLOCATED_FD = 0x00000020,   /* with CSCONF_PREALLOCATED, buffers are given by 'fd', 'offset' and 'pitch' */
 
-     CSCONF_ALL          = 0x0000001F
+     CSCONF_ALL          = 0x0000003F
 } CoreSurfaceConfigFlags;
 
 typedef enum {
@@ -135,6 +136,9 @@ typedef struct {
           unsigned int             pitch;              /* " */
 
           void                    *handle;             /* " */
+
+          int                      fd;                 /* file descriptor of the creator, see 'pid' */
+          int                      pid;                /* process id of the creator for importing 'fd' */
      }                        preallocated[MAX_SURFACE_BUFFERS];
 
      CoreSurfacePoolID        preallocated_pool_id;
@@ -217,6 +221,28 @@ typedef enum {
      CSSF_ALL            = 0x00000001
 } CoreSurfaceStateFlags;
 
+/*
+ * Set in CoreSurface::readers while the surface lock is held, shared readers back off then.
+ */
+#define CORE_SURFACE_READERS_EXCLUSIVE  0x40000000
+
+/*
+ * Time after which the surface lock holder stops waiting for shared readers (micro seconds).
+ */
+#define CORE_SURFACE_READERS_TIMEOUT    500000
+
+typedef struct {
+     unsigned int             locks;         /* exclusive acquisitions of the surface lock (outermost only) */
+     unsigned int             contended;     /* acquisitions which had to wait for another holder */
+     unsigned int             shared;        /* front buffer reads done with the shared lock */
+     unsigned int             shared_failed; /* shared lock attempts falling back to the surface lock */
+
+     long long                wait_time;     /* total time spent waiting for the surface lock (micro seconds) */
+     long long                wait_max;      /* longest wait for the surface lock (micro seconds) */
+     long long                hold_time;     /* total time the surface lock has been held (micro seconds) */
+     long long                hold_max;      /* longest time the surface lock has been held (micro seconds) */
+} CoreSurfaceLockStats;
+
 struct __DFB_CoreSurface
 {
      FusionObject             object;
@@ -262,6 +288,12 @@ struct __DFB_CoreSurface
      DFBFrameTimeConfig       frametime_config;
 
      long long                last_frame_time;
+
+     int                      lock_depth;    /* recursion depth of the surface lock holder */
+     long long                lock_time;     /* time of outermost acquisition of the surface lock */
+     int                      readers;       /* shared front buffer readers, see CORE_SURFACE_READERS_EXCLUSIVE */
+
+     CoreSurfaceLockStats     lock_stats;
 };
 
 #define CORE_SURFACE_ASSERT(surface)                                                           \
@@ -410,29 +442,25 @@ DFBResult dfb_surface_set_alpha_ramp( CoreSurface                  *surface,
 DFBResult dfb_surface_clear_buffers  ( CoreSurface                  *surface );
 
 
-static __inline__ DirectResult
-dfb_surface_lock( CoreSurface *surface )
-{
-     D_MAGIC_ASSERT( surface, CoreSurface );
-
-     return fusion_skirmish_prevail( &surface->lock );
-}
+DirectResult dfb_surface_lock   ( CoreSurface *surface );
 
-static __inline__ DirectResult
-dfb_surface_trylock( CoreSurface *surface )
-{
-     D_MAGIC_ASSERT( surface, CoreSurface );
+DirectResult dfb_surface_trylock( CoreSurface *surface );
 
-     return fusion_skirmish_swoop( &surface->lock );
-}
+DirectResult dfb_surface_unlock ( CoreSurface *surface );
 
-static __inline__ DirectResult
-dfb_surface_unlock( CoreSurface *surface )
-{
-     D_MAGIC_ASSERT( surface, CoreSurface );
+/*
+ * Shared lock for reading the front buffer (compositing, hit-testing, dumps).
+ *
+ * Any number of readers may hold it at the same time without taking the surface lock,
+ * while the holder of the surface lock waits for them to leave, dropping the ones that
+ * did not leave within CORE_SURFACE_READERS_TIMEOUT. Returns false if the surface lock
+ * is held, in which case the caller has to use dfb_surface_lock() instead.
+ *
+ * Readers must not modify the surface or acquire the surface lock while holding it.
+ */
+bool         dfb_surface_read_lock  ( CoreSurface *surface );
 
-     return fusion_skirmish_dismiss( &surface->lock );
-}
+void         dfb_surface_read_unlock( CoreSurface *surface );
 
 static __inline__ CoreSurfaceBuffer *
 dfb_surface_get_buffer( CoreSurface           *surface,
@@ -35,6 +35,7 @@
 #include <directfb.h>
 #include <directfb_util.h>
 
+#include <direct/conf.h>
 #include <direct/debug.h>
 #include <direct/mem.h>
 #include <direct/messages.h>
@@ -60,6 +61,8 @@ extern SurfacePoolFuncs sharedSecureSurfacePoolFuncs;
 extern SurfacePoolFuncs localSurfacePoolFuncs;
 #endif
 extern SurfacePoolFuncs preallocSurfacePoolFuncs;
+extern SurfacePoolFuncs memfdSurfacePoolFuncs;
+extern SurfacePoolFuncs compressedSurfacePoolFuncs;
 
 extern const SurfacePoolBridgeFuncs *preallocSurfacePoolBridgeFuncs;
 
@@ -252,9 +255,33 @@ dfb_surface_core_initialize( CoreDFB              *core,
           return ret;
      }
 
+     ret = dfb_surface_pool_initialize2( core, &memfdSurfacePoolFuncs, data, &shared->memfd_pool );
+     if (ret) {
+          D_DERROR( ret, "Core/Surface: Could not register 'memfd' surface pool!\n" );
+          dfb_surface_pool_destroy( shared->prealloc_pool );
+          dfb_surface_pool_destroy( shared->surface_pool );
+          return ret;
+     }
+
+     ret = dfb_surface_pool_initialize2( core, &compressedSurfacePoolFuncs, data, &shared->compressed_pool );
+     if (ret) {
+          D_DERROR( ret, "Core/Surface: Could not register 'compressed' surface pool!\n" );
+          dfb_surface_pool_destroy( shared->memfd_pool );
+          dfb_surface_pool_destroy( shared->prealloc_pool );
+          dfb_surface_pool_destroy( shared->surface_pool );
+          return ret;
+     }
+
+     /* Pools of the system module back up displaced allocations compressed if enabled. */
+     if (direct_config_get_int_value( "surface-backup-compression" ))
+          dfb_surface_pool_set_default_backup( shared->compressed_pool );
+
      ret = dfb_surface_pool_bridge_initialize( core, preallocSurfacePoolBridgeFuncs, data, &shared->prealloc_pool_bridge );
      if (ret) {
           D_DERROR( ret, "Core/Surface: Could not register 'prealloc' surface pool bridge!\n" );
+          dfb_surface_pool_set_default_backup( NULL );
+          dfb_surface_pool_destroy( shared->compressed_pool );
+          dfb_surface_pool_destroy( shared->memfd_pool );
           dfb_surface_pool_destroy( shared->prealloc_pool );
           dfb_surface_pool_destroy( shared->surface_pool );
           return ret;
@@ -264,6 +291,9 @@ dfb_surface_core_initialize( CoreDFB              *core,
      if (ret) {
           D_DERROR( ret, "Core/Surface: Could not register surface core signal handler!\n" );
           dfb_surface_pool_bridge_destroy( shared->prealloc_pool_bridge );
+          dfb_surface_pool_set_default_backup( NULL );
+          dfb_surface_pool_destroy( shared->compressed_pool );
+          dfb_surface_pool_destroy( shared->memfd_pool );
           dfb_surface_pool_destroy( shared->prealloc_pool );
           dfb_surface_pool_destroy( shared->surface_pool );
           return ret;
@@ -301,12 +331,18 @@ dfb_surface_core_join( CoreDFB              *core,
 
      dfb_surface_pool_join2( core, shared->prealloc_pool, &preallocSurfacePoolFuncs, data );
 
+     dfb_surface_pool_join2( core, shared->memfd_pool, &memfdSurfacePoolFuncs, data );
+
+     dfb_surface_pool_join2( core, shared->compressed_pool, &compressedSurfacePoolFuncs, data );
+
      dfb_surface_pool_bridge_join( core, shared->prealloc_pool_bridge, preallocSurfacePoolBridgeFuncs, data );
 
      ret = direct_signal_handler_add( DIRECT_SIGNAL_DUMP_STACK, dfb_surface_core_dump_handler, data, &data->dump_signal_handler );
      if (ret) {
           D_DERROR( ret, "Core/Surface: Could not register surface core signal handler!\n" );
           dfb_surface_pool_bridge_leave( shared->prealloc_pool_bridge );
+          dfb_surface_pool_leave( shared->compressed_pool );
+          dfb_surface_pool_leave( shared->memfd_pool );
           dfb_surface_pool_leave( shared->prealloc_pool );
           dfb_surface_pool_leave( shared->surface_pool );
           return ret;
@@ -334,6 +370,12 @@ dfb_surface_core_shutdown( DFBSurfaceCore *data,
 
      dfb_surface_pool_bridge_destroy( shared->prealloc_pool_bridge );
 
+     dfb_surface_pool_set_default_backup( NULL );
+
+     dfb_surface_pool_destroy( shared->compressed_pool );
+
+     dfb_surface_pool_destroy( shared->memfd_pool );
+
      dfb_surface_pool_destroy( shared->prealloc_pool );
 
 #if FUSION_BUILD_MULTI
@@ -365,6 +407,10 @@ dfb_surface_core_leave( DFBSurfaceCore *data,
 
      dfb_surface_pool_bridge_leave( shared->prealloc_pool_bridge );
 
+     dfb_surface_pool_leave( shared->compressed_pool );
+
+     dfb_surface_pool_leave( shared->memfd_pool );
+
      dfb_surface_pool_leave( shared->prealloc_pool );
 
 #if FUSION_BUILD_MULTI
@@ -40,6 +40,8 @@ typedef struct {
 
      CoreSurfacePool       *surface_pool;
      CoreSurfacePool       *prealloc_pool;
+     CoreSurfacePool       *memfd_pool;
+     CoreSurfacePool       *compressed_pool;
 
      CoreSurfacePoolBridge *prealloc_pool_bridge;
 } DFBSurfaceCoreShared;
@@ -64,6 +64,7 @@ static void                   *pool_locals[MAX_SURFACE_POOLS];
 static int                     pool_count;
 static CoreSurfacePool        *pool_array[MAX_SURFACE_POOLS];
 static unsigned int            pool_order[MAX_SURFACE_POOLS];
+static CoreSurfacePool        *pool_backup;
 
 /**********************************************************************************************************************/
 
@@ -186,9 +187,9 @@ dfb_surface_pool_initialize2( CoreDFB                 *core,
           return ret;
      }
 
-     /* Set default backup pool being the shared memory surface pool */
+     /* Set default backup pool being the shared memory surface pool, unless another one has been set */
      if (!pool->backup && pool_count > 1)
-          pool->backup = pool_array[0];
+          pool->backup = pool_backup ? pool_backup : pool_array[0];
 
      /* Insert new pool into priority order */
      insert_pool_local( pool );
@@ -199,6 +200,14 @@ dfb_surface_pool_initialize2( CoreDFB                 *core,
      return DFB_OK;
 }
 
+void
+dfb_surface_pool_set_default_backup( CoreSurfacePool *pool )
+{
+     D_DEBUG_AT( Core_SurfacePool, "%s( %p )\n", __FUNCTION__, pool );
+
+     pool_backup = pool;
+}
+
 DFBResult
 dfb_surface_pool_join( CoreDFB                *core,
                        CoreSurfacePool        *pool,
@@ -972,6 +981,14 @@ dfb_surface_pool_prelock( CoreSurfacePool        *pool,
      return DFB_OK;
 }
 
+bool
+dfb_surface_pool_has_prelock( CoreSurfacePool *pool )
+{
+     D_MAGIC_ASSERT( pool, CoreSurfacePool );
+
+     return get_funcs( pool )->PreLock != NULL;
+}
+
 DFBResult
 dfb_surface_pool_lock( CoreSurfacePool       *pool,
                        CoreSurfaceAllocation *allocation,
@@ -276,6 +276,11 @@ DFBResult dfb_surface_pool_initialize2( CoreDFB                 *core,
                                         void                    *ctx,
                                         CoreSurfacePool        **ret_pool );
 
+/*
+ * Sets the backup pool for pools initialized afterwards, NULL for the default (first pool).
+ */
+void      dfb_surface_pool_set_default_backup( CoreSurfacePool *pool );
+
 DFBResult dfb_surface_pool_join      ( CoreDFB                 *core,
                                        CoreSurfacePool         *pool,
                                        const SurfacePoolFuncs  *funcs );
@@ -307,6 +312,8 @@ DFBResult dfb_surface_pool_prelock   ( CoreSurfacePool         *pool,
                                        CoreSurfaceAccessorID    accessor,
                                        CoreSurfaceAccessFlags   access );
 
+bool      dfb_surface_pool_has_prelock( CoreSurfacePool       *pool );
+
 DFBResult dfb_surface_pool_lock      ( CoreSurfacePool         *pool,
                                        CoreSurfaceAllocation   *allocation,
                                        CoreSurfaceBufferLock   *lock );
@@ -2558,42 +2558,23 @@ IDirectFBSurface_DrawString( IDirectFBSurface *thiz,
      }
 
      if (flags & (DSTF_RIGHT | DSTF_CENTER)) {
-          int          i, num, kx, ky;
-          int          xsize = 0;
-          int          ysize = 0;
-          unsigned int prev = 0;
-          unsigned int indices[bytes];
+          int             xsize;
+          int             ysize;
+          CoreFontLayout *layout;
 
-          /* FIXME: Avoid double locking and decoding. */
+          /* The layout is cached, dfb_gfxcard_drawstring() won't decode the text again. */
           dfb_font_lock( core_font );
 
-          /* Decode string to character indices. */
-          ret = dfb_font_decode_text( core_font, data->encoding, text, bytes, indices, &num );
+          ret = dfb_font_layout_text( core_font, data->encoding, text, bytes, &layout );
           if (ret) {
                dfb_font_unlock( core_font );
                return ret;
           }
 
-          D_ASSERT( num <= bytes );
+          xsize = layout->xadvance;
+          ysize = layout->yadvance;
 
-          /* Calculate string width. */
-          for (i=0; i<num; i++) {
-               unsigned int   current = indices[i];
-               CoreGlyphData *glyph;
-
-               if (dfb_font_get_glyph_data( core_font, current, 0, &glyph ) == DFB_OK) {
-                    xsize += glyph->xadvance;
-                    ysize += glyph->yadvance;
-
-                    if (prev && core_font->GetKerning &&
-                        core_font->GetKerning( core_font, prev, current, &kx, &ky ) == DFB_OK) {
-                         xsize += kx << 8;
-                         ysize += ky << 8;
-                    }
-               }
-
-               prev = current;
-          }
+          dfb_font_layout_done( core_font, layout );
 
           dfb_font_unlock( core_font );
 
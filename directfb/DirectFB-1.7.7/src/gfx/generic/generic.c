@@ -8388,6 +8388,91 @@ static const GenefxFunc Bop_argb_blend_alphachannel_one_invsrc_Aop_PFI[DFB_NUM_P
 
 /**********************************************************************************************************************/
 
+/*
+ * Colorized premultiplied glyphs, e.g. from a premultiplied ARGB font cache, optionally
+ * modulated by the color alpha (DSBLIT_BLEND_COLORALPHA | DSBLIT_SRC_PREMULTCOLOR).
+ */
+static void Bop_argb_colorize_one_invsrc_Aop_argb( GenefxState *gfxs )
+{
+     int  w  = gfxs->length;
+     u32 *S  = gfxs->Bop[0];
+     u32 *D  = gfxs->Aop[0];
+     u32  ca = gfxs->Cacc.RGB.a;
+     u32  cr = gfxs->Cacc.RGB.r;
+     u32  cg = gfxs->Cacc.RGB.g;
+     u32  cb = gfxs->Cacc.RGB.b;
+
+     while (w--) {
+          u32 s = *S++;
+
+          if (s) {
+               u32 sa = ((s >> 24) * ca) >> 8;
+               u32 c  = (sa << 24) |
+                        (((((s >> 16) & 0xff) * cr) >> 8) << 16) |
+                        (((((s >>  8) & 0xff) * cg) >> 8) <<  8) |
+                         ((( s        & 0xff) * cb) >> 8);
+
+               if (sa == 0xff)
+                    *D = c;
+               else {
+                    u32 d      = *D;
+                    int invsrc = 256 - sa;
+                    u32 Drb    = ((d & 0x00ff00ff) * invsrc) >> 8;
+                    u32 Dag    = ((d & 0xff00ff00) >> 8) * invsrc;
+
+                    *D = c + (Drb & 0x00ff00ff) + (Dag & 0xff00ff00);
+               }
+          }
+
+          D++;
+     }
+}
+
+static const GenefxFunc Bop_argb_colorize_one_invsrc_Aop_PFI[DFB_NUM_PIXELFORMATS] = {
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB1555)] = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB16)]    = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB24)]    = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB32)]    = Bop_argb_colorize_one_invsrc_Aop_argb,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB)]     = Bop_argb_colorize_one_invsrc_Aop_argb,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ABGR)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_A8)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_YUY2)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB332)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_UYVY)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_I420)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_YV12)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_LUT8)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ALUT44)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_AiRGB)]    = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_A1)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_NV12)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_NV16)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB2554)] = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB4444)] = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGBA4444)] = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_NV21)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_AYUV)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_A4)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB1666)] = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB6666)] = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB18)]    = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_LUT1)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_LUT2)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB444)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB555)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_BGR555)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGBA5551)] = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_YUV444P)]  = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB8565)] = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGBAF88871)] = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_AVYU)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_VYU)]      = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_A1_LSB)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_YV16)]     = NULL,
+};
+
+/**********************************************************************************************************************/
+
 /* change the last value to adjust the size of the device (1-4) */
 #define SET_PIXEL_DUFFS_DEVICE( D, S, w ) \
      SET_PIXEL_DUFFS_DEVICE_N( D, S, w, 3 )
@@ -9543,6 +9628,26 @@ gAcquireSetup( CardState *state, DFBAccelerationMask accel )
                          break;
                     }
                }
+               if ((simpld_blittingflags == (DSBLIT_COLORIZE | DSBLIT_BLEND_ALPHACHANNEL) ||
+                    simpld_blittingflags == (DSBLIT_COLORIZE | DSBLIT_BLEND_ALPHACHANNEL |
+                                             DSBLIT_BLEND_COLORALPHA | DSBLIT_SRC_PREMULTCOLOR)) &&
+                   state->src_blend == DSBF_ONE                                           &&
+                   state->dst_blend == DSBF_INVSRCALPHA                                   &&
+                   (gfxs->src_caps & DSCAPS_PREMULTIPLIED))
+               {
+                    if (gfxs->src_format == DSPF_ARGB && Bop_argb_colorize_one_invsrc_Aop_PFI[dst_pfi]) {
+                         u16 ca = (simpld_blittingflags & DSBLIT_BLEND_COLORALPHA) ? color.a + 1 : 256;
+
+                         /* Color modulation per channel in 1/256, see Bop_argb_colorize_one_invsrc_Aop_argb(). */
+                         gfxs->Cacc.RGB.a = ca;
+                         gfxs->Cacc.RGB.r = ((color.r + 1) * ca) >> 8;
+                         gfxs->Cacc.RGB.g = ((color.g + 1) * ca) >> 8;
+                         gfxs->Cacc.RGB.b = ((color.b + 1) * ca) >> 8;
+
+                         *funcs++ = Bop_argb_colorize_one_invsrc_Aop_PFI[dst_pfi];
+                         break;
+                    }
+               }
                if (((simpld_blittingflags == (DSBLIT_COLORIZE | DSBLIT_BLEND_ALPHACHANNEL |
                                               DSBLIT_SRC_PREMULTIPLY) &&
                      state->src_blend == DSBF_ONE)
@@ -304,6 +304,8 @@ IDirectFB_Destruct( IDirectFB *thiz )
           }
      }
 
+     IDirectFBImageProvider_FlushCache();
+
      ret = dfb_core_destroy( data->core, false );
 
      DIRECT_DEALLOCATE_INTERFACE( thiz );
@@ -543,9 +545,10 @@ init_palette( CoreSurface *surface, const DFBSurfaceDescription *desc )
 }
 
 static DFBResult
-IDirectFB_CreateSurface( IDirectFB                    *thiz,
-                         const DFBSurfaceDescription  *desc,
-                         IDirectFBSurface            **interface )
+create_surface( IDirectFB                    *thiz,
+                const DFBSurfaceDescription  *desc,
+                const DFBSurfaceBufferFD     *fds,
+                IDirectFBSurface            **interface )
 {
      IDirectFBSurface *iface;
      DFBResult ret;
@@ -1040,7 +1043,7 @@ IDirectFB_CreateSurface( IDirectFB                    *thiz,
      if ((caps & DSCAPS_FLIPPING) == DSCAPS_FLIPPING)
           caps &= ~DSCAPS_TRIPLE;
 
-     if (desc->flags & DSDESC_PREALLOCATED) {
+     if ((desc->flags & DSDESC_PREALLOCATED) || fds) {
           int               min_pitch;
           CoreSurfaceConfig config;
           int               i, num = 1;
@@ -1055,6 +1058,23 @@ IDirectFB_CreateSurface( IDirectFB                    *thiz,
           D_DEBUG_AT( IDFB, "  -> %d buffers, min pitch %d\n", num, min_pitch );
 
           for (i=0; i<num; i++) {
+               if (fds) {
+                    if (fds[i].fd < 0) {
+                         D_DEBUG_AT( IDFB, "  -> no file descriptor in fds [%d]\n", i );
+                         return DFB_INVARG;
+                    }
+
+                    if (fds[i].pitch < min_pitch) {
+                         D_DEBUG_AT( IDFB, "  -> wrong pitch (%d) in fds [%d]\n", fds[i].pitch, i );
+                         return DFB_INVARG;
+                    }
+
+                    config.preallocated[i].fd     = fds[i].fd;
+                    config.preallocated[i].offset = fds[i].offset;
+                    config.preallocated[i].pitch  = fds[i].pitch;
+                    continue;
+               }
+
                if (!desc->preallocated[i].data) {
                     D_DEBUG_AT( IDFB, "  -> no data in preallocated [%d]\n", i );
                     return DFB_INVARG;
@@ -1073,6 +1093,9 @@ IDirectFB_CreateSurface( IDirectFB                    *thiz,
           config.colorspace = colorspace;
           config.caps       = caps;
 
+          if (fds)
+               config.flags |= CSCONF_PREALLOCATED_FD;
+
           ret = dfb_surface_pools_prealloc( desc, &config );
           if (ret) {
                D_DERROR( ret, "IDirectFB::CreateSurface: Preallocation failed!\n" );
@@ -1113,6 +1136,34 @@ IDirectFB_CreateSurface( IDirectFB                    *thiz,
      return ret;
 }
 
+static DFBResult
+IDirectFB_CreateSurface( IDirectFB                    *thiz,
+                         const DFBSurfaceDescription  *desc,
+                         IDirectFBSurface            **interface )
+{
+     return create_surface( thiz, desc, NULL, interface );
+}
+
+static DFBResult
+IDirectFB_CreateSurfaceFromFDs( IDirectFB                    *thiz,
+                                const DFBSurfaceDescription  *desc,
+                                const DFBSurfaceBufferFD     *fds,
+                                IDirectFBSurface            **interface )
+{
+     D_DEBUG_AT( IDFB, "%s( %p )\n", __FUNCTION__, thiz );
+
+     if (!desc || !fds || !interface)
+          return DFB_INVARG;
+
+     if (desc->flags & DSDESC_PREALLOCATED)
+          return DFB_INVARG;
+
+     if ((desc->flags & DSDESC_CAPS) && (desc->caps & DSCAPS_PRIMARY))
+          return DFB_INVARG;
+
+     return create_surface( thiz, desc, fds, interface );
+}
+
 static DFBResult
 IDirectFB_CreatePalette( IDirectFB                    *thiz,
                          const DFBPaletteDescription  *desc,
@@ -2110,6 +2161,7 @@ IDirectFB_Construct( IDirectFB *thiz )
      thiz->WaitForSync = IDirectFB_WaitForSync;
      thiz->GetInterface = IDirectFB_GetInterface;
      thiz->GetSurface = IDirectFB_GetSurface;
+     thiz->CreateSurfaceFromFDs = IDirectFB_CreateSurfaceFromFDs;
 
      direct_mutex_init( &data->init_lock );
      direct_waitqueue_init( &data->init_wq );
@@ -137,6 +137,9 @@ typedef struct {
 
      DFBEventBufferStats           stats;
      bool                          stats_enabled;
+
+     unsigned int                  merged_motions; /* DWET_MOTION events merged into queued ones */
+     unsigned int                  merged_updates; /* DWET_UPDATE events merged into queued ones */
 } IDirectFBEventBuffer_data;
 
 /*
@@ -145,6 +148,12 @@ typedef struct {
 static void IDirectFBEventBuffer_AddItem( IDirectFBEventBuffer_data *data,
                                           EventBufferItem           *item );
 
+/*
+ * merges a window event into one still in the event queue
+ */
+static bool IDirectFBEventBuffer_MergeItem( IDirectFBEventBuffer_data *data,
+                                            const EventBufferItem     *item );
+
 #if !DIRECTFB_BUILD_PURE_VOODOO
 static ReactionResult IDirectFBEventBuffer_InputReact( const void *msg_data,
                                                        void       *ctx );
@@ -216,6 +225,10 @@ IDirectFBEventBuffer_Destruct( IDirectFBEventBuffer *thiz )
 
      D_DEBUG_AT( IDFBEvBuf, "%s( %p )\n", __FUNCTION__, thiz );
 
+     if (data->merged_motions || data->merged_updates)
+          D_DEBUG_AT( IDFBEvBuf, "  -> %u motion and %u update events were merged\n",
+                      data->merged_motions, data->merged_updates );
+
 #if !DIRECTFB_BUILD_PURE_VOODOO
      /* Remove the event buffer from the containers linked list. */
      containers_remove_input_eventbuffer( thiz );
@@ -994,6 +1007,15 @@ static void IDirectFBEventBuffer_AddItem( IDirectFBEventBuffer_data *data,
 
      direct_mutex_lock( &data->events_mutex );
 
+     if (dfb_config->coalesce_window_events && IDirectFBEventBuffer_MergeItem( data, item )) {
+          direct_waitqueue_broadcast( &data->wait_condition );
+
+          direct_mutex_unlock( &data->events_mutex );
+
+          D_FREE( item );
+          return;
+     }
+
      if (data->stats_enabled)
           CollectEventStatistics( &data->stats, &item->evt, 1 );
 
@@ -1004,6 +1026,93 @@ static void IDirectFBEventBuffer_AddItem( IDirectFBEventBuffer_data *data,
      direct_mutex_unlock( &data->events_mutex );
 }
 
+static bool IDirectFBEventBuffer_MergeItem( IDirectFBEventBuffer_data *data,
+                                            const EventBufferItem     *item )
+{
+     const DFBWindowEvent *evt = &item->evt.window;
+     EventBufferItem      *queued;
+     DFBWindowEvent       *pending;
+     int                   x2, y2;
+
+     if (item->evt.clazz != DFEC_WINDOW || !data->events)
+          return false;
+
+     switch (evt->type) {
+          case DWET_MOTION:
+               /* Only the last event may be replaced, motion must not overtake anything. */
+               queued  = (EventBufferItem*) data->events->prev;
+               pending = &queued->evt.window;
+
+               if (queued->evt.clazz != DFEC_WINDOW || pending->type != DWET_MOTION ||
+                   pending->window_id != evt->window_id || pending->buttons != evt->buttons ||
+                   pending->modifiers != evt->modifiers || pending->locks != evt->locks ||
+                   pending->flags != evt->flags)
+                    return false;
+
+               if (evt->flags & DWEF_RELATIVE) {
+                    int x = pending->x + evt->x;
+                    int y = pending->y + evt->y;
+
+                    *pending = *evt;
+
+                    pending->x = x;
+                    pending->y = y;
+               }
+               else
+                    *pending = *evt;
+
+               data->merged_motions++;
+               break;
+
+          case DWET_UPDATE:
+               /* Updates are idempotent, but must not overtake other events of the window or geometry changes
+                  of any window. Look for a pending one from the end of the queue, stopping at such events. */
+               queued = (EventBufferItem*) data->events->prev;
+
+               while (true) {
+                    pending = &queued->evt.window;
+
+                    if (queued->evt.clazz == DFEC_WINDOW) {
+                         if (pending->window_id == evt->window_id) {
+                              if (pending->type != DWET_UPDATE)
+                                   return false;
+
+                              break;
+                         }
+
+                         if (pending->type & (DWET_POSITION | DWET_SIZE))
+                              return false;
+                    }
+
+                    if (&queued->link == data->events)
+                         return false;
+
+                    queued = (EventBufferItem*) queued->link.prev;
+               }
+
+               x2 = MAX( pending->x + pending->w, evt->x + evt->w );
+               y2 = MAX( pending->y + pending->h, evt->y + evt->h );
+
+               pending->x = MIN( pending->x, evt->x );
+               pending->y = MIN( pending->y, evt->y );
+               pending->w = x2 - pending->x;
+               pending->h = y2 - pending->y;
+
+               pending->timestamp = evt->timestamp;
+
+               data->merged_updates++;
+               break;
+
+          default:
+               return false;
+     }
+
+     D_DEBUG_AT( IDFBEvBuf, "  -> merged window event 0x%06x (%u motions, %u updates merged)\n",
+                 evt->type, data->merged_motions, data->merged_updates );
+
+     return true;
+}
+
 #if !DIRECTFB_BUILD_PURE_VOODOO
 static ReactionResult IDirectFBEventBuffer_InputReact( const void *msg_data,
                                                        void       *ctx )
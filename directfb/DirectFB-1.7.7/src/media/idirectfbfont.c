@@ -305,45 +305,21 @@ IDirectFBFont_GetStringExtents( IDirectFBFont *thiz,
      dfb_font_lock( font );
 
      if (bytes > 0) {
-          int          i, num;
-          unsigned int prev  = 0;
-          unsigned int indices[bytes];
+          CoreFontLayout *layout;
 
-          /* Decode string to character indices. */
-          ret = dfb_font_decode_text( font, data->encoding, text, bytes, indices, &num );
+          ret = dfb_font_layout_text( font, data->encoding, text, bytes, &layout );
           if (ret) {
                dfb_font_unlock( font );
                return ret;
           }
 
-          D_ASSERT( num <= bytes );
+          xbaseline = layout->xadvance;
+          ybaseline = layout->yadvance;
 
-          for (i=0; i<num; i++) {
-               unsigned int   current = indices[i];
-               CoreGlyphData *glyph;
+          if (ink_rect)
+               *ink_rect = layout->ink;
 
-               if (dfb_font_get_glyph_data( font, current, 0, &glyph ) == DFB_OK) {  // FIXME: support font layers
-                    int kx, ky = 0;
-
-                    if (prev && font->GetKerning &&
-                        font->GetKerning( font, prev, current, &kx, &ky ) == DFB_OK) {
-                         xbaseline += kx << 8;
-                         ybaseline += ky << 8;
-                    }
-
-                    if (ink_rect) {
-                         DFBRectangle glyph_rect = { xbaseline + (glyph->left << 8),
-                              ybaseline + (glyph->top << 8),
-                              glyph->width << 8, glyph->height << 8};
-                         dfb_rectangle_union (ink_rect, &glyph_rect);
-                    }
-
-                    xbaseline += glyph->xadvance;
-                    ybaseline += glyph->yadvance;
-               }
-
-               prev = current;
-          }
+          dfb_font_layout_done( font, layout );
      }
 
      if (logical_rect) {
@@ -416,40 +392,21 @@ IDirectFBFont_GetStringWidth( IDirectFBFont *thiz,
           bytes = strlen (text);
 
      if (bytes > 0) {
-          int           i, num, kx, ky;
-          unsigned int  prev = 0;
-          unsigned int  indices[bytes];
-          CoreFont     *font = data->font;
+          CoreFont       *font = data->font;
+          CoreFontLayout *layout;
 
           dfb_font_lock( font );
 
-          /* Decode string to character indices. */
-          ret = dfb_font_decode_text( font, data->encoding, text, bytes, indices, &num );
+          ret = dfb_font_layout_text( font, data->encoding, text, bytes, &layout );
           if (ret) {
                dfb_font_unlock( font );
                return ret;
           }
 
-          D_ASSERT( num <= bytes );
-
-          /* Calculate string width. */
-          for (i=0; i<num; i++) {
-               unsigned int   current = indices[i];
-               CoreGlyphData *glyph;
-
-               if (dfb_font_get_glyph_data( font, current, 0, &glyph ) == DFB_OK) {  // FIXME: support font layers
-                    xsize += glyph->xadvance;
-                    ysize += glyph->yadvance;
-
-                    if (prev && font->GetKerning &&
-                        font->GetKerning( font, prev, current, &kx, &ky ) == DFB_OK) {
-                         xsize += kx << 8;
-                         ysize += ky << 8;
-                    }
-               }
+          xsize = layout->xadvance;
+          ysize = layout->yadvance;
 
-               prev = current;
-          }
+          dfb_font_layout_done( font, layout );
 
           dfb_font_unlock( font );
      }
@@ -831,6 +788,53 @@ IDirectFBFont_GetDescription( IDirectFBFont      *thiz,
      return DFB_OK;
 }
 
+/*
+ * Load the glyphs of a string into the glyph cache.
+ */
+static DFBResult
+IDirectFBFont_PrefetchGlyphs( IDirectFBFont *thiz,
+                              const char    *text,
+                              int            bytes )
+{
+     DFBResult     ret;
+     int           num;
+     unsigned int *indices;
+     CoreFont     *font;
+
+     DIRECT_INTERFACE_GET_DATA(IDirectFBFont)
+
+     D_DEBUG_AT( Font, "%s( %p )\n", __FUNCTION__, thiz );
+
+     if (!text)
+          return DFB_INVARG;
+
+     if (bytes < 0)
+          bytes = strlen (text);
+
+     if (!bytes)
+          return DFB_OK;
+
+     font = data->font;
+
+     indices = D_MALLOC( bytes * sizeof(unsigned int) );
+     if (!indices)
+          return D_OOM();
+
+     dfb_font_lock( font );
+
+     /* Decode string to character indices. */
+     ret = dfb_font_decode_text( font, data->encoding, text, bytes, indices, &num );
+
+     dfb_font_unlock( font );
+
+     if (ret == DFB_OK)
+          ret = dfb_font_prefetch_glyphs( font, indices, num );
+
+     D_FREE( indices );
+
+     return ret;
+}
+
 /**********************************************************************************************************************/
 
 DFBResult
@@ -860,6 +864,7 @@ IDirectFBFont_Construct( IDirectFBFont *thiz, CoreFont *font )
      thiz->GetGlyphExtentsXY = IDirectFBFont_GetGlyphExtentsXY;
      thiz->GetUnderline = IDirectFBFont_GetUnderline;
      thiz->GetDescription = IDirectFBFont_GetDescription;
+     thiz->PrefetchGlyphs = IDirectFBFont_PrefetchGlyphs;
 
      return DFB_OK;
 }
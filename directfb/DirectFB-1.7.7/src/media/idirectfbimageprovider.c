@@ -35,19 +35,245 @@
 #include <stddef.h>
 #include <string.h>
 
+#include <sys/stat.h>
+
 #include <directfb.h>
 
 #include <core/core.h>
+#include <core/surface.h>
 
+#include <direct/debug.h>
 #include <direct/interface.h>
+#include <direct/list.h>
 #include <direct/mem.h>
+#include <direct/thread.h>
 
 #include <fusion/conf.h>
 
+#include <display/idirectfbsurface.h>
+
 #include <media/idirectfbimageprovider.h>
 #include <media/idirectfbimageprovider_client.h>
 #include <media/idirectfbdatabuffer.h>
 
+#include <misc/conf.h>
+
+
+D_DEBUG_DOMAIN( ImageCache, "ImageProvider/Cache", "Decoded image cache" );
+
+/**********************************************************************************************************************/
+
+typedef struct {
+     const char             *file;
+     unsigned long           mtime;
+     unsigned long           size;
+
+     int                     width;
+     int                     height;
+     DFBSurfacePixelFormat   format;
+     DFBSurfaceCapabilities  caps;
+     DIRenderFlags           flags;
+
+     unsigned int            hash;
+} ImageCacheKey;
+
+typedef struct {
+     DirectLink              link;
+
+     ImageCacheKey           key;
+
+     int                     refs;      /* RenderTo calls copying the pixels outside of the cache lock */
+     bool                    evicted;   /* free the entry when the last reference is gone */
+
+     int                     pitch;
+     unsigned long           bytes;
+     void                   *pixels;    /* allocated behind the entry, followed by the file name */
+} ImageCacheEntry;
+
+typedef struct {
+     unsigned long           lookups;   /* RenderTo calls with a cacheable destination */
+     unsigned long           hits;      /* of those served from the cache */
+     unsigned long           evictions; /* images dropped to stay within the budget */
+
+     unsigned int            entries;   /* images currently cached */
+     unsigned long           bytes;     /* memory used by cached pixels */
+} ImageCacheStats;
+
+static DirectMutex      cache_lock = DIRECT_MUTEX_INITIALIZER( cache_lock );
+static DirectLink      *cache_entries;   /* most recently used first */
+static ImageCacheStats  cache_stats;
+
+static unsigned int
+image_cache_hash( const ImageCacheKey *key )
+{
+     unsigned int         hash = 2166136261u;
+     const unsigned char *file = (const unsigned char*) key->file;
+
+     while (*file)
+          hash = (hash ^ *file++) * 16777619u;
+
+     hash = (hash ^ key->mtime) * 16777619u;
+     hash = (hash ^ key->size) * 16777619u;
+     hash = (hash ^ ((key->width << 16) | key->height)) * 16777619u;
+     hash = (hash ^ key->format) * 16777619u;
+     hash = (hash ^ (key->caps ^ (key->flags << 24))) * 16777619u;
+
+     return hash;
+}
+
+static bool
+image_cache_key_equal( const ImageCacheKey *a, const ImageCacheKey *b )
+{
+     return a->hash   == b->hash   && a->mtime  == b->mtime  && a->size   == b->size   &&
+            a->width  == b->width  && a->height == b->height && a->format == b->format &&
+            a->caps   == b->caps   && a->flags  == b->flags  && !strcmp( a->file, b->file );
+}
+
+/*
+ * Only formats with whole bytes per pixel and no palette can be copied back into any position of any surface.
+ */
+static bool
+image_cache_format_supported( DFBSurfacePixelFormat format )
+{
+     return DFB_BYTES_PER_PIXEL( format ) && !DFB_PLANAR_PIXELFORMAT( format ) &&
+            !DFB_PIXELFORMAT_IS_INDEXED( format ) && !DFB_COLOR_IS_YUV( format );
+}
+
+/* Called with the cache lock held. */
+static void
+image_cache_remove( ImageCacheEntry *entry )
+{
+     D_DEBUG_AT( ImageCache, "  -> removing %s %dx%d (%lu bytes)\n",
+                 entry->key.file, entry->key.width, entry->key.height, entry->bytes );
+
+     direct_list_remove( &cache_entries, &entry->link );
+
+     cache_stats.entries--;
+     cache_stats.bytes -= entry->bytes;
+
+     entry->evicted = true;
+
+     if (!entry->refs)
+          D_FREE( entry );
+}
+
+static ImageCacheEntry *
+image_cache_lookup( const ImageCacheKey *key )
+{
+     ImageCacheEntry *entry;
+
+     direct_mutex_lock( &cache_lock );
+
+     cache_stats.lookups++;
+
+     direct_list_foreach (entry, cache_entries) {
+          if (image_cache_key_equal( &entry->key, key )) {
+               direct_list_move_to_front( &cache_entries, &entry->link );
+
+               entry->refs++;
+
+               cache_stats.hits++;
+               break;
+          }
+     }
+
+     direct_mutex_unlock( &cache_lock );
+
+     return entry;
+}
+
+static void
+image_cache_release( ImageCacheEntry *entry )
+{
+     direct_mutex_lock( &cache_lock );
+
+     if (!--entry->refs && entry->evicted)
+          D_FREE( entry );
+
+     direct_mutex_unlock( &cache_lock );
+}
+
+/*
+ * Reads back the image just rendered to the destination and adds it, dropping least recently used ones if needed.
+ */
+static void
+image_cache_store( const ImageCacheKey *key, CoreSurface *surface, const DFBRectangle *rect )
+{
+     ImageCacheEntry *entry;
+     ImageCacheEntry *other;
+     int              pitch  = (DFB_BYTES_PER_LINE( key->format, rect->w ) + 7) & ~7;
+     unsigned long    bytes  = (unsigned long) pitch * rect->h;
+     unsigned long    budget = dfb_config->image_cache_size * 1024UL;
+     size_t           length = strlen( key->file ) + 1;
+
+     if (bytes > budget)
+          return;
+
+     entry = D_MALLOC( sizeof(ImageCacheEntry) + bytes + length );
+     if (!entry)
+          return;
+
+     memset( entry, 0, sizeof(ImageCacheEntry) );
+
+     entry->key    = *key;
+     entry->pitch  = pitch;
+     entry->bytes  = bytes;
+     entry->pixels = entry + 1;
+
+     entry->key.file = memcpy( entry->pixels + bytes, key->file, length );
+
+     /* Make sure any rendering queued for the destination is done. */
+     CoreGraphicsStateClient_FlushCurrent( 0 );
+
+     if (dfb_surface_read_buffer( surface, CSBR_BACK, entry->pixels, pitch, rect )) {
+          D_FREE( entry );
+          return;
+     }
+
+     direct_mutex_lock( &cache_lock );
+
+     /* Another thread may have rendered the same image meanwhile. */
+     direct_list_foreach (other, cache_entries) {
+          if (image_cache_key_equal( &other->key, key )) {
+               direct_mutex_unlock( &cache_lock );
+               D_FREE( entry );
+               return;
+          }
+     }
+
+     while (cache_entries && cache_stats.bytes + bytes > budget) {
+          image_cache_remove( direct_list_get_last( cache_entries ) );
+
+          cache_stats.evictions++;
+     }
+
+     direct_list_prepend( &cache_entries, &entry->link );
+
+     cache_stats.entries++;
+     cache_stats.bytes += bytes;
+
+     D_DEBUG_AT( ImageCache, "  -> added %s %dx%d %s (%u entries, %lu bytes)\n", key->file, key->width, key->height,
+                 dfb_pixelformat_name( key->format ), cache_stats.entries, cache_stats.bytes );
+
+     direct_mutex_unlock( &cache_lock );
+}
+
+void
+IDirectFBImageProvider_FlushCache( void )
+{
+     direct_mutex_lock( &cache_lock );
+
+     D_DEBUG_AT( ImageCache, "%s() <- %lu lookups, %lu hits, %lu evictions, %u entries, %lu bytes\n", __FUNCTION__,
+                 cache_stats.lookups, cache_stats.hits, cache_stats.evictions, cache_stats.entries, cache_stats.bytes );
+
+     while (cache_entries)
+          image_cache_remove( (ImageCacheEntry*) cache_entries );
+
+     direct_mutex_unlock( &cache_lock );
+}
+
+/**********************************************************************************************************************/
+
 
 static DirectResult
 IDirectFBImageProvider_AddRef( IDirectFBImageProvider *thiz )
@@ -68,6 +294,9 @@ IDirectFBImageProvider_Release( IDirectFBImageProvider *thiz )
           if (data->Destruct)
                data->Destruct( thiz );
 
+          if (data->cache_file)
+               D_FREE( data->cache_file );
+
           /* Decrease the data buffer reference counter. */
           if (data->buffer)
                data->buffer->Release( data->buffer );
@@ -139,6 +368,206 @@ IDirectFBImageProvider_WriteBack( IDirectFBImageProvider *thiz,
      return DFB_UNIMPLEMENTED;
 }
 
+/*
+ * Wraps RenderTo of implementations created for a file while the image cache is enabled.
+ */
+static DFBResult
+IDirectFBImageProvider_CachedRenderTo( IDirectFBImageProvider *thiz,
+                                       IDirectFBSurface       *destination,
+                                       const DFBRectangle     *destination_rect )
+{
+     DFBResult              ret;
+     IDirectFBSurface_data *dst_data;
+     CoreSurface           *dst_surface;
+     DFBRectangle           rect;
+     DFBRectangle           clipped;
+     ImageCacheKey          key;
+     ImageCacheEntry       *entry;
+
+     DIRECT_INTERFACE_GET_DATA( IDirectFBImageProvider )
+
+     if (!destination)
+          return DFB_INVARG;
+
+     dst_data = (IDirectFBSurface_data*) destination->priv;
+     if (!dst_data)
+          return DFB_DEAD;
+
+     dst_surface = dst_data->surface;
+     if (!dst_surface)
+          return DFB_DESTROYED;
+
+     if (destination_rect) {
+          if (destination_rect->w < 1 || destination_rect->h < 1)
+               return DFB_INVARG;
+
+          rect    = *destination_rect;
+          rect.x += dst_data->area.wanted.x;
+          rect.y += dst_data->area.wanted.y;
+     }
+     else
+          rect = dst_data->area.wanted;
+
+     clipped = rect;
+
+     /* Only images rendered completely and without progress notification are cached. */
+     if (!dfb_config->image_cache_size || data->render_callback ||
+         !image_cache_format_supported( dst_surface->config.format ) ||
+         !dfb_rectangle_intersect( &clipped, &dst_data->area.current ) || !DFB_RECTANGLE_EQUAL( clipped, rect ))
+          return data->RenderTo( thiz, destination, destination_rect );
+
+     key.file   = data->cache_file;
+     key.mtime  = data->cache_mtime;
+     key.size   = data->cache_size;
+     key.width  = rect.w;
+     key.height = rect.h;
+     key.format = dst_surface->config.format;
+     key.caps   = dst_surface->config.caps & DSCAPS_PREMULTIPLIED;
+     key.flags  = data->cache_flags;
+     key.hash   = image_cache_hash( &key );
+
+     entry = image_cache_lookup( &key );
+     if (entry) {
+          D_DEBUG_AT( ImageCache, "%s( %p ) <- hit %s %4d,%4d-%4dx%4d\n", __FUNCTION__, thiz,
+                      key.file, DFB_RECTANGLE_VALS(&rect) );
+
+          CoreGraphicsStateClient_FlushCurrent( 0 );
+
+          ret = dfb_surface_write_buffer( dst_surface, CSBR_BACK, entry->pixels, entry->pitch, &rect );
+
+          image_cache_release( entry );
+
+          if (ret == DFB_OK)
+               return DFB_OK;
+     }
+
+     ret = data->RenderTo( thiz, destination, destination_rect );
+     if (ret == DFB_OK)
+          image_cache_store( &key, dst_surface, &rect );
+
+     return ret;
+}
+
+static DFBResult
+IDirectFBImageProvider_CachedSetRenderFlags( IDirectFBImageProvider *thiz,
+                                             DIRenderFlags           flags )
+{
+     DFBResult ret;
+
+     DIRECT_INTERFACE_GET_DATA( IDirectFBImageProvider )
+
+     ret = data->SetRenderFlags( thiz, flags );
+     if (ret == DFB_OK)
+          data->cache_flags = flags;
+
+     return ret;
+}
+
+static DFBResult
+IDirectFBImageProvider_CachedSetRenderCallback( IDirectFBImageProvider *thiz,
+                                                DIRenderCallback        callback,
+                                                void                   *callback_data )
+{
+     DFBResult ret;
+
+     DIRECT_INTERFACE_GET_DATA( IDirectFBImageProvider )
+
+     /* Implementations may keep the callback in their own data, remember it for bypassing the cache. */
+     ret = data->SetRenderCallback( thiz, callback, callback_data );
+     if (ret == DFB_OK) {
+          data->render_callback         = callback;
+          data->render_callback_context = callback_data;
+     }
+
+     return ret;
+}
+
+typedef struct {
+     IDirectFBImageProvider *thiz;
+     IDirectFBSurface       *destination;
+     DFBRectangle            rect;
+     bool                    has_rect;
+     DIRenderDoneCallback    callback;
+     void                   *callback_data;
+
+     DirectMutex             lock;     /* held by the caller until the thread is detached */
+} RenderAsyncJob;
+
+static void *
+render_async_thread( DirectThread *thread, void *arg )
+{
+     DFBResult       ret;
+     RenderAsyncJob *job = arg;
+
+     direct_mutex_lock( &job->lock );
+     direct_mutex_unlock( &job->lock );
+     direct_mutex_deinit( &job->lock );
+
+     ret = job->thiz->RenderTo( job->thiz, job->destination, job->has_rect ? &job->rect : NULL );
+
+     job->callback( ret, job->callback_data );
+
+     job->destination->Release( job->destination );
+     job->thiz->Release( job->thiz );
+
+     D_FREE( job );
+
+     return NULL;
+}
+
+static DFBResult
+IDirectFBImageProvider_RenderToAsync( IDirectFBImageProvider *thiz,
+                                      IDirectFBSurface       *destination,
+                                      const DFBRectangle     *destination_rect,
+                                      DIRenderDoneCallback    callback,
+                                      void                   *callback_data )
+{
+     DirectThread   *thread;
+     RenderAsyncJob *job;
+
+     if (!destination || !callback)
+          return DFB_INVARG;
+
+     job = D_CALLOC( 1, sizeof(RenderAsyncJob) );
+     if (!job)
+          return D_OOM();
+
+     job->thiz          = thiz;
+     job->destination   = destination;
+     job->has_rect      = destination_rect != NULL;
+     job->callback      = callback;
+     job->callback_data = callback_data;
+
+     if (destination_rect)
+          job->rect = *destination_rect;
+
+     thiz->AddRef( thiz );
+     destination->AddRef( destination );
+
+     direct_mutex_init( &job->lock );
+     direct_mutex_lock( &job->lock );
+
+     thread = direct_thread_create( DTT_DEFAULT, render_async_thread, job, "Image Render" );
+     if (!thread) {
+          direct_mutex_unlock( &job->lock );
+          direct_mutex_deinit( &job->lock );
+
+          destination->Release( destination );
+          thiz->Release( thiz );
+
+          D_FREE( job );
+
+          return DFB_FAILURE;
+     }
+
+     /* The thread frees itself when done, but only after being detached. */
+     direct_thread_detach( thread );
+
+     direct_mutex_unlock( &job->lock );
+
+     return DFB_OK;
+}
+
 static void
 IDirectFBImageProvider_Construct( IDirectFBImageProvider *thiz )
 {
@@ -150,6 +579,7 @@ IDirectFBImageProvider_Construct( IDirectFBImageProvider *thiz )
      thiz->SetRenderCallback     = IDirectFBImageProvider_SetRenderCallback;
      thiz->SetRenderFlags        = IDirectFBImageProvider_SetRenderFlags;
      thiz->WriteBack             = IDirectFBImageProvider_WriteBack;
+     thiz->RenderToAsync         = IDirectFBImageProvider_RenderToAsync;
 }
      
 DFBResult
@@ -159,6 +589,7 @@ IDirectFBImageProvider_CreateFromBuffer( IDirectFBDataBuffer     *buffer,
                                          IDirectFBImageProvider **interface )
 {
      DFBResult                            ret;
+     struct stat                          st;
      DirectInterfaceFuncs                *funcs = NULL;
      IDirectFBDataBuffer_data            *buffer_data;
      IDirectFBImageProvider              *imageprovider;
@@ -200,6 +631,8 @@ IDirectFBImageProvider_CreateFromBuffer( IDirectFBDataBuffer     *buffer,
           if (ret)
                return ret;
 
+          imageprovider->RenderToAsync = IDirectFBImageProvider_RenderToAsync;
+
           *interface = imageprovider;
 
           return DFB_OK;
@@ -224,6 +657,24 @@ IDirectFBImageProvider_CreateFromBuffer( IDirectFBDataBuffer     *buffer,
 
      data->idirectfb = idirectfb;
 
+     /* Let files rendered again be copied from the decoded image cache, identified by path, modification time
+        and size, if the implementation allows it. */
+     if (dfb_config->image_cache_size && data->cacheable &&
+         buffer_data->filename && !stat( buffer_data->filename, &st )) {
+          data->cache_file = D_STRDUP( buffer_data->filename );
+          if (data->cache_file) {
+               data->cache_mtime       = st.st_mtime;
+               data->cache_size        = st.st_size;
+               data->RenderTo          = imageprovider->RenderTo;
+               data->SetRenderFlags    = imageprovider->SetRenderFlags;
+               data->SetRenderCallback = imageprovider->SetRenderCallback;
+
+               imageprovider->RenderTo          = IDirectFBImageProvider_CachedRenderTo;
+               imageprovider->SetRenderFlags    = IDirectFBImageProvider_CachedSetRenderFlags;
+               imageprovider->SetRenderCallback = IDirectFBImageProvider_CachedSetRenderCallback;
+          }
+     }
+
      *interface = imageprovider;
 
      return DFB_OK;
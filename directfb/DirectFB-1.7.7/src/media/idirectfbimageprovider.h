@@ -50,6 +50,8 @@ IDirectFBImageProvider_CreateFromBuffer( IDirectFBDataBuffer     *buffer,
                                          IDirectFB               *idirectfb,
                                          IDirectFBImageProvider **interface_ptr );
 
+void IDirectFBImageProvider_FlushCache( void );
+
 /**********************************************************************************************************************/
 
 /*
@@ -68,6 +70,21 @@ typedef struct {
      void                *render_callback_context;
 
      void (*Destruct)( IDirectFBImageProvider *thiz );
+
+     /* Set by implementations writing all pixels of RenderTo via CPU locks of the destination, i.e. without
+        blitting flags or other state of the application affecting the result, to allow the decoded image cache. */
+     bool                 cacheable;
+
+     /* Identity of the file for the decoded image cache, set by IDirectFBImageProvider_CreateFromBuffer(). */
+     char                *cache_file;
+     unsigned long        cache_mtime;
+     unsigned long        cache_size;
+     DIRenderFlags        cache_flags;
+
+     DFBResult (*RenderTo)( IDirectFBImageProvider *thiz, IDirectFBSurface *destination,
+                            const DFBRectangle *destination_rect );
+     DFBResult (*SetRenderFlags)( IDirectFBImageProvider *thiz, DIRenderFlags flags );
+     DFBResult (*SetRenderCallback)( IDirectFBImageProvider *thiz, DIRenderCallback callback, void *ctx );
 } IDirectFBImageProvider_data;
 
 
@@ -127,6 +127,8 @@ static const char *config_usage_strings[]  = {
      "  [no-]thrifty-surface-buffers   Free sysmem instance on xfer to video memory\n"
      "  font-format=<pixelformat>      Set the preferred font format\n"
      "  [no-]font-premult              Enable/disable premultiplied glyph images in ARGB format\n"
+     "  font-cache-dir=<directory>     Share rasterized glyphs between processes via files in this directory\n"
+     "  font-subpixel-phases=<1|2|4>   Render glyphs at up to 4 horizontal subpixel positions (default 1)\n"
      "  [no-]deinit-check              Enable deinit check at exit\n"
      "  [no-]core-sighandler           Enable/disable core signal handler (for emergency shutdowns)\n"
      "  block-all-signals              Block all signals\n"
@@ -174,6 +176,7 @@ static const char *config_usage_strings[]  = {
      "  [no-]startstop                 Issue StartDrawing/StopDrawing to driver\n"
      "  [no-]autoflip-window           Auto flip non-flipping windowed primary surfaces\n"
      "  [no-]discard-repeat-events     Discard repeat events (option per application)\n"
+     "  [no-]coalesce-window-events    Merge queued window motion and update events (option per application)\n"
      "  [no-]gfx-emit-early            Early emit GFX commands to prevent being IDLE\n"
      "  [no-]flip-notify               Use FlipNotify for remote display\n"
      "  flip-notify-max-latency=<ms>   Set maximum FlipNotify latency (ms from Flip to Notify, default 200)\n"
@@ -213,6 +216,8 @@ static const char *config_usage_strings[]  = {
      "\n"
      "  max-font-rows=<number>         Maximum number of glyph cache rows (total for all fonts)\n"
      "  max-font-row-width=<pixels>    Maximum width of glyph cache row surface\n"
+     "  max-font-layouts=<number>      Maximum number of cached text layouts (total for all fonts, 0 disables)\n"
+     "  image-cache-size=<kb>          Memory budget for decoded images rendered again (default 0, disabled)\n"
      "  graphics-state-call-limit=<n>  Set FusionCall quota for graphics state object (default 5000)\n"
      "\n",
      " Window surface swapping policy:\n"
@@ -477,6 +482,7 @@ static void config_allocate( void )
      dfb_config->kd_graphics              = true;
      dfb_config->translucent_windows      = true;
      dfb_config->font_premult             = true;
+     dfb_config->font_subpixel_phases     = 1;
      dfb_config->mouse_motion_compression = false;
      dfb_config->mouse_gpm_source         = false;
      dfb_config->mouse_source             = D_STRDUP( DEV_NAME );
@@ -518,6 +524,7 @@ static void config_allocate( void )
 
      dfb_config->max_font_rows      = 99;
      dfb_config->max_font_row_width = 2048;
+     dfb_config->max_font_layouts   = 256;
 
      dfb_config->core_sighandler    = true;
 
@@ -682,6 +689,33 @@ DFBResult dfb_config_set( const char *name, const char *value )
                return DFB_INVARG;
           }
      } else
+     if (strcmp (name, "font-cache-dir" ) == 0) {
+          if (value) {
+               if (dfb_config->font_cache_dir)
+                    D_FREE( dfb_config->font_cache_dir );
+               dfb_config->font_cache_dir = D_STRDUP( value );
+          }
+          else {
+               D_ERROR("DirectFB/Config 'font-cache-dir': No directory name specified!\n");
+               return DFB_INVARG;
+          }
+     } else
+     if (strcmp (name, "font-subpixel-phases" ) == 0) {
+          if (value) {
+               int phases;
+
+               if (sscanf( value, "%d", &phases ) < 1 || (phases != 1 && phases != 2 && phases != 4)) {
+                    D_ERROR("DirectFB/Config 'font-subpixel-phases': Value must be 1, 2 or 4!\n");
+                    return DFB_INVARG;
+               }
+
+               dfb_config->font_subpixel_phases = phases;
+          }
+          else {
+               D_ERROR("DirectFB/Config 'font-subpixel-phases': No value specified!\n");
+               return DFB_INVARG;
+          }
+     } else
      if (strcmp (name, "font-premult" ) == 0) {
           dfb_config->font_premult = true;
      } else
@@ -1175,6 +1209,12 @@ DFBResult dfb_config_set( const char *name, const char *value )
      if (strcmp (name, "no-discard-repeat-events" ) == 0) {
           dfb_config->discard_repeat_events = false;
      } else
+     if (strcmp (name, "coalesce-window-events" ) == 0) {
+          dfb_config->coalesce_window_events = true;
+     } else
+     if (strcmp (name, "no-coalesce-window-events" ) == 0) {
+          dfb_config->coalesce_window_events = false;
+     } else
      if (strcmp (name, "vsync-none" ) == 0) {
           dfb_config->pollvsync_none = true;
      } else
@@ -1828,6 +1868,44 @@ DFBResult dfb_config_set( const char *name, const char *value )
                return DFB_INVARG;
           }
      } else
+     if (strcmp (name, "max-font-layouts" ) == 0) {
+          if (value) {
+               char *error;
+               unsigned long num;
+
+               num = strtoul( value, &error, 10 );
+
+               if (*error) {
+                    D_ERROR( "DirectFB/Config '%s': Error in value '%s'!\n", name, error );
+                    return DFB_INVARG;
+               }
+
+               dfb_config->max_font_layouts = num;
+          }
+          else {
+               D_ERROR( "DirectFB/Config '%s': No value specified!\n", name );
+               return DFB_INVARG;
+          }
+     } else
+     if (strcmp (name, "image-cache-size" ) == 0) {
+          if (value) {
+               char *error;
+               unsigned long size;
+
+               size = strtoul( value, &error, 10 );
+
+               if (*error) {
+                    D_ERROR( "DirectFB/Config '%s': Error in value '%s'!\n", name, error );
+                    return DFB_INVARG;
+               }
+
+               dfb_config->image_cache_size = size;
+          }
+          else {
+               D_ERROR( "DirectFB/Config '%s': No value specified!\n", name );
+               return DFB_INVARG;
+          }
+     } else
      if (strcmp (name, "max-font-row-width" ) == 0) {
           if (value) {
                char *error;
@@ -216,6 +216,8 @@ typedef struct
      int           accelerator;                   /* Accelerator ID */
 
      bool          font_premult;                  /* Use premultiplied data in case of ARGB glyph images */
+     char         *font_cache_dir;                /* Directory of glyph files shared by processes */
+     int           font_subpixel_phases;          /* Horizontal subpixel positions rendered per glyph */
 
      FusionVector  linux_input_devices;
      FusionVector  tslib_devices;
@@ -263,6 +265,9 @@ typedef struct
 
      int           max_font_rows;
      int           max_font_row_width;
+     int           max_font_layouts;
+
+     unsigned int  image_cache_size;               /* Budget for decoded images in kilobytes, 0 disables the cache */
 
      bool          core_sighandler;
 
@@ -290,6 +295,7 @@ typedef struct
      DFBWindowCursorFlags default_cursor_flags;
 
      bool                 discard_repeat_events;
+     bool                 coalesce_window_events;  /* merge motion/update events still in the queue */
 
      DFBSurfaceID         primary_id;              /* id for primary surface */
 
@@ -32,6 +32,13 @@
 
 #include <config.h>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <direct/atomic.h>
+#include <direct/memcpy.h>
+
 #include <core/Task.h>
 #include <core/DisplayTask.h>
 
@@ -42,6 +49,8 @@
 
 #include <misc/conf.h>
 
+#include "dummy_ring.h"
+
 
 #define DUMMY_WIDTH  8
 #define DUMMY_HEIGHT 8
@@ -80,11 +89,155 @@ typedef struct {
 
      long long              pts;
 
+     DFBRegion              update;
+
      CoreSurfaceBufferLock  lock;
 } DummyDisplayBuffer;
 
 /**********************************************************************************************************************/
 
+static int              dummy_ring_fd = -1;
+static void            *dummy_ring_map;
+static size_t           dummy_ring_length;
+static DummyRingHeader *dummy_ring_header;
+
+static DFBResult
+dummy_ring_open( const char            *filename,
+                 int                    slots,
+                 int                    width,
+                 int                    height,
+                 DFBSurfacePixelFormat  format )
+{
+     u32    data_offset = direct_util_align( sizeof(DummyRingFrame), 64 );
+     u32    slot_size   = direct_util_align( data_offset + DFB_BYTES_PER_LINE( format, width ) *
+                                             DFB_PLANE_MULTIPLY( format, height ), direct_pagesize() );
+     u32    header_size = direct_util_align( sizeof(DummyRingHeader), direct_pagesize() );
+     size_t length      = header_size + (size_t) slots * slot_size;
+
+     D_DEBUG_AT( Dummy_Display, "%s( '%s', %d slots, %dx%d %s )\n", __FUNCTION__,
+                 filename, slots, width, height, dfb_pixelformat_name( format ) );
+
+     dummy_ring_fd = open( filename, O_RDWR | O_CREAT | O_TRUNC, 0644 );
+     if (dummy_ring_fd < 0) {
+          D_PERROR( "Dummy/Display: Could not open ring file '%s'!\n", filename );
+          return DFB_IO;
+     }
+
+     if (ftruncate( dummy_ring_fd, length ) < 0) {
+          D_PERROR( "Dummy/Display: Could not resize ring file '%s' to %zu bytes!\n", filename, length );
+          close( dummy_ring_fd );
+          dummy_ring_fd = -1;
+          return DFB_IO;
+     }
+
+     dummy_ring_map = mmap( NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, dummy_ring_fd, 0 );
+     if (dummy_ring_map == MAP_FAILED) {
+          D_PERROR( "Dummy/Display: Could not map ring file '%s'!\n", filename );
+          close( dummy_ring_fd );
+          dummy_ring_fd  = -1;
+          dummy_ring_map = NULL;
+          return DFB_IO;
+     }
+
+     dummy_ring_length = length;
+     dummy_ring_header = dummy_ring_map;
+
+     dummy_ring_header->magic       = DUMMY_RING_MAGIC;
+     dummy_ring_header->version     = DUMMY_RING_VERSION;
+     dummy_ring_header->header_size = header_size;
+     dummy_ring_header->slots       = slots;
+     dummy_ring_header->slot_size   = slot_size;
+     dummy_ring_header->data_offset = data_offset;
+     dummy_ring_header->written     = 0;
+
+     D_INFO( "Dummy/Display: Writing frames to '%s' (%d slots of %u bytes)\n", filename, slots, slot_size );
+
+     return DFB_OK;
+}
+
+static void
+dummy_ring_close( void )
+{
+     if (dummy_ring_map) {
+          munmap( dummy_ring_map, dummy_ring_length );
+
+          dummy_ring_map    = NULL;
+          dummy_ring_header = NULL;
+     }
+
+     if (dummy_ring_fd >= 0) {
+          close( dummy_ring_fd );
+
+          dummy_ring_fd = -1;
+     }
+}
+
+static void
+dummy_ring_write( DummyDisplayBuffer *request,
+                  long long           now )
+{
+     CoreSurface    *surface = request->surface;
+     DummyRingFrame *frame;
+     u8             *dst;
+     u8             *src;
+     int             i, pitch, rows;
+     u64             index;
+
+     if (!dummy_ring_header) {
+          char *filename;
+          int   num;
+
+          if (direct_config_get( "dummy-layer-ring", &filename, 1, &num ) || num < 1)
+               return;
+
+          if (dummy_ring_open( filename, direct_config_get_int_value_with_default( "dummy-layer-ring-frames", 8 ),
+                               surface->config.size.w, surface->config.size.h, surface->config.format ))
+               return;
+     }
+
+     pitch = DFB_BYTES_PER_LINE( surface->config.format, surface->config.size.w );
+     rows  = DFB_PLANE_MULTIPLY( surface->config.format, surface->config.size.h );
+
+     if (dummy_ring_header->data_offset + pitch * rows > dummy_ring_header->slot_size) {
+          D_ONCE( "surface %dx%d %s does not fit into ring slots of %u bytes", surface->config.size.w,
+                  surface->config.size.h, dfb_pixelformat_name( surface->config.format ), dummy_ring_header->slot_size );
+          return;
+     }
+
+     index = dummy_ring_header->written;
+     frame = dummy_ring_map + dummy_ring_header->header_size + (index % dummy_ring_header->slots) * dummy_ring_header->slot_size;
+
+     /* Mark the slot as being written, the atomic add implies a full memory barrier. */
+     D_SYNC_ADD( &frame->serial, 1 );
+
+     frame->width      = surface->config.size.w;
+     frame->height     = surface->config.size.h;
+     frame->format     = surface->config.format;
+     frame->pitch      = pitch;
+     frame->size       = pitch * rows;
+     frame->index      = index;
+     frame->pts        = request->pts;
+     frame->time       = now;
+     frame->num_damage = 1;
+     frame->damage[0]  = request->update;
+
+     dst = (u8*) frame + dummy_ring_header->data_offset;
+     src = request->lock.addr;
+
+     for (i=0; i<rows; i++) {
+          direct_memcpy( dst, src, pitch );
+
+          dst += pitch;
+          src += request->lock.pitch;
+     }
+
+     D_SYNC_ADD( &frame->serial, 1 );
+
+     dummy_ring_header->written = index + 1;
+}
+
+/**********************************************************************************************************************/
+
 static void *
 dummy_display_loop( DirectThread *thread,
                     void         *ctx )
@@ -132,6 +285,8 @@ dummy_display_loop( DirectThread *thread,
 
           dfb_surface_notify_display2( request->surface, request->index, request->task );
 
+          dummy_ring_write( request, now );
+
           if (direct_config_get_int_value( "dummy-layer-dump" ) && request->pts > 0) {
                static long long first;
 
@@ -226,6 +381,8 @@ dummyShutdownScreen( CoreScreen           *screen,
      dummy_display_thread      = NULL;
      dummy_display_thread_stop = false;
 
+     dummy_ring_close();
+
      return DFB_OK;
 }
 
@@ -252,6 +409,7 @@ static ScreenFuncs dummyScreenFuncs = {
 
 static DFBResult
 dummyDisplayRequest( CoreSurface           *surface,
+                     const DFBRegion       *update,
                      CoreSurfaceBufferLock *lock )
 {
      DFBResult           ret;
@@ -296,6 +454,11 @@ dummyDisplayRequest( CoreSurface           *surface,
      request->pts     = lock->task ? DisplayTask_GetPTS( lock->task ) : -1;
      request->lock    = *lock;
 
+     if (update)
+          request->update = *update;
+     else
+          request->update = DFB_REGION_INIT_FROM_DIMENSION( &surface->config.size );
+
      D_MAGIC_SET( request, DummyDisplayBuffer );
 
      D_DEBUG_AT( Dummy_Display, "  -> %p\n", request );
@@ -404,7 +567,7 @@ dummyFlipRegion( CoreLayer             *layer,
 {
      dfb_surface_flip( surface, false );
 
-     return dummyDisplayRequest( surface, left_lock );
+     return dummyDisplayRequest( surface, left_update, left_lock );
 }
 
 static DFBResult
@@ -418,7 +581,7 @@ dummyUpdateRegion( CoreLayer             *layer,
                    const DFBRegion       *right_update,
                    CoreSurfaceBufferLock *right_lock )
 {
-     return dummyDisplayRequest( surface, left_lock );
+     return dummyDisplayRequest( surface, left_update, left_lock );
 }
 
 static DisplayLayerFuncs dummyLayerFuncs = {
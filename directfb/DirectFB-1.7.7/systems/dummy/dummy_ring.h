@@ -0,0 +1,88 @@
+/*
+   (c) Copyright 2012-2013  DirectFB integrated media GmbH
+   (c) Copyright 2001-2013  The world wide DirectFB Open Source Community (directfb.org)
+   (c) Copyright 2000-2004  Convergence (integrated media) GmbH
+
+   All rights reserved.
+
+   Written by Denis Oliver Kropp <dok@directfb.org>,
+              Andreas Shimokawa <andi@directfb.org>,
+              Marek Pikarski <mass@directfb.org>,
+              Sven Neumann <neo@directfb.org>,
+              Ville Syrjälä <syrjala@sci.fi> and
+              Claudio Ciccani <klan@users.sf.net>.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+
+
+#ifndef __DUMMY_DUMMY_RING_H__
+#define __DUMMY_DUMMY_RING_H__
+
+#include <direct/types.h>
+
+#include <directfb.h>
+
+/*
+ * Layout of the frame ring file written by the dummy system when "dummy-layer-ring=<file>" is set.
+ *
+ * The file starts with a DummyRingHeader followed by 'slots' frame slots of 'slot_size' bytes each.
+ * Every slot begins with a DummyRingFrame followed by the raw pixels at 'data_offset' (relative to the slot).
+ *
+ * Frame N is stored in slot N % slots. A reader takes a consistent copy by checking that the slot's
+ * 'serial' is even and unchanged before and after reading the slot.
+ */
+
+#define DUMMY_RING_MAGIC         0x52424644     /* 'DFBR' */
+#define DUMMY_RING_VERSION       1
+
+#define DUMMY_RING_MAX_DAMAGE    16
+
+typedef struct {
+     u32                   magic;           /* DUMMY_RING_MAGIC */
+     u32                   version;         /* DUMMY_RING_VERSION */
+
+     u32                   header_size;     /* size of this header, offset of the first slot */
+     u32                   slots;           /* number of frame slots */
+     u32                   slot_size;       /* size of each slot including its DummyRingFrame */
+     u32                   data_offset;     /* offset of pixels within a slot */
+
+     volatile u64          written;         /* total number of frames written so far */
+} DummyRingHeader;
+
+typedef struct {
+     volatile u32          serial;          /* odd while the slot is being written */
+
+     u32                   width;
+     u32                   height;
+     u32                   format;          /* DFBSurfacePixelFormat */
+     u32                   pitch;           /* bytes per line of the pixel data */
+     u32                   size;            /* bytes of pixel data */
+
+     u64                   index;           /* frame number */
+     s64                   pts;             /* presentation time stamp in micro seconds, -1 if none */
+     s64                   time;            /* monotonic time of display in micro seconds */
+
+     u32                   num_damage;      /* number of valid entries in 'damage' */
+     u32                   reserved;
+
+     DFBRegion             damage[DUMMY_RING_MAX_DAMAGE];
+} DummyRingFrame;
+
+
+#endif
+
@@ -67,6 +67,9 @@
 #include <core/coredefs.h>
 #include <core/coretypes.h>
 
+#include <core/Task.h>
+#include <core/DisplayTask.h>
+
 #include <core/layer_control.h>
 #include <core/layers.h>
 #include <core/gfxcard.h>
@@ -103,6 +106,7 @@ DFB_CORE_SYSTEM( fbdev )
 
 D_DEBUG_DOMAIN( FBDev_Mode, "FBDev/Mode", "FBDev System Module Mode Switching" );
 D_DEBUG_DOMAIN( FBDev_Primary, "FBDev/Primary", "FBDev Primary Layer" );
+D_DEBUG_DOMAIN( FBDev_Display, "FBDev/Display", "FBDev Primary Layer Display Thread" );
 
 /******************************************************************************/
 
@@ -179,6 +183,16 @@ static DFBResult primaryFlipRegion    ( CoreLayer                  *layer,
                                         const DFBRegion            *right_update,
                                         CoreSurfaceBufferLock      *right_lock );
 
+static DFBResult primaryUpdateRegion  ( CoreLayer                  *layer,
+                                        void                       *driver_data,
+                                        void                       *layer_data,
+                                        void                       *region_data,
+                                        CoreSurface                *surface,
+                                        const DFBRegion            *left_update,
+                                        CoreSurfaceBufferLock      *left_lock,
+                                        const DFBRegion            *right_update,
+                                        CoreSurfaceBufferLock      *right_lock );
+
 
 static DisplayLayerFuncs primaryLayerFuncs = {
      .LayerDataSize      = primaryLayerDataSize,
@@ -192,6 +206,7 @@ static DisplayLayerFuncs primaryLayerFuncs = {
      .SetRegion          = primarySetRegion,
      .RemoveRegion       = primaryRemoveRegion,
      .FlipRegion         = primaryFlipRegion,
+     .UpdateRegion       = primaryUpdateRegion,
 };
 
 /******************************************************************************/
@@ -202,6 +217,10 @@ static DFBResult primaryInitScreen  ( CoreScreen           *screen,
                                       void                 *screen_data,
                                       DFBScreenDescription *description );
 
+static DFBResult primaryShutdownScreen( CoreScreen         *screen,
+                                        void               *driver_data,
+                                        void               *screen_data );
+
 static DFBResult primarySetPowerMode( CoreScreen           *screen,
                                       void                 *driver_data,
                                       void                 *screen_data,
@@ -223,7 +242,8 @@ static DFBResult primaryGetVSyncCount( CoreScreen           *screen,
                                        unsigned long        *ret_count );
 
 static ScreenFuncs primaryScreenFuncs = {
-     .InitScreen    = primaryInitScreen,
+     .InitScreen     = primaryInitScreen,
+     .ShutdownScreen = primaryShutdownScreen,
      .SetPowerMode  = primarySetPowerMode,
      .WaitVSync     = primaryWaitVSync,
      .GetScreenSize = primaryGetScreenSize,
@@ -238,6 +258,14 @@ static DFBResult dfb_fbdev_set_palette( CorePalette *palette );
 static DFBResult dfb_fbdev_set_rgb332_palette( void );
 static DFBResult dfb_fbdev_pan( int xoffset, int yoffset, bool onsync );
 static DFBResult dfb_fbdev_blank( int level );
+
+static DFBResult dfb_fbdev_display_start  ( void );
+static void      dfb_fbdev_display_stop   ( void );
+static DFBResult dfb_fbdev_display_request( CoreSurface           *surface,
+                                            CoreSurfaceBufferLock *lock,
+                                            DFBSurfaceFlipFlags    flags,
+                                            bool                   flip );
+static void      dfb_fbdev_display_flush  ( void );
 static void      dfb_fbdev_var_to_mode( const struct fb_var_screeninfo *var,
                                         VideoMode                      *mode );
 static const VideoMode *dfb_fbdev_find_mode( int                          width,
@@ -1062,6 +1090,21 @@ primaryInitScreen( CoreScreen           *screen,
      snprintf( description->name,
                DFB_SCREEN_DESC_NAME_LENGTH, "FBDev Primary Screen" );
 
+     if (direct_config_get_int_value( "fbdev-display-queue" ) > 0)
+          return dfb_fbdev_display_start();
+
+     return DFB_OK;
+}
+
+static DFBResult
+primaryShutdownScreen( CoreScreen *screen,
+                       void       *driver_data,
+                       void       *screen_data )
+{
+     D_DEBUG_AT( FBDev_Primary, "%s()\n", __FUNCTION__ );
+
+     dfb_fbdev_display_stop();
+
      return DFB_OK;
 }
 
@@ -1416,6 +1459,10 @@ primaryAddRegion( CoreLayer             *layer,
 {
      D_DEBUG_AT( FBDev_Primary, "%s()\n", __FUNCTION__ );
 
+     /* With the display thread, tasks of this layer are completed and notifications are sent by the thread. */
+     if (dfb_fbdev->display.thread)
+          dfb_layer_add_system_caps( layer, CSCAPS_DISPLAY_TASKS | CSCAPS_NOTIFY_DISPLAY | CSCAPS_DISPLAY_PTS );
+
      return DFB_OK;
 }
 
@@ -1486,6 +1533,8 @@ primaryRemoveRegion( CoreLayer             *layer,
 {
      D_DEBUG_AT( FBDev_Primary, "%s()\n", __FUNCTION__ );
 
+     dfb_fbdev_display_flush();
+
      return DFB_OK;
 }
 
@@ -1506,6 +1555,12 @@ primaryFlipRegion( CoreLayer             *layer,
 
      D_DEBUG_AT( FBDev_Primary, "%s()\n", __FUNCTION__ );
 
+     if (dfb_fbdev->display.thread) {
+          dfb_surface_flip( surface, false );
+
+          return dfb_fbdev_display_request( surface, left_lock, flags, true );
+     }
+
      if (((flags & DSFLIP_WAITFORSYNC) == DSFLIP_WAITFORSYNC) &&
          !dfb_config->pollvsync_after)
           dfb_screen_wait_vsync( dfb_screens_at(DSCID_PRIMARY) );
@@ -1525,6 +1580,379 @@ primaryFlipRegion( CoreLayer             *layer,
      return DFB_OK;
 }
 
+static DFBResult
+primaryUpdateRegion( CoreLayer             *layer,
+                     void                  *driver_data,
+                     void                  *layer_data,
+                     void                  *region_data,
+                     CoreSurface           *surface,
+                     const DFBRegion       *left_update,
+                     CoreSurfaceBufferLock *left_lock,
+                     const DFBRegion       *right_update,
+                     CoreSurfaceBufferLock *right_lock )
+{
+     D_DEBUG_AT( FBDev_Primary, "%s()\n", __FUNCTION__ );
+
+     /* Front buffer content is scanned out directly, only pacing and notification are done by the thread. */
+     if (dfb_fbdev->display.thread)
+          return dfb_fbdev_display_request( surface, left_lock, DSFLIP_NONE, false );
+
+     return DFB_OK;
+}
+
+/** fbdev display thread **/
+
+typedef struct {
+     DirectLink             link;
+
+     int                    magic;
+
+     CoreSurface           *surface;
+     CoreSurfaceBuffer     *buffer;
+     int                    index;
+     DFB_DisplayTask       *task;
+
+     long long              pts;
+
+     DFBSurfaceFlipFlags    flags;
+     bool                   flip;
+     int                    xoffset;
+     int                    yoffset;
+} FBDevDisplayRequest;
+
+static void
+display_request_finish( FBDevDisplayRequest *request )
+{
+     D_MAGIC_ASSERT( request, FBDevDisplayRequest );
+
+     dfb_surface_buffer_unref( request->buffer );
+     dfb_surface_unref( request->surface );
+
+     D_MAGIC_CLEAR( request );
+
+     D_FREE( request );
+}
+
+static void
+display_wait_vblank( FBDevDisplay *display )
+{
+     static const int zero = 0;
+
+     if (!display->vsync || ioctl( dfb_fbdev->fd, FBIO_WAITFORVSYNC, &zero ))
+          dfb_screen_wait_vsync( dfb_screens_at(DSCID_PRIMARY) );
+
+     display->vblank = direct_clock_get_time( DIRECT_CLOCK_MONOTONIC );
+}
+
+static void
+display_request_show( FBDevDisplay        *display,
+                      FBDevDisplayRequest *request )
+{
+     DFBSurfaceFlipFlags flags  = request->flags;
+     bool                synced = false;
+
+     if (request->flip) {
+          if (((flags & DSFLIP_WAITFORSYNC) == DSFLIP_WAITFORSYNC) && !dfb_config->pollvsync_after) {
+               display_wait_vblank( display );
+
+               synced = true;
+          }
+
+          if ((flags & DSFLIP_WAITFORSYNC) == DSFLIP_ONSYNC) {
+               long long start = direct_clock_get_time( DIRECT_CLOCK_MONOTONIC );
+               long long end;
+
+               dfb_fbdev_pan( request->xoffset, request->yoffset, true );
+
+               end = direct_clock_get_time( DIRECT_CLOCK_MONOTONIC );
+
+               /* Many drivers return from panning activated on vsync right away instead of blocking
+                  until the vblank, still wait for it then. Without FBIO_WAITFORVSYNC trust the pan. */
+               if (!display->vsync || end - start > display->interval / 2) {
+                    display->vblank = end;
+
+                    synced = true;
+               }
+          }
+          else
+               dfb_fbdev_pan( request->xoffset, request->yoffset, false );
+     }
+
+     /* Pace to the refresh, this also makes sure the previous buffer is no longer scanned out. */
+     if (!synced)
+          display_wait_vblank( display );
+
+     D_DEBUG_AT( FBDev_Display, "  -> shown at vblank %lld (%lldus after pts)\n",
+                 display->vblank, request->pts > 0 ? display->vblank - request->pts : 0 );
+
+     dfb_surface_notify_display2( request->surface, request->index, request->task );
+}
+
+static void *
+display_loop( DirectThread *thread,
+              void         *arg )
+{
+     static const int  zero    = 0;
+     FBDevDisplay     *display = arg;
+
+     /* Pace against the vblank directly, if the driver supports waiting for it. */
+     display->vsync = !dfb_config->pollvsync_none && !ioctl( dfb_fbdev->fd, FBIO_WAITFORVSYNC, &zero );
+
+     D_DEBUG_AT( FBDev_Display, "%s() -> FBIO_WAITFORVSYNC %ssupported\n", __FUNCTION__, display->vsync ? "" : "not " );
+
+     while (true) {
+          long long            now;
+          FBDevDisplayRequest *request;
+          DirectLink          *dropped = NULL;
+
+          direct_mutex_lock( &display->lock );
+
+          while (!display->requests && !display->stop)
+               direct_waitqueue_wait( &display->wq, &display->lock );
+
+          if (display->stop) {
+               direct_mutex_unlock( &display->lock );
+               break;
+          }
+
+          now = direct_clock_get_time( DIRECT_CLOCK_MONOTONIC );
+
+          request = (FBDevDisplayRequest*) display->requests;
+          D_MAGIC_ASSERT( request, FBDevDisplayRequest );
+
+          /* Drop frames whose successor is already due, showing them would only delay the newer one. */
+          while (request->link.next && request->pts > 0) {
+               FBDevDisplayRequest *next = (FBDevDisplayRequest*) request->link.next;
+
+               D_MAGIC_ASSERT( next, FBDevDisplayRequest );
+
+               if (next->pts <= 0 || next->pts > now + display->interval / 2)
+                    break;
+
+               D_DEBUG_AT( FBDev_Display, "  -> dropping request %p (pts %lld, %lldus late)\n",
+                           request, request->pts, now - request->pts );
+
+               direct_list_remove( &display->requests, &request->link );
+               direct_list_append( &dropped, &request->link );
+
+               display->queued--;
+               display->dropped++;
+
+               request = next;
+          }
+
+          direct_mutex_unlock( &display->lock );
+
+          if (dropped)
+               direct_waitqueue_broadcast( &display->wq );
+
+          while (dropped) {
+               FBDevDisplayRequest *drop = (FBDevDisplayRequest*) dropped;
+
+               direct_list_remove( &dropped, &drop->link );
+
+               /* The frame will never be shown, so its buffer is released right away,
+                  still notify it like a shown one for those waiting on its display. */
+               dfb_surface_notify_display2( drop->surface, drop->index, NULL );
+
+               if (drop->task)
+                    Task_Done( drop->task );
+
+               display_request_finish( drop );
+          }
+
+          D_DEBUG_AT( FBDev_Display, "%s() <- request %p, index %d, task %p, pts %lldus (%lldus from now)\n",
+                      __FUNCTION__, request, request->index, request->task, request->pts, request->pts - now );
+
+          /* Sleep until one frame before the presentation time, the vsync wait does the rest. */
+          while (request->pts - now > display->interval) {
+               direct_thread_sleep( request->pts - now - display->interval );
+
+               now = direct_clock_get_time( DIRECT_CLOCK_MONOTONIC );
+          }
+
+          display_request_show( display, request );
+
+
+          direct_mutex_lock( &display->lock );
+
+          /* The previous frame is no longer scanned out, complete its task. */
+          if (display->task)
+               Task_Done( display->task );
+
+          display->task = request->task;
+
+          direct_list_remove( &display->requests, &request->link );
+
+          display->queued--;
+          display->displayed++;
+
+          direct_waitqueue_broadcast( &display->wq );
+
+          direct_mutex_unlock( &display->lock );
+
+          display_request_finish( request );
+     }
+
+     D_DEBUG_AT( FBDev_Display, "%s() <- stop! (%u displayed, %u dropped)\n",
+                 __FUNCTION__, display->displayed, display->dropped );
+
+     return NULL;
+}
+
+static DFBResult
+dfb_fbdev_display_start( void )
+{
+     FBDevDisplay *display = &dfb_fbdev->display;
+
+     D_DEBUG_AT( FBDev_Display, "%s()\n", __FUNCTION__ );
+
+     D_ASSERT( display->thread == NULL );
+
+     display->max_queued = direct_config_get_int_value( "fbdev-display-queue" );
+     display->interval   = dfb_config->screen_frame_interval;
+
+     if (dfb_fbdev->shared->current_mode.pixclock > 0) {
+          const VideoMode *mode  = &dfb_fbdev->shared->current_mode;
+          long long        total = (long long) (mode->xres + mode->left_margin + mode->right_margin + mode->hsync_len) *
+                                   (mode->yres + mode->upper_margin + mode->lower_margin + mode->vsync_len);
+
+          /* pixclock is in pico seconds */
+          display->interval = total * mode->pixclock / 1000000LL;
+     }
+
+     direct_mutex_init( &display->lock );
+     direct_waitqueue_init( &display->wq );
+
+     display->thread = direct_thread_create( DTT_OUTPUT, display_loop, display, "FBDev Display" );
+     if (!display->thread) {
+          direct_waitqueue_deinit( &display->wq );
+          direct_mutex_deinit( &display->lock );
+          return DFB_INIT;
+     }
+
+     D_INFO( "DirectFB/FBDev: Using display thread with up to %d pending frames (interval %lldus)\n",
+             display->max_queued, display->interval );
+
+     return DFB_OK;
+}
+
+static void
+dfb_fbdev_display_stop( void )
+{
+     FBDevDisplay *display = &dfb_fbdev->display;
+
+     D_DEBUG_AT( FBDev_Display, "%s()\n", __FUNCTION__ );
+
+     if (!display->thread)
+          return;
+
+     dfb_fbdev_display_flush();
+
+     direct_mutex_lock( &display->lock );
+
+     display->stop = true;
+
+     direct_waitqueue_broadcast( &display->wq );
+
+     direct_mutex_unlock( &display->lock );
+
+     direct_thread_join( display->thread );
+     direct_thread_destroy( display->thread );
+
+     direct_waitqueue_deinit( &display->wq );
+     direct_mutex_deinit( &display->lock );
+
+     display->thread = NULL;
+     display->stop   = false;
+}
+
+static DFBResult
+dfb_fbdev_display_request( CoreSurface           *surface,
+                           CoreSurfaceBufferLock *lock,
+                           DFBSurfaceFlipFlags    flags,
+                           bool                   flip )
+{
+     DFBResult            ret;
+     FBDevDisplay        *display = &dfb_fbdev->display;
+     FBDevDisplayRequest *request;
+
+     D_DEBUG_AT( FBDev_Display, "%s( %p, %p, 0x%04x, %sflip )\n", __FUNCTION__, surface, lock, flags, flip ? "" : "no " );
+
+     CORE_SURFACE_ASSERT( surface );
+     CORE_SURFACE_BUFFER_LOCK_ASSERT( lock );
+     CORE_SURFACE_ALLOCATION_ASSERT( lock->allocation );
+
+     ret = dfb_surface_ref( surface );
+     if (ret)
+          return ret;
+
+     ret = dfb_surface_buffer_ref( lock->buffer );
+     if (ret) {
+          dfb_surface_unref( surface );
+          return ret;
+     }
+
+     request = D_CALLOC( 1, sizeof(FBDevDisplayRequest) );
+     if (!request) {
+          dfb_surface_buffer_unref( lock->buffer );
+          dfb_surface_unref( surface );
+          return D_OOM();
+     }
+
+     request->surface = surface;
+     request->buffer  = lock->buffer;
+     request->index   = lock->allocation->index;
+     request->task    = lock->task;
+     request->pts     = lock->task ? DisplayTask_GetPTS( lock->task ) : -1;
+     request->flags   = flags;
+     request->flip    = flip;
+     request->xoffset = dfb_fbdev->shared->config.source.x;
+     request->yoffset = lock->offset / lock->pitch + dfb_fbdev->shared->config.source.y;
+
+     D_MAGIC_SET( request, FBDevDisplayRequest );
+
+     direct_mutex_lock( &display->lock );
+
+     /* Bound the queue, this blocks the display task, but not the producer of the frame. */
+     while (display->queued >= display->max_queued)
+          direct_waitqueue_wait( &display->wq, &display->lock );
+
+     direct_list_append( &display->requests, &request->link );
+
+     display->queued++;
+
+     direct_waitqueue_broadcast( &display->wq );
+
+     direct_mutex_unlock( &display->lock );
+
+     return DFB_OK;
+}
+
+static void
+dfb_fbdev_display_flush( void )
+{
+     FBDevDisplay *display = &dfb_fbdev->display;
+
+     D_DEBUG_AT( FBDev_Display, "%s()\n", __FUNCTION__ );
+
+     if (!display->thread)
+          return;
+
+     direct_mutex_lock( &display->lock );
+
+     while (display->requests)
+          direct_waitqueue_wait( &display->wq, &display->lock );
+
+     if (display->task) {
+          Task_Done( display->task );
+
+          display->task = NULL;
+     }
+
+     direct_mutex_unlock( &display->lock );
+}
+
 /** fbdev internal **/
 
 static void
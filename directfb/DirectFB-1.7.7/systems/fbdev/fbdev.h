@@ -41,6 +41,8 @@
 
 #include <core/system.h>
 
+#include <direct/thread.h>
+
 #include <fusion/call.h>
 #include <fusion/reactor.h>
 
@@ -104,6 +106,34 @@ typedef struct {
      SurfaceManager          *manager;
 } FBDevShared;
 
+/*
+ * Asynchronous display of the primary layer, enabled via "fbdev-display-queue=<n>".
+ *
+ * Flips are queued by the display task and executed (pan + vsync) by a dedicated thread,
+ * which paces the frames by their PTS and drops frames that are superseded before display.
+ */
+typedef struct {
+     DirectThread            *thread;
+     bool                     stop;
+
+     DirectMutex              lock;
+     DirectWaitQueue          wq;
+
+     DirectLink              *requests;      /* pending FBDevDisplayRequest list */
+     int                      queued;        /* number of pending requests */
+     int                      max_queued;    /* bound of pending requests */
+
+     DFB_DisplayTask         *task;          /* task currently on screen */
+
+     long long                interval;      /* frame interval in micro seconds */
+
+     bool                     vsync;         /* FBIO_WAITFORVSYNC is supported */
+     long long                vblank;        /* time of the last vblank waited for */
+
+     unsigned int             displayed;     /* number of frames shown */
+     unsigned int             dropped;       /* number of late frames skipped */
+} FBDevDisplay;
+
 typedef struct {
      FBDevShared             *shared;
 
@@ -117,6 +147,8 @@ typedef struct {
      VirtualTerminal         *vt;
 
      AGPDevice               *agp;
+
+     FBDevDisplay             display;
 } FBDev;
 
 
@@ -0,0 +1,231 @@
+/*
+   (c) Copyright 2012-2013  DirectFB integrated media GmbH
+   (c) Copyright 2001-2013  The world wide DirectFB Open Source Community (directfb.org)
+   (c) Copyright 2000-2004  Convergence (integrated media) GmbH
+
+   All rights reserved.
+
+   Written by Denis Oliver Kropp <dok@directfb.org>,
+              Andreas Shimokawa <andi@directfb.org>,
+              Marek Pikarski <mass@directfb.org>,
+              Sven Neumann <neo@directfb.org>,
+              Ville Syrjälä <syrjala@sci.fi> and
+              Claudio Ciccani <klan@users.sf.net>.
+
+   This file is subject to the terms and conditions of the MIT License:
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without restriction,
+   including without limitation the rights to use, copy, modify, merge,
+   publish, distribute, sublicense, and/or sell copies of the Software,
+   and to permit persons to whom the Software is furnished to do so,
+   subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+   IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+   CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+   TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+   SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <direct/clock.h>
+#include <direct/messages.h>
+
+#include <directfb.h>
+#include <directfb_util.h>
+
+/*
+ * Labels mixing Latin, Greek, Cyrillic and CJK, so most glyphs have indices above 127.
+ */
+static const char *strings[] = {
+     "Settings / Настройки / 設定 / Ρυθμίσεις",
+     "Программа передач на сегодня",
+     "電子節目表 — 今日の番組 — 오늘의 프로그램",
+     "Λίστα καναλιών 1–99, Список каналов",
+     "繁體中文 简体中文 日本語 한국어 English",
+     "Громкость 75% · 音量 75% · Volume 75%",
+     "Wiedergabe fortsetzen? Продолжить? 続けますか？",
+     "0123456789 АБВГДЕЖЗИЙ ΑΒΓΔΕΖΗΘ あいうえお",
+};
+
+/**********************************************************************************************************************/
+
+static int
+print_usage( const char *prg )
+{
+     fprintf (stderr, "\n");
+     fprintf (stderr, "== DirectFB Font Scripts Test (version %s) ==\n", DIRECTFB_VERSION);
+     fprintf (stderr, "\n");
+     fprintf (stderr, "Usage: %s [options] <file>\n", prg);
+     fprintf (stderr, "\n");
+     fprintf (stderr, "Options:\n");
+     fprintf (stderr, "  -h, --help                        Show this help message\n");
+     fprintf (stderr, "  -v, --version                     Print version information\n");
+     fprintf (stderr, "  -s, --size <pixels>               Font height (default 24)\n");
+     fprintf (stderr, "  -l, --loops <num>                 Number of rounds over all strings (default 1000)\n");
+
+     return -1;
+}
+
+/**********************************************************************************************************************/
+
+static int
+count_characters( const char *text )
+{
+     int num = 0;
+
+     for (; *text; text++) {
+          if ((*text & 0xc0) != 0x80)
+               num++;
+     }
+
+     return num;
+}
+
+int
+main( int argc, char *argv[] )
+{
+     DFBResult              ret;
+     int                    i, n;
+     int                    size      = 24;
+     int                    num_loops = 1000;
+     int                    chars     = 0;
+     long long              t_draw, t_width;
+     DFBFontDescription     fdesc;
+     DFBSurfaceDescription  desc;
+     const char            *url  = NULL;
+     IDirectFB             *dfb;
+     IDirectFBFont         *font = NULL;
+     IDirectFBSurface      *dest = NULL;
+
+     /* Initialize DirectFB. */
+     ret = DirectFBInit( &argc, &argv );
+     if (ret) {
+          D_DERROR( ret, "DFBTest/FontScripts: DirectFBInit() failed!\n" );
+          return ret;
+     }
+
+     /* Parse arguments. */
+     for (i=1; i<argc; i++) {
+          const char *arg = argv[i];
+
+          if (strcmp( arg, "-h" ) == 0 || strcmp (arg, "--help") == 0)
+               return print_usage( argv[0] );
+          else if (strcmp (arg, "-v") == 0 || strcmp (arg, "--version") == 0) {
+               fprintf (stderr, "dfbtest_font_scripts version %s\n", DIRECTFB_VERSION);
+               return false;
+          }
+          else if ((strcmp (arg, "-s") == 0 || strcmp (arg, "--size") == 0) && ++i < argc)
+               size = atoi( argv[i] );
+          else if ((strcmp (arg, "-l") == 0 || strcmp (arg, "--loops") == 0) && ++i < argc)
+               num_loops = atoi( argv[i] );
+          else if (!url)
+               url = arg;
+          else
+               return print_usage( argv[0] );
+     }
+
+     /* Check if we got an URL. */
+     if (!url || size < 1 || num_loops < 1)
+          return print_usage( argv[0] );
+
+     /* Create super interface. */
+     ret = DirectFBCreate( &dfb );
+     if (ret) {
+          D_DERROR( ret, "DFBTest/FontScripts: DirectFBCreate() failed!\n" );
+          return ret;
+     }
+
+     fdesc.flags  = DFDESC_HEIGHT;
+     fdesc.height = size;
+
+     ret = dfb->CreateFont( dfb, url, &fdesc, &font );
+     if (ret) {
+          D_DERROR( ret, "DFBTest/FontScripts: IDirectFB::CreateFont( '%s' ) failed!\n", url );
+          goto out;
+     }
+
+     /* Create an offscreen surface to draw into. */
+     desc.flags       = DSDESC_WIDTH | DSDESC_HEIGHT | DSDESC_PIXELFORMAT;
+     desc.width       = 1280;
+     desc.height      = size * D_ARRAY_SIZE(strings) * 2;
+     desc.pixelformat = DSPF_ARGB;
+
+     ret = dfb->CreateSurface( dfb, &desc, &dest );
+     if (ret) {
+          D_DERROR( ret, "DFBTest/FontScripts: IDirectFB::CreateSurface() failed!\n" );
+          goto out;
+     }
+
+     dest->Clear( dest, 0, 0, 0, 0xff );
+     dest->SetColor( dest, 0xff, 0xff, 0xff, 0xff );
+     dest->SetFont( dest, font );
+
+     for (n=0; n<D_ARRAY_SIZE(strings); n++)
+          chars += count_characters( strings[n] );
+
+     /* Load all glyphs before measuring. */
+     for (n=0; n<D_ARRAY_SIZE(strings); n++)
+          dest->DrawString( dest, strings[n], -1, 10, n * size * 2, DSTF_TOPLEFT );
+
+     dfb->WaitIdle( dfb );
+
+     /* Measure the labels like a UI does when laying out each frame. */
+     t_width = direct_clock_get_abs_micros();
+
+     for (i=0; i<num_loops; i++) {
+          for (n=0; n<D_ARRAY_SIZE(strings); n++) {
+               int width;
+
+               font->GetStringWidth( font, strings[n], -1, &width );
+          }
+     }
+
+     t_width = direct_clock_get_abs_micros() - t_width;
+
+     /* Draw the labels, centered to measure and draw each one. */
+     t_draw = direct_clock_get_abs_micros();
+
+     for (i=0; i<num_loops; i++) {
+          for (n=0; n<D_ARRAY_SIZE(strings); n++)
+               dest->DrawString( dest, strings[n], -1, desc.width / 2, n * size * 2, DSTF_TOPCENTER );
+     }
+
+     dfb->WaitIdle( dfb );
+
+     t_draw = direct_clock_get_abs_micros() - t_draw;
+
+     D_INFO( "DFBTest/FontScripts: %d strings with %d characters, %d rounds\n",
+             (int) D_ARRAY_SIZE(strings), chars, num_loops );
+
+     D_INFO( "DFBTest/FontScripts: GetStringWidth   %8.3f us per string, %10.0f chars/sec\n",
+             t_width / (double)(num_loops * D_ARRAY_SIZE(strings)),
+             chars * (double) num_loops * 1000000.0 / (t_width ? : 1) );
+
+     D_INFO( "DFBTest/FontScripts: DrawString       %8.3f us per string, %10.0f chars/sec\n",
+             t_draw / (double)(num_loops * D_ARRAY_SIZE(strings)),
+             chars * (double) num_loops * 1000000.0 / (t_draw ? : 1) );
+
+out:
+     if (dest)
+          dest->Release( dest );
+
+     if (font)
+          font->Release( font );
+
+     /* Shutdown DirectFB. */
+     dfb->Release( dfb );
+
+     return ret;
+}
@@ -0,0 +1,284 @@
+/*
+   (c) Copyright 2012-2013  DirectFB integrated media GmbH
+   (c) Copyright 2001-2013  The world wide DirectFB Open Source Community (directfb.org)
+   (c) Copyright 2000-2004  Convergence (integrated media) GmbH
+
+   All rights reserved.
+
+   Written by Denis Oliver Kropp <dok@directfb.org>,
+              Andreas Shimokawa <andi@directfb.org>,
+              Marek Pikarski <mass@directfb.org>,
+              Sven Neumann <neo@directfb.org>,
+              Ville Syrjälä <syrjala@sci.fi> and
+              Claudio Ciccani <klan@users.sf.net>.
+
+   This file is subject to the terms and conditions of the MIT License:
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without restriction,
+   including without limitation the rights to use, copy, modify, merge,
+   publish, distribute, sublicense, and/or sell copies of the Software,
+   and to permit persons to whom the Software is furnished to do so,
+   subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+   IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+   CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+   TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+   SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <config.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <direct/messages.h>
+
+#include <directfb.h>
+
+#define WIDTH  64
+#define HEIGHT 64
+#define PITCH  (WIDTH * 4 + 64)
+
+/**********************************************************************************************************************/
+
+static int
+print_usage( const char *prg )
+{
+     fprintf (stderr, "\n");
+     fprintf (stderr, "== DirectFB MemFD Surface Test (version %s) ==\n", DIRECTFB_VERSION);
+     fprintf (stderr, "\n");
+     fprintf (stderr, "Usage: %s [options]\n", prg);
+     fprintf (stderr, "\n");
+     fprintf (stderr, "Options:\n");
+     fprintf (stderr, "  -h, --help                        Show this help message\n");
+     fprintf (stderr, "  -v, --version                     Print version information\n");
+
+     return -1;
+}
+
+/**********************************************************************************************************************/
+
+static int
+create_fd( size_t length )
+{
+     int fd = -1;
+
+#ifdef __NR_memfd_create
+     fd = syscall( __NR_memfd_create, "dfbtest_memfd", 0 );
+#endif
+     if (fd < 0) {
+          D_PERROR( "DFBTest/MemFD: memfd_create() failed!\n" );
+          return -1;
+     }
+
+     if (ftruncate( fd, length )) {
+          D_PERROR( "DFBTest/MemFD: ftruncate( %zu ) failed!\n", length );
+          close( fd );
+          return -1;
+     }
+
+     return fd;
+}
+
+static inline u32
+pattern( int x, int y )
+{
+     return 0xff000000 | (x * 4) << 16 | (y * 4) << 8 | ((x ^ y) & 0xff);
+}
+
+static void
+gen_pixels( u8 *ptr )
+{
+     int x, y;
+
+     for (y=0; y<HEIGHT; y++) {
+          u32 *p = (u32*)(ptr + PITCH * y);
+
+          for (x=0; x<WIDTH; x++)
+               p[x] = pattern( x, y );
+     }
+}
+
+static int
+check_pixels( const char *what, const u8 *ptr, int pitch, u32 fill, int fill_w, int fill_h )
+{
+     int x, y;
+
+     for (y=0; y<HEIGHT; y++) {
+          const u32 *p = (const u32*)(ptr + pitch * y);
+
+          for (x=0; x<WIDTH; x++) {
+               u32 expected = (x < fill_w && y < fill_h) ? fill : pattern( x, y );
+
+               if (p[x] != expected) {
+                    D_ERROR( "DFBTest/MemFD: %s has 0x%08x at %d,%d instead of 0x%08x!\n",
+                             what, p[x], x, y, expected );
+                    return -1;
+               }
+          }
+     }
+
+     return 0;
+}
+
+/**********************************************************************************************************************/
+
+int
+main( int argc, char *argv[] )
+{
+     DFBResult               ret;
+     int                     i;
+     int                     fd      = -1;
+     u8                     *map     = MAP_FAILED;
+     int                     failed  = 0;
+     DFBSurfaceDescription   desc;
+     DFBSurfaceBufferFD      buffer;
+     IDirectFB              *dfb;
+     IDirectFBSurface       *source  = NULL;
+     IDirectFBSurface       *dest    = NULL;
+     void                   *ptr;
+     int                     pitch;
+
+     /* Initialize DirectFB. */
+     ret = DirectFBInit( &argc, &argv );
+     if (ret) {
+          D_DERROR( ret, "DFBTest/MemFD: DirectFBInit() failed!\n" );
+          return ret;
+     }
+
+     /* Parse arguments. */
+     for (i=1; i<argc; i++) {
+          const char *arg = argv[i];
+
+          if (strcmp( arg, "-h" ) == 0 || strcmp (arg, "--help") == 0)
+               return print_usage( argv[0] );
+          else if (strcmp (arg, "-v") == 0 || strcmp (arg, "--version") == 0) {
+               fprintf (stderr, "dfbtest_memfd version %s\n", DIRECTFB_VERSION);
+               return false;
+          }
+          else
+               return print_usage( argv[0] );
+     }
+
+     /* Create super interface. */
+     ret = DirectFBCreate( &dfb );
+     if (ret) {
+          D_DERROR( ret, "DFBTest/MemFD: DirectFBCreate() failed!\n" );
+          return ret;
+     }
+
+     /* Create the file holding the pixels of the source and write them directly. */
+     fd = create_fd( PITCH * HEIGHT );
+     if (fd < 0) {
+          ret = DFB_INIT;
+          goto out;
+     }
+
+     map = mmap( NULL, PITCH * HEIGHT, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+     if (map == MAP_FAILED) {
+          D_PERROR( "DFBTest/MemFD: mmap() failed!\n" );
+          ret = DFB_INIT;
+          goto out;
+     }
+
+     gen_pixels( map );
+
+     desc.flags       = DSDESC_WIDTH | DSDESC_HEIGHT | DSDESC_PIXELFORMAT;
+     desc.width       = WIDTH;
+     desc.height      = HEIGHT;
+     desc.pixelformat = DSPF_ARGB;
+
+     /* A pitch exceeding the file size has to be rejected. */
+     buffer.fd     = fd;
+     buffer.offset = 0;
+     buffer.pitch  = PITCH * 2;
+
+     ret = dfb->CreateSurfaceFromFDs( dfb, &desc, &buffer, &source );
+     if (ret != DFB_INVARG) {
+          D_ERROR( "DFBTest/MemFD: Import of too short file returned '%s' instead of DFB_INVARG!\n",
+                   DirectFBErrorString( ret ) );
+          if (!ret) {
+               source->Release( source );
+               source = NULL;
+          }
+          failed++;
+     }
+
+     /* Import the file as the source surface. */
+     buffer.pitch = PITCH;
+
+     ret = dfb->CreateSurfaceFromFDs( dfb, &desc, &buffer, &source );
+     if (ret) {
+          D_DERROR( ret, "DFBTest/MemFD: IDirectFB::CreateSurfaceFromFDs() failed!\n" );
+          goto out;
+     }
+
+     ret = dfb->CreateSurface( dfb, &desc, &dest );
+     if (ret) {
+          D_DERROR( ret, "DFBTest/MemFD: IDirectFB::CreateSurface() for the destination failed!\n" );
+          goto out;
+     }
+
+     /* Render from the imported surface and read back the result. */
+     dest->Blit( dest, source, NULL, 0, 0 );
+
+     ret = dest->Lock( dest, DSLF_READ, &ptr, &pitch );
+     if (ret) {
+          D_DERROR( ret, "DFBTest/MemFD: IDirectFBSurface::Lock() on the destination failed!\n" );
+          goto out;
+     }
+
+     if (check_pixels( "Blit from imported file", ptr, pitch, 0, 0, 0 ))
+          failed++;
+
+     dest->Unlock( dest );
+
+     /* Render to the imported surface, the result has to show up in our own mapping. */
+     source->SetColor( source, 0x12, 0x34, 0x56, 0xff );
+     source->FillRectangle( source, 0, 0, WIDTH / 2, HEIGHT / 2 );
+
+     ret = source->Lock( source, DSLF_READ, &ptr, &pitch );
+     if (ret) {
+          D_DERROR( ret, "DFBTest/MemFD: IDirectFBSurface::Lock() on the source failed!\n" );
+          goto out;
+     }
+
+     source->Unlock( source );
+
+     if (check_pixels( "Mapping after fill", map, PITCH, 0xff123456, WIDTH / 2, HEIGHT / 2 ))
+          failed++;
+
+     if (failed)
+          ret = DFB_FAILURE;
+     else
+          D_INFO( "DFBTest/MemFD: All checks passed\n" );
+
+out:
+     if (dest)
+          dest->Release( dest );
+
+     if (source)
+          source->Release( source );
+
+     if (map != MAP_FAILED)
+          munmap( map, PITCH * HEIGHT );
+
+     if (fd >= 0)
+          close( fd );
+
+     /* Shutdown DirectFB. */
+     dfb->Release( dfb );
+
+     return ret;
+}
@@ -0,0 +1,485 @@
+/*
+   (c) Copyright 2012-2013  DirectFB integrated media GmbH
+   (c) Copyright 2001-2013  The world wide DirectFB Open Source Community (directfb.org)
+   (c) Copyright 2000-2004  Convergence (integrated media) GmbH
+
+   All rights reserved.
+
+   Written by Denis Oliver Kropp <dok@directfb.org>,
+              Andreas Shimokawa <andi@directfb.org>,
+              Marek Pikarski <mass@directfb.org>,
+              Sven Neumann <neo@directfb.org>,
+              Ville Syrjälä <syrjala@sci.fi> and
+              Claudio Ciccani <klan@users.sf.net>.
+
+   This file is subject to the terms and conditions of the MIT License:
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without restriction,
+   including without limitation the rights to use, copy, modify, merge,
+   publish, distribute, sublicense, and/or sell copies of the Software,
+   and to permit persons to whom the Software is furnished to do so,
+   subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+   IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+   CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+   TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+   SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <direct/clock.h>
+#include <direct/messages.h>
+
+#include <region.h>
+
+
+static int num_windows = 64;
+static int num_loops   = 2000;
+static int screen_w    = 1920;
+static int screen_h    = 1080;
+static int num_models  = 20000;
+static bool check;
+
+static int failures;
+
+/**********************************************************************************************************************/
+
+static int parse_cmdline ( int argc, char *argv[] );
+static int show_usage    ( void );
+
+/**********************************************************************************************************************/
+
+static void
+random_rect( misc_region_t *region )
+{
+     int w = 16 + rand() % (screen_w / 3);
+     int h = 16 + rand() % (screen_h / 3);
+
+     misc_region_init_rect( region, NULL, rand() % (screen_w - w), rand() % (screen_h - h), w, h );
+}
+
+static void
+verify( misc_region_t *region, const char *op )
+{
+     if (check && !misc_region_selfcheck( region )) {
+          D_ERROR( "Region/Bench: Invalid region after %s!\n", op );
+          failures++;
+     }
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Reference model: regions on a small grid are compared pixel by pixel against plain bitmaps.
+ */
+
+#define GRID 24
+
+typedef struct {
+     bool pixels[GRID][GRID];
+} ModelBitmap;
+
+static void
+model_random( misc_region_t *region, ModelBitmap *model )
+{
+     int i, n = rand() % 6;
+
+     misc_region_init( region, NULL );
+
+     memset( model, 0, sizeof(ModelBitmap) );
+
+     for (i=0; i<n; i++) {
+          int x, y;
+          int x1 = rand() % GRID;
+          int y1 = rand() % GRID;
+          int w  = 1 + rand() % (GRID - x1);
+          int h  = 1 + rand() % (GRID - y1);
+
+          misc_region_union_rect( region, region, x1, y1, w, h );
+
+          for (y=y1; y<y1+h; y++) {
+               for (x=x1; x<x1+w; x++)
+                    model->pixels[y][x] = true;
+          }
+     }
+}
+
+static bool
+model_compare( misc_region_t *region, const ModelBitmap *model, const char *op, int iteration )
+{
+     int          i, n, x, y;
+     misc_box_t  *boxes;
+     ModelBitmap  actual;
+
+     if (!misc_region_selfcheck( region )) {
+          D_ERROR( "Region/Model: Invalid region after %s (iteration %d)!\n", op, iteration );
+          goto failed;
+     }
+
+     memset( &actual, 0, sizeof(ModelBitmap) );
+
+     boxes = misc_region_boxes( region, &n );
+
+     for (i=0; i<n; i++) {
+          if (boxes[i].x1 < 0 || boxes[i].y1 < 0 || boxes[i].x2 > GRID || boxes[i].y2 > GRID) {
+               D_ERROR( "Region/Model: Box %d,%d-%d,%d outside of grid after %s (iteration %d)!\n",
+                        boxes[i].x1, boxes[i].y1, boxes[i].x2, boxes[i].y2, op, iteration );
+               goto failed;
+          }
+
+          for (y=boxes[i].y1; y<boxes[i].y2; y++) {
+               for (x=boxes[i].x1; x<boxes[i].x2; x++)
+                    actual.pixels[y][x] = true;
+          }
+     }
+
+     for (y=0; y<GRID; y++) {
+          for (x=0; x<GRID; x++) {
+               if (actual.pixels[y][x] != model->pixels[y][x]) {
+                    D_ERROR( "Region/Model: Pixel %d,%d is %s after %s (iteration %d)!\n",
+                             x, y, actual.pixels[y][x] ? "set" : "not set", op, iteration );
+                    goto failed;
+               }
+          }
+     }
+
+     return true;
+
+failed:
+     failures++;
+
+     return false;
+}
+
+typedef enum {
+     MODEL_UNION,
+     MODEL_INTERSECT,
+     MODEL_SUBTRACT
+} ModelOp;
+
+static void
+model_apply( ModelOp op, ModelBitmap *result, const ModelBitmap *a, const ModelBitmap *b )
+{
+     int x, y;
+
+     for (y=0; y<GRID; y++) {
+          for (x=0; x<GRID; x++) {
+               switch (op) {
+                    case MODEL_UNION:
+                         result->pixels[y][x] = a->pixels[y][x] || b->pixels[y][x];
+                         break;
+
+                    case MODEL_INTERSECT:
+                         result->pixels[y][x] = a->pixels[y][x] && b->pixels[y][x];
+                         break;
+
+                    case MODEL_SUBTRACT:
+                         result->pixels[y][x] = a->pixels[y][x] && !b->pixels[y][x];
+                         break;
+               }
+          }
+     }
+}
+
+static void
+region_apply( ModelOp op, misc_region_t *result, misc_region_t *a, misc_region_t *b )
+{
+     switch (op) {
+          case MODEL_UNION:
+               misc_region_union( result, a, b );
+               break;
+
+          case MODEL_INTERSECT:
+               misc_region_intersect( result, a, b );
+               break;
+
+          case MODEL_SUBTRACT:
+               misc_region_subtract( result, a, b );
+               break;
+     }
+}
+
+/*
+ * Checks an operation with distinct arguments and with the result aliasing either argument.
+ */
+static void
+model_check_op( ModelOp op, const char *name, misc_region_t *a, const ModelBitmap *ma,
+                misc_region_t *b, const ModelBitmap *mb, int iteration )
+{
+     char          what[32];
+     misc_region_t result;
+     ModelBitmap   expected;
+
+     model_apply( op, &expected, ma, mb );
+
+     misc_region_init( &result, NULL );
+     region_apply( op, &result, a, b );
+     model_compare( &result, &expected, name, iteration );
+
+     snprintf( what, sizeof(what), "%s (result = a)", name );
+     misc_region_copy( &result, a );
+     region_apply( op, &result, &result, b );
+     model_compare( &result, &expected, what, iteration );
+
+     snprintf( what, sizeof(what), "%s (result = b)", name );
+     misc_region_copy( &result, b );
+     region_apply( op, &result, a, &result );
+     model_compare( &result, &expected, what, iteration );
+
+     /* Same region for all arguments. */
+     model_apply( op, &expected, ma, ma );
+
+     snprintf( what, sizeof(what), "%s (a = b)", name );
+     region_apply( op, &result, a, a );
+     model_compare( &result, &expected, what, iteration );
+
+     snprintf( what, sizeof(what), "%s (result = a = b)", name );
+     misc_region_copy( &result, a );
+     region_apply( op, &result, &result, &result );
+     model_compare( &result, &expected, what, iteration );
+
+     misc_region_deinit( &result );
+}
+
+static void
+model_check_contains( misc_region_t *region, const ModelBitmap *model, int iteration )
+{
+     int                   x, y;
+     int                   in = 0, out = 0;
+     misc_box_t            box;
+     misc_region_overlap_t expected;
+     misc_region_overlap_t overlap;
+
+     box.x1 = rand() % GRID;
+     box.y1 = rand() % GRID;
+     box.x2 = box.x1 + 1 + rand() % (GRID - box.x1);
+     box.y2 = box.y1 + 1 + rand() % (GRID - box.y1);
+
+     for (y=box.y1; y<box.y2; y++) {
+          for (x=box.x1; x<box.x2; x++) {
+               if (model->pixels[y][x])
+                    in++;
+               else
+                    out++;
+          }
+     }
+
+     expected = !in ? MISC_REGION_OUT : !out ? MISC_REGION_IN : MISC_REGION_PART;
+
+     overlap = misc_region_contains_rectangle( region, &box );
+     if (overlap != expected) {
+          D_ERROR( "Region/Model: Box %d,%d-%d,%d overlap is %d instead of %d (iteration %d)!\n",
+                   box.x1, box.y1, box.x2, box.y2, overlap, expected, iteration );
+          failures++;
+     }
+}
+
+static void
+run_model( void )
+{
+     int           n;
+     int           errors = failures;
+     misc_region_t a, b;
+     ModelBitmap   ma, mb;
+
+     srand( 42 );
+
+     for (n=0; n<num_models; n++) {
+          model_random( &a, &ma );
+          model_random( &b, &mb );
+
+          if (!model_compare( &a, &ma, "union_rect", n ) || !model_compare( &b, &mb, "union_rect", n )) {
+               misc_region_deinit( &a );
+               misc_region_deinit( &b );
+               continue;
+          }
+
+          model_check_op( MODEL_UNION,     "union",     &a, &ma, &b, &mb, n );
+          model_check_op( MODEL_INTERSECT, "intersect", &a, &ma, &b, &mb, n );
+          model_check_op( MODEL_SUBTRACT,  "subtract",  &a, &ma, &b, &mb, n );
+
+          model_check_contains( &a, &ma, n );
+
+          misc_region_deinit( &a );
+          misc_region_deinit( &b );
+     }
+
+     D_INFO( "Region/Model: %d random region pairs checked, %d failures\n", num_models, failures - errors );
+}
+
+typedef enum {
+     OP_UNION,
+     OP_SUBTRACT,
+     OP_INTERSECT,
+     OP_CONTAINS,
+     _OP_NUM
+} BenchOp;
+
+static const char *op_names[_OP_NUM] = { "union", "subtract", "intersect", "contains" };
+
+/*
+ * Runs a window stack like workload: the region is built from num_windows rectangles,
+ * then every window is subtracted from, intersected with or tested against it.
+ */
+static void
+run_bench( BenchOp op )
+{
+     int           i, n;
+     long long     ops = 0;
+     unsigned int  rects = 0;
+     DirectClock   clock;
+     misc_region_t region;
+     misc_region_t window;
+     misc_region_t result;
+
+     srand( 23 );
+
+     misc_region_init( &result, NULL );
+
+     direct_clock_start( &clock );
+
+     for (n=0; n<num_loops; n++) {
+          misc_region_init( &region, NULL );
+
+          for (i=0; i<num_windows; i++) {
+               random_rect( &window );
+
+               switch (op) {
+                    case OP_UNION:
+                         misc_region_union( &region, &region, &window );
+                         verify( &region, "union" );
+                         ops++;
+                         break;
+
+                    case OP_SUBTRACT:
+                    case OP_INTERSECT:
+                    case OP_CONTAINS:
+                         misc_region_union( &region, &region, &window );
+                         break;
+
+                    default:
+                         break;
+               }
+
+               misc_region_deinit( &window );
+          }
+
+          if (op != OP_UNION) {
+               for (i=0; i<num_windows; i++) {
+                    random_rect( &window );
+
+                    switch (op) {
+                         case OP_SUBTRACT:
+                              misc_region_subtract( &result, &region, &window );
+                              verify( &result, "subtract" );
+                              break;
+
+                         case OP_INTERSECT:
+                              misc_region_intersect( &result, &region, &window );
+                              verify( &result, "intersect" );
+                              break;
+
+                         case OP_CONTAINS:
+                              misc_region_contains_rectangle( &region, &window.extents );
+                              break;
+
+                         default:
+                              break;
+                    }
+
+                    ops++;
+
+                    misc_region_deinit( &window );
+               }
+          }
+
+          rects += misc_region_n_rects( &region );
+
+          misc_region_deinit( &region );
+     }
+
+     direct_clock_stop( &clock );
+
+     misc_region_deinit( &result );
+
+     D_INFO( "Region/Bench: %-10s %8lld ops in %lld.%03lld seconds (%lld.%03lld us/op, %u rects/region)\n",
+             op_names[op], ops, DIRECT_CLOCK_DIFF_SEC_MS( &clock ),
+             direct_clock_diff( &clock ) * 1000 / ops / 1000, direct_clock_diff( &clock ) * 1000 / ops % 1000,
+             rects / num_loops );
+}
+
+int
+main( int argc, char *argv[] )
+{
+     int i;
+
+     if (parse_cmdline( argc, argv ))
+          return -1;
+
+     run_model();
+
+     for (i=0; i<_OP_NUM; i++)
+          run_bench( i );
+
+     misc_region_pool_flush();
+
+     return failures ? 1 : 0;
+}
+
+/**********************************************************************************************************************/
+
+static int
+parse_cmdline( int argc, char *argv[] )
+{
+     int i;
+
+     for (i=1; i<argc; i++) {
+          if (!strcmp( argv[i], "-c" ))
+               check = true;
+          else if (!strcmp( argv[i], "-w" ) && ++i < argc)
+               num_windows = atoi( argv[i] );
+          else if (!strcmp( argv[i], "-l" ) && ++i < argc)
+               num_loops = atoi( argv[i] );
+          else if (!strcmp( argv[i], "-m" ) && ++i < argc)
+               num_models = atoi( argv[i] );
+          else
+               return show_usage();
+     }
+
+     if (num_windows < 1 || num_loops < 1 || num_models < 0)
+          return show_usage();
+
+     return 0;
+}
+
+static int
+show_usage( void )
+{
+     fprintf( stderr, "\n"
+                      "Usage:\n"
+                      "   dfbtest_region [options]\n"
+                      "\n"
+                      "Options:\n"
+                      "   -c        Check regions after each operation\n"
+                      "   -w <num>  Number of windows (default 64)\n"
+                      "   -l <num>  Number of loops (default 2000)\n"
+                      "   -m <num>  Number of random region pairs compared to a bitmap model (default 20000)\n"
+                      "\n"
+              );
+
+     return -1;
+}
+
@@ -0,0 +1,240 @@
+/*
+   (c) Copyright 2012-2013  DirectFB integrated media GmbH
+   (c) Copyright 2001-2013  The world wide DirectFB Open Source Community (directfb.org)
+   (c) Copyright 2000-2004  Convergence (integrated media) GmbH
+
+   All rights reserved.
+
+   Written by Denis Oliver Kropp <dok@directfb.org>,
+              Andreas Shimokawa <andi@directfb.org>,
+              Marek Pikarski <mass@directfb.org>,
+              Sven Neumann <neo@directfb.org>,
+              Ville Syrjälä <syrjala@sci.fi> and
+              Claudio Ciccani <klan@users.sf.net>.
+
+   This file is subject to the terms and conditions of the MIT License:
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without restriction,
+   including without limitation the rights to use, copy, modify, merge,
+   publish, distribute, sublicense, and/or sell copies of the Software,
+   and to permit persons to whom the Software is furnished to do so,
+   subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+   IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+   CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+   TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+   SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <direct/messages.h>
+
+#include <directfb.h>
+#include <directfb_util.h>
+
+#define MAX_WINDOWS 32
+
+/**********************************************************************************************************************/
+
+static int
+print_usage( const char *prg )
+{
+     fprintf (stderr, "\n");
+     fprintf (stderr, "== DirectFB Restack Test (version %s) ==\n", DIRECTFB_VERSION);
+     fprintf (stderr, "\n");
+     fprintf (stderr, "Usage: %s [options]\n", prg);
+     fprintf (stderr, "\n");
+     fprintf (stderr, "Options:\n");
+     fprintf (stderr, "  -h, --help                        Show this help message\n");
+     fprintf (stderr, "  -v, --version                     Print version information\n");
+     fprintf (stderr, "  -w, --windows <num>               Number of overlapping windows (default 8)\n");
+     fprintf (stderr, "  -l, --loops <num>                 Number of restack rounds (default 50)\n");
+
+     return -1;
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Sums up the pixels of all layer updates arriving within a short time after a restack.
+ */
+static long long
+collect_updates( IDirectFBEventBuffer *events )
+{
+     long long pixels = 0;
+     DFBEvent  event;
+
+     while (events->WaitForEventWithTimeout( events, 0, 50 ) == DFB_OK) {
+          while (events->GetEvent( events, &event ) == DFB_OK) {
+               if (event.clazz == DFEC_SURFACE && event.surface.type == DSEVT_UPDATE)
+                    pixels += (long long)(event.surface.update.x2 - event.surface.update.x1 + 1) *
+                                         (event.surface.update.y2 - event.surface.update.y1 + 1);
+          }
+     }
+
+     return pixels;
+}
+
+int
+main( int argc, char *argv[] )
+{
+     DFBResult               ret;
+     int                     i, n;
+     int                     num_windows = 8;
+     int                     num_loops   = 50;
+     int                     created     = 0;
+     int                     width, height;
+     long long               pixels[4]   = { 0, 0, 0, 0 };
+     static const char      *names[4]    = { "RaiseToTop", "LowerToBottom", "Raise", "Lower" };
+     DFBWindowDescription    desc;
+     DFBDisplayLayerConfig   config;
+     IDirectFB              *dfb;
+     IDirectFBDisplayLayer  *layer   = NULL;
+     IDirectFBSurface       *surface = NULL;
+     IDirectFBEventBuffer   *events  = NULL;
+     IDirectFBWindow        *windows[MAX_WINDOWS];
+
+     /* Initialize DirectFB. */
+     ret = DirectFBInit( &argc, &argv );
+     if (ret) {
+          D_DERROR( ret, "DFBTest/Restack: DirectFBInit() failed!\n" );
+          return ret;
+     }
+
+     /* Parse arguments. */
+     for (i=1; i<argc; i++) {
+          const char *arg = argv[i];
+
+          if (strcmp( arg, "-h" ) == 0 || strcmp (arg, "--help") == 0)
+               return print_usage( argv[0] );
+          else if (strcmp (arg, "-v") == 0 || strcmp (arg, "--version") == 0) {
+               fprintf (stderr, "dfbtest_restack version %s\n", DIRECTFB_VERSION);
+               return false;
+          }
+          else if ((strcmp (arg, "-w") == 0 || strcmp (arg, "--windows") == 0) && ++i < argc)
+               num_windows = atoi( argv[i] );
+          else if ((strcmp (arg, "-l") == 0 || strcmp (arg, "--loops") == 0) && ++i < argc)
+               num_loops = atoi( argv[i] );
+          else
+               return print_usage( argv[0] );
+     }
+
+     if (num_windows < 2 || num_windows > MAX_WINDOWS || num_loops < 1)
+          return print_usage( argv[0] );
+
+     /* Create super interface. */
+     ret = DirectFBCreate( &dfb );
+     if (ret) {
+          D_DERROR( ret, "DFBTest/Restack: DirectFBCreate() failed!\n" );
+          return ret;
+     }
+
+     /* Get primary layer. */
+     ret = dfb->GetDisplayLayer( dfb, DLID_PRIMARY, &layer );
+     if (ret) {
+          D_DERROR( ret, "DFBTest/Restack: IDirectFB::GetDisplayLayer( PRIMARY ) failed!\n" );
+          goto out;
+     }
+
+     layer->GetConfiguration( layer, &config );
+
+     width  = config.width;
+     height = config.height;
+
+     /* Get the layer surface to receive its updates. */
+     ret = layer->GetSurface( layer, &surface );
+     if (ret) {
+          D_DERROR( ret, "DFBTest/Restack: IDirectFBDisplayLayer::GetSurface() failed!\n" );
+          goto out;
+     }
+
+     ret = surface->CreateEventBuffer( surface, &events );
+     if (ret) {
+          D_DERROR( ret, "DFBTest/Restack: IDirectFBSurface::CreateEventBuffer() failed!\n" );
+          goto out;
+     }
+
+     /* Create a cascade of overlapping windows. */
+     desc.flags  = DWDESC_WIDTH | DWDESC_HEIGHT | DWDESC_POSX | DWDESC_POSY | DWDESC_CAPS;
+     desc.caps   = DWCAPS_NONE;
+     desc.width  = width / 3;
+     desc.height = height / 3;
+
+     for (n=0; n<num_windows; n++) {
+          IDirectFBSurface *window_surface;
+
+          desc.posx = n * (width  - desc.width)  / num_windows;
+          desc.posy = n * (height - desc.height) / num_windows;
+
+          ret = layer->CreateWindow( layer, &desc, &windows[n] );
+          if (ret) {
+               D_DERROR( ret, "DFBTest/Restack: IDirectFBDisplayLayer::CreateWindow() failed!\n" );
+               goto out;
+          }
+
+          created++;
+
+          windows[n]->GetSurface( windows[n], &window_surface );
+
+          window_surface->Clear( window_surface, 0x40 + n * 0xbf / num_windows, 0x80, 0xff - n * 0xbf / num_windows, 0xff );
+          window_surface->Flip( window_surface, NULL, DSFLIP_NONE );
+          window_surface->Release( window_surface );
+
+          windows[n]->SetOpacity( windows[n], 0xff );
+     }
+
+     collect_updates( events );
+
+     /* Restack windows in the middle of the cascade, counting the pixels repainted for each operation. */
+     for (i=0; i<num_loops; i++) {
+          IDirectFBWindow *window = windows[(i * 7 + num_windows / 2) % num_windows];
+
+          window->RaiseToTop( window );
+          pixels[0] += collect_updates( events );
+
+          window->LowerToBottom( window );
+          pixels[1] += collect_updates( events );
+
+          window->Raise( window );
+          pixels[2] += collect_updates( events );
+
+          window->Lower( window );
+          pixels[3] += collect_updates( events );
+     }
+
+     for (i=0; i<4; i++)
+          D_INFO( "DFBTest/Restack: %-14s %8lld pixels per restack (window has %d)\n",
+                  names[i], pixels[i] / num_loops, desc.width * desc.height );
+
+out:
+     for (n=0; n<created; n++)
+          windows[n]->Release( windows[n] );
+
+     if (events)
+          events->Release( events );
+
+     if (surface)
+          surface->Release( surface );
+
+     if (layer)
+          layer->Release( layer );
+
+     /* Shutdown DirectFB. */
+     dfb->Release( dfb );
+
+     return ret;
+}
+
@@ -57,6 +57,7 @@
 
 #include <core/CoreLayer.h>
 
+#include <core/compressed_surface_pool.h>
 #include <core/core.h>
 #include <core/layer_control.h>
 #include <core/layer_context.h>
@@ -90,6 +91,7 @@ static bool loop_mode;
 static bool show_shm;
 static bool show_pools;
 static bool show_allocs;
+static bool show_locks;
 static int  dump_layer;       /* ref or -1 (all) or 0 (none) */
 static int  dump_surface;     /* ref or -1 (all) or 0 (none) */
 
@@ -265,6 +267,51 @@ dump_surfaces( void )
 
 /**********************************************************************************************************************/
 
+static bool
+lock_callback( FusionObjectPool *pool,
+               FusionObject     *object,
+               void             *ctx )
+{
+     CoreSurface                *surface = (CoreSurface*) object;
+     const CoreSurfaceLockStats *stats   = &surface->lock_stats;
+
+     if (object->state != FOS_ACTIVE)
+          return true;
+
+#if FUSION_BUILD_MULTI
+     printf( "0x%08x [%3lx] : ", object->ref.multi.id, object->identity );
+#else
+     printf( "N/A              : " );
+#endif
+
+     printf( "%4d x %4d  ", surface->config.size.w, surface->config.size.h );
+
+     printf( "%8u %8u %5u.%u%%  ", stats->locks, stats->contended,
+             stats->locks ? stats->contended * 100 / stats->locks : 0,
+             stats->locks ? stats->contended * 1000 / stats->locks % 10 : 0 );
+
+     printf( "%8lld %7lld  ", stats->wait_time / 1000, stats->wait_max );
+
+     printf( "%8lld %7lld  ", stats->hold_time / 1000, stats->hold_max );
+
+     printf( "%8u %8u\n", stats->shared, stats->shared_failed );
+
+     return true;
+}
+
+static void
+dump_surface_locks( void )
+{
+     printf( "\n"
+             "----------------------------------------[ Surface Locks ]-------------------------------------------------------\n" );
+     printf( "Reference   FID  . Width Height    Locks   Waited    Ratio  Wait(ms)  Max(us)  Hold(ms)  Max(us)    Shared   Failed\n" );
+     printf( "----------------------------------------------------------------------------------------------------------------\n" );
+
+     dfb_core_enum_surfaces( NULL, lock_callback, NULL );
+}
+
+/**********************************************************************************************************************/
+
 static DFBEnumerationResult
 alloc_callback( CoreSurfaceAllocation *alloc,
                 void                  *ctx )
@@ -481,6 +528,23 @@ surface_pool_info_callback( CoreSurfacePool *pool,
      return DFENUM_OK;
 }
 
+static void
+dump_compressed_backups( void )
+{
+     CompressedSurfacePoolStats stats;
+
+     if (dfb_compressed_surface_pool_get_stats( &stats ))
+          return;
+
+     printf( "\n" );
+     printf( "Compressed backups: %u written (%u compressed, %u uncompressed), %u restored\n",
+             stats.backups, stats.compressed, stats.stored, stats.restores );
+     printf( "                    %lluk in %lluk (%llu%%), restore avg %lld us, max %lld us\n",
+             stats.raw_bytes >> 10, stats.packed_bytes >> 10,
+             stats.raw_bytes ? stats.packed_bytes * 100 / stats.raw_bytes : 0,
+             stats.restores ? stats.restore_time / stats.restores : 0, stats.restore_max );
+}
+
 static void
 dump_surface_pool_info( void )
 {
@@ -490,6 +554,8 @@ dump_surface_pool_info( void )
      printf( "-------------------------------------------------------------------------------------------------\n" );
 
      dfb_surface_pools_enumerate( surface_pool_info_callback, NULL );
+
+     dump_compressed_backups();
 }
 
 /**********************************************************************************************************************/
@@ -855,6 +921,11 @@ main( int argc, char *argv[] )
           }
      #endif
 
+          if (show_locks) {
+               dump_surface_locks();
+               fflush( stdout );
+          }
+
           if (show_pools) {
                printf( "\n" );
                dump_surface_pool_info();
@@ -899,6 +970,7 @@ print_usage (const char *prg_name)
      fprintf (stderr, "   -s,  --shm          Show shared memory pool content (if debug enabled)\n");
      fprintf (stderr, "   -p,  --pools        Show information about surface pools\n");
      fprintf (stderr, "   -a,  --allocs       Show surface buffer allocations in surface pools\n");
+     fprintf (stderr, "   -k,  --locks        Show surface lock contention (waiting/holding times, shared front buffer reads)\n");
      fprintf (stderr, "   -dl, --dumplayer    Dump surfaces of layer contexts into files (dfb_layer_context_REFID...)\n");
      fprintf (stderr, "   -ds, --dumpsurface  Dump surfaces (front buffers) into files (dfb_surface_REFID...)\n");
      fprintf (stderr, "   -h,  --help         Show this help message\n");
@@ -944,6 +1016,11 @@ parse_command_line( int argc, char *argv[] )
                continue;
           }
 
+          if (strcmp (arg, "-k") == 0 || strcmp (arg, "--locks") == 0) {
+               show_locks = true;
+               continue;
+          }
+
           if (strcmp (arg, "-dl") == 0 || strcmp (arg, "--dumplayer") == 0) {
                dump_layer = -1;
                continue;
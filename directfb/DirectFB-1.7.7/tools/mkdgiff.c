@@ -48,6 +48,8 @@
 #include <direct/mem.h>
 #include <direct/memcpy.h>
 #include <direct/direct.h>
+#include <direct/system.h>
+#include <direct/thread.h>
 
 #include <gfx/convert.h>
 
@@ -58,6 +60,7 @@
 #include FT_GLYPH_H
 
 #define MAX_SIZE_COUNT    256
+#define MAX_JOB_COUNT      64
 #define MAX_ROW_WIDTH    2047
 
 D_DEBUG_DOMAIN( mkdgiff, "mkdgiff", "DirectFB Glyph Image File Format Tool" );
@@ -73,6 +76,28 @@ static int                    face_sizes[MAX_SIZE_COUNT];
 
 static bool                   premult;
 
+static int                    job_count;
+static unsigned long          row_align;
+
+/**********************************************************************************************************************/
+
+typedef struct {
+     int                      size;
+     int                      ret;
+
+     DGIFFFaceHeader          header;
+     DGIFFGlyphInfo          *glyphs;
+     DGIFFGlyphRow           *rows;
+     void                   **row_data;
+     int                      num_rows;
+} FaceJob;
+
+static FaceJob                jobs[MAX_SIZE_COUNT];
+static int                    next_job;
+static DirectMutex            jobs_lock;
+
+static unsigned long          file_offset;
+
 /**********************************************************************************************************************/
 
 static void
@@ -86,6 +111,8 @@ print_usage (const char *prg_name)
      fprintf (stderr, "   -f, --format    <pixelformat>   Choose the pixel format (default A8)\n");
      fprintf (stderr, "   -s, --sizes     <s1>[,s2...]    Choose sizes to generate glyph images for\n");
      fprintf (stderr, "   -p, --premult                   Use premultiplied alpha\n");
+     fprintf (stderr, "   -a, --align     <bytes>         Align row data in the file (default page size, 0 for none)\n");
+     fprintf (stderr, "   -j, --jobs      <number>        Render sizes in parallel (default number of CPUs)\n");
      fprintf (stderr, "   -h, --help                      Show this help message\n");
      fprintf (stderr, "   -v, --version                   Print version information\n");
      fprintf (stderr, "\n");
@@ -219,6 +246,26 @@ parse_command_line( int argc, char *argv[] )
                continue;
           }
 
+          if (strcmp (arg, "-a") == 0 || strcmp (arg, "--align") == 0) {
+               if (++n == argc) {
+                    print_usage (argv[0]);
+                    return DFB_FALSE;
+               }
+
+               row_align = strtoul( argv[n], NULL, 10 );
+               continue;
+          }
+
+          if (strcmp (arg, "-j") == 0 || strcmp (arg, "--jobs") == 0) {
+               if (++n == argc) {
+                    print_usage (argv[0]);
+                    return DFB_FALSE;
+               }
+
+               job_count = atoi( argv[n] );
+               continue;
+          }
+
           if (filename || access( arg, R_OK )) {
                print_usage (argv[0]);
                return DFB_FALSE;
@@ -427,20 +474,23 @@ write_glyph( DGIFFGlyphInfo *glyph, FT_GlyphSlot slot, void *dst, int pitch )
      }
 }
 
+/*
+ * Rasterizes all glyphs of one size into rows kept in memory, written later by write_face().
+ */
 static int
-do_face( FT_Face face, int size )
+render_face( FT_Face face, FaceJob *job )
 {
      int              i, ret;
      int              align        = DFB_PIXELFORMAT_ALIGNMENT( format );
+     int              size         = job->size;
      int              num_glyphs   = 0;
      int              num_rows     = 1;
      int              row_index    = 0;
      int              row_offset   = 0;
-     int              next_face    = sizeof(DGIFFFaceHeader);
      int              total_height = 0;
      FT_ULong         code;
      FT_UInt          index;
-     DGIFFFaceHeader  header;
+     DGIFFFaceHeader *header       = &job->header;
      DGIFFGlyphInfo  *glyphs;
      DGIFFGlyphRow   *rows;
      void           **row_data;
@@ -448,7 +498,7 @@ do_face( FT_Face face, int size )
      D_DEBUG_AT( mkdgiff, "%s( %p, %d ) <- %ld glyphs\n", __FUNCTION__, face, size, face->num_glyphs );
 
      /* Clear to not leak any data into file. */
-     memset( &header, 0, sizeof(header) );
+     memset( header, 0, sizeof(*header) );
 
      /* Set the desired size. */
      ret = FT_Set_Char_Size( face, 0, size << 6, 0, 0 );
@@ -462,6 +512,10 @@ do_face( FT_Face face, int size )
      rows     = D_CALLOC( face->num_glyphs, sizeof(DGIFFGlyphRow) ); /* WORST case :) */
      row_data = D_CALLOC( face->num_glyphs, sizeof(void*) );         /* WORST case :) */
 
+     job->glyphs   = glyphs;
+     job->rows     = rows;
+     job->row_data = row_data;
+
      for (code = FT_Get_First_Char( face, &index );
           index;
           code = FT_Get_Next_Char( face, code, &index ))
@@ -480,7 +534,7 @@ do_face( FT_Face face, int size )
           ret = FT_Load_Glyph( face, index, FT_LOAD_RENDER );
           if (ret) {
                D_ERROR( "Could not render glyph for character index %d!\n", index );
-               goto out;
+               return ret;
           }
 
           slot = face->glyph;
@@ -507,6 +561,8 @@ do_face( FT_Face face, int size )
                row->height = glyph->height;
      }
 
+     job->num_rows = num_rows;
+
      for (i=0; i<num_rows; i++) {
           DGIFFGlyphRow *row = &rows[i];
 
@@ -517,15 +573,10 @@ do_face( FT_Face face, int size )
           row->pitch = (DFB_BYTES_PER_LINE( format, row->width ) + 7) & ~7;
 
           row_data[i] = D_CALLOC( row->height, row->pitch );
-
-          next_face += row->height * row->pitch;
      }
 
      D_DEBUG_AT( mkdgiff, "  -> %d glyphs, %d rows, total height %d\n", num_glyphs, num_rows, total_height );
 
-     next_face += num_glyphs * sizeof(DGIFFGlyphInfo);
-     next_face += num_rows * sizeof(DGIFFGlyphRow);
-
      for (i=0; i<num_glyphs; i++) {
           DGIFFGlyphInfo *glyph = &glyphs[i];
 
@@ -534,7 +585,7 @@ do_face( FT_Face face, int size )
           ret = FT_Load_Char( face, glyph->unicode, FT_LOAD_RENDER );
           if (ret) {
                D_ERROR( "Could not render glyph for unicode character 0x%x!\n", glyph->unicode );
-               goto out;
+               return ret;
           }
 
           if (row_offset > 0 && row_offset + glyph->width > MAX_ROW_WIDTH) {
@@ -557,46 +608,165 @@ do_face( FT_Face face, int size )
 
      D_ASSERT( row_index == num_rows - 1 );
 
-     header.next_face   = next_face;
-     header.size        = size;
+     header->size        = size;
 
-     header.ascender    = face->size->metrics.ascender >> 6;
-     header.descender   = face->size->metrics.descender >> 6;
-     header.height      = header.ascender - header.descender + 1;
+     header->ascender    = face->size->metrics.ascender >> 6;
+     header->descender   = face->size->metrics.descender >> 6;
+     header->height      = header->ascender - header->descender + 1;
 
-     header.max_advance = face->size->metrics.max_advance >> 6;
+     header->max_advance = face->size->metrics.max_advance >> 6;
 
-     header.pixelformat = format;
+     header->pixelformat = format;
 
-     header.num_glyphs  = num_glyphs;
-     header.num_rows    = num_rows;
+     header->num_glyphs  = num_glyphs;
+     header->num_rows    = num_rows;
 
-     D_DEBUG_AT( mkdgiff, "  -> ascender %d, descender %d\n", header.ascender, header.descender );
-     D_DEBUG_AT( mkdgiff, "  -> height %d, max advance %d\n", header.height, header.max_advance );
+     D_DEBUG_AT( mkdgiff, "  -> ascender %d, descender %d\n", header->ascender, header->descender );
+     D_DEBUG_AT( mkdgiff, "  -> height %d, max advance %d\n", header->height, header->max_advance );
 
-     fwrite( &header, sizeof(header), 1, stdout );
+     return 0;
+}
 
-     fwrite( glyphs, sizeof(*glyphs), num_glyphs, stdout );
+/**********************************************************************************************************************/
 
-     for (i=0; i<num_rows; i++) {
-          DGIFFGlyphRow *row = &rows[i];
+static void
+write_data( const void *data, size_t size )
+{
+     fwrite( data, size, 1, stdout );
 
-          fwrite( row, sizeof(*row), 1, stdout );
+     file_offset += size;
+}
 
-          fwrite( row_data[i], row->pitch, row->height, stdout );
+static void
+write_face( FaceJob *job )
+{
+     int            i;
+     unsigned long  offset = file_offset + sizeof(DGIFFFaceHeader) +
+                             job->header.num_glyphs * sizeof(DGIFFGlyphInfo);
+
+     for (i=0; i<job->num_rows; i++) {
+          DGIFFGlyphRow *row = &job->rows[i];
+
+          offset += dgiff_row_padding( offset, row_align ) + sizeof(DGIFFGlyphRow) + row->pitch * row->height;
      }
 
-out:
-     for (i=0; i<num_rows; i++) {
-          if (row_data[i])
-               D_FREE( row_data[i] );
+     job->header.next_face = offset - file_offset;
+
+     write_data( &job->header, sizeof(job->header) );
+
+     write_data( job->glyphs, job->header.num_glyphs * sizeof(DGIFFGlyphInfo) );
+
+     for (i=0; i<job->num_rows; i++) {
+          DGIFFGlyphRow *row     = &job->rows[i];
+          unsigned long  padding = dgiff_row_padding( file_offset, row_align );
+
+          dgiff_write_padding( stdout, padding );
+
+          file_offset += padding;
+
+          write_data( row, sizeof(*row) );
+
+          write_data( job->row_data[i], row->pitch * row->height );
      }
 
-     D_FREE( row_data );
-     D_FREE( rows );
-     D_FREE( glyphs );
+     D_ASSERT( file_offset == offset );
+}
 
-     return ret;
+static void
+free_face( FaceJob *job )
+{
+     int i;
+
+     if (job->row_data) {
+          for (i=0; i<job->num_rows; i++) {
+               if (job->row_data[i])
+                    D_FREE( job->row_data[i] );
+          }
+
+          D_FREE( job->row_data );
+     }
+
+     if (job->rows)
+          D_FREE( job->rows );
+
+     if (job->glyphs)
+          D_FREE( job->glyphs );
+}
+
+/**********************************************************************************************************************/
+
+static int
+open_face( FT_Library *ret_library, FT_Face *ret_face )
+{
+     int        ret;
+     FT_Library library = NULL;
+     FT_Face    face    = NULL;
+
+     ret = FT_Init_FreeType( &library );
+     if (ret) {
+          D_ERROR( "Initialization of the FreeType2 library failed!\n" );
+          return ret;
+     }
+
+     ret = FT_New_Face( library, filename, face_index, &face );
+     if (ret) {
+          if (ret == FT_Err_Unknown_File_Format)
+               D_ERROR( "Unsupported font format in file `%s'!\n", filename );
+          else
+               D_ERROR( "Failed loading face %d from font file `%s'!\n", face_index, filename );
+
+          FT_Done_FreeType( library );
+          return ret;
+     }
+
+     ret = FT_Select_Charmap( face, ft_encoding_unicode );
+     if (ret) {
+          D_ERROR( "Couldn't select Unicode encoding, falling back to Latin1.\n" );
+
+          ret = FT_Select_Charmap( face, ft_encoding_latin_1 );
+          if (ret)
+               D_ERROR( "Couldn't even select Latin1 encoding!\n" );
+     }
+
+     *ret_library = library;
+     *ret_face    = face;
+
+     return 0;
+}
+
+/*
+ * Each worker has its own FreeType face, rendering the next size not yet taken.
+ */
+static void *
+render_thread( DirectThread *thread, void *arg )
+{
+     int        ret;
+     FT_Library library = NULL;
+     FT_Face    face    = NULL;
+
+     ret = open_face( &library, &face );
+
+     while (true) {
+          FaceJob *job;
+
+          direct_mutex_lock( &jobs_lock );
+
+          job = (next_job < size_count) ? &jobs[next_job++] : NULL;
+
+          direct_mutex_unlock( &jobs_lock );
+
+          if (!job)
+               break;
+
+          job->ret = ret ? ret : render_face( face, job );
+     }
+
+     if (!ret) {
+          FT_Done_Face( face );
+          FT_Done_FreeType( library );
+     }
+
+     return NULL;
 }
 
 /**********************************************************************************************************************/
@@ -612,15 +782,16 @@ static DGIFFHeader header = {
 int
 main( int argc, char *argv[] )
 {
-     int        i, ret;
-     FT_Library library = NULL;
-     FT_Face    face    = NULL;
+     int           i, ret = 0;
+     DirectThread *threads[MAX_JOB_COUNT];
 
      direct_initialize();
 
      direct_config->debug    = true;
      direct_config->debugmem = true;
 
+     row_align = direct_pagesize();
+
      /* Parse the command line. */
      if (!parse_command_line( argc, argv ))
           return -1;
@@ -643,49 +814,57 @@ main( int argc, char *argv[] )
           face_sizes[5] = 32;
      }
 
-     header.num_faces = size_count;
+     if (!job_count)
+          job_count = sysconf( _SC_NPROCESSORS_ONLN );
 
+     job_count = MAX( 1, MIN( job_count, MIN( size_count, MAX_JOB_COUNT ) ) );
 
-     ret = FT_Init_FreeType( &library );
-     if (ret) {
-          D_ERROR( "Initialization of the FreeType2 library failed!\n" );
-          goto out;
+     header.num_faces = size_count;
+
+     if (row_align) {
+          header.minor     = 1;
+          header.flags    |= DGIFF_FLAG_ALIGNED_ROWS;
+          header.row_align = row_align;
      }
 
-     ret = FT_New_Face( library, filename, face_index, &face );
-     if (ret) {
-          if (ret == FT_Err_Unknown_File_Format)
-               D_ERROR( "Unsupported font format in file `%s'!\n", filename );
-          else
-               D_ERROR( "Failed loading face %d from font file `%s'!\n", face_index, filename );
 
-          goto out;
-     }
+     /* Render all sizes in parallel. */
+     for (i=0; i<size_count; i++)
+          jobs[i].size = face_sizes[i];
 
-     ret = FT_Select_Charmap( face, ft_encoding_unicode );
-     if (ret) {
-          D_ERROR( "Couldn't select Unicode encoding, falling back to Latin1.\n" );
+     direct_mutex_init( &jobs_lock );
 
-          ret = FT_Select_Charmap( face, ft_encoding_latin_1 );
-          if (ret)
-               D_ERROR( "Couldn't even select Latin1 encoding!\n" );
+     for (i=0; i<job_count; i++)
+          threads[i] = direct_thread_create( DTT_DEFAULT, render_thread, NULL, "mkdgiff" );
+
+     for (i=0; i<job_count; i++) {
+          if (threads[i]) {
+               direct_thread_join( threads[i] );
+               direct_thread_destroy( threads[i] );
+          }
+          else
+               render_thread( NULL, NULL );
      }
 
-     fwrite( &header, sizeof(header), 1, stdout );
+     direct_mutex_deinit( &jobs_lock );
 
      for (i=0; i<size_count; i++) {
-          ret = do_face( face, face_sizes[i] );
+          ret = jobs[i].ret;
           if (ret)
                goto out;
      }
 
 
-out:
-     if (face)
-          FT_Done_Face( face );
+     /* Write the file in order of sizes. */
+     write_data( &header, sizeof(header) );
+
+     for (i=0; i<size_count; i++)
+          write_face( &jobs[i] );
 
-     if (library)
-          FT_Done_FreeType( library );
+
+out:
+     for (i=0; i<size_count; i++)
+          free_face( &jobs[i] );
 
      direct_print_memleaks();
 
@@ -693,5 +872,3 @@ out:
 
      return ret;
 }
-
-
@@ -63,6 +63,7 @@ extern "C" {
 #include <direct/mem.h>
 #include <direct/memcpy.h>
 #include <direct/direct.h>
+#include <direct/system.h>
 
 #include <gfx/convert.h>
 
@@ -81,6 +82,9 @@ static DirectFBSurfaceBlittingFlagsNames( m_bflags );
 
 static const char            *filename;
 static DFBSurfacePixelFormat  m_format = DSPF_ARGB;
+static unsigned long          m_align;
+
+static unsigned long          m_offset;
 
 /**********************************************************************************************************************/
 
@@ -93,6 +97,7 @@ print_usage (const char *prg_name)
      fprintf (stderr, "Usage: %s [options]\n\n", prg_name);
      fprintf (stderr, "Options:\n");
      fprintf (stderr, "   -f, --format   <pixelformat>   Choose the pixel format (default ARGB)\n");
+     fprintf (stderr, "   -a, --align     <bytes>         Align row data in the file (default page size, 0 for none)\n");
      fprintf (stderr, "   -s, --sizes    <s1>[,s2...]    Choose sizes to generate glyph images for\n");
      fprintf (stderr, "   -h, --help                     Show this help message\n");
      fprintf (stderr, "   -v, --version                  Print version information\n");
@@ -188,6 +193,16 @@ parse_command_line( int argc, char *argv[] )
                continue;
           }
 
+          if (strcmp (arg, "-a") == 0 || strcmp (arg, "--align") == 0) {
+               if (++n == argc) {
+                    print_usage (argv[0]);
+                    return DFB_FALSE;
+               }
+
+               m_align = strtoul( argv[n], NULL, 10 );
+               continue;
+          }
+
           if (filename || access( arg, R_OK )) {
                print_usage (argv[0]);
                return DFB_FALSE;
@@ -803,6 +818,14 @@ write_glyph( DGIFFGlyphInfo *glyph, const DFBSurfaceDescription &desc, void *dst
      }
 }
 
+static void
+write_data( const void *data, size_t size )
+{
+     fwrite( data, size, 1, stdout );
+
+     m_offset += size;
+}
+
 static int
 do_face( const Face *face )
 {
@@ -812,7 +835,7 @@ do_face( const Face *face )
      int              num_rows     = 1;
      int              row_index    = 0;
      int              row_offset   = 0;
-     int              next_face    = sizeof(DGIFFFaceHeader);
+     unsigned long    next_face;
      int              total_height = 0;
 
      Entity::vector   glyph_vector;
@@ -889,14 +912,17 @@ do_face( const Face *face )
           row->pitch = (DFB_BYTES_PER_LINE( m_format, row->width ) + 7) & ~7;
 
           row_data[i] = D_CALLOC( row->height, row->pitch );
-
-          next_face += row->height * row->pitch;
      }
 
      D_DEBUG_AT( mkdgiff, "  -> %d glyphs, %d rows, total height %d\n", num_glyphs, num_rows, total_height );
 
-     next_face += num_glyphs * sizeof(DGIFFGlyphInfo);
-     next_face += num_rows * sizeof(DGIFFGlyphRow);
+     /* Rows may be preceded by padding, see DGIFF_FLAG_ALIGNED_ROWS. */
+     next_face = m_offset + sizeof(DGIFFFaceHeader) + num_glyphs * sizeof(DGIFFGlyphInfo);
+
+     for (i=0; i<num_rows; i++)
+          next_face += dgiff_row_padding( next_face, m_align ) + sizeof(DGIFFGlyphRow) + rows[i].height * rows[i].pitch;
+
+     next_face -= m_offset;
 
      for (i=0; i<num_glyphs; i++) {
           DGIFFGlyphInfo *glyph = &glyphs[i];
@@ -942,16 +968,21 @@ do_face( const Face *face )
      D_DEBUG_AT( mkdgiff, "  -> ascender %d, descender %d\n", header.ascender, header.descender );
      D_DEBUG_AT( mkdgiff, "  -> height %d, max advance %d\n", header.height, header.max_advance );
 
-     fwrite( &header, sizeof(header), 1, stdout );
+     write_data( &header, sizeof(header) );
 
-     fwrite( glyphs, sizeof(*glyphs), num_glyphs, stdout );
+     write_data( glyphs, num_glyphs * sizeof(*glyphs) );
 
      for (i=0; i<num_rows; i++) {
-          DGIFFGlyphRow *row = &rows[i];
+          DGIFFGlyphRow *row     = &rows[i];
+          unsigned long  padding = dgiff_row_padding( m_offset, m_align );
+
+          dgiff_write_padding( stdout, padding );
+
+          m_offset += padding;
 
-          fwrite( row, sizeof(*row), 1, stdout );
+          write_data( row, sizeof(*row) );
 
-          fwrite( row_data[i], row->pitch, row->height, stdout );
+          write_data( row_data[i], row->pitch * row->height );
      }
 
      for (i=0; i<num_rows; i++) {
@@ -991,6 +1022,8 @@ main( int argc, char *argv[] )
      direct_config->debug    = true;
      direct_config->debugmem = true;
 
+     m_align = direct_pagesize();
+
      /* Parse the command line. */
      if (!parse_command_line( argc, argv ))
           return -1;
@@ -1024,9 +1057,14 @@ main( int argc, char *argv[] )
 
      header.num_faces = faces.size();
 
+     if (m_align) {
+          header.minor     = 1;
+          header.flags    |= DGIFF_FLAG_ALIGNED_ROWS;
+          header.row_align = m_align;
+     }
 
 
-     fwrite( &header, sizeof(header), 1, stdout );
+     write_data( &header, sizeof(header) );
 
      for (Entity::vector::const_iterator iter = faces.begin(); iter != faces.end(); iter++) {
           const Face *face = dynamic_cast<const Face*>( *iter );
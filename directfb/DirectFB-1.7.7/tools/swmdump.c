@@ -337,6 +337,25 @@ dump_tiers( SaWMan *sawman )
      }
 }
 
+static void
+dump_stats( SaWMan                 *sawman,
+            DFBWindowStackingClass  stacking,
+            const char             *name )
+{
+     unsigned int hits, misses;
+     unsigned int blits, merged;
+     unsigned int frames, missed;
+
+     if (sawman_get_scale_stats( sawman, stacking, true, &hits, &misses ) == DFB_OK)
+          D_INFO( "Scale cache [%s]: %u hits, %u misses\n", name, hits, misses );
+
+     if (sawman_get_event_stats( sawman, stacking, true, &blits, &merged ) == DFB_OK)
+          D_INFO( "Blit events [%s]: %u sent, %u merged\n", name, blits, merged );
+
+     if (sawman_get_schedule_stats( sawman, stacking, true, &frames, &missed ) == DFB_OK)
+          D_INFO( "Schedule [%s]: %u frames, %u missed\n", name, frames, missed );
+}
+
 /**********************************************************************************************************************/
 
 static void
@@ -486,6 +505,13 @@ main( int argc, char *argv[] )
           saw->GetPerformance( saw, DWSC_LOWER, DFB_TRUE, &updates, &pixels, &duration );
           saw->GetPerformance( saw, DWSC_UPPER, DFB_TRUE, &updates, &pixels, &duration );
 
+          sawman_get_scale_stats( data->sawman, DWSC_LOWER, true, NULL, NULL );
+          sawman_get_scale_stats( data->sawman, DWSC_UPPER, true, NULL, NULL );
+          sawman_get_event_stats( data->sawman, DWSC_LOWER, true, NULL, NULL );
+          sawman_get_event_stats( data->sawman, DWSC_UPPER, true, NULL, NULL );
+          sawman_get_schedule_stats( data->sawman, DWSC_LOWER, true, NULL, NULL );
+          sawman_get_schedule_stats( data->sawman, DWSC_UPPER, true, NULL, NULL );
+
           while (true) {
                unsigned int mpixels;
 
@@ -503,6 +529,8 @@ main( int argc, char *argv[] )
                D_INFO( "Performance [LOWER]: %u updates (%u /sec), %u Mpixels (%u /sec)\n",
                        updates, updates * 1000 / (int)duration, mpixels, mpixels * 1000 / (int)duration );
 
+               dump_stats( data->sawman, DWSC_LOWER, "LOWER" );
+
 
                ret = saw->GetPerformance( saw, DWSC_UPPER, DFB_TRUE, &updates, &pixels, &duration );
                if (ret) {
@@ -516,6 +544,8 @@ main( int argc, char *argv[] )
 
                     D_INFO( "Performance [UPPER]: %u updates (%u /sec), %u Mpixels (%u /sec)\n",
                             updates, updates * 1000 / (int)duration, mpixels, mpixels * 1000 / (int)duration );
+
+                    dump_stats( data->sawman, DWSC_UPPER, "UPPER" );
                }
           }
      }
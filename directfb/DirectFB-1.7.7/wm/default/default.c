@@ -96,6 +96,15 @@ typedef struct {
 #define MAX_UPDATING_REGIONS       8    /* updated region to be scheduled for display */
 #define MAX_UPDATED_REGIONS        8    /* updated region scheduled for display */
 
+#define HIT_GRID_COLS             16    /* spatial index for pointer hit tests */
+#define HIT_GRID_ROWS             16
+#define HIT_CELL_WINDOWS           8    /* more windows in one cell fall back to scanning the stack */
+
+#define SHAPE_MASK_READ_BYTES  16384    /* chunk size for reading a shaped window's front buffer */
+
+#define HIT_GRID_COL(data,x)      CLAMP( (long long) (x) * HIT_GRID_COLS / MAX( (data)->hit_size.w, 1 ), 0, HIT_GRID_COLS - 1 )
+#define HIT_GRID_ROW(data,y)      CLAMP( (long long) (y) * HIT_GRID_ROWS / MAX( (data)->hit_size.h, 1 ), 0, HIT_GRID_ROWS - 1 )
+
 typedef struct {
      CoreDFB                      *core;
 
@@ -107,6 +116,11 @@ typedef struct {
      FusionSkirmish                update_skirmish;
 } WMData;
 
+typedef struct {
+     int                           num;                /* > HIT_CELL_WINDOWS if overflown */
+     u16                           windows[HIT_CELL_WINDOWS];   /* indices into the stack, bottom to top */
+} HitCell;
+
 typedef struct {
      int                           magic;
 
@@ -159,6 +173,10 @@ typedef struct {
      CoreSurface                  *surface;
      Reaction                      surface_reaction;
      DFB_Task                     *last_notify_task;
+
+     bool                          hit_valid;          /* grid matches stacking order and bounds */
+     DFBDimension                  hit_size;
+     HitCell                       hit_cells[HIT_GRID_ROWS][HIT_GRID_COLS];
 } StackData;
 
 typedef struct {
@@ -171,6 +189,11 @@ typedef struct {
      int                           priority;           /* derived from stacking class */
 
      CoreLayerRegionConfig         config;
+
+     u32                          *mask;               /* input mask of a shaped window, one bit per pixel */
+     int                           mask_pitch;         /* in words */
+     DFBDimension                  mask_size;
+     bool                          mask_valid;         /* cleared on each flip */
 } WindowData;
 
 /**************************************************************************************************/
@@ -481,6 +504,334 @@ get_keyboard_window( CoreWindowStack     *stack,
      return NULL;
 }
 
+/*
+ * Tells whether a pixel of a shaped window (read from its front buffer) takes pointer input.
+ */
+static bool
+shape_pixel_hit( const CoreWindow *window,
+                 CoreSurface      *surface,
+                 const u8         *buf )
+{
+     DFBWindowOptions      options = window->config.options;
+     DFBSurfacePixelFormat format  = surface->config.format;
+
+     if (options & DWOP_ALPHACHANNEL) {
+          int alpha = -1;
+
+          D_ASSERT( DFB_PIXELFORMAT_HAS_ALPHA( format ) );
+
+          switch (format) {
+               case DSPF_AiRGB:
+                    alpha = 0xff - (*(u32*)(buf) >> 24);
+                    break;
+               case DSPF_ARGB:
+               case DSPF_ABGR:
+               case DSPF_AYUV:
+               case DSPF_AVYU:
+                    alpha = *(u32*)(buf) >> 24;
+                    break;
+               case DSPF_ARGB8565:
+#ifdef WORDS_BIGENDIAN
+                    alpha = buf[0];
+#else
+                    alpha = buf[2];
+#endif
+                    break;
+               case DSPF_RGBA5551:
+                    alpha = *(u16*)(buf) & 0x1;
+                    alpha = alpha ? 0xff : 0x00;
+                    break;
+               case DSPF_ARGB1555:
+               case DSPF_ARGB2554:
+               case DSPF_ARGB4444:
+                    alpha = *(u16*)(buf) & 0x8000;
+                    alpha = alpha ? 0xff : 0x00;
+                    break;
+               case DSPF_RGBA4444:
+                    alpha = *(u16*)(buf) & 0x0008;
+                    alpha = alpha ? 0xff : 0x00;
+                    break;
+               case DSPF_RGBAF88871:
+                    alpha = *(u32*)(buf) & 0x000000fe;
+                    alpha |= alpha >> 7;
+                    break;
+               case DSPF_ALUT44:
+                    alpha = *(u8*)(buf) & 0xf0;
+                    alpha |= alpha >> 4;
+                    break;
+               case DSPF_LUT1:
+               case DSPF_LUT2:
+               case DSPF_LUT8: {
+                    CorePalette *palette = surface->palette;
+                    u8           pix     = *((u8*) buf);
+
+                    if (palette && pix < palette->num_entries) {
+                         alpha = palette->entries[pix].a;
+                         break;
+                    }
+
+
+                    /* fall through */
+               }
+
+               default:
+                    D_ONCE( "unknown format 0x%x", surface->config.format );
+                    break;
+          }
+
+          if (alpha) /* alpha == -1 on error */
+               return true;
+     }
+
+     if (options & DWOP_COLORKEYING) {
+          int       pixel = 0;
+          const u8 *p;
+
+          switch (format) {
+               case DSPF_ARGB:
+               case DSPF_ABGR:
+               case DSPF_AiRGB:
+               case DSPF_RGB32:
+                    pixel = *(u32*)(buf) & 0x00ffffff;
+                    break;
+
+               case DSPF_RGBAF88871:
+                    pixel = *(u32*)(buf) & 0xffffff00;
+                    break;
+
+               case DSPF_RGB24:
+                    p = (buf);
+#ifdef WORDS_BIGENDIAN
+                    pixel = (p[0] << 16) | (p[1] << 8) | p[2];
+#else
+                    pixel = (p[2] << 16) | (p[1] << 8) | p[0];
+#endif
+                    break;
+
+               case DSPF_RGB16:
+                    pixel = *(u16*)(buf);
+                    break;
+
+               case DSPF_ARGB4444:
+               case DSPF_RGB444:
+                    pixel = *(u16*)(buf)
+                            & 0x0fff;
+                    break;
+
+               case DSPF_RGBA4444:
+                    pixel = *(u16*)(buf)
+                            & 0xfff0;
+                    break;
+
+               case DSPF_ARGB8565:
+                    p = (buf);
+#ifdef WORDS_BIGENDIAN
+                    pixel = p[1] << 8 | p[2];
+#else
+                    pixel = p[1] << 8 | p[0];
+#endif
+                    break;
+
+               case DSPF_ARGB1555:
+               case DSPF_RGB555:
+               case DSPF_BGR555:
+                    pixel = *(u16*)(buf)
+                            & 0x7fff;
+                    break;
+
+               case DSPF_RGBA5551:
+                    pixel = *(u16*)(buf)
+                            & 0xfffe;
+                    break;
+
+               case DSPF_RGB332:
+               case DSPF_LUT8:
+                    pixel = *(u8*)(buf);
+                    break;
+
+               case DSPF_ALUT44:
+                    pixel = *(u8*)(buf)
+                            & 0x0f;
+                    break;
+
+               default:
+                    D_ONCE( "unknown format 0x%x", surface->config.format );
+                    break;
+          }
+
+          if (pixel != window->config.color_key)
+               return true;
+     }
+
+     return false;
+}
+
+/*
+ * Rebuilds the 1-bit input mask of a shaped window from its front buffer,
+ * so that hit tests don't need to lock the surface until the next flip.
+ */
+static bool
+update_shape_mask( CoreWindow *window,
+                   WindowData *data )
+{
+     CoreSurface           *surface = window->surface;
+     DFBSurfacePixelFormat  format  = surface->config.format;
+     int                    width   = surface->config.size.w;
+     int                    height  = surface->config.size.h;
+     int                    bpp     = DFB_BYTES_PER_PIXEL( format );
+     int                    pitch   = (width + 31) / 32;
+     int                    lines;
+     int                    x, y, n;
+     u8                    *buf;
+
+     if (bpp < 1 || DFB_PLANAR_PIXELFORMAT( format ))
+          return false;
+
+     if (!data->mask || data->mask_size.w != width || data->mask_size.h != height) {
+          if (data->mask)
+               SHFREE( window->stack->shmpool, data->mask );
+
+          data->mask = SHMALLOC( window->stack->shmpool, pitch * height * 4 );
+          if (!data->mask)
+               return false;
+
+          data->mask_size.w = width;
+          data->mask_size.h = height;
+          data->mask_pitch  = pitch;
+     }
+
+     lines = MAX( 1, SHAPE_MASK_READ_BYTES / (width * bpp) );
+
+     buf = D_MALLOC( width * bpp * lines );
+     if (!buf)
+          return false;
+
+     memset( data->mask, 0, pitch * height * 4 );
+
+     for (y=0; y<height; y+=lines) {
+          DFBRectangle rect = { 0, y, width, MIN( lines, height - y ) };
+
+          if (dfb_surface_read_buffer( surface, CSBR_FRONT, buf, width * bpp, &rect )) {
+               D_FREE( buf );
+               return false;
+          }
+
+          for (n=0; n<rect.h; n++) {
+               const u8 *src  = buf + n * width * bpp;
+               u32      *mask = data->mask + (y + n) * pitch;
+
+               for (x=0; x<width; x++, src += bpp) {
+                    if (shape_pixel_hit( window, surface, src ))
+                         mask[x >> 5] |= 1 << (x & 31);
+               }
+          }
+     }
+
+     D_FREE( buf );
+
+     data->mask_valid = true;
+
+     return true;
+}
+
+static bool
+window_hit( CoreWindow *window,
+            int         x,
+            int         y )
+{
+     CoreWindowConfig *config  = &window->config;
+     DFBWindowOptions  options = config->options;
+     DFBRectangle      rotated;
+     DFBRectangle     *bounds  = &rotated;
+     WindowData       *data    = window->window_data;
+     CoreSurface      *surface = window->surface;
+     int               wx, wy;
+     u8                buf[8];
+     DFBRectangle      rect;
+
+     if ((options & DWOP_GHOST) || !config->opacity)
+          return false;
+
+     transform_window_to_stack( window, &config->bounds, &rotated );
+
+     if (x < bounds->x  ||  x >= bounds->x + bounds->w ||
+         y < bounds->y  ||  y >= bounds->y + bounds->h)
+          return false;
+
+     wx = x - bounds->x;
+     wy = y - bounds->y;
+
+     if ( !(options & DWOP_SHAPED)  ||
+          !(options &(DWOP_ALPHACHANNEL|DWOP_COLORKEYING))
+          || !surface ||
+          ((options & DWOP_OPAQUE_REGION) &&
+           (wx >= config->opaque.x1  &&  wx <= config->opaque.x2 &&
+            wy >= config->opaque.y1  &&  wy <= config->opaque.y2)))
+          return true;
+
+     if (wx >= surface->config.size.w || wy >= surface->config.size.h)
+          return false;
+
+     if ((data->mask_valid &&
+          data->mask_size.w == surface->config.size.w &&
+          data->mask_size.h == surface->config.size.h) || update_shape_mask( window, data ))
+          return (data->mask[wy * data->mask_pitch + (wx >> 5)] >> (wx & 31)) & 1;
+
+     /* Fall back to reading the single pixel. */
+     rect.x = wx;
+     rect.y = wy;
+     rect.w = 1;
+     rect.h = 1;
+
+     if (dfb_surface_read_buffer( surface, CSBR_FRONT, buf, 8, &rect ) == DFB_OK)
+          return shape_pixel_hit( window, surface, buf );
+
+     return false;
+}
+
+/*
+ * Spreads the windows over a coarse grid covering the stack, each cell listing
+ * the windows overlapping it from bottom to top.
+ */
+static void
+update_hit_grid( CoreWindowStack *stack,
+                 StackData       *data )
+{
+     int         i;
+     int         cx, cy;
+     CoreWindow *window;
+
+     memset( data->hit_cells, 0, sizeof(data->hit_cells) );
+
+     data->hit_size.w = stack->width;
+     data->hit_size.h = stack->height;
+     data->hit_valid  = true;
+
+     fusion_vector_foreach (window, i, data->windows) {
+          DFBRectangle bounds;
+          int          col1, col2, row1, row2;
+
+          transform_window_to_stack( window, &window->config.bounds, &bounds );
+
+          col1 = HIT_GRID_COL( data, bounds.x );
+          col2 = HIT_GRID_COL( data, bounds.x + bounds.w - 1 );
+          row1 = HIT_GRID_ROW( data, bounds.y );
+          row2 = HIT_GRID_ROW( data, bounds.y + bounds.h - 1 );
+
+          for (cy=row1; cy<=row2; cy++) {
+               for (cx=col1; cx<=col2; cx++) {
+                    HitCell *cell = &data->hit_cells[cy][cx];
+
+                    if (cell->num < HIT_CELL_WINDOWS && i < 0x10000)
+                         cell->windows[cell->num] = i;
+
+                    if (cell->num <= HIT_CELL_WINDOWS)
+                         cell->num++;
+               }
+          }
+     }
+}
+
 static CoreWindow*
 window_at_pointer( CoreWindowStack *stack,
                    StackData       *data,
@@ -490,6 +841,7 @@ window_at_pointer( CoreWindowStack *stack,
 {
      int         i;
      CoreWindow *window;
+     HitCell    *cell;
 
      D_ASSERT( stack != NULL );
      D_ASSERT( data != NULL );
@@ -507,185 +859,26 @@ window_at_pointer( CoreWindowStack *stack,
      if (y < 0)
           y = stack->cursor.y;
 
-     fusion_vector_foreach_reverse (window, i, data->windows) {
-          CoreWindowConfig *config  = &window->config;
-          DFBWindowOptions  options = config->options;
-          DFBRectangle      rotated;
-          DFBRectangle     *bounds  = &rotated;
+     if (!data->hit_valid || data->hit_size.w != stack->width || data->hit_size.h != stack->height)
+          update_hit_grid( stack, data );
 
-          transform_window_to_stack( window, &config->bounds, &rotated );
+     cell = &data->hit_cells[HIT_GRID_ROW( data, y )][HIT_GRID_COL( data, x )];
 
-          if (!(options & DWOP_GHOST) && config->opacity &&
-              x >= bounds->x  &&  x < bounds->x + bounds->w &&
-              y >= bounds->y  &&  y < bounds->y + bounds->h)
-          {
-               int wx = x - bounds->x;
-               int wy = y - bounds->y;
-
-               if ( !(options & DWOP_SHAPED)  ||
-                    !(options &(DWOP_ALPHACHANNEL|DWOP_COLORKEYING))
-                    || !window->surface ||
-                    ((options & DWOP_OPAQUE_REGION) &&
-                     (wx >= config->opaque.x1  &&  wx <= config->opaque.x2 &&
-                      wy >= config->opaque.y1  &&  wy <= config->opaque.y2)))
-               {
-                    return window;
-               }
-               else {
-                    u8                     buf[8];
-                    CoreSurface           *surface = window->surface;
-                    DFBSurfacePixelFormat  format  = surface->config.format;
-                    DFBRectangle           rect    = { wx, wy, 1, 1 };
-
-                    if (dfb_surface_read_buffer( surface, CSBR_FRONT, buf, 8, &rect ) == DFB_OK) {
-                         if (options & DWOP_ALPHACHANNEL) {
-                              int alpha = -1;
-
-                              D_ASSERT( DFB_PIXELFORMAT_HAS_ALPHA( format ) );
-
-                              switch (format) {
-                                   case DSPF_AiRGB:
-                                        alpha = 0xff - (*(u32*)(buf) >> 24);
-                                        break;
-                                   case DSPF_ARGB:
-                                   case DSPF_ABGR:
-                                   case DSPF_AYUV:
-                                   case DSPF_AVYU:
-                                        alpha = *(u32*)(buf) >> 24;
-                                        break;
-                                   case DSPF_ARGB8565:
-#ifdef WORDS_BIGENDIAN
-                                        alpha = buf[0];
-#else
-                                        alpha = buf[2];
-#endif
-                                        break;
-                                   case DSPF_RGBA5551:
-                                        alpha = *(u16*)(buf) & 0x1;
-                                        alpha = alpha ? 0xff : 0x00;
-                                        break;
-                                   case DSPF_ARGB1555:
-                                   case DSPF_ARGB2554:
-                                   case DSPF_ARGB4444:
-                                        alpha = *(u16*)(buf) & 0x8000;
-                                        alpha = alpha ? 0xff : 0x00;
-                                        break;
-                                   case DSPF_RGBA4444:
-                                        alpha = *(u16*)(buf) & 0x0008;
-                                        alpha = alpha ? 0xff : 0x00;
-                                        break;
-                                   case DSPF_RGBAF88871:
-                                        alpha = *(u32*)(buf) & 0x000000fe;
-                                        alpha |= alpha >> 7;
-                                        break;
-                                   case DSPF_ALUT44:
-                                        alpha = *(u8*)(buf) & 0xf0;
-                                        alpha |= alpha >> 4;
-                                        break;
-                                   case DSPF_LUT1:
-                                   case DSPF_LUT2:
-                                   case DSPF_LUT8: {
-                                        CorePalette *palette = surface->palette;
-                                        u8           pix     = *((u8*) buf);
-
-                                        if (palette && pix < palette->num_entries) {
-                                             alpha = palette->entries[pix].a;
-                                             break;
-                                        }
-
-
-                                        /* fall through */
-                                   }
-
-                                   default:
-                                        D_ONCE( "unknown format 0x%x", surface->config.format );
-                                        break;
-                              }
-
-                              if (alpha) /* alpha == -1 on error */
-                                   return window;
-                         }
-                         if (options & DWOP_COLORKEYING) {
-                              int pixel = 0;
-                              u8 *p;
-                              switch (format) {
-                                   case DSPF_ARGB:
-                                   case DSPF_ABGR:
-                                   case DSPF_AiRGB:
-                                   case DSPF_RGB32:
-                                        pixel = *(u32*)(buf) & 0x00ffffff;
-                                        break;
-
-                                   case DSPF_RGBAF88871:
-                                        pixel = *(u32*)(buf) & 0xffffff00;
-                                        break;
-
-                                   case DSPF_RGB24:
-                                        p = (buf);
-#ifdef WORDS_BIGENDIAN
-                                        pixel = (p[0] << 16) | (p[1] << 8) | p[2];
-#else
-                                        pixel = (p[2] << 16) | (p[1] << 8) | p[0];
-#endif
-                                        break;
-
-                                   case DSPF_RGB16:
-                                        pixel = *(u16*)(buf);
-                                        break;
+     if (cell->num <= HIT_CELL_WINDOWS && data->windows.count <= 0x10000) {
+          for (i=cell->num-1; i>=0; i--) {
+               window = fusion_vector_at( &data->windows, cell->windows[i] );
 
-                                   case DSPF_ARGB4444:
-                                   case DSPF_RGB444:
-                                        pixel = *(u16*)(buf)
-                                                & 0x0fff;
-                                        break;
-
-                                   case DSPF_RGBA4444:
-                                        pixel = *(u16*)(buf)
-                                                & 0xfff0;
-                                        break;
+               if (window_hit( window, x, y ))
+                    return window;
+          }
 
-                                   case DSPF_ARGB8565:
-                                        p = (buf);
-#ifdef WORDS_BIGENDIAN
-                                        pixel = p[1] << 8 | p[2];
-#else
-                                        pixel = p[1] << 8 | p[0];
-#endif
-                                        break;
-
-                                   case DSPF_ARGB1555:
-                                   case DSPF_RGB555:
-                                   case DSPF_BGR555:
-                                        pixel = *(u16*)(buf)
-                                                & 0x7fff;
-                                        break;
-
-                                   case DSPF_RGBA5551:
-                                        pixel = *(u16*)(buf)
-                                                & 0xfffe;
-                                        break;
-
-                                   case DSPF_RGB332:
-                                   case DSPF_LUT8:
-                                        pixel = *(u8*)(buf);
-                                        break;
-
-                                   case DSPF_ALUT44:
-                                        pixel = *(u8*)(buf)
-                                                & 0x0f;
-                                        break;
-
-                                   default:
-                                        D_ONCE( "unknown format 0x%x", surface->config.format );
-                                        break;
-                              }
+          return NULL;
+     }
 
-                              if (pixel != config->color_key)
-                                   return window;
-                         }
-                    }
-               }
-          }
+     /* Too many windows overlapping the cell. */
+     fusion_vector_foreach_reverse (window, i, data->windows) {
+          if (window_hit( window, x, y ))
+               return window;
      }
 
      return NULL;
@@ -1967,6 +2160,72 @@ update_window( CoreWindow          *window,
      return DFB_OK;
 }
 
+/*
+     restacking only changes where the window overlaps the windows it passed,
+     the window has already been moved from 'old' to 'index'
+*/
+static void
+update_restack( CoreWindow *window,
+                WindowData *window_data,
+                int         old,
+                int         index )
+{
+     int              i;
+     int              from, to;
+     int              changed;
+     StackData       *data;
+     CoreWindowStack *stack;
+     DFBRectangle     bounds;
+
+     D_ASSERT( window != NULL );
+     D_ASSERT( window_data != NULL );
+     D_ASSERT( window_data->stack_data != NULL );
+     D_ASSERT( window_data->stack_data->stack != NULL );
+     D_ASSERT( old != index );
+
+     data  = window_data->stack_data;
+     stack = data->stack;
+
+     if (!VISIBLE_WINDOW(window) || stack->hw_mode)
+          return;
+
+     if (index > old) {
+          /* raised, passed windows are below it now */
+          from    = old;
+          to      = index - 1;
+          changed = index;
+     }
+     else {
+          /* lowered, passed windows are above it now and may not be skipped even if opaque */
+          from    = index + 1;
+          to      = old;
+          changed = old;
+     }
+
+     transform_window_to_stack( window, &window->config.bounds, &bounds );
+
+     for (i=from; i<=to; i++) {
+          CoreWindow   *other = fusion_vector_at( &data->windows, i );
+          DFBRectangle  overlap;
+          DFBRegion     update;
+
+          if (!VISIBLE_WINDOW(other))
+               continue;
+
+          transform_window_to_stack( other, &other->config.bounds, &overlap );
+
+          if (!dfb_rectangle_intersect( &overlap, &bounds ))
+               continue;
+
+          update = DFB_REGION_INIT_FROM_RECTANGLE( &overlap );
+
+          if (!dfb_unsafe_region_intersect( &update, 0, 0, stack->width - 1, stack->height - 1 ))
+               continue;
+
+          wind_of_change( stack, data, &update, DSFLIP_NONE, fusion_vector_size( &data->windows ) - 1, changed );
+     }
+}
+
 /**************************************************************************************************/
 /**************************************************************************************************/
 
@@ -2003,6 +2262,8 @@ insert_window( WMData          *wmdata,
      /* Insert the window at the acquired position. */
      fusion_vector_insert( &data->windows, window, index );
 
+     data->hit_valid = false;
+
      window->flags |= CWF_INSERTED;
 
      dfb_wm_dispatch_WindowState( wmdata->core, window );
@@ -2099,6 +2360,8 @@ remove_window( WMData          *wmdata,
 
      fusion_vector_remove( &data->windows, fusion_vector_index_of( &data->windows, window ) );
 
+     data->hit_valid = false;
+
      window->flags &= ~CWF_INSERTED;
 
      dfb_wm_dispatch_WindowState( wmdata->core, window );
@@ -2140,6 +2403,8 @@ move_window( CoreWindow *window,
           update_window( window, data, NULL, 0, false, false, false );
      }
 
+     data->stack_data->hit_valid = false;
+
      /* Send new position */
      evt.type = DWET_POSITION;
      evt.x    = bounds->x;
@@ -2223,6 +2488,8 @@ resize_window( CoreWindow *window,
      bounds->w = width;
      bounds->h = height;
 
+     data->stack_data->hit_valid = false;
+
      /* Send new size */
      evt.type = DWET_SIZE;
      evt.w    = bounds->w;
@@ -2279,6 +2546,8 @@ set_window_bounds( CoreWindow *window,
      window->config.bounds.w = width;
      window->config.bounds.h = height;
 
+     data->stack_data->hit_valid = false;
+
      new_region.x1 = 0;
      new_region.y1 = 0;
      new_region.x2 = width  - 1;
@@ -2437,9 +2706,11 @@ restack_window( WMData                 *wmdata,
      /* Actually change the stacking order now. */
      fusion_vector_move( &data->windows, old, index );
 
+     data->hit_valid = false;
+
      dfb_wm_dispatch_WindowRestack( wmdata->core, window, index );
 
-     update_window( window, window_data, NULL, DSFLIP_NONE, (index < old), false, false );
+     update_restack( window, window_data, old, index );
 
      return DFB_OK;
 }
@@ -4051,6 +4322,12 @@ wm_remove_window( CoreWindowStack *stack,
 
      remove_window( wmdata, stack, sdata, window, data );
 
+     if (data->mask) {
+          SHFREE( stack->shmpool, data->mask );
+
+          data->mask = NULL;
+     }
+
      /* Free key list. */
      if (window->config.keys) {
           SHFREE( stack->shmpool, window->config.keys );
@@ -4117,6 +4394,9 @@ wm_set_window_config( CoreWindow             *window,
      if (flags & CWCF_COLOR_KEY)
           window->config.color_key = config->color_key;
 
+     if (flags & (CWCF_OPTIONS | CWCF_COLOR_KEY))
+          ((WindowData*) window_data)->mask_valid = false;
+
      if (flags & CWCF_OPAQUE)
           window->config.opaque = config->opaque;
 
@@ -4151,6 +4431,8 @@ wm_set_window_config( CoreWindow             *window,
 
           window->config.rotation = config->rotation;
 
+          ((StackData*) stack->stack_data)->hit_valid = false;
+
           update_window( window, window_data, NULL, DSFLIP_NONE, false, false, false );
      }
 
@@ -4412,6 +4694,9 @@ wm_update_window( CoreWindow          *window,
 
      send_update_event( window, stack->stack_data, left_region );
 
+     /* Input mask is rebuilt on demand. */
+     ((WindowData*) window_data)->mask_valid = false;
+
      update_window( window, window_data, left_region, flags, false, false, true );
 
      process_updates( stack->stack_data, wm_data, stack, flags );
@@ -2052,6 +2052,12 @@ local_ref( WMData *wmdata )
                fusion_skirmish_dismiss( &wmdata->update_skirmish );
                return ret;
           }
+
+          /* Start threads for parallel composition if configured */
+          sawman_composer_init( wmdata );
+
+          /* Start thread repainting deferred updates and snapshots */
+          sawman_scheduler_init( wmdata );
      }
 
      wmdata->refs++;
@@ -2073,6 +2079,10 @@ local_unref( WMData *wmdata )
      fusion_skirmish_prevail( &wmdata->update_skirmish );
 
      if (!--wmdata->refs) {
+          sawman_scheduler_deinit( wmdata );
+
+          sawman_composer_deinit( wmdata );
+
           CoreGraphicsStateClient_Deinit( &wmdata->client );
 
           dfb_state_destroy( &wmdata->state );
@@ -3215,6 +3225,9 @@ wm_add_window( CoreWindowStack *stack,
           }
      }
 
+     misc_region_init( &sawwin->left.visible_region, sawwin->shmpool );
+     misc_region_init( &sawwin->right.visible_region, sawwin->shmpool );
+
      dfb_updates_init( &sawwin->left.visible, sawwin->left.visible_regions, D_ARRAY_SIZE(sawwin->left.visible_regions) );
      dfb_updates_init( &sawwin->left.updates, sawwin->left.updates_regions, D_ARRAY_SIZE(sawwin->left.updates_regions) );
 
@@ -3398,6 +3411,12 @@ wm_remove_window( CoreWindowStack *stack,
                     sawwin->parent_window = NULL;
                }
 
+               misc_region_deinit( &sawwin->left.visible_region );
+               misc_region_deinit( &sawwin->right.visible_region );
+
+               sawman_release_scaled( sawman, sawwin );
+               sawman_release_snapshot( sawman, sawwin );
+
                D_MAGIC_CLEAR( sawwin );
                break;
 
@@ -4548,14 +4567,40 @@ wm_update_window( CoreWindow          *window,
           sawman_post_event( sawman, sawwin, &event );
      }
 
-     if (!SAWMAN_VISIBLE_WINDOW(window) || !data->active)
+     if (!SAWMAN_VISIBLE_WINDOW(window) || !data->active) {
+          /* Content of a hidden window changed, drop its pre-scaled copy. */
+          if (sawwin->scaled.valid && !sawman_lock( sawman )) {
+               sawwin->scaled.valid   = false;
+               sawwin->scaled.flipped = true;
+
+               sawman_unlock( sawman );
+          }
+
+          /* Previews are also shown for hidden windows. */
+          if (sawwin->snapshot.size.w && !sawman_lock( sawman )) {
+               sawwin->snapshot.dirty = true;
+
+               sawman_process_updates( sawman, DSFLIP_NONE, wmdata );
+
+               sawman_unlock( sawman );
+          }
+
           return DFB_OK;
+     }
 
      /* Lock SaWMan. */
      ret = sawman_lock( sawman );
      if (ret)
           return ret;
 
+     /* Pre-scaled copy is stale, stretch directly while the window keeps flipping. */
+     sawwin->scaled.valid   = false;
+     sawwin->scaled.flipped = true;
+
+     /* Snapshot is taken with the next processing of updates. */
+     if (sawwin->snapshot.size.w)
+          sawwin->snapshot.dirty = true;
+
      /* Check for window being inserted. */
      if (!(sawwin->flags & SWMWF_INSERTED)) {
           D_DEBUG_AT( SaWMan_WM, "  -> window %d not inserted!\n", window->id );
@@ -5240,6 +5285,10 @@ wm_update_cursor( CoreWindowStack       *stack,
 
      fusion_skirmish_dismiss( &wmdata->update_skirmish );
 
+     /* Compose a directly scanned out window again while the cursor is over it. */
+     if (tier->cursor_drawn && sawman_scanout_release( sawman, NULL, &tier->cursor_region ))
+          sawman_process_updates( sawman, DSFLIP_NONE, wmdata );
+
      sawman_unlock( sawman );
 
      return DFB_OK;